@@ -0,0 +1,16 @@
+find_package(PkgConfig)
+
+if (PKG_CONFIG_FOUND)
+	pkg_check_modules(ZSTD libzstd>=1.4.0)
+endif()
+
+if (NOT ZSTD_FOUND)
+	include(FindPackageHandleStandardArgs)
+	find_path(ZSTD_INCLUDE_DIRS NAMES zstd.h)
+	find_library(ZSTD_LIBRARIES NAMES zstd)
+	find_package_handle_standard_args(Zstd DEFAULT_MSG ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS)
+endif()
+
+if(Zstd_FIND_REQUIRED AND NOT ZSTD_FOUND)
+	message(FATAL_ERROR "Could not find Zstandard")
+endif()
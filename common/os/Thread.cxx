@@ -35,7 +35,7 @@
 
 using namespace os;
 
-Thread::Thread() : running(false), threadId(NULL)
+Thread::Thread() : running(false), joinable(false), threadId(NULL)
 {
   mutex = new Mutex;
 
@@ -87,12 +87,19 @@ void Thread::start()
 #endif
 
   running = true;
+  joinable = true;
 }
 
 void Thread::wait()
 {
-  if (!isRunning())
-    return;
+  // The thread might already have finished, but it still has to be
+  // joined to free its resources
+  {
+    AutoMutex a(mutex);
+    if (!joinable)
+      return;
+    joinable = false;
+  }
 
 #ifdef WIN32
   DWORD ret;
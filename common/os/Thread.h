@@ -50,6 +50,7 @@ namespace os {
   private:
     Mutex *mutex;
     bool running;
+    bool joinable;
 
     void *threadId;
   };
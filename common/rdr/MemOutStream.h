@@ -50,6 +50,25 @@ namespace rdr {
 
     const uint8_t* data() { return start; }
 
+    // capacity() returns how much memory is currently allocated, and
+    // shrink() gives back anything above len bytes that isn't in use.
+
+    size_t capacity() { return end - start; }
+
+    void shrink(size_t len) {
+      if (len < length())
+        len = length();
+      if (len >= capacity())
+        return;
+
+      uint8_t* newStart = new uint8_t[len];
+      memcpy(newStart, start, ptr - start);
+      ptr = newStart + (ptr - start);
+      delete [] start;
+      start = newStart;
+      end = newStart + len;
+    }
+
   protected:
 
     // overrun() either doubles the buffer or adds enough space for
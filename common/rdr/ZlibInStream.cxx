@@ -97,6 +97,25 @@ bool ZlibInStream::fillBuffer()
   zs->next_out = (uint8_t*)end;
   zs->avail_out = availSpace();
 
+  // Don't touch the underlying stream once all of our data has been
+  // consumed, as there might be something else after it. There might
+  // still be output pending inside zlib though, e.g. if the last match
+  // didn't fit in our buffer.
+  if (bytesIn == 0) {
+    zs->next_in = Z_NULL;
+    zs->avail_in = 0;
+
+    int rc = inflate(zs, Z_SYNC_FLUSH);
+    if ((rc < 0) && (rc != Z_BUF_ERROR))
+      throw Exception("ZlibInStream: inflate failed");
+
+    if (zs->next_out == end)
+      return false;
+
+    end = zs->next_out;
+    return true;
+  }
+
   if (!underlying->hasData(1))
     return false;
   size_t length = underlying->avail();
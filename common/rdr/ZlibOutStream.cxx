@@ -21,6 +21,7 @@
 #include <config.h>
 #endif
 
+#include <assert.h>
 #include <stdio.h>
 
 #include <rdr/ZlibOutStream.h>
@@ -36,18 +37,9 @@ static rfb::LogWriter vlog("ZlibOutStream");
 using namespace rdr;
 
 ZlibOutStream::ZlibOutStream(OutStream* os, int compressLevel)
-  : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel)
+  : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel),
+    zs(NULL)
 {
-  zs = new z_stream;
-  zs->zalloc    = Z_NULL;
-  zs->zfree     = Z_NULL;
-  zs->opaque    = Z_NULL;
-  zs->next_in   = Z_NULL;
-  zs->avail_in  = 0;
-  if (deflateInit(zs, compressLevel) != Z_OK) {
-    delete zs;
-    throw Exception("ZlibOutStream: deflateInit failed");
-  }
 }
 
 ZlibOutStream::~ZlibOutStream()
@@ -56,8 +48,10 @@ ZlibOutStream::~ZlibOutStream()
     flush();
   } catch (Exception&) {
   }
-  deflateEnd(zs);
-  delete zs;
+  if (zs != NULL) {
+    deflateEnd(zs);
+    delete zs;
+  }
 }
 
 void ZlibOutStream::setUnderlying(OutStream* os)
@@ -89,8 +83,41 @@ void ZlibOutStream::cork(bool enable)
     underlying->cork(enable);
 }
 
+size_t ZlibOutStream::getMemoryUsage()
+{
+  if (zs == NULL)
+    return 0;
+
+  // From zconf.h, using the default windowBits and memLevel
+  return (1 << (MAX_WBITS + 2)) + (1 << (8 + 9));
+}
+
+void ZlibOutStream::init()
+{
+  assert(zs == NULL);
+
+  zs = new z_stream;
+  zs->zalloc    = Z_NULL;
+  zs->zfree     = Z_NULL;
+  zs->opaque    = Z_NULL;
+  zs->next_in   = Z_NULL;
+  zs->avail_in  = 0;
+  if (deflateInit(zs, newLevel) != Z_OK) {
+    delete zs;
+    zs = NULL;
+    throw Exception("ZlibOutStream: deflateInit failed");
+  }
+
+  compressionLevel = newLevel;
+}
+
 bool ZlibOutStream::flushBuffer()
 {
+  // The compressor uses quite a bit of memory, so don't set it up
+  // until it is actually needed
+  if (zs == NULL)
+    init();
+
   checkCompressionLevel();
 
   zs->next_in = sentUpTo;
@@ -43,7 +43,13 @@ namespace rdr {
     virtual void flush();
     virtual void cork(bool enable);
 
+    // getMemoryUsage() returns an estimate of the memory used by the
+    // compressor. Nothing is allocated until data is first written.
+    size_t getMemoryUsage();
+
   private:
+    void init();
+
     virtual bool flushBuffer();
     void deflate(int flush);
     void checkCompressionLevel();
@@ -0,0 +1,145 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include <rdr/ZstdInStream.h>
+#include <rdr/Exception.h>
+
+#include <zstd.h>
+
+using namespace rdr;
+
+ZstdInStream::ZstdInStream()
+  : underlying(0), dctx(NULL), bytesIn(0), pendingOutput(false)
+{
+  init();
+}
+
+ZstdInStream::~ZstdInStream()
+{
+  deinit();
+}
+
+void ZstdInStream::setUnderlying(InStream* is, size_t bytesIn_)
+{
+  underlying = is;
+  bytesIn = bytesIn_;
+  skip(avail());
+}
+
+void ZstdInStream::flushUnderlying()
+{
+  while (bytesIn > 0) {
+    if (!hasData(1))
+      throw Exception("ZstdInStream: failed to flush remaining stream data");
+    skip(avail());
+  }
+
+  while (pendingOutput && hasData(1))
+    skip(avail());
+
+  setUnderlying(NULL, 0);
+}
+
+void ZstdInStream::reset()
+{
+  deinit();
+  init();
+}
+
+void ZstdInStream::init()
+{
+  size_t rc;
+
+  assert(dctx == NULL);
+
+  dctx = ZSTD_createDCtx();
+  if (dctx == NULL)
+    throw Exception("ZstdInStream: ZSTD_createDCtx failed");
+
+  rc = ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax, maxWindowLog);
+  if (ZSTD_isError(rc)) {
+    ZSTD_freeDCtx(dctx);
+    dctx = NULL;
+    throw Exception("ZstdInStream: ZSTD_DCtx_setParameter failed: %s",
+                    ZSTD_getErrorName(rc));
+  }
+
+  pendingOutput = false;
+}
+
+void ZstdInStream::deinit()
+{
+  assert(dctx != NULL);
+  setUnderlying(NULL, 0);
+  ZSTD_freeDCtx(dctx);
+  dctx = NULL;
+}
+
+bool ZstdInStream::fillBuffer()
+{
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  size_t rc;
+
+  if (!underlying)
+    throw Exception("ZstdInStream overrun: no underlying stream");
+
+  // Don't touch the underlying stream once all of our data has been
+  // consumed, as there might be something else after it
+  if ((bytesIn == 0) && !pendingOutput)
+    return false;
+
+  in.src = NULL;
+  in.size = 0;
+  in.pos = 0;
+
+  if (bytesIn > 0) {
+    if (underlying->hasData(1)) {
+      size_t length = underlying->avail();
+      if (length > bytesIn)
+        length = bytesIn;
+      in.src = underlying->getptr(length);
+      in.size = length;
+    } else if (!pendingOutput) {
+      return false;
+    }
+  }
+
+  out.dst = (uint8_t*)end;
+  out.size = availSpace();
+  out.pos = 0;
+
+  rc = ZSTD_decompressStream(dctx, &out, &in);
+  if (ZSTD_isError(rc))
+    throw Exception("ZstdInStream: decompression failed: %s",
+                    ZSTD_getErrorName(rc));
+
+  pendingOutput = (out.pos == out.size);
+
+  bytesIn -= in.pos;
+  end += out.pos;
+  if (in.pos > 0)
+    underlying->setptr(in.pos);
+  return true;
+}
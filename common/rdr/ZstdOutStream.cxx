@@ -0,0 +1,195 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include <rdr/ZstdInStream.h>
+#include <rdr/ZstdOutStream.h>
+#include <rdr/Exception.h>
+
+#include <zstd.h>
+
+using namespace rdr;
+
+// Zstandard levels for the RFB compression levels. The lowest level
+// trades ratio for LZ4 like speed, and the higher ones look for
+// matches in a much larger window than zlib can.
+static const int zstdLevels[10] = { -5, -1, 1, 2, 3, 4, 6, 8, 11, 15 };
+static const int defaultLevel = 2;
+
+// Long distance matching finds things like repeated windows and
+// scrolled text that have moved far back in the stream, if enabled
+static const int longDistanceLevel = 6;
+
+ZstdOutStream::ZstdOutStream(OutStream* os, int compressLevel)
+  : underlying(os), compressionLevel(-1), newLevel(-1),
+    longDistance(false), newLongDistance(false), cctx(NULL)
+{
+  setCompressionLevel(compressLevel);
+}
+
+ZstdOutStream::~ZstdOutStream()
+{
+  try {
+    flush();
+  } catch (Exception&) {
+  }
+  if (cctx != NULL)
+    ZSTD_freeCCtx(cctx);
+}
+
+void ZstdOutStream::setUnderlying(OutStream* os)
+{
+  underlying = os;
+  if (underlying)
+    underlying->cork(corked);
+}
+
+void ZstdOutStream::setCompressionLevel(int level)
+{
+  if (level < 0 || level > 9)
+    level = defaultLevel;
+
+  newLevel = level;
+}
+
+void ZstdOutStream::setLongDistance(bool enable)
+{
+  newLongDistance = enable;
+}
+
+void ZstdOutStream::flush()
+{
+  BufferedOutStream::flush();
+  if (underlying != NULL)
+    underlying->flush();
+}
+
+void ZstdOutStream::cork(bool enable)
+{
+  BufferedOutStream::cork(enable);
+  if (underlying != NULL)
+    underlying->cork(enable);
+}
+
+size_t ZstdOutStream::getMemoryUsage()
+{
+  if (cctx == NULL)
+    return 0;
+
+  return ZSTD_sizeof_CCtx(cctx);
+}
+
+void ZstdOutStream::init()
+{
+  assert(cctx == NULL);
+
+  cctx = ZSTD_createCCtx();
+  if (cctx == NULL)
+    throw Exception("ZstdOutStream: ZSTD_createCCtx failed");
+}
+
+bool ZstdOutStream::flushBuffer()
+{
+  // The compressor uses quite a bit of memory, so don't set it up
+  // until it is actually needed
+  if (cctx == NULL)
+    init();
+
+  checkCompressionLevel();
+
+  // Force out everything from the compressor
+  compress(corked ? ZSTD_e_continue : ZSTD_e_flush);
+
+  return true;
+}
+
+void ZstdOutStream::compress(int mode)
+{
+  ZSTD_inBuffer in;
+  size_t rc;
+
+  if (!underlying)
+    throw Exception("ZstdOutStream: underlying OutStream has not been set");
+
+  in.src = sentUpTo;
+  in.size = ptr - sentUpTo;
+  in.pos = 0;
+
+  if ((mode == ZSTD_e_continue) && (in.size == 0))
+    return;
+
+  do {
+    ZSTD_outBuffer out;
+
+    out.dst = underlying->getptr(1);
+    out.size = underlying->avail();
+    out.pos = 0;
+
+    rc = ZSTD_compressStream2(cctx, &out, &in, (ZSTD_EndDirective)mode);
+    if (ZSTD_isError(rc))
+      throw Exception("ZstdOutStream: compression failed: %s",
+                      ZSTD_getErrorName(rc));
+
+    underlying->setptr(out.pos);
+
+    // For flushes, rc is what is left in the compressor's buffers
+  } while ((in.pos < in.size) || ((mode != ZSTD_e_continue) && (rc != 0)));
+
+  sentUpTo += in.pos;
+}
+
+void ZstdOutStream::checkCompressionLevel()
+{
+  size_t rc;
+
+  if ((newLevel == compressionLevel) && (newLongDistance == longDistance))
+    return;
+
+  // Parameters can only be changed between frames, which means that
+  // the new frame starts without any history (-1 means no frame has
+  // been started yet)
+  if (compressionLevel != -1)
+    compress(ZSTD_e_end);
+
+  rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                              zstdLevels[newLevel]);
+  if (!ZSTD_isError(rc)) {
+    if (newLongDistance && (newLevel >= longDistanceLevel)) {
+      rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog,
+                                  ZstdInStream::maxWindowLog);
+      if (!ZSTD_isError(rc))
+        rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1);
+    } else {
+      // Back to what the level normally uses
+      rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, 0);
+      if (!ZSTD_isError(rc))
+        rc = ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 0);
+    }
+  }
+  if (ZSTD_isError(rc))
+    throw Exception("ZstdOutStream: ZSTD_CCtx_setParameter failed: %s",
+                    ZSTD_getErrorName(rc));
+
+  compressionLevel = newLevel;
+  longDistance = newLongDistance;
+}
@@ -0,0 +1,71 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ZstdOutStream streams to a compressed data stream (underlying),
+// compressing with Zstandard on the fly.
+//
+
+#ifndef __RDR_ZSTDOUTSTREAM_H__
+#define __RDR_ZSTDOUTSTREAM_H__
+
+#include <rdr/BufferedOutStream.h>
+
+struct ZSTD_CCtx_s;
+
+namespace rdr {
+
+  class ZstdOutStream : public BufferedOutStream {
+
+  public:
+
+    ZstdOutStream(OutStream* os=0, int compressionLevel=-1);
+    virtual ~ZstdOutStream();
+
+    void setUnderlying(OutStream* os);
+    // setCompressionLevel() takes the same 0-9 scale as ZlibOutStream,
+    // with -1 for the default
+    void setCompressionLevel(int level=-1);
+    // setLongDistance() lets levels 6 and above look for matches up to
+    // 16 MiB back, which costs a lot more memory. Off by default.
+    void setLongDistance(bool enable);
+    virtual void flush();
+    virtual void cork(bool enable);
+
+    // getMemoryUsage() returns the memory used by the compressor.
+    // Nothing is allocated until data is first written.
+    size_t getMemoryUsage();
+
+  private:
+    void init();
+
+    virtual bool flushBuffer();
+    void compress(int mode);
+    void checkCompressionLevel();
+
+    OutStream* underlying;
+    int compressionLevel;
+    int newLevel;
+    bool longDistance;
+    bool newLongDistance;
+    ZSTD_CCtx_s* cctx;
+  };
+
+} // end of namespace rdr
+
+#endif
@@ -31,10 +31,12 @@
 #include <rfb/CMsgReader.h>
 #include <rfb/CMsgWriter.h>
 #include <rfb/CSecurity.h>
+#include <rfb/ContentCache.h>
 #include <rfb/Decoder.h>
 #include <rfb/KeysymStr.h>
 #include <rfb/Security.h>
 #include <rfb/SecurityClient.h>
+#include <rfb/Tracer.h>
 #include <rfb/CConnection.h>
 #include <rfb/util.h>
 
@@ -55,12 +57,13 @@ CConnection::CConnection()
     shared(false),
     state_(RFBSTATE_UNINITIALISED),
     pendingPFChange(false), preferredEncoding(encodingTight),
-    compressLevel(2), qualityLevel(-1),
+    compressLevel(2), qualityLevel(-1), contentCacheLevel(-1),
     formatChange(false), encodingChange(false),
     firstUpdate(true), pendingUpdate(false), continuousUpdates(false),
     forceNonincremental(true),
     framebuffer(NULL), decoder(this),
-    hasRemoteClipboard(false), hasLocalClipboard(false)
+    hasRemoteClipboard(false), hasLocalClipboard(false),
+    clipboardTimer(this, &CConnection::handleClipboardTimeout)
 {
 }
 
@@ -389,6 +392,10 @@ void CConnection::close()
 {
   state_ = RFBSTATE_CLOSING;
 
+  clipboardTimer.stop();
+  clipboardCompressor.cancel();
+  clipboardDecompressor.cancel();
+
   /*
    * We're already shutting down, so just log any pending decoder
    * problems
@@ -503,6 +510,8 @@ void CConnection::framebufferUpdateStart()
 
   assert(framebuffer != NULL);
 
+  Tracer::nextFrame();
+
   // Note: This might not be true if continuous updates are supported
   pendingUpdate = false;
 
@@ -542,6 +551,8 @@ bool CConnection::dataRect(const Rect& r, int encoding)
 
 void CConnection::serverCutText(const char* str)
 {
+  clipboardDecompressor.cancel();
+
   hasLocalClipboard = false;
 
   serverClipboard = str;
@@ -586,6 +597,8 @@ void CConnection::handleClipboardPeek()
 
 void CConnection::handleClipboardNotify(uint32_t flags)
 {
+  clipboardDecompressor.cancel();
+
   hasRemoteClipboard = false;
 
   if (flags & rfb::clipboardUTF8) {
@@ -617,6 +630,22 @@ void CConnection::handleClipboardProvide(uint32_t flags,
   handleClipboardData(serverClipboard.c_str());
 }
 
+void CConnection::handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                   size_t maxLength)
+{
+  // Anything still being unpacked has been replaced by this
+  clipboardDecompressor.cancel();
+
+  if (payload->compressed.size() < ClipboardWorker::asyncThreshold) {
+    CMsgHandler::handleClipboardProvideCompressed(payload, maxLength);
+    return;
+  }
+
+  clipboardDecompressor.startDecompress(payload, maxLength);
+  if (!clipboardTimer.isStarted())
+    clipboardTimer.start(10);
+}
+
 void CConnection::authSuccess()
 {
 }
@@ -655,6 +684,8 @@ void CConnection::requestClipboard()
 
 void CConnection::announceClipboard(bool available)
 {
+  clipboardCompressor.cancel();
+
   hasLocalClipboard = available;
   unsolicitedClipboardAttempt = false;
 
@@ -695,12 +726,55 @@ void CConnection::sendClipboardData(const char* data)
       }
     }
 
+    if (sizes[0] >= ClipboardWorker::asyncThreshold) {
+      ClipboardPayload payload;
+
+      payload.flags = rfb::clipboardUTF8;
+      payload.formats.push_back(std::vector<uint8_t>(data[0],
+                                                     data[0] + sizes[0]));
+
+      clipboardCompressor.startCompress(&payload);
+      if (!clipboardTimer.isStarted())
+        clipboardTimer.start(10);
+      return;
+    }
+
     writer()->writeClipboardProvide(rfb::clipboardUTF8, sizes, data);
   } else {
     writer()->writeClientCutText(data);
   }
 }
 
+bool CConnection::handleClipboardTimeout(Timer* /*t*/)
+{
+  ClipboardPayload payload;
+  bool failed;
+
+  if (state_ != RFBSTATE_NORMAL)
+    return false;
+
+  // There is no way to abort the connection from here, so errors are
+  // left for the main loop to discover
+  try {
+    if (clipboardCompressor.getResult(&payload, &failed))
+      writer()->writeClipboardProvideCompressed(payload.flags,
+                                                payload.compressed.data(),
+                                                payload.compressed.size());
+
+    if (clipboardDecompressor.getResult(&payload, &failed)) {
+      if (failed)
+        vlog.error("Extended clipboard decode error - ignoring");
+      else
+        handleClipboardPayload(&payload);
+    }
+  } catch (rdr::Exception& e) {
+    vlog.error("Failed to handle clipboard data: %s", e.str());
+    return false;
+  }
+
+  return clipboardCompressor.isBusy() || clipboardDecompressor.isBusy();
+}
+
 void CConnection::refreshFramebuffer()
 {
   forceNonincremental = true;
@@ -734,6 +808,29 @@ void CConnection::setCompressLevel(int level)
   encodingChange = true;
 }
 
+void CConnection::setContentCacheSize(int size)
+{
+  int level;
+
+  level = -1;
+  if (size > 0) {
+    level = 0;
+    while (((size >> (level + 1)) > 0) && (level < 15))
+      level++;
+  }
+
+  if (contentCacheLevel == level)
+    return;
+
+  contentCacheLevel = level;
+  encodingChange = true;
+}
+
+unsigned CConnection::getContentCacheSlots() const
+{
+  return ContentCache::slotsForLevel(contentCacheLevel);
+}
+
 void CConnection::setQualityLevel(int level)
 {
   if (qualityLevel == level)
@@ -850,11 +947,22 @@ void CConnection::updateEncodings()
 
   encodings.push_back(encodingCopyRect);
 
+#ifdef HAVE_ZSTD
+  // Vendor specific, so not found below
+  if (preferredEncoding != encodingZstdRLE)
+    encodings.push_back(encodingZstdRLE);
+#endif
+
+  // The content cache isn't in this range either, and is only used
+  // if we announce its size further down
   for (int i = encodingMax; i >= 0; i--) {
     if ((i != preferredEncoding) && Decoder::supported(i))
       encodings.push_back(i);
   }
 
+  if (contentCacheLevel >= 0)
+    encodings.push_back(pseudoEncodingContentCache0 + contentCacheLevel);
+
   if (compressLevel >= 0 && compressLevel <= 9)
       encodings.push_back(pseudoEncodingCompressLevel0 + compressLevel);
   if (qualityLevel >= 0 && qualityLevel <= 9)
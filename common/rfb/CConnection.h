@@ -27,8 +27,10 @@
 #include <string>
 
 #include <rfb/CMsgHandler.h>
+#include <rfb/ClipboardWorker.h>
 #include <rfb/DecodeManager.h>
 #include <rfb/SecurityClient.h>
+#include <rfb/Timer.h>
 
 namespace rfb {
 
@@ -125,6 +127,8 @@ namespace rfb {
     virtual void handleClipboardProvide(uint32_t flags,
                                         const size_t* lengths,
                                         const uint8_t* const* data);
+    virtual void handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                  size_t maxLength);
 
 
     // Methods to be overridden in a derived class
@@ -194,6 +198,12 @@ namespace rfb {
     // sent to the server
     void setCompressLevel(int level);
     void setQualityLevel(int level);
+    // setContentCacheSize() sets how many MiB of memory the server may
+    // fill with copies of screen content, rounded down to a power of
+    // two. Zero disables the cache. The size can't be changed once
+    // the server has started using the cache.
+    void setContentCacheSize(int size);
+    unsigned getContentCacheSlots() const;
     // setPF() controls the pixel format requested from the server.
     // server.pf() will automatically be adjusted once the new format
     // is active.
@@ -264,6 +274,8 @@ namespace rfb {
     void requestNewUpdate();
     void updateEncodings();
 
+    bool handleClipboardTimeout(Timer* t);
+
     rdr::InStream* is;
     rdr::OutStream* os;
     CMsgReader* reader_;
@@ -280,6 +292,7 @@ namespace rfb {
     int preferredEncoding;
     int compressLevel;
     int qualityLevel;
+    int contentCacheLevel;
 
     bool formatChange;
     rfb::PixelFormat nextPF;
@@ -298,6 +311,11 @@ namespace rfb {
     bool hasRemoteClipboard;
     bool hasLocalClipboard;
     bool unsolicitedClipboardAttempt;
+
+    // Large clipboards are (de)compressed in the background
+    ClipboardWorker clipboardCompressor;
+    ClipboardWorker clipboardDecompressor;
+    MethodTimer<CConnection> clipboardTimer;
   };
 }
 #endif
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 
+#include <rfb/ClipboardWorker.h>
 #include <rfb/Exception.h>
 #include <rfb/LogWriter.h>
 #include <rfb/CMsgHandler.h>
@@ -166,3 +167,31 @@ void CMsgHandler::handleClipboardProvide(uint32_t /*flags*/,
                                          const uint8_t* const* /*data*/)
 {
 }
+
+void CMsgHandler::handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                   size_t maxLength)
+{
+  if (!ClipboardWorker::decompress(payload, maxLength))
+    throw Exception("Extended clipboard decode error");
+
+  handleClipboardPayload(payload);
+}
+
+void CMsgHandler::handleClipboardPayload(const ClipboardPayload* payload)
+{
+  size_t num;
+  size_t lengths[16];
+  const uint8_t* data[16];
+
+  num = 0;
+  for (int i = 0;i < 16;i++) {
+    if (!(payload->flags & (1 << i)))
+      continue;
+
+    lengths[num] = payload->formats[num].size();
+    data[num] = payload->formats[num].data();
+    num++;
+  }
+
+  handleClipboardProvide(payload->flags, lengths, data);
+}
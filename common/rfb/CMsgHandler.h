@@ -34,6 +34,8 @@ namespace rdr { class InStream; }
 
 namespace rfb {
 
+  struct ClipboardPayload;
+
   class CMsgHandler {
   public:
     CMsgHandler();
@@ -85,7 +87,17 @@ namespace rfb {
                                         const size_t* lengths,
                                         const uint8_t* const* data);
 
+    // handleClipboardProvideCompressed() is called with the data of a
+    // "provide" action as it was received. The default implementation
+    // decompresses it and calls handleClipboardProvide().
+    virtual void handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                  size_t maxLength);
+
     ServerParams server;
+
+  protected:
+    // Calls handleClipboardProvide() with the formats of a payload
+    void handleClipboardPayload(const ClipboardPayload* payload);
   };
 }
 #endif
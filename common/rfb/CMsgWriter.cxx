@@ -294,11 +294,21 @@ void CMsgWriter::writeClipboardProvide(uint32_t flags,
 
   zos.flush();
 
+  writeClipboardProvideCompressed(flags, mos.data(), mos.length());
+}
+
+void CMsgWriter::writeClipboardProvideCompressed(uint32_t flags,
+                                                 const uint8_t* data,
+                                                 size_t len)
+{
+  if (!(server->clipboardFlags() & clipboardProvide))
+    throw Exception("Server does not support clipboard \"provide\" action");
+
   startMsg(msgTypeClientCutText);
   os->pad(3);
-  os->writeS32(-(4 + mos.length()));
+  os->writeS32(-(4 + len));
   os->writeU32(flags | clipboardProvide);
-  os->writeBytes(mos.data(), mos.length());
+  os->writeBytes(data, len);
   endMsg();
 }
 
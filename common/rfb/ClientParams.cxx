@@ -33,7 +33,7 @@ using namespace rfb;
 ClientParams::ClientParams()
   : majorVersion(0), minorVersion(0),
     compressLevel(2), qualityLevel(-1), fineQualityLevel(-1),
-    subsampling(subsampleUndefined),
+    subsampling(subsampleUndefined), contentCacheLevel(-1),
     width_(0), height_(0),
     cursorPos_(0, 0), ledState_(ledUnknown)
 {
@@ -104,6 +104,7 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
   qualityLevel = -1;
   fineQualityLevel = -1;
   subsampling = subsampleUndefined;
+  contentCacheLevel = -1;
 
   encodings_.clear();
   encodings_.insert(encodingRaw);
@@ -142,6 +143,10 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
         encodings[i] <= pseudoEncodingFineQualityLevel100)
       fineQualityLevel = encodings[i] - pseudoEncodingFineQualityLevel0;
 
+    if (encodings[i] >= pseudoEncodingContentCache0 &&
+        encodings[i] <= pseudoEncodingContentCache15)
+      contentCacheLevel = encodings[i] - pseudoEncodingContentCache0;
+
     encodings_.insert(encodings[i]);
   }
 }
@@ -106,6 +106,9 @@ namespace rfb {
     int qualityLevel;
     int fineQualityLevel;
     int subsampling;
+    // Size of the client's content cache, as an offset from
+    // pseudoEncodingContentCache0, or -1 if it has none
+    int contentCacheLevel;
 
   private:
 
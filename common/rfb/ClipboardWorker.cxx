@@ -0,0 +1,284 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <os/Mutex.h>
+
+#include <rdr/Exception.h>
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibInStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/ClipboardWorker.h>
+#include <rfb/LogWriter.h>
+
+using namespace rfb;
+
+static LogWriter vlog("ClipboardWorker");
+
+ClipboardWorker::ClipboardWorker()
+  : stopRequested(false), serial(0), queued(false),
+    queuedCompress(false), queuedMaxLength(0), working(false),
+    finished(false), finishedFailed(false)
+{
+  mutex = new os::Mutex();
+  cond = new os::Condition(mutex);
+}
+
+ClipboardWorker::~ClipboardWorker()
+{
+  mutex->lock();
+  stopRequested = true;
+  cond->signal();
+  mutex->unlock();
+
+  if (isRunning())
+    wait();
+
+  delete cond;
+  delete mutex;
+}
+
+void ClipboardWorker::compress(ClipboardPayload* payload)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos;
+  size_t count;
+
+  zos.setUnderlying(&mos);
+
+  count = 0;
+  for (int i = 0;i < 16;i++) {
+    const std::vector<uint8_t>* format;
+
+    if (!(payload->flags & (1 << i)))
+      continue;
+
+    format = &payload->formats[count++];
+
+    zos.writeU32(format->size());
+    if (!format->empty())
+      zos.writeBytes(format->data(), format->size());
+  }
+
+  zos.flush();
+
+  payload->compressed.assign(mos.data(), mos.data() + mos.length());
+}
+
+bool ClipboardWorker::decompress(ClipboardPayload* payload,
+                                 size_t maxLength)
+{
+  rdr::MemInStream mis(payload->compressed.data(),
+                       payload->compressed.size());
+  rdr::ZlibInStream zis;
+
+  payload->formats.clear();
+
+  try {
+    zis.setUnderlying(&mis, payload->compressed.size());
+
+    for (int i = 0;i < 16;i++) {
+      size_t length;
+
+      if (!(payload->flags & (1 << i)))
+        continue;
+
+      if (!zis.hasData(4))
+        return false;
+
+      length = zis.readU32();
+
+      if (length > maxLength) {
+        vlog.error("Extended clipboard data too long (%d bytes) - ignoring",
+                   (unsigned)length);
+
+        // Slowly (safely) drain away the data
+        while (length > 0) {
+          size_t chunk;
+
+          if (!zis.hasData(1))
+            return false;
+
+          chunk = zis.avail();
+          if (chunk > length)
+            chunk = length;
+
+          zis.skip(chunk);
+          length -= chunk;
+        }
+
+        payload->flags &= ~(1 << i);
+
+        continue;
+      }
+
+      if (!zis.hasData(length))
+        return false;
+
+      payload->formats.push_back(std::vector<uint8_t>(length));
+      if (length > 0)
+        zis.readBytes(payload->formats.back().data(), length);
+    }
+
+    zis.flushUnderlying();
+    zis.setUnderlying(NULL, 0);
+  } catch (rdr::Exception& e) {
+    vlog.error("Extended clipboard decode error: %s", e.str());
+    return false;
+  }
+
+  return true;
+}
+
+void ClipboardWorker::startCompress(ClipboardPayload* payload)
+{
+  queueJob(payload, true, 0);
+}
+
+void ClipboardWorker::startDecompress(ClipboardPayload* payload,
+                                      size_t maxLength)
+{
+  queueJob(payload, false, maxLength);
+}
+
+void ClipboardWorker::cancel()
+{
+  os::AutoMutex a(mutex);
+
+  serial++;
+
+  queued = false;
+  queuedPayload.formats.clear();
+  queuedPayload.compressed.clear();
+
+  finished = false;
+  finishedPayload.formats.clear();
+  finishedPayload.compressed.clear();
+}
+
+bool ClipboardWorker::isBusy()
+{
+  os::AutoMutex a(mutex);
+  return queued || working || finished;
+}
+
+bool ClipboardWorker::getResult(ClipboardPayload* payload, bool* failed)
+{
+  os::AutoMutex a(mutex);
+
+  if (!finished)
+    return false;
+
+  payload->flags = finishedPayload.flags;
+  payload->formats.swap(finishedPayload.formats);
+  payload->compressed.swap(finishedPayload.compressed);
+  *failed = finishedFailed;
+
+  finished = false;
+  finishedPayload.formats.clear();
+  finishedPayload.compressed.clear();
+
+  return true;
+}
+
+void ClipboardWorker::queueJob(ClipboardPayload* payload, bool compress,
+                               size_t maxLength)
+{
+  mutex->lock();
+
+  serial++;
+
+  finished = false;
+  finishedPayload.formats.clear();
+  finishedPayload.compressed.clear();
+
+  queued = true;
+  queuedCompress = compress;
+  queuedMaxLength = maxLength;
+  queuedPayload.flags = payload->flags;
+  queuedPayload.formats.swap(payload->formats);
+  queuedPayload.compressed.swap(payload->compressed);
+
+  payload->formats.clear();
+  payload->compressed.clear();
+
+  cond->signal();
+
+  mutex->unlock();
+
+  // Most connections never see a large clipboard, so don't create
+  // the thread until it is needed
+  if (!isRunning())
+    start();
+}
+
+void ClipboardWorker::worker()
+{
+  mutex->lock();
+
+  while (!stopRequested) {
+    ClipboardPayload payload;
+    bool compress, failed;
+    size_t maxLength;
+    unsigned jobSerial;
+
+    if (!queued) {
+      cond->wait();
+      continue;
+    }
+
+    payload.flags = queuedPayload.flags;
+    payload.formats.swap(queuedPayload.formats);
+    payload.compressed.swap(queuedPayload.compressed);
+    compress = queuedCompress;
+    maxLength = queuedMaxLength;
+    jobSerial = serial;
+
+    queued = false;
+    working = true;
+
+    mutex->unlock();
+
+    failed = false;
+    if (compress)
+      ClipboardWorker::compress(&payload);
+    else
+      failed = !ClipboardWorker::decompress(&payload, maxLength);
+
+    mutex->lock();
+
+    working = false;
+
+    // Someone might have changed their mind whilst we were busy
+    if (jobSerial != serial)
+      continue;
+
+    finished = true;
+    finishedFailed = failed;
+    finishedPayload.flags = payload.flags;
+    finishedPayload.formats.swap(payload.formats);
+    finishedPayload.compressed.swap(payload.compressed);
+  }
+
+  mutex->unlock();
+}
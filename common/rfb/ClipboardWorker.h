@@ -0,0 +1,117 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ClipboardWorker - compression of extended clipboard data
+//
+// The data in an extended clipboard "provide" action is a single zlib
+// stream, which can take a long time to produce or unpack for large
+// clipboards. This class does that work on a separate thread so that
+// the main loop can keep handling updates and input in the meantime.
+// Only one job is handled at a time, and starting a new one discards
+// any previous job that has not yet been collected.
+//
+
+#ifndef __RFB_CLIPBOARDWORKER_H__
+#define __RFB_CLIPBOARDWORKER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <os/Thread.h>
+
+namespace os {
+  class Condition;
+  class Mutex;
+}
+
+namespace rfb {
+
+  struct ClipboardPayload {
+    uint32_t flags;
+    // One entry for each format in flags, in order
+    std::vector< std::vector<uint8_t> > formats;
+    // The same data as it appears in the protocol
+    std::vector<uint8_t> compressed;
+  };
+
+  class ClipboardWorker : public os::Thread {
+  public:
+    ClipboardWorker();
+    virtual ~ClipboardWorker();
+
+    // Payloads smaller than this are quicker to handle directly
+    static const size_t asyncThreshold = 64 * 1024;
+
+    // compress() fills in the compressed field from the formats
+    static void compress(ClipboardPayload* payload);
+    // decompress() fills in the formats from the compressed field. Any
+    // format longer than maxLength is dropped. Returns false if the
+    // data is corrupt.
+    static bool decompress(ClipboardPayload* payload, size_t maxLength);
+
+    // Start a job in the background. The payload is taken over and
+    // left empty.
+    void startCompress(ClipboardPayload* payload);
+    void startDecompress(ClipboardPayload* payload, size_t maxLength);
+
+    // cancel() discards the current job
+    void cancel();
+
+    // isBusy() returns true if there is a job that has not yet been
+    // collected using getResult()
+    bool isBusy();
+
+    // getResult() returns true and the payload of a finished job, if
+    // there is one. failed is set if the data could not be
+    // decompressed.
+    bool getResult(ClipboardPayload* payload, bool* failed);
+
+  protected:
+    virtual void worker();
+
+  private:
+    void queueJob(ClipboardPayload* payload, bool compress,
+                  size_t maxLength);
+
+  private:
+    os::Mutex* mutex;
+    os::Condition* cond;
+    bool stopRequested;
+
+    // Incremented for every new job, so that stale results can be
+    // recognised
+    unsigned serial;
+
+    bool queued;
+    bool queuedCompress;
+    size_t queuedMaxLength;
+    ClipboardPayload queuedPayload;
+
+    bool working;
+
+    bool finished;
+    bool finishedFailed;
+    ClipboardPayload finishedPayload;
+  };
+
+}
+
+#endif
@@ -51,6 +51,10 @@ namespace rfb {
     // per second.
     size_t getBandwidth();
 
+    // getInFlight() returns the number of bytes that have been sent
+    // but that haven't reached the client yet, as best we can tell
+    unsigned getInFlight();
+
     // debugTrace() writes the current congestion window, as well as the
     // congestion window of the underlying TCP layer, to the specified
     // file
@@ -58,7 +62,6 @@ namespace rfb {
 
   protected:
     unsigned getExtraBuffer();
-    unsigned getInFlight();
 
     void updateCongestion();
 
@@ -0,0 +1,215 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rfb/ContentCache.h>
+#include <rfb/PixelBuffer.h>
+
+using namespace rfb;
+
+// Constants and mixing from xxHash64, but with the data read as
+// native words as the hash never leaves this process
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+
+static inline uint64_t rotl64(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+  acc += input * prime2;
+  acc = rotl64(acc, 31);
+  return acc * prime1;
+}
+
+static inline uint64_t read64(const uint8_t* data)
+{
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+ContentCache::ContentCache()
+{
+}
+
+ContentCache::~ContentCache()
+{
+}
+
+unsigned ContentCache::slotsForLevel(int level)
+{
+  // 1 MiB worth of full size tiles at 32 bpp
+  static const unsigned slotsPerMiB =
+    1024 * 1024 / (contentCacheTileSize * contentCacheTileSize * 4);
+
+  if ((level < 0) || (level > 15))
+    return 0;
+
+  return slotsPerMiB << level;
+}
+
+void ContentCache::setSlots(unsigned slots)
+{
+  clear();
+
+  slotHashes.resize(slots);
+  lruPos.resize(slots);
+}
+
+void ContentCache::clear()
+{
+  index.clear();
+  lru.clear();
+  seen.clear();
+  seenOrder.clear();
+}
+
+bool ContentCache::lookup(uint64_t hash, unsigned* slot)
+{
+  std::map<uint64_t, unsigned>::const_iterator iter;
+
+  iter = index.find(hash);
+  if (iter == index.end())
+    return false;
+
+  *slot = iter->second;
+
+  // Move to the back, as the most recently used
+  lru.splice(lru.end(), lru, lruPos[*slot]);
+
+  return true;
+}
+
+unsigned ContentCache::insert(uint64_t hash)
+{
+  unsigned slot;
+
+  if (lru.size() < slotHashes.size()) {
+    // Slots are filled in order, and only emptied all at once
+    slot = lru.size();
+  } else {
+    slot = lru.front();
+    lru.pop_front();
+    index.erase(slotHashes[slot]);
+  }
+
+  index[hash] = slot;
+  slotHashes[slot] = hash;
+  lruPos[slot] = lru.insert(lru.end(), slot);
+
+  return slot;
+}
+
+bool ContentCache::checkSeen(uint64_t hash)
+{
+  if (seen.count(hash) != 0)
+    return true;
+
+  if (slotHashes.empty())
+    return false;
+
+  if (seenOrder.size() >= slotHashes.size()) {
+    seen.erase(seenOrder.front());
+    seenOrder.pop_front();
+  }
+
+  seen.insert(hash);
+  seenOrder.push_back(hash);
+
+  return false;
+}
+
+size_t ContentCache::getMemoryUsage() const
+{
+  size_t usage;
+
+  usage = slotHashes.capacity() * sizeof(uint64_t);
+  usage += lruPos.capacity() * sizeof(std::list<unsigned>::iterator);
+
+  // Rough size of the map and list nodes
+  usage += index.size() * (sizeof(std::map<uint64_t, unsigned>::value_type) +
+                           4 * sizeof(void*));
+  usage += lru.size() * (sizeof(unsigned) + 2 * sizeof(void*));
+  usage += seen.size() * (sizeof(uint64_t) * 2 + 4 * sizeof(void*));
+
+  return usage;
+}
+
+uint64_t ContentCache::hashRect(const PixelBuffer* pb, const Rect& r)
+{
+  const uint8_t* data;
+  int stride;
+  size_t bpp, rowBytes;
+  uint64_t acc[4], hash;
+
+  data = pb->getBuffer(r, &stride);
+  bpp = pb->getPF().bpp / 8;
+  rowBytes = r.width() * bpp;
+
+  acc[0] = prime1 + prime2;
+  acc[1] = prime2;
+  acc[2] = 0;
+  acc[3] = -prime1;
+
+  for (int y = 0; y < r.height(); y++) {
+    const uint8_t* row;
+    size_t i;
+
+    row = data + y * stride * bpp;
+
+    // Four independent lanes so the multiplications can overlap
+    for (i = 0; i + 32 <= rowBytes; i += 32) {
+      acc[0] = round64(acc[0], read64(row + i));
+      acc[1] = round64(acc[1], read64(row + i + 8));
+      acc[2] = round64(acc[2], read64(row + i + 16));
+      acc[3] = round64(acc[3], read64(row + i + 24));
+    }
+    for (; i + 8 <= rowBytes; i += 8)
+      acc[0] = round64(acc[0], read64(row + i));
+    if (i < rowBytes) {
+      uint64_t tail;
+
+      tail = 0;
+      memcpy(&tail, row + i, rowBytes - i);
+      acc[1] = round64(acc[1], tail);
+    }
+  }
+
+  hash = rotl64(acc[0], 1) + rotl64(acc[1], 7) +
+         rotl64(acc[2], 12) + rotl64(acc[3], 18);
+
+  // Two rects with the same bytes but different shapes must differ
+  hash ^= ((uint64_t)r.width() << 32) | r.height();
+
+  hash ^= hash >> 33;
+  hash *= prime2;
+  hash ^= hash >> 29;
+  hash *= prime3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
@@ -0,0 +1,105 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ContentCache - index of the tiles a client has cached
+//
+// A client that announces a content cache keeps copies of tiles in
+// numbered slots, as instructed by the server. The server only keeps
+// a hash of what is in each slot, so that when the same pixels show
+// up again it can tell the client to copy them back from the slot
+// instead of encoding them again.
+//
+// Each encodingContentCache rect carries a U8 operation and a U32 slot
+// number. A store copies the rect from the client's framebuffer in to
+// the slot, and a restore copies the slot back to the framebuffer. The
+// framebuffer is as it is after all earlier rects have been decoded.
+// Rects are at most contentCacheTileSize pixels on either side, and a
+// restore has the same size as the rect that was stored in the slot.
+//
+
+#ifndef __RFB_CONTENTCACHE_H__
+#define __RFB_CONTENTCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace rfb {
+
+  class PixelBuffer;
+  struct Rect;
+
+  static const int contentCacheTileSize = 64;
+
+  enum ContentCacheOp {
+    contentCacheStore = 0,
+    contentCacheRestore = 1,
+  };
+
+  class ContentCache {
+  public:
+    ContentCache();
+    ~ContentCache();
+
+    // slotsForLevel() returns the number of slots a client has when it
+    // announces pseudoEncodingContentCache0 + level
+    static unsigned slotsForLevel(int level);
+
+    // setSlots() sets the number of slots the client has, and forgets
+    // everything that has been stored
+    void setSlots(unsigned slots);
+    unsigned getSlots() const { return slotHashes.size(); }
+
+    void clear();
+
+    // lookup() finds the slot holding the pixels with the given hash
+    bool lookup(uint64_t hash, unsigned* slot);
+    // insert() picks a slot for new pixels, reusing the least recently
+    // used one once they have all been filled
+    unsigned insert(uint64_t hash);
+
+    // checkSeen() returns true if the hash has been given to it
+    // before. It can remember about as many hashes as there are slots.
+    bool checkSeen(uint64_t hash);
+
+    size_t getMemoryUsage() const;
+
+    // hashRect() returns a hash of the pixels in the given rect,
+    // including its size
+    static uint64_t hashRect(const PixelBuffer* pb, const Rect& r);
+
+  private:
+    std::map<uint64_t, unsigned> index;
+    std::vector<uint64_t> slotHashes;
+    // Filled slots, with the least recently used first
+    std::list<unsigned> lru;
+    std::vector<std::list<unsigned>::iterator> lruPos;
+
+    std::set<uint64_t> seen;
+    std::deque<uint64_t> seenOrder;
+  };
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rdr/MemInStream.h>
+#include <rdr/OutStream.h>
+
+#include <rfb/ContentCache.h>
+#include <rfb/ContentCacheDecoder.h>
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+
+using namespace rfb;
+
+// Stores and restores depend on each other through the slots, so
+// everything has to happen in the order the server sent it
+ContentCacheDecoder::ContentCacheDecoder()
+  : Decoder(DecoderOrdered), stores(0), restores(0), restoredPixels(0),
+    memoryUsage(0)
+{
+}
+
+ContentCacheDecoder::~ContentCacheDecoder()
+{
+}
+
+void ContentCacheDecoder::setSlots(unsigned count)
+{
+  slots.clear();
+  slots.resize(count);
+  slotSizes.clear();
+  slotSizes.resize(count);
+  memoryUsage = 0;
+}
+
+bool ContentCacheDecoder::readRect(const Rect& r, rdr::InStream* is,
+                                   const ServerParams& /*server*/,
+                                   rdr::OutStream* os)
+{
+  uint8_t op;
+  uint32_t slot;
+
+  if (!is->hasData(1 + 4))
+    return false;
+
+  op = is->readU8();
+  slot = is->readU32();
+
+  if (slot >= slotSizes.size())
+    throw Exception("Content cache slot %u out of range", (unsigned)slot);
+
+  switch (op) {
+  case contentCacheStore:
+    if ((r.width() > contentCacheTileSize) ||
+        (r.height() > contentCacheTileSize))
+      throw Exception("Content cache rect too large");
+
+    // The framebuffer is practically always 32 bpp
+    memoryUsage -= slotSizes[slot].x * slotSizes[slot].y * 4;
+    slotSizes[slot] = Point(r.width(), r.height());
+    memoryUsage += r.area() * 4;
+
+    stores++;
+    break;
+  case contentCacheRestore:
+    if (slotSizes[slot] != Point(r.width(), r.height()))
+      throw Exception("Content cache slot %u does not match rect",
+                      (unsigned)slot);
+
+    restores++;
+    restoredPixels += r.area();
+    break;
+  default:
+    throw Exception("Unknown content cache operation %d", (int)op);
+  }
+
+  os->writeU8(op);
+  os->writeU32(slot);
+
+  return true;
+}
+
+void ContentCacheDecoder::decodeRect(const Rect& r, const uint8_t* buffer,
+                                     size_t buflen,
+                                     const ServerParams& /*server*/,
+                                     ModifiablePixelBuffer* pb)
+{
+  rdr::MemInStream is(buffer, buflen);
+  uint8_t op;
+  Slot* slot;
+
+  op = is.readU8();
+  slot = &slots[is.readU32()];
+
+  if (op == contentCacheStore) {
+    slot->pf = pb->getPF();
+    slot->data.resize(r.area() * (slot->pf.bpp / 8));
+    pb->getImage(slot->data.data(), r);
+  } else {
+    // The pixel format might have changed since the slot was filled
+    if (slot->pf == pb->getPF())
+      pb->imageRect(r, slot->data.data());
+    else
+      pb->imageRect(slot->pf, r, slot->data.data());
+  }
+}
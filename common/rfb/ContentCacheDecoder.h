@@ -0,0 +1,65 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+#ifndef __RFB_CONTENTCACHEDECODER_H__
+#define __RFB_CONTENTCACHEDECODER_H__
+
+#include <vector>
+
+#include <rfb/Decoder.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/Rect.h>
+
+namespace rfb {
+
+  class ContentCacheDecoder : public Decoder {
+  public:
+    ContentCacheDecoder();
+    virtual ~ContentCacheDecoder();
+
+    // setSlots() limits how many slots the server may use, which
+    // should match the size that was announced to it
+    void setSlots(unsigned slots);
+
+    virtual bool readRect(const Rect& r, rdr::InStream* is,
+                          const ServerParams& server, rdr::OutStream* os);
+    virtual void decodeRect(const Rect& r, const uint8_t* buffer,
+                            size_t buflen, const ServerParams& server,
+                            ModifiablePixelBuffer* pb);
+
+    // Statistics, only updated by readRect()
+    unsigned stores;
+    unsigned restores;
+    unsigned long long restoredPixels;
+    // Memory that the filled slots need
+    size_t getMemoryUsage() const { return memoryUsage; }
+
+  private:
+    struct Slot {
+      PixelFormat pf;
+      std::vector<uint8_t> data;
+    };
+
+    std::vector<Slot> slots;
+
+    // What readRect() has seen stored in each slot, so that bad
+    // restores can be rejected before they reach the worker threads
+    std::vector<Point> slotSizes;
+    size_t memoryUsage;
+  };
+}
+#endif
@@ -27,17 +27,22 @@
 #include <rfb/Cursor.h>
 #include <rfb/LogWriter.h>
 #include <rfb/Exception.h>
+#include <rfb/PixelFormatSIMD.h>
 
 using namespace rfb;
 
 static LogWriter vlog("Cursor");
 
+// Red, green and blue in the first three bytes, like the cursor data
+static const PixelFormat blendPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
 Cursor::Cursor(int width, int height, const Point& hotspot,
                const uint8_t* data) :
   width_(width), height_(height), hotspot_(hotspot)
 {
   this->data = new uint8_t[width_*height_*4];
   memcpy(this->data, data, width_*height_*4);
+  premultiply();
 }
 
 Cursor::Cursor(const Cursor& other) :
@@ -46,6 +51,7 @@ Cursor::Cursor(const Cursor& other) :
 {
   data = new uint8_t[width_*height_*4];
   memcpy(data, other.data, width_*height_*4);
+  premultiplied = other.premultiplied;
 }
 
 Cursor::~Cursor()
@@ -248,6 +254,22 @@ void Cursor::crop()
   hotspot_ = hotspot_.subtract(busy.tl);
   delete [] data;
   data = newData;
+
+  premultiply();
+}
+
+void Cursor::premultiply()
+{
+  premultiplied.resize(width_*height_*4);
+
+  for (int i = 0;i < width_*height_;i++) {
+    const uint8_t* in = data + i*4;
+    uint8_t* out = &premultiplied[i*4];
+
+    for (int c = 0;c < 3;c++)
+      out[c] = ((unsigned)in[c]*in[3] + 127) / 255;
+    out[3] = in[3];
+  }
 }
 
 RenderedCursor::RenderedCursor()
@@ -265,14 +287,15 @@ const uint8_t* RenderedCursor::getBuffer(const Rect& _r, int* stride) const
   return buffer.getBuffer(r, stride);
 }
 
-void RenderedCursor::update(PixelBuffer* framebuffer,
-                            Cursor* cursor, const Point& pos)
+void RenderedCursor::update(const PixelBuffer* framebuffer,
+                            const Cursor* cursor, const Point& pos)
 {
   Point rawOffset, diff;
   Rect clippedRect;
 
-  const uint8_t* data;
-  int stride;
+  const uint8_t *data, *src;
+  uint8_t* dst;
+  int stride, dstStride;
 
   assert(framebuffer);
   assert(cursor);
@@ -294,35 +317,41 @@ void RenderedCursor::update(PixelBuffer* framebuffer,
   if (clippedRect.area() == 0)
     return;
 
-  data = framebuffer->getBuffer(buffer.getRect(offset), &stride);
-  buffer.imageRect(buffer.getRect(), data, stride);
+  // The blending is done on pixels with the same layout as the
+  // cursor data, which is then converted back to the real format
+  scratch.resize(clippedRect.area()*4);
+
+  data = framebuffer->getBuffer(clippedRect, &stride);
+  blendPF.bufferFromBuffer(scratch.data(), format, data,
+                           clippedRect.width(), clippedRect.height(),
+                           clippedRect.width(), stride);
 
   diff = offset.subtract(rawOffset);
-  for (int y = 0;y < buffer.height();y++) {
-    for (int x = 0;x < buffer.width();x++) {
-      size_t idx;
-      uint8_t bg[4], fg[4];
-      uint8_t rgb[3];
-
-      idx = (y+diff.y)*cursor->width() + (x+diff.x);
-      memcpy(fg, cursor->getBuffer() + idx*4, 4);
-
-      if (fg[3] == 0x00)
-        continue;
-      else if (fg[3] == 0xff) {
-        memcpy(rgb, fg, 3);
-      } else {
-        buffer.getImage(bg, Rect(x, y, x+1, y+1));
-        format.rgbFromBuffer(rgb, bg, 1);
-        // FIXME: Gamma aware blending
-        for (int i = 0;i < 3;i++) {
-          rgb[i] = (unsigned)rgb[i]*(255-fg[3])/255 +
-                   (unsigned)fg[i]*fg[3]/255;
+  src = cursor->getPremultiplied() + (diff.y*cursor->width() + diff.x)*4;
+
+  // FIXME: Gamma aware blending
+  if (!simdBlendOver(scratch.data(), src,
+                     clippedRect.width(), clippedRect.height(),
+                     clippedRect.width(), cursor->width())) {
+    for (int y = 0;y < clippedRect.height();y++) {
+      uint8_t* out = &scratch[y*clippedRect.width()*4];
+      const uint8_t* in = src + y*cursor->width()*4;
+
+      for (int x = 0;x < clippedRect.width();x++) {
+        unsigned inv = 255 - in[3];
+        for (int i = 0;i < 4;i++) {
+          unsigned t = out[i]*inv + 128;
+          out[i] = in[i] + ((t + (t >> 8)) >> 8);
         }
+        out += 4;
+        in += 4;
       }
-
-      format.bufferFromRGB(bg, rgb, 1);
-      buffer.imageRect(Rect(x, y, x+1, y+1), bg);
     }
   }
+
+  dst = buffer.getBufferRW(buffer.getRect(), &dstStride);
+  format.bufferFromBuffer(dst, blendPF, scratch.data(),
+                          clippedRect.width(), clippedRect.height(),
+                          dstStride, clippedRect.width());
+  buffer.commitBufferRW(buffer.getRect());
 }
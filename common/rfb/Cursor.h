@@ -40,6 +40,9 @@ namespace rfb {
     int height() const { return height_; };
     const Point& hotspot() const { return hotspot_; };
     const uint8_t* getBuffer() const { return data; };
+    // getPremultiplied() returns the same data, but with the colour
+    // channels multiplied by the alpha channel
+    const uint8_t* getPremultiplied() const { return premultiplied.data(); };
 
     // getBitmap() returns a monochrome version of the cursor
     std::vector<uint8_t> getBitmap() const;
@@ -50,10 +53,14 @@ namespace rfb {
     // mask.
     void crop();
 
+  protected:
+    void premultiply();
+
   protected:
     int width_, height_;
     Point hotspot_;
     uint8_t* data;
+    std::vector<uint8_t> premultiplied;
   };
 
   class RenderedCursor : public PixelBuffer {
@@ -64,11 +71,15 @@ namespace rfb {
 
     virtual const uint8_t* getBuffer(const Rect& r, int* stride) const;
 
-    void update(PixelBuffer* framebuffer, Cursor* cursor, const Point& pos);
+    void update(const PixelBuffer* framebuffer, const Cursor* cursor,
+                const Point& pos);
 
   protected:
     ManagedPixelBuffer buffer;
     Point offset;
+
+    // The area below the cursor in a format suitable for blending
+    std::vector<uint8_t> scratch;
   };
 
 }
@@ -24,11 +24,14 @@
 #include <string.h>
 
 #include <rfb/CConnection.h>
+#include <rfb/ContentCache.h>
+#include <rfb/ContentCacheDecoder.h>
 #include <rfb/DecodeManager.h>
 #include <rfb/Decoder.h>
 #include <rfb/Exception.h>
 #include <rfb/Region.h>
 #include <rfb/LogWriter.h>
+#include <rfb/Tracer.h>
 #include <rfb/util.h>
 
 #include <rdr/Exception.h>
@@ -40,14 +43,23 @@ using namespace rfb;
 
 static LogWriter vlog("DecodeManager");
 
+// Every so many rects, the free buffers are shrunk back to what the
+// rects in that period needed, so that a single large update doesn't
+// keep its memory around for the rest of the session
+static const unsigned bufferTrimInterval = 256;
+// Buffers are never trimmed below this
+static const size_t bufferMinRetained = 256 * 1024;
+
 DecodeManager::DecodeManager(CConnection *conn) :
   conn(conn), threadException(NULL)
 {
   size_t cpuCount;
 
-  memset(decoders, 0, sizeof(decoders));
+  memset(&bufferStats, 0, sizeof(bufferStats));
+  bufferWindowPeak = 0;
+  bufferWindowRects = 0;
 
-  memset(stats, 0, sizeof(stats));
+  Tracer::init();
 
   queueMutex = new os::Mutex();
   producerCond = new os::Condition(queueMutex);
@@ -97,16 +109,23 @@ DecodeManager::~DecodeManager()
   delete producerCond;
   delete queueMutex;
 
-  for (size_t i = 0; i < sizeof(decoders)/sizeof(decoders[0]); i++)
-    delete decoders[i];
+  std::map<int, Decoder*>::iterator iter;
+
+  for (iter = decoders.begin(); iter != decoders.end(); ++iter)
+    delete iter->second;
+
+  Tracer::finish();
 }
 
 bool DecodeManager::decodeRect(const Rect& r, int encoding,
                                ModifiablePixelBuffer* pb)
 {
   Decoder *decoder;
+  std::list<rdr::MemOutStream*>::iterator bufferIter;
   rdr::MemOutStream *bufferStream;
+  size_t capacity;
   int equiv;
+  uint64_t start;
 
   QueueEntry *entry;
 
@@ -123,27 +142,27 @@ bool DecodeManager::decodeRect(const Rect& r, int encoding,
       vlog.error("Unknown encoding %d", encoding);
       throw rdr::Exception("Unknown encoding");
     }
+
+    // The server may only use as many slots as we told it about
+    if (encoding == encodingContentCache) {
+      ((ContentCacheDecoder*)decoders[encoding])->setSlots(
+        conn->getContentCacheSlots());
+    }
   }
 
   decoder = decoders[encoding];
 
-  // Wait for an available memory buffer
-  queueMutex->lock();
-
-  // FIXME: Should we return and let other things run here?
-  while (freeBuffers.empty())
-    producerCond->wait();
-
   // Don't pop the buffer in case we throw an exception
   // whilst reading
-  bufferStream = freeBuffers.front();
-
-  queueMutex->unlock();
+  bufferIter = takeBuffer(r.area() * (conn->server.pf().bpp/8));
+  bufferStream = *bufferIter;
+  capacity = bufferStream->capacity();
 
   // First check if any thread has encountered a problem
   throwThreadException();
 
   // Read the rect
+  start = Tracer::now();
   bufferStream->clear();
   try {
     if (!decoder->readRect(r, conn->getInStream(), conn->server, bufferStream))
@@ -152,12 +171,31 @@ bool DecodeManager::decodeRect(const Rect& r, int encoding,
     throw Exception("Error reading rect: %s", e.str());
   }
 
+  if (bufferStream->capacity() == capacity)
+    bufferStats.reused++;
+  else
+    bufferStats.grown++;
+
+  if (bufferStream->length() > bufferWindowPeak)
+    bufferWindowPeak = bufferStream->length();
+  if (++bufferWindowRects >= bufferTrimInterval)
+    trimBuffers();
+
   stats[encoding].rects++;
   stats[encoding].bytes += 12 + bufferStream->length();
-  stats[encoding].pixels += r.area();
-  equiv = 12 + r.area() * (conn->server.pf().bpp/8);
+  // Storing something in the content cache doesn't draw anything
+  if ((encoding == encodingContentCache) &&
+      (bufferStream->data()[0] == contentCacheStore)) {
+    equiv = 12 + bufferStream->length();
+  } else {
+    stats[encoding].pixels += r.area();
+    equiv = 12 + r.area() * (conn->server.pf().bpp/8);
+  }
   stats[encoding].equivalent += equiv;
 
+  Tracer::record(traceDecodeRead, 0, Tracer::currentFrame(),
+                 start, Tracer::now(), bufferStream->length());
+
   // Then try to put it on the queue
   entry = new QueueEntry;
 
@@ -168,16 +206,29 @@ bool DecodeManager::decodeRect(const Rect& r, int encoding,
   entry->server = &conn->server;
   entry->pb = pb;
   entry->bufferStream = bufferStream;
+  entry->frame = Tracer::currentFrame();
 
   decoder->getAffectedRegion(r, bufferStream->data(),
                              bufferStream->length(), conn->server,
                              &entry->affectedRegion);
+  entry->affectedRect = entry->affectedRegion.get_bounding_rect();
 
   queueMutex->lock();
 
-  // The workers add buffers to the end so it's safe to assume
-  // the front is still the same buffer
-  freeBuffers.pop_front();
+  // The workers only add buffers to the end, so the iterator is
+  // still valid
+  freeBuffers.erase(bufferIter);
+
+  // Work out once which of the queued rects this one has to wait for,
+  // rather than every time a worker looks for something to do
+  entry->blockers = 0;
+  for (std::list<QueueEntry*>::iterator iter = workQueue.begin();
+       iter != workQueue.end(); ++iter) {
+    if (entriesConflict(*iter, entry)) {
+      (*iter)->dependents.push_back(entry);
+      entry->blockers++;
+    }
+  }
 
   workQueue.push_back(entry);
 
@@ -202,36 +253,139 @@ void DecodeManager::flush()
   throwThreadException();
 }
 
+std::list<rdr::MemOutStream*>::iterator DecodeManager::takeBuffer(size_t needed)
+{
+  std::list<rdr::MemOutStream*>::iterator iter, best;
+  size_t held;
+
+  os::AutoMutex a(queueMutex);
+
+  // FIXME: Should we return and let other things run here?
+  while (freeBuffers.empty())
+    producerCond->wait();
+
+  // Pick the smallest buffer that will fit the rect without growing,
+  // or the largest one if none will. That way small rects don't tie
+  // up the large buffers, and large rects rarely need to reallocate.
+  best = freeBuffers.begin();
+  for (iter = freeBuffers.begin(); iter != freeBuffers.end(); ++iter) {
+    size_t capacity, bestCapacity;
+
+    capacity = (*iter)->capacity();
+    bestCapacity = (*best)->capacity();
+
+    if (bestCapacity < needed) {
+      if (capacity > bestCapacity)
+        best = iter;
+    } else if ((capacity >= needed) && (capacity < bestCapacity)) {
+      best = iter;
+    }
+  }
+
+  // Buffers that are in use can't shrink, so this is good enough
+  held = 0;
+  for (iter = freeBuffers.begin(); iter != freeBuffers.end(); ++iter)
+    held += (*iter)->capacity();
+  if (held > bufferStats.peakHeld)
+    bufferStats.peakHeld = held;
+
+  return best;
+}
+
+void DecodeManager::trimBuffers()
+{
+  std::vector<rdr::MemOutStream*> oversized;
+  std::list<rdr::MemOutStream*>::iterator iter;
+  size_t limit;
+
+  limit = bufferWindowPeak;
+  if (limit < bufferMinRetained)
+    limit = bufferMinRetained;
+
+  bufferWindowPeak = 0;
+  bufferWindowRects = 0;
+
+  queueMutex->lock();
+  for (iter = freeBuffers.begin(); iter != freeBuffers.end(); ++iter) {
+    if ((*iter)->capacity() > limit)
+      oversized.push_back(*iter);
+  }
+  queueMutex->unlock();
+
+  // Only this thread takes buffers from the free list, so these stay
+  // ours whilst we shrink them without the lock
+  for (size_t i = 0; i < oversized.size(); i++) {
+    size_t before;
+
+    before = oversized[i]->capacity();
+    oversized[i]->shrink(limit);
+    bufferStats.trimmed += before - oversized[i]->capacity();
+  }
+}
+
+bool DecodeManager::entriesConflict(const QueueEntry* earlier,
+                                    const QueueEntry* later)
+{
+  // If this is an ordered decoder then all rects must be handled in
+  // the order they arrived
+  if ((later->decoder->flags & DecoderOrdered) &&
+      (later->encoding == earlier->encoding))
+    return true;
+
+  // For a partially ordered decoder we must ask the decoder
+  if ((later->decoder->flags & DecoderPartiallyOrdered) &&
+      (later->encoding == earlier->encoding)) {
+    if (later->decoder->doRectsConflict(later->rect,
+                                        later->bufferStream->data(),
+                                        later->bufferStream->length(),
+                                        earlier->rect,
+                                        earlier->bufferStream->data(),
+                                        earlier->bufferStream->length(),
+                                        *later->server))
+      return true;
+  }
+
+  // Check overlap, which is usually settled by the bounding rects
+  if (!earlier->affectedRect.overlaps(later->affectedRect))
+    return false;
+
+  return !earlier->affectedRegion.intersect(later->affectedRegion).is_empty();
+}
+
 void DecodeManager::logStats()
 {
-  size_t i;
+  std::map<int, DecoderStats>::const_iterator stat;
 
   unsigned rects;
   unsigned long long pixels, bytes, equivalent;
 
   double ratio;
 
+  std::list<rdr::MemOutStream*>::iterator iter;
+  size_t held;
+  double reuse;
+
   rects = 0;
   pixels = bytes = equivalent = 0;
 
-  for (i = 0;i < (sizeof(stats)/sizeof(stats[0]));i++) {
+  for (stat = stats.begin(); stat != stats.end(); ++stat) {
     // Did this class do anything at all?
-    if (stats[i].rects == 0)
+    if (stat->second.rects == 0)
       continue;
 
-    rects += stats[i].rects;
-    pixels += stats[i].pixels;
-    bytes += stats[i].bytes;
-    equivalent += stats[i].equivalent;
+    rects += stat->second.rects;
+    pixels += stat->second.pixels;
+    bytes += stat->second.bytes;
+    equivalent += stat->second.equivalent;
 
-    ratio = (double)stats[i].equivalent / stats[i].bytes;
+    ratio = (double)stat->second.equivalent / stat->second.bytes;
 
-    vlog.info("    %s: %s, %s", encodingName(i),
-              siPrefix(stats[i].rects, "rects").c_str(),
-              siPrefix(stats[i].pixels, "pixels").c_str());
+    vlog.info("    %s: %s, %s", encodingName(stat->first),
+              siPrefix(stat->second.rects, "rects").c_str(),
+              siPrefix(stat->second.pixels, "pixels").c_str());
     vlog.info("    %*s  %s (1:%g ratio)",
-              (int)strlen(encodingName(i)), "",
-              iecPrefix(stats[i].bytes, "B").c_str(), ratio);
+              (int)strlen(encodingName(stat->first)), "",
+              iecPrefix(stat->second.bytes, "B").c_str(), ratio);
   }
 
   ratio = (double)equivalent / bytes;
@@ -241,6 +395,36 @@ void DecodeManager::logStats()
             siPrefix(pixels, "pixels").c_str());
   vlog.info("         %s (1:%g ratio)",
             iecPrefix(bytes, "B").c_str(), ratio);
+
+  held = 0;
+  queueMutex->lock();
+  for (iter = freeBuffers.begin(); iter != freeBuffers.end(); ++iter)
+    held += (*iter)->capacity();
+  queueMutex->unlock();
+
+  reuse = 0;
+  if (bufferStats.reused + bufferStats.grown != 0)
+    reuse = 100.0 * bufferStats.reused /
+            (bufferStats.reused + bufferStats.grown);
+
+  vlog.info("  Buffers: %s held (%s peak), %s trimmed",
+            iecPrefix(held, "B").c_str(),
+            iecPrefix(bufferStats.peakHeld, "B").c_str(),
+            iecPrefix(bufferStats.trimmed, "B").c_str());
+  vlog.info("           %.1f%% of rects fit without growing", reuse);
+
+  if (decoders.count(encodingContentCache) != 0) {
+    ContentCacheDecoder* cache;
+
+    cache = (ContentCacheDecoder*)decoders[encodingContentCache];
+
+    vlog.info("  Content cache: %s restored, %s stored",
+              siPrefix(cache->restores, "rects").c_str(),
+              siPrefix(cache->stores, "rects").c_str());
+    vlog.info("                 %s restored, %s held",
+              siPrefix(cache->restoredPixels, "pixels").c_str(),
+              iecPrefix(cache->getMemoryUsage(), "B").c_str());
+  }
 }
 
 void DecodeManager::setThreadException(const rdr::Exception& e)
@@ -274,6 +458,10 @@ DecodeManager::DecodeThread::DecodeThread(DecodeManager* manager)
 
   stopRequested = false;
 
+  traceTrack = 0;
+  if (Tracer::isEnabled())
+    traceTrack = Tracer::newTrack("Decoder thread");
+
   start();
 }
 
@@ -318,9 +506,14 @@ void DecodeManager::DecodeThread::worker()
 
     // Do the actual decoding
     try {
+      uint64_t start;
+
+      start = Tracer::now();
       entry->decoder->decodeRect(entry->rect, entry->bufferStream->data(),
                                  entry->bufferStream->length(),
                                  *entry->server, entry->pb);
+      Tracer::record(traceDecodeRect, traceTrack, entry->frame,
+                     start, Tracer::now(), entry->encoding);
     } catch (rdr::Exception& e) {
       manager->setThreadException(e);
     } catch(...) {
@@ -329,6 +522,14 @@ void DecodeManager::DecodeThread::worker()
 
     manager->queueMutex->lock();
 
+    // Let the rects that were waiting for this one know
+    unsigned unblocked = 0;
+    for (size_t i = 0; i < entry->dependents.size(); i++) {
+      entry->dependents[i]->blockers--;
+      if (entry->dependents[i]->blockers == 0)
+        unblocked++;
+    }
+
     // Remove the entry from the queue and give back the memory buffer
     manager->freeBuffers.push_back(entry->bufferStream);
     manager->workQueue.remove(entry);
@@ -336,9 +537,9 @@ void DecodeManager::DecodeThread::worker()
 
     // Wake the main thread in case it is waiting for a memory buffer
     manager->producerCond->signal();
-    // This rect might have been blocking multiple other rects, so
-    // wake up every worker thread
-    if (manager->workQueue.size() > 1)
+    // We'll take one of the rects that can now run ourselves, so only
+    // wake other workers if there are more
+    if (unblocked > 1)
       manager->consumerCond->broadcast();
   }
 
@@ -348,61 +549,14 @@ void DecodeManager::DecodeThread::worker()
 DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
 {
   std::list<DecodeManager::QueueEntry*>::iterator iter;
-  Region lockedRegion;
-
-  if (manager->workQueue.empty())
-    return NULL;
-
-  if (!manager->workQueue.front()->active)
-    return manager->workQueue.front();
 
+  // The queue never holds more than a couple of rects per thread, so
+  // a scan for the first one that isn't waiting for anything is cheap
   for (iter = manager->workQueue.begin();
        iter != manager->workQueue.end();
        ++iter) {
-    DecodeManager::QueueEntry* entry;
-
-    std::list<DecodeManager::QueueEntry*>::iterator iter2;
-
-    entry = *iter;
-
-    // Another thread working on this?
-    if (entry->active)
-      goto next;
-
-    // If this is an ordered decoder then make sure this is the first
-    // rectangle in the queue for that decoder
-    if (entry->decoder->flags & DecoderOrdered) {
-      for (iter2 = manager->workQueue.begin(); iter2 != iter; ++iter2) {
-        if (entry->encoding == (*iter2)->encoding)
-          goto next;
-      }
-    }
-
-    // For a partially ordered decoder we must ask the decoder for each
-    // pair of rectangles.
-    if (entry->decoder->flags & DecoderPartiallyOrdered) {
-      for (iter2 = manager->workQueue.begin(); iter2 != iter; ++iter2) {
-        if (entry->encoding != (*iter2)->encoding)
-          continue;
-        if (entry->decoder->doRectsConflict(entry->rect,
-                                            entry->bufferStream->data(),
-                                            entry->bufferStream->length(),
-                                            (*iter2)->rect,
-                                            (*iter2)->bufferStream->data(),
-                                            (*iter2)->bufferStream->length(),
-                                            *entry->server))
-          goto next;
-      }
-    }
-
-    // Check overlap with earlier rectangles
-    if (!lockedRegion.intersect(entry->affectedRegion).is_empty())
-      goto next;
-
-    return entry;
-
-next:
-    lockedRegion.assign_union(entry->affectedRegion);
+    if (!(*iter)->active && ((*iter)->blockers == 0))
+      return *iter;
   }
 
   return NULL;
@@ -20,6 +20,8 @@
 #define __RFB_DECODEMANAGER_H__
 
 #include <list>
+#include <map>
+#include <vector>
 
 #include <os/Thread.h>
 
@@ -53,6 +55,9 @@ namespace rfb {
     void flush();
 
   private:
+    std::list<rdr::MemOutStream*>::iterator takeBuffer(size_t needed);
+    void trimBuffers();
+
     void logStats();
 
     void setThreadException(const rdr::Exception& e);
@@ -60,7 +65,9 @@ namespace rfb {
 
   private:
     CConnection *conn;
-    Decoder *decoders[encodingMax+1];
+    // Indexed by encoding, which can be far above encodingMax for
+    // vendor specific ones
+    std::map<int, Decoder*> decoders;
 
     struct DecoderStats {
       unsigned rects;
@@ -69,7 +76,7 @@ namespace rfb {
       unsigned long long equivalent;
     };
 
-    DecoderStats stats[encodingMax+1];
+    std::map<int, DecoderStats> stats;
 
     struct QueueEntry {
       bool active;
@@ -80,9 +87,31 @@ namespace rfb {
       ModifiablePixelBuffer* pb;
       rdr::MemOutStream* bufferStream;
       Region affectedRegion;
+      Rect affectedRect;
+      uint32_t frame;
+      // Number of earlier entries that have to be decoded first
+      unsigned blockers;
+      // Later entries that are waiting for this one
+      std::vector<QueueEntry*> dependents;
     };
 
+    static bool entriesConflict(const QueueEntry* earlier,
+                                const QueueEntry* later);
+
     std::list<rdr::MemOutStream*> freeBuffers;
+
+    // Only used by the main thread
+    struct BufferStats {
+      unsigned reused;
+      unsigned grown;
+      unsigned long long trimmed;
+      size_t peakHeld;
+    };
+
+    BufferStats bufferStats;
+    // Largest rect seen since the buffers were last trimmed
+    size_t bufferWindowPeak;
+    unsigned bufferWindowRects;
     std::list<QueueEntry*> workQueue;
 
     os::Mutex* queueMutex;
@@ -105,6 +134,8 @@ namespace rfb {
       DecodeManager* manager;
 
       bool stopRequested;
+
+      unsigned traceTrack;
     };
 
     std::list<DecodeThread*> threads;
@@ -27,6 +27,7 @@
 #include <rfb/Decoder.h>
 #include <rfb/RawDecoder.h>
 #include <rfb/CopyRectDecoder.h>
+#include <rfb/ContentCacheDecoder.h>
 #include <rfb/RREDecoder.h>
 #include <rfb/HextileDecoder.h>
 #include <rfb/ZRLEDecoder.h>
@@ -34,6 +35,9 @@
 #ifdef HAVE_H264
 #include <rfb/H264Decoder.h>
 #endif
+#ifdef HAVE_ZSTD
+#include <rfb/ZstdRLEDecoder.h>
+#endif
 
 using namespace rfb;
 
@@ -77,6 +81,10 @@ bool Decoder::supported(int encoding)
 #ifdef HAVE_H264
   case encodingH264:
 #endif
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:
+#endif
+  case encodingContentCache:
     return true;
   default:
     return false;
@@ -102,6 +110,12 @@ Decoder* Decoder::createDecoder(int encoding)
   case encodingH264:
     return new H264Decoder();
 #endif
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:
+    return new ZstdRLEDecoder();
+#endif
+  case encodingContentCache:
+    return new ContentCacheDecoder();
   default:
     return NULL;
   }
@@ -24,15 +24,20 @@
 #endif
 
 #include <stdlib.h>
+#include <sys/time.h>
+
+#include <algorithm>
 
 #include <rfb/EncodeManager.h>
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/LogWriter.h>
 #include <rfb/Exception.h>
+#include <rfb/Tracer.h>
 #include <rfb/util.h>
 
 #include <rfb/RawEncoder.h>
@@ -41,6 +46,9 @@
 #include <rfb/ZRLEEncoder.h>
 #include <rfb/TightEncoder.h>
 #include <rfb/TightJPEGEncoder.h>
+#ifdef HAVE_ZSTD
+#include <rfb/ZstdRLEEncoder.h>
+#endif
 
 using namespace rfb;
 
@@ -57,9 +65,36 @@ static const int SolidSearchBlock = 16;
 // Don't bother with blocks smaller than this
 static const int SolidBlockMinArea = 2048;
 
-// How long we consider a region recently changed (in ms)
+// How long we consider a region recently changed (in ms). This is
+// about how often content changes, not about the link, so it doesn't
+// follow the bandwidth.
 static const int RecentChangeTimeout = 50;
 
+// How much encoding time (in us) to measure before reconsidering the
+// compression level
+static const uint64_t AdaptiveInterval = 20000;
+
+// Tiles that changed in at least this many of the last eight updates,
+// and that look like photos, are considered video
+static const int VideoMinChanges = 6;
+// How long (in ms) video has to be still before it gets a lossless
+// refresh
+static const int VideoTimeout = 500;
+// How many updates with video to measure before reconsidering its
+// quality
+static const unsigned VideoInterval = 8;
+
+// How many separate lossy areas we keep track of the age of
+static const size_t MaxLossyAreas = 16;
+
+// How many pixels of lossless refreshes to measure before older
+// measurements start counting less
+static const unsigned long long RefreshHistory = 4 * 1024 * 1024;
+// And how many we need before we trust the measurements at all
+static const unsigned long long RefreshMinPixels = 64 * 1024;
+// Lossy areas this close (in pixels) to the focus are refreshed first
+static const int RefreshFocusDistance = 64;
+
 namespace rfb {
 
 enum EncoderClass {
@@ -69,6 +104,9 @@ enum EncoderClass {
   encoderTight,
   encoderTightJPEG,
   encoderZRLE,
+#ifdef HAVE_ZSTD
+  encoderZstdRLE,
+#endif
   encoderClassMax,
 };
 
@@ -104,6 +142,10 @@ static const char *encoderClassName(EncoderClass klass)
     return "Tight (JPEG)";
   case encoderZRLE:
     return "ZRLE";
+#ifdef HAVE_ZSTD
+  case encoderZstdRLE:
+    return "ZstdRLE";
+#endif
   case encoderClassMax:
     break;
   }
@@ -134,22 +176,25 @@ static const char *encoderTypeName(EncoderType type)
 }
 
 EncodeManager::EncodeManager(SConnection* conn_)
-  : conn(conn_), recentChangeTimer(this)
+  : conn(conn_), lossyCleared(0), lossyClearedTime(0), lossyMaxTime(0),
+    refreshBytes(0), refreshPixels(0), refreshTime(0),
+    recentChangeTimer(this), encoderIdleTimer(this),
+    traceTrack(0), beforeTime(0), linkBandwidth(0), adaptiveLevel(-1),
+    adaptiveTime(0), adaptiveBytes(0), adjustQuality(false),
+    qualityOffset(0), videoQualityOffset(0), videoBytes(0),
+    videoUpdates(0), videoPixels(0)
 {
   StatsVector::iterator iter;
 
+  // Encoders are created as they are needed, see getEncoder()
   encoders.resize(encoderClassMax, NULL);
   activeEncoders.resize(encoderTypeMax, encoderRaw);
-
-  encoders[encoderRaw] = new RawEncoder(conn);
-  encoders[encoderRRE] = new RREEncoder(conn);
-  encoders[encoderHextile] = new HextileEncoder(conn);
-  encoders[encoderTight] = new TightEncoder(conn);
-  encoders[encoderTightJPEG] = new TightJPEGEncoder(conn);
-  encoders[encoderZRLE] = new ZRLEEncoder(conn);
+  encoderLastUsed.resize(encoderClassMax);
+  refreshStats.resize(encoderClassMax);
 
   updates = 0;
   memset(&copyStats, 0, sizeof(copyStats));
+  memset(cacheStats, 0, sizeof(cacheStats));
   stats.resize(encoderClassMax);
   for (iter = stats.begin();iter != stats.end();++iter) {
     StatsVector::value_type::iterator iter2;
@@ -201,6 +246,32 @@ void EncodeManager::logStats()
               iecPrefix(copyStats.bytes, "B").c_str(), ratio);
   }
 
+  if ((cacheStats[contentCacheRestore].rects != 0) ||
+      (cacheStats[contentCacheStore].rects != 0)) {
+    static const char* opNames[] = { "Stores", "Restores" };
+
+    vlog.info("  %s:", "ContentCache");
+
+    for (i = 0;i < 2;i++) {
+      if (cacheStats[i].rects == 0)
+        continue;
+
+      rects += cacheStats[i].rects;
+      pixels += cacheStats[i].pixels;
+      bytes += cacheStats[i].bytes;
+      equivalent += cacheStats[i].equivalent;
+
+      ratio = (double)cacheStats[i].equivalent / cacheStats[i].bytes;
+
+      vlog.info("    %s: %s, %s", opNames[i],
+                siPrefix(cacheStats[i].rects, "rects").c_str(),
+                siPrefix(cacheStats[i].pixels, "pixels").c_str());
+      vlog.info("    %*s  %s (1:%g ratio)",
+                (int)strlen(opNames[i]), "",
+                iecPrefix(cacheStats[i].bytes, "B").c_str(), ratio);
+    }
+  }
+
   for (i = 0;i < stats.size();i++) {
     // Did this class do anything at all?
     for (j = 0;j < stats[i].size();j++) {
@@ -239,6 +310,43 @@ void EncodeManager::logStats()
             siPrefix(pixels, "pixels").c_str());
   vlog.info("         %s (1:%g ratio)",
             iecPrefix(bytes, "B").c_str(), ratio);
+
+  if (adaptiveLevel != -1) {
+    vlog.info("  Compression level: %d (client asked for %d)",
+              adaptiveLevel, conn->client.compressLevel);
+  }
+
+  if (videoPixels != 0) {
+    vlog.info("  Video: %s (quality offset %d)",
+              siPrefix(videoPixels, "pixels").c_str(), videoQualityOffset);
+  }
+
+  if (lossyCleared != 0) {
+    vlog.info("  Lossy areas: %u refreshed after %llu ms on average, "
+              "%u ms at most", lossyCleared,
+              lossyClearedTime / lossyCleared, lossyMaxTime);
+  }
+
+  bytes = 0;
+  for (i = 0;i < encoders.size();i++) {
+    if (encoders[i] != NULL)
+      bytes += encoders[i]->getMemoryUsage();
+  }
+
+  vlog.info("  Encoder memory: %s", iecPrefix(bytes, "B").c_str());
+
+  for (i = 0;i < encoders.size();i++) {
+    if ((encoders[i] == NULL) || (encoders[i]->getMemoryUsage() == 0))
+      continue;
+    vlog.info("    %s: %s", encoderClassName((EncoderClass)i),
+              iecPrefix(encoders[i]->getMemoryUsage(), "B").c_str());
+  }
+
+  if (contentCache.getSlots() != 0) {
+    vlog.info("  Content cache index: %s (%u slots)",
+              iecPrefix(contentCache.getMemoryUsage(), "B").c_str(),
+              contentCache.getSlots());
+  }
 }
 
 bool EncodeManager::supported(int encoding)
@@ -249,6 +357,9 @@ bool EncodeManager::supported(int encoding)
   case encodingHextile:
   case encodingZRLE:
   case encodingTight:
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:
+#endif
     return true;
   default:
     return false;
@@ -274,55 +385,272 @@ int EncodeManager::getNextLosslessRefresh(const Region& req)
 
 void EncodeManager::pruneLosslessRefresh(const Region& limits)
 {
+  std::list<LossyArea>::iterator iter;
+
   lossyRegion.assign_intersect(limits);
   pendingRefreshRegion.assign_intersect(limits);
+
+  // Areas that disappeared were never refreshed, so they don't count
+  // towards the statistics
+  iter = lossyAreas.begin();
+  while (iter != lossyAreas.end()) {
+    iter->region.assign_intersect(limits);
+    if (iter->region.is_empty())
+      iter = lossyAreas.erase(iter);
+    else
+      ++iter;
+  }
 }
 
 void EncodeManager::writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
                                 const RenderedCursor* renderedCursor)
 {
+  updateMotion(ui.changed, pb->getRect());
+
   doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, renderedCursor);
 
   recentlyChangedRegion.assign_union(ui.changed);
   recentlyChangedRegion.assign_union(ui.copied);
   if (!recentChangeTimer.isStarted())
     recentChangeTimer.start(RecentChangeTimeout);
+
+  startIdleTimer();
 }
 
 void EncodeManager::writeLosslessRefresh(const Region& req, const PixelBuffer* pb,
                                          const RenderedCursor* renderedCursor,
-                                         size_t maxUpdateSize)
+                                         size_t maxUpdateSize,
+                                         const Point& focus)
+{
+  Region refresh;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+  StatsVector before;
+  size_t beforeBytes;
+  uint64_t start;
+
+  refresh = getLosslessRefresh(req, maxUpdateSize, focus);
+
+  before = stats;
+  beforeBytes = conn->getOutStream()->length();
+  start = usMonotonic();
+
+  doUpdate(false, refresh, Region(), Point(), pb, renderedCursor);
+
+  refreshBytes += conn->getOutStream()->length() - beforeBytes;
+  refresh.get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect)
+    refreshPixels += rect->area();
+  refreshTime += usMonotonic() - start;
+
+  for (int klass = 0; klass < encoderClassMax; klass++) {
+    for (int type = 0; type < encoderTypeMax; type++) {
+      refreshStats[klass].bytes +=
+        stats[klass][type].bytes - before[klass][type].bytes;
+      refreshStats[klass].pixels +=
+        stats[klass][type].pixels - before[klass][type].pixels;
+    }
+
+    if (refreshStats[klass].pixels > RefreshHistory) {
+      refreshStats[klass].bytes /= 2;
+      refreshStats[klass].pixels /= 2;
+    }
+  }
+
+  // Content changes, so let older refreshes fade out
+  if (refreshPixels > RefreshHistory) {
+    refreshBytes /= 2;
+    refreshPixels /= 2;
+    refreshTime /= 2;
+  }
+
+  startIdleTimer();
+}
+
+size_t EncodeManager::getRefreshEncodeRate()
 {
-  doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
-           Region(), Point(), pb, renderedCursor);
+  if ((refreshPixels < RefreshMinPixels) || (refreshTime == 0))
+    return 0;
+
+  return refreshBytes * 1000000 / refreshTime;
 }
 
 bool EncodeManager::handleTimeout(Timer* t)
 {
   if (t == &recentChangeTimer) {
+    // Video only gets refreshed once it has stopped for a while
+    if (!videoRegion.is_empty() &&
+        (msSince(&videoLastChanged) >= VideoTimeout)) {
+      videoRegion.clear();
+      motionHistory.assign(motionHistory.size(), 0);
+    }
+
     // Any lossy region that wasn't recently updated can
     // now be scheduled for a refresh
-    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion));
+    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion)
+                                                 .subtract(videoRegion));
     recentlyChangedRegion.clear();
 
     // Will there be more to do? (i.e. do we need another round)
     if (!lossyRegion.subtract(pendingRefreshRegion).is_empty())
       return true;
+  } else if (t == &encoderIdleTimer) {
+    return releaseIdleEncoders();
   }
 
   return false;
 }
 
+Encoder* EncodeManager::getEncoder(int klass)
+{
+  Encoder* encoder;
+
+  if (encoders[klass] != NULL)
+    return encoders[klass];
+
+  switch (klass) {
+  case encoderRaw:
+    encoder = new RawEncoder(conn);
+    break;
+  case encoderRRE:
+    encoder = new RREEncoder(conn);
+    break;
+  case encoderHextile:
+    encoder = new HextileEncoder(conn);
+    break;
+  case encoderTight:
+    encoder = new TightEncoder(conn);
+    // The client still has the zlib state from any previous instance
+    if (isEncoderUsed(klass))
+      ((TightEncoder*)encoder)->resetStreams();
+    break;
+  case encoderTightJPEG:
+    encoder = new TightJPEGEncoder(conn);
+    break;
+  case encoderZRLE:
+    encoder = new ZRLEEncoder(conn);
+    break;
+#ifdef HAVE_ZSTD
+  case encoderZstdRLE:
+    encoder = new ZstdRLEEncoder(conn);
+    break;
+#endif
+  default:
+    throw Exception("Invalid encoder class %d", klass);
+  }
+
+  encoders[klass] = encoder;
+  gettimeofday(&encoderLastUsed[klass], NULL);
+
+  return encoder;
+}
+
+bool EncodeManager::isSupported(int klass)
+{
+  switch (klass) {
+  case encoderRaw:
+    return true;
+  case encoderRRE:
+    return conn->client.supportsEncoding(encodingRRE);
+  case encoderHextile:
+    return conn->client.supportsEncoding(encodingHextile);
+  case encoderTight:
+    return conn->client.supportsEncoding(encodingTight);
+  case encoderTightJPEG:
+    return TightJPEGEncoder::clientSupportsJPEG(conn->client);
+  case encoderZRLE:
+    return conn->client.supportsEncoding(encodingZRLE);
+#ifdef HAVE_ZSTD
+  case encoderZstdRLE:
+    return conn->client.supportsEncoding(encodingZstdRLE);
+#endif
+  }
+
+  return false;
+}
+
+bool EncodeManager::isEncoderUsed(int klass)
+{
+  StatsVector::value_type::const_iterator iter;
+
+  for (iter = stats[klass].begin(); iter != stats[klass].end(); ++iter) {
+    if (iter->rects != 0)
+      return true;
+  }
+
+  return false;
+}
+
+bool EncodeManager::releaseIdleEncoders()
+{
+  size_t i;
+  bool remaining;
+
+  if (Server::encoderIdleTimeout == 0)
+    return false;
+
+  remaining = false;
+
+  for (i = 0;i < encoders.size();i++) {
+    if (encoders[i] == NULL)
+      continue;
+
+    // ZRLE has no way of telling the client to reset its zlib stream,
+    // so that encoder has to stay once it has been used
+    if ((i == encoderZRLE) && isEncoderUsed(i))
+      continue;
+#ifdef HAVE_ZSTD
+    // Same thing for the Zstandard stream
+    if ((i == encoderZstdRLE) && isEncoderUsed(i))
+      continue;
+#endif
+
+    if (msSince(&encoderLastUsed[i]) <
+        (unsigned)Server::encoderIdleTimeout * 1000) {
+      remaining = true;
+      continue;
+    }
+
+    vlog.debug("Releasing idle %s encoder (%s)",
+               encoderClassName((EncoderClass)i),
+               iecPrefix(encoders[i]->getMemoryUsage(), "B").c_str());
+
+    delete encoders[i];
+    encoders[i] = NULL;
+  }
+
+  // Keep checking as long as there is something left to release
+  return remaining;
+}
+
+void EncodeManager::startIdleTimer()
+{
+  if (Server::encoderIdleTimeout == 0)
+    return;
+  if (encoderIdleTimer.isStarted())
+    return;
+
+  encoderIdleTimer.start(Server::encoderIdleTimeout * 1000);
+}
+
 void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
                              const Region& copied, const Point& copyDelta,
                              const PixelBuffer* pb,
                              const RenderedCursor* renderedCursor)
 {
     int nRects;
-    Region changed, cursorRegion;
+    Region changed, cursorRegion, interestRegion, video;
+    int boost;
+    Encoder* fullColour;
+    std::vector<CacheTile> cacheStores;
+    uint64_t start;
+    int startLength;
 
     updates++;
 
+    start = Tracer::now();
+    startLength = conn->getOutStream()->length();
+
     prepareEncoders(allowLossy);
 
     changed = changed_;
@@ -339,14 +667,30 @@ void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
       changed.assign_subtract(renderedCursor->getEffectiveRect());
     }
 
+    // Video will end up as JPEG anyway, so there is no point in
+    // looking for solid areas or palettes in it
+    fullColour = getEncoder(activeEncoders[encoderFullColour]);
+    if (allowLossy && (fullColour->flags & EncoderLossy)) {
+      video = changed.intersect(videoRegion);
+      changed.assign_subtract(videoRegion);
+    }
+
+    // Where the user is looking gets a better quality, and everything
+    // else a bit worse to make up for it
+    boost = Server::roiQualityBoost;
+    if (allowLossy && (boost > 0))
+      interestRegion = regionOfInterest;
+
     if (conn->client.supportsEncoding(pseudoEncodingLastRect))
       nRects = 0xFFFF;
     else {
       nRects = 0;
       if (conn->client.supportsEncoding(encodingCopyRect))
         nRects += copied.numRects();
-      nRects += computeNumRects(changed);
+      nRects += computeNumRects(changed.subtract(interestRegion));
+      nRects += computeNumRects(changed.intersect(interestRegion));
       nRects += computeNumRects(cursorRegion);
+      nRects += computeNumRects(video);
     }
 
     conn->writer()->writeFramebufferUpdateStart(nRects);
@@ -354,17 +698,77 @@ void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
     if (conn->client.supportsEncoding(encodingCopyRect))
       writeCopyRects(copied, copyDelta);
 
+    if (!video.is_empty()) {
+      int videoStart;
+
+      videoStart = conn->getOutStream()->length();
+
+      adjustQuality = true;
+      qualityOffset = videoQualityOffset;
+      writeRects(video, pb, true);
+      adjustQuality = false;
+
+      // The encoders keep the lowered quality, so put it back for the
+      // rest of the update
+      resetQuality();
+
+      videoBytes += conn->getOutStream()->length() - videoStart;
+      if (videoUpdates == 0)
+        gettimeofday(&videoIntervalStart, NULL);
+      videoUpdates++;
+      if (videoUpdates >= VideoInterval)
+        updateVideoQuality();
+    }
+
+    /*
+     * Anything the client already has a copy of is cheaper to send
+     * than even solid rects.
+     */
+    if (prepareContentCache(pb))
+      writeCachedRects(&changed, pb, &cacheStores);
+
     /*
      * We start by searching for solid rects, which are then removed
      * from the changed region.
      */
-    if (conn->client.supportsEncoding(pseudoEncodingLastRect))
+    if (conn->client.supportsEncoding(pseudoEncodingLastRect)) {
       writeSolidRects(&changed, pb);
+      // The area around the cursor is often solid as well
+      writeSolidRects(&cursorRegion, renderedCursor);
+    }
+
+    if (interestRegion.is_empty()) {
+      writeRects(changed, pb);
+      writeRects(cursorRegion, renderedCursor);
+    } else {
+      Region interest;
+
+      interest = changed.intersect(interestRegion);
+      changed.assign_subtract(interestRegion);
+
+      adjustQuality = true;
+
+      qualityOffset = -((boost + 1) / 2);
+      writeRects(changed, pb);
 
-    writeRects(changed, pb);
-    writeRects(cursorRegion, renderedCursor);
+      qualityOffset = boost;
+      if (isInterestLossless(boost))
+        prepareEncoders(false);
+      writeRects(interest, pb);
+      // The cursor is where the pointer is, so always interesting
+      writeRects(cursorRegion, renderedCursor);
+
+      adjustQuality = false;
+    }
+
+    // The client has the new contents now, so it can keep copies
+    writeCacheStores(cacheStores);
 
     conn->writer()->writeFramebufferUpdateEnd();
+
+    Tracer::record(traceUpdate, traceTrack, Tracer::currentFrame(),
+                   start, Tracer::now(),
+                   conn->getOutStream()->length() - startLength);
 }
 
 void EncodeManager::prepareEncoders(bool allowLossy)
@@ -383,7 +787,7 @@ void EncodeManager::prepareEncoders(bool allowLossy)
 
   allowJPEG = conn->client.pf().bpp >= 16;
   if (!allowLossy) {
-    if (encoders[encoderTightJPEG]->losslessQuality == -1)
+    if (TightJPEGEncoder::losslessQualityLevel == -1)
       allowJPEG = false;
   }
 
@@ -399,7 +803,7 @@ void EncodeManager::prepareEncoders(bool allowLossy)
     bitmapRLE = indexedRLE = fullColour = encoderHextile;
     break;
   case encodingTight:
-    if (encoders[encoderTightJPEG]->isSupported() && allowJPEG)
+    if (isSupported(encoderTightJPEG) && allowJPEG)
       fullColour = encoderTightJPEG;
     else
       fullColour = encoderTight;
@@ -411,27 +815,34 @@ void EncodeManager::prepareEncoders(bool allowLossy)
     bitmapRLE = indexedRLE = encoderZRLE;
     bitmap = indexed = encoderZRLE;
     break;
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:
+    fullColour = encoderZstdRLE;
+    bitmapRLE = indexedRLE = encoderZstdRLE;
+    bitmap = indexed = encoderZstdRLE;
+    break;
+#endif
   }
 
   // Any encoders still unassigned?
 
   if (fullColour == encoderRaw) {
-    if (encoders[encoderTightJPEG]->isSupported() && allowJPEG)
+    if (isSupported(encoderTightJPEG) && allowJPEG)
       fullColour = encoderTightJPEG;
-    else if (encoders[encoderZRLE]->isSupported())
+    else if (isSupported(encoderZRLE))
       fullColour = encoderZRLE;
-    else if (encoders[encoderTight]->isSupported())
+    else if (isSupported(encoderTight))
       fullColour = encoderTight;
-    else if (encoders[encoderHextile]->isSupported())
+    else if (isSupported(encoderHextile))
       fullColour = encoderHextile;
   }
 
   if (indexed == encoderRaw) {
-    if (encoders[encoderZRLE]->isSupported())
+    if (isSupported(encoderZRLE))
       indexed = encoderZRLE;
-    else if (encoders[encoderTight]->isSupported())
+    else if (isSupported(encoderTight))
       indexed = encoderTight;
-    else if (encoders[encoderHextile]->isSupported())
+    else if (isSupported(encoderHextile))
       indexed = encoderHextile;
   }
 
@@ -444,19 +855,19 @@ void EncodeManager::prepareEncoders(bool allowLossy)
     bitmapRLE = bitmap;
 
   if (solid == encoderRaw) {
-    if (encoders[encoderTight]->isSupported())
+    if (isSupported(encoderTight))
       solid = encoderTight;
-    else if (encoders[encoderRRE]->isSupported())
+    else if (isSupported(encoderRRE))
       solid = encoderRRE;
-    else if (encoders[encoderZRLE]->isSupported())
+    else if (isSupported(encoderZRLE))
       solid = encoderZRLE;
-    else if (encoders[encoderHextile]->isSupported())
+    else if (isSupported(encoderHextile))
       solid = encoderHextile;
   }
 
   // JPEG is the only encoder that can reduce things to grayscale
   if ((conn->client.subsampling == subsampleGray) &&
-      encoders[encoderTightJPEG]->isSupported() && allowLossy) {
+      isSupported(encoderTightJPEG) && allowLossy) {
     solid = bitmap = bitmapRLE = encoderTightJPEG;
     indexed = indexedRLE = fullColour = encoderTightJPEG;
   }
@@ -468,10 +879,21 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   activeEncoders[encoderIndexedRLE] = indexedRLE;
   activeEncoders[encoderFullColour] = fullColour;
 
+  // The client's level is the most we will use, but we might go lower
+  // if the link is faster than we can compress
+  if (Server::adaptiveCompressLevel && (conn->client.compressLevel >= 0)) {
+    if ((adaptiveLevel == -1) ||
+        (adaptiveLevel > conn->client.compressLevel))
+      adaptiveLevel = conn->client.compressLevel;
+  } else {
+    adaptiveLevel = -1;
+  }
+
   for (iter = activeEncoders.begin(); iter != activeEncoders.end(); ++iter) {
     Encoder *encoder;
 
-    encoder = encoders[*iter];
+    encoder = getEncoder(*iter);
+    gettimeofday(&encoderLastUsed[*iter], NULL);
 
     encoder->setCompressLevel(conn->client.compressLevel);
 
@@ -488,41 +910,99 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   }
 }
 
+// Orders rects by how far they are from a point
+struct FocusDistance {
+  FocusDistance(const Point& focus_) : focus(focus_) {}
+
+  long long distance(const Rect& r) const {
+    long long dx, dy;
+
+    dx = __rfbmax(0, __rfbmax(r.tl.x - focus.x, focus.x - (r.br.x - 1)));
+    dy = __rfbmax(0, __rfbmax(r.tl.y - focus.y, focus.y - (r.br.y - 1)));
+
+    return dx * dx + dy * dy;
+  }
+
+  bool operator()(const Rect& a, const Rect& b) const {
+    return distance(a) < distance(b);
+  }
+
+  Point focus;
+};
+
 Region EncodeManager::getLosslessRefresh(const Region& req,
-                                         size_t maxUpdateSize)
+                                         size_t maxUpdateSize,
+                                         const Point& focus)
 {
   std::vector<Rect> rects;
+  std::vector<Rect>::iterator iter;
+  FocusDistance closer(focus);
+  size_t first;
   Region refresh;
-  size_t area;
+  int klass;
+  double bytesPerPixel;
+  size_t maxArea, area;
+
+  // Lossy areas are photos, so the refresh is mostly sent with the
+  // full colour encoder. doUpdate() will do this again, but we need
+  // to know which encoder that is now.
+  prepareEncoders(false);
+  klass = activeEncoders[encoderFullColour];
+
+  // We will measure pixels, not bytes, so use what that encoder has
+  // compressed refreshes to so far. Encoders differ a lot here, and
+  // the client can switch between them. Until we know, make a
+  // conservative guess at the compression ratio at 2:1.
+  if (refreshStats[klass].pixels >= RefreshMinPixels)
+    bytesPerPixel = (double)refreshStats[klass].bytes /
+                    refreshStats[klass].pixels;
+  else
+    bytesPerPixel = conn->client.pf().bpp / 8 / 2.0;
 
-  // We make a conservative guess at the compression ratio at 2:1
-  maxUpdateSize *= 2;
+  // Very compressible content shouldn't make us bite off more than
+  // the encoders can chew in one go
+  if (bytesPerPixel < 0.01)
+    bytesPerPixel = 0.01;
 
-  // We will measure pixels, not bytes (assume 32 bpp)
-  maxUpdateSize /= 4;
+  maxArea = maxUpdateSize / bytesPerPixel;
 
-  area = 0;
+  // Start with what is close to where the user is looking, which we
+  // assume is the cursor
   pendingRefreshRegion.intersect(req).get_rects(&rects);
-  while (!rects.empty()) {
-    size_t idx;
-    Rect rect;
+  std::stable_sort(rects.begin(), rects.end(), closer);
+
+  // Take the rest in random order, so we don't keep damaging and
+  // restoring the same rect over and over
+  for (first = 0; first < rects.size(); first++) {
+    if (closer.distance(rects[first]) >
+        RefreshFocusDistance * RefreshFocusDistance)
+      break;
+  }
+  for (size_t i = first; i + 1 < rects.size(); i++)
+    std::swap(rects[i], rects[i + rand() % (rects.size() - i)]);
 
-    // Grab a random rect so we don't keep damaging and restoring the
-    // same rect over and over
-    idx = rand() % rects.size();
+  area = 0;
+  for (iter = rects.begin(); iter != rects.end(); ++iter) {
+    Rect rect;
 
-    rect = rects[idx];
+    rect = *iter;
 
     // Add rects until we exceed the threshold, then include as much as
-    // possible of the final rect
-    if ((area + rect.area()) > maxUpdateSize) {
+    // possible of the final rect, from the side closest to the focus
+    if ((area + rect.area()) > maxArea) {
       // Use the narrowest axis to avoid getting to thin rects
       if (rect.width() > rect.height()) {
-        int width = (maxUpdateSize - area) / rect.height();
-        rect.br.x = rect.tl.x + __rfbmax(1, width);
+        int width = __rfbmax(1, (int)((maxArea - area) / rect.height()));
+        if (focus.x >= (rect.tl.x + rect.br.x) / 2)
+          rect.tl.x = rect.br.x - width;
+        else
+          rect.br.x = rect.tl.x + width;
       } else {
-        int height = (maxUpdateSize - area) / rect.width();
-        rect.br.y = rect.tl.y + __rfbmax(1, height);
+        int height = __rfbmax(1, (int)((maxArea - area) / rect.width()));
+        if (focus.y >= (rect.tl.y + rect.br.y) / 2)
+          rect.tl.y = rect.br.y - height;
+        else
+          rect.br.y = rect.tl.y + height;
       }
       refresh.assign_union(Region(rect));
       break;
@@ -530,13 +1010,71 @@ Region EncodeManager::getLosslessRefresh(const Region& req,
 
     area += rect.area();
     refresh.assign_union(Region(rect));
-
-    rects.erase(rects.begin() + idx);
   }
 
   return refresh;
 }
 
+void EncodeManager::addLossy(const Region& region)
+{
+  Region added;
+
+  added = region.subtract(lossyRegion);
+  lossyRegion.assign_union(region);
+
+  if (added.is_empty())
+    return;
+
+  if (!lossyAreas.empty() && (lossyAreas.back().update == updates)) {
+    lossyAreas.back().region.assign_union(added);
+    return;
+  }
+
+  lossyAreas.push_back(LossyArea());
+  lossyAreas.back().region = added;
+  lossyAreas.back().update = updates;
+  gettimeofday(&lossyAreas.back().since, NULL);
+
+  // Merge the oldest ones, keeping the older time
+  if (lossyAreas.size() > MaxLossyAreas) {
+    std::list<LossyArea>::iterator second;
+
+    second = ++lossyAreas.begin();
+    second->region.assign_union(lossyAreas.front().region);
+    second->since = lossyAreas.front().since;
+    lossyAreas.pop_front();
+  }
+}
+
+void EncodeManager::removeLossy(const Region& region)
+{
+  std::list<LossyArea>::iterator iter;
+
+  if (lossyRegion.is_empty())
+    return;
+
+  lossyRegion.assign_subtract(region);
+
+  iter = lossyAreas.begin();
+  while (iter != lossyAreas.end()) {
+    unsigned age;
+
+    iter->region.assign_subtract(region);
+    if (!iter->region.is_empty()) {
+      ++iter;
+      continue;
+    }
+
+    age = msSince(&iter->since);
+    lossyCleared++;
+    lossyClearedTime += age;
+    if (age > lossyMaxTime)
+      lossyMaxTime = age;
+
+    iter = lossyAreas.erase(iter);
+  }
+}
+
 int EncodeManager::computeNumRects(const Region& changed)
 {
   int numRects;
@@ -580,6 +1118,8 @@ Encoder *EncodeManager::startRect(const Rect& rect, int type)
   klass = activeEncoders[activeType];
 
   beforeLength = conn->getOutStream()->length();
+  if (Tracer::isEnabled() || isAdaptiveClass(klass))
+    beforeTime = usMonotonic();
 
   stats[klass][activeType].rects++;
   stats[klass][activeType].pixels += rect.area();
@@ -587,14 +1127,18 @@ Encoder *EncodeManager::startRect(const Rect& rect, int type)
   stats[klass][activeType].equivalent += equiv;
 
   encoder = encoders[klass];
+  if (isAdaptiveClass(klass))
+    encoder->setCompressLevel(adaptiveLevel);
+  if (adjustQuality && (encoder->flags & EncoderLossy))
+    setQualityOffset(encoder, qualityOffset);
   conn->writer()->startRect(rect, encoder->encoding);
 
   if ((encoder->flags & EncoderLossy) &&
       ((encoder->losslessQuality == -1) ||
        (encoder->getQualityLevel() < encoder->losslessQuality)))
-    lossyRegion.assign_union(Region(rect));
+    addLossy(Region(rect));
   else
-    lossyRegion.assign_subtract(Region(rect));
+    removeLossy(Region(rect));
 
   // This was either a rect getting refreshed, or a rect that just got
   // new content. Either way we should not try to refresh it anymore.
@@ -614,6 +1158,107 @@ void EncodeManager::endRect()
 
   klass = activeEncoders[activeType];
   stats[klass][activeType].bytes += length;
+
+  if (Tracer::isEnabled()) {
+    Tracer::record(traceEncodeRect, traceTrack, Tracer::currentFrame(),
+                   beforeTime, Tracer::now(), length);
+  }
+
+  if (isAdaptiveClass(klass)) {
+    adaptiveTime += usMonotonic() - beforeTime;
+    adaptiveBytes += length;
+    if (adaptiveTime >= AdaptiveInterval)
+      updateAdaptiveLevel();
+  }
+}
+
+bool EncodeManager::isAdaptiveClass(int klass)
+{
+  if (adaptiveLevel == -1)
+    return false;
+
+  // Only the zlib based encoders can change level cheaply between
+  // rects
+  return (klass == encoderTight) || (klass == encoderZRLE);
+}
+
+void EncodeManager::updateAdaptiveLevel()
+{
+  size_t rate;
+  int level;
+
+  if (linkBandwidth == 0) {
+    adaptiveTime = adaptiveBytes = 0;
+    return;
+  }
+
+  // How fast the encoders produce data at the current level
+  rate = adaptiveBytes * 1000000 / adaptiveTime;
+
+  level = adaptiveLevel;
+
+  // If the data comes out much faster than the link can take it, then
+  // more CPU time can be spent on making it smaller. If it comes out
+  // slower, then the link is left idle and a cheaper level is better.
+  // The gap between the two limits keeps us from flipping back and
+  // forth between neighbouring levels.
+  if ((rate > linkBandwidth * 2) &&
+      (adaptiveLevel < conn->client.compressLevel))
+    level++;
+  else if ((rate < linkBandwidth) && (adaptiveLevel > 0))
+    level--;
+
+  if (level != adaptiveLevel) {
+    vlog.debug("Compression level %d -> %d (encoding at %s/s, link "
+               "at %s/s)", adaptiveLevel, level,
+               iecPrefix(rate, "B").c_str(),
+               iecPrefix(linkBandwidth, "B").c_str());
+    adaptiveLevel = level;
+  }
+
+  adaptiveTime = adaptiveBytes = 0;
+}
+
+void EncodeManager::setQualityOffset(Encoder* encoder, int offset)
+{
+  int level, fine;
+
+  level = conn->client.qualityLevel;
+  if (level != -1)
+    level = __rfbmax(0, __rfbmin(9, level + offset));
+
+  // Roughly what one level is worth in JPEG quality
+  fine = conn->client.fineQualityLevel;
+  if (fine != -1)
+    fine = __rfbmax(1, __rfbmin(100, fine + offset * 10));
+
+  encoder->setQualityLevel(level);
+  encoder->setFineQualityLevel(fine, conn->client.subsampling);
+}
+
+void EncodeManager::resetQuality()
+{
+  std::vector<int>::iterator iter;
+
+  for (iter = activeEncoders.begin(); iter != activeEncoders.end(); ++iter) {
+    Encoder* encoder;
+
+    encoder = getEncoder(*iter);
+    if (encoder->flags & EncoderLossy)
+      setQualityOffset(encoder, 0);
+  }
+}
+
+bool EncodeManager::isInterestLossless(int boost)
+{
+  // Nothing lossy can do better than the top level, so anything
+  // beyond that means lossless
+  if (conn->client.fineQualityLevel != -1)
+    return conn->client.fineQualityLevel + boost * 10 > 100;
+  if (conn->client.qualityLevel != -1)
+    return conn->client.qualityLevel + boost > 9;
+
+  return false;
 }
 
 void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
@@ -643,13 +1288,338 @@ void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
   lossyCopy = lossyRegion;
   lossyCopy.translate(delta);
   lossyCopy.assign_intersect(copied);
-  lossyRegion.assign_union(lossyCopy);
+  addLossy(lossyCopy);
 
   // Stop any pending refresh as a copy is enough that we consider
   // this region to be recently changed
   pendingRefreshRegion.assign_subtract(copied);
 }
 
+bool EncodeManager::prepareContentCache(const PixelBuffer* pb)
+{
+  unsigned slots;
+
+  // We can't know in advance how many rects there will be
+  if (!conn->client.supportsEncoding(pseudoEncodingLastRect))
+    return false;
+
+  slots = ContentCache::slotsForLevel(conn->client.contentCacheLevel);
+  slots = __rfbmin(slots, (unsigned)Server::contentCacheSize *
+                          ContentCache::slotsForLevel(0));
+
+  if (slots == 0) {
+    if (contentCache.getSlots() != 0)
+      contentCache.setSlots(0);
+    return false;
+  }
+
+  // The hashes are of our pixels, but the client stores its own
+  // version of them
+  if ((slots != contentCache.getSlots()) ||
+      (pb->getPF() != cacheServerPF) ||
+      (conn->client.pf() != cacheClientPF)) {
+    contentCache.setSlots(slots);
+    cacheServerPF = pb->getPF();
+    cacheClientPF = conn->client.pf();
+  }
+
+  return true;
+}
+
+// Adds the area of each rect in the region to the tiles it covers,
+// so that fully covered tiles can be found without any region
+// operations per tile
+static void addTileCoverage(const Region& region, const Rect& grid,
+                            std::vector<int>* coverage)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+  int gridWidth;
+
+  gridWidth = grid.width();
+
+  region.get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    Rect r;
+
+    r = rect->intersect(Rect(grid.tl.x * contentCacheTileSize,
+                             grid.tl.y * contentCacheTileSize,
+                             grid.br.x * contentCacheTileSize,
+                             grid.br.y * contentCacheTileSize));
+    if (r.is_empty())
+      continue;
+
+    for (int ty = r.tl.y / contentCacheTileSize;
+         ty <= (r.br.y - 1) / contentCacheTileSize; ty++) {
+      for (int tx = r.tl.x / contentCacheTileSize;
+           tx <= (r.br.x - 1) / contentCacheTileSize; tx++) {
+        Rect tile(tx * contentCacheTileSize, ty * contentCacheTileSize,
+                  (tx + 1) * contentCacheTileSize,
+                  (ty + 1) * contentCacheTileSize);
+
+        (*coverage)[(ty - grid.tl.y) * gridWidth + (tx - grid.tl.x)] +=
+          r.intersect(tile).area();
+      }
+    }
+  }
+}
+
+void EncodeManager::writeCachedRects(Region *changed, const PixelBuffer* pb,
+                                     std::vector<CacheTile>* stores)
+{
+  Rect bounds, grid;
+  std::vector<int> coverage, recent;
+  std::vector<Rect> restored;
+
+  bounds = changed->get_bounding_rect();
+  if (bounds.is_empty())
+    return;
+
+  // In tiles rather than pixels
+  grid.tl.x = bounds.tl.x / contentCacheTileSize;
+  grid.tl.y = bounds.tl.y / contentCacheTileSize;
+  grid.br.x = (bounds.br.x - 1) / contentCacheTileSize + 1;
+  grid.br.y = (bounds.br.y - 1) / contentCacheTileSize + 1;
+
+  coverage.resize(grid.area());
+  addTileCoverage(*changed, grid, &coverage);
+
+  // Things that keep changing, like video, would just push everything
+  // else out of the cache. So anything that changed recently is only
+  // stored if it has been seen before.
+  recent.resize(grid.area());
+  addTileCoverage(recentlyChangedRegion, grid, &recent);
+
+  for (int ty = grid.tl.y; ty < grid.br.y; ty++) {
+    for (int tx = grid.tl.x; tx < grid.br.x; tx++) {
+      int idx;
+      Rect tile;
+      uint32_t _buffer;
+      uint8_t* colourValue = (uint8_t*)&_buffer;
+      CacheTile entry;
+      unsigned slot;
+
+      idx = (ty - grid.tl.y) * grid.width() + (tx - grid.tl.x);
+
+      tile.setXYWH(tx * contentCacheTileSize, ty * contentCacheTileSize,
+                   contentCacheTileSize, contentCacheTileSize);
+      tile = tile.intersect(pb->getRect());
+
+      if (coverage[idx] != tile.area())
+        continue;
+
+      // Solid rects are already cheap
+      pb->getImage(colourValue, Rect(tile.tl.x, tile.tl.y,
+                                     tile.tl.x + 1, tile.tl.y + 1));
+      if (checkSolidTile(tile, colourValue, pb))
+        continue;
+
+      entry.rect = tile;
+      entry.hash = ContentCache::hashRect(pb, tile);
+
+      if (contentCache.lookup(entry.hash, &slot)) {
+        writeCacheRect(tile, contentCacheRestore, slot);
+        restored.push_back(tile);
+        continue;
+      }
+
+      if ((recent[idx] == 0) || contentCache.checkSeen(entry.hash))
+        stores->push_back(entry);
+    }
+  }
+
+  for (size_t i = 0; i < restored.size(); i++) {
+    changed->assign_subtract(Region(restored[i]));
+    // Only lossless content is ever stored
+    removeLossy(Region(restored[i]));
+    pendingRefreshRegion.assign_subtract(Region(restored[i]));
+  }
+}
+
+void EncodeManager::writeCacheStores(const std::vector<CacheTile>& stores)
+{
+  std::vector<CacheTile>::const_iterator iter;
+
+  for (iter = stores.begin(); iter != stores.end(); ++iter) {
+    unsigned slot;
+
+    // The client has to end up with exactly what we hashed
+    if (!lossyRegion.is_empty() &&
+        !lossyRegion.intersect(Region(iter->rect)).is_empty())
+      continue;
+
+    // Identical tiles in the same update
+    if (contentCache.lookup(iter->hash, &slot))
+      continue;
+
+    slot = contentCache.insert(iter->hash);
+    writeCacheRect(iter->rect, contentCacheStore, slot);
+  }
+}
+
+void EncodeManager::writeCacheRect(const Rect& rect, int op, unsigned slot)
+{
+  rdr::OutStream* os;
+  EncoderStats* opStats;
+  int length;
+
+  os = conn->getOutStream();
+  opStats = &cacheStats[op];
+
+  length = os->length();
+
+  conn->writer()->startRect(rect, encodingContentCache);
+  os->writeU8(op);
+  os->writeU32(slot);
+  conn->writer()->endRect();
+
+  length = os->length() - length;
+
+  opStats->rects++;
+  opStats->bytes += length;
+  if (op == contentCacheRestore) {
+    opStats->pixels += rect.area();
+    opStats->equivalent += 12 + rect.area() * (conn->client.pf().bpp/8);
+  } else {
+    opStats->equivalent += length;
+  }
+}
+
+static int countBits(uint8_t value)
+{
+  int count;
+
+  count = 0;
+  while (value != 0) {
+    value &= value - 1;
+    count++;
+  }
+
+  return count;
+}
+
+void EncodeManager::updateMotion(const Region& changed, const Rect& fb)
+{
+  Rect grid;
+  std::vector<int> coverage;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  // Same tiles as the content cache
+  grid.setXYWH(0, 0,
+               (fb.width() + contentCacheTileSize - 1) / contentCacheTileSize,
+               (fb.height() + contentCacheTileSize - 1) / contentCacheTileSize);
+  if (grid != motionGrid) {
+    motionGrid = grid;
+    motionHistory.assign(grid.area(), 0);
+    photoTiles.assign(grid.area(), false);
+  }
+
+  coverage.resize(grid.area());
+  addTileCoverage(changed, grid, &coverage);
+
+  videoRegion.clear();
+
+  for (int ty = 0; ty < grid.height(); ty++) {
+    Rect run;
+
+    for (int tx = 0; tx < grid.width(); tx++) {
+      int idx;
+      Rect tile;
+      bool moving;
+
+      idx = ty * grid.width() + tx;
+
+      tile.setXYWH(tx * contentCacheTileSize, ty * contentCacheTileSize,
+                   contentCacheTileSize, contentCacheTileSize);
+      tile = tile.intersect(fb);
+
+      // Small changes are more likely to be things like typing, or
+      // a blinking cursor
+      moving = coverage[idx] >= tile.area() / 2;
+      motionHistory[idx] = (motionHistory[idx] << 1) | (moving ? 1 : 0);
+
+      // Lots of changes that can be encoded losslessly, like switching
+      // between windows with text, are not video
+      if ((countBits(motionHistory[idx]) < VideoMinChanges) ||
+          !photoTiles[idx]) {
+        if (!run.is_empty())
+          rects.push_back(run);
+        run.clear();
+        continue;
+      }
+
+      if (run.is_empty())
+        run = tile;
+      else
+        run.br.x = tile.br.x;
+    }
+
+    if (!run.is_empty())
+      rects.push_back(run);
+  }
+
+  for (rect = rects.begin(); rect != rects.end(); ++rect)
+    videoRegion.assign_union(Region(*rect));
+
+  if (!videoRegion.intersect(changed).is_empty())
+    gettimeofday(&videoLastChanged, NULL);
+}
+
+void EncodeManager::markPhotoTiles(const Rect& rect, bool photo)
+{
+  Rect r;
+
+  if (motionGrid.is_empty())
+    return;
+
+  r = rect.intersect(Rect(0, 0, motionGrid.br.x * contentCacheTileSize,
+                          motionGrid.br.y * contentCacheTileSize));
+  if (r.is_empty())
+    return;
+
+  for (int ty = r.tl.y / contentCacheTileSize;
+       ty <= (r.br.y - 1) / contentCacheTileSize; ty++) {
+    for (int tx = r.tl.x / contentCacheTileSize;
+         tx <= (r.br.x - 1) / contentCacheTileSize; tx++)
+      photoTiles[ty * motionGrid.width() + tx] = photo;
+  }
+}
+
+void EncodeManager::updateVideoQuality()
+{
+  unsigned elapsed, minElapsed;
+  size_t rate, target;
+
+  // Updates can't be sent faster than the frame rate, and we might
+  // be going through them faster than real time (e.g. in encperf)
+  elapsed = msSince(&videoIntervalStart);
+  minElapsed = videoUpdates * 1000 / __rfbmax(1, (int)Server::frameRate);
+  if (elapsed < minElapsed)
+    elapsed = minElapsed;
+
+  rate = videoBytes * 1000 / __rfbmax(1, (int)elapsed);
+
+  videoBytes = 0;
+  videoUpdates = 0;
+
+  if (linkBandwidth == 0) {
+    videoQualityOffset = 0;
+    return;
+  }
+
+  // Leave some room for everything else
+  target = linkBandwidth / 4 * 3;
+
+  if ((rate > target) && (videoQualityOffset > -9))
+    videoQualityOffset--;
+  else if ((rate < target / 2) && (videoQualityOffset < 0))
+    videoQualityOffset++;
+
+  vlog.debug("Video at %d kB/s, quality offset now %d",
+             (int)(rate / 1000), videoQualityOffset);
+}
+
 void EncodeManager::writeSolidRects(Region *changed, const PixelBuffer* pb)
 {
   std::vector<Rect> rects;
@@ -757,7 +1727,8 @@ void EncodeManager::findSolidRect(const Rect& rect, Region *changed,
   }
 }
 
-void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
+void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb,
+                               bool video)
 {
   std::vector<Rect> rects;
   std::vector<Rect>::const_iterator rect;
@@ -772,7 +1743,10 @@ void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
 
     // No split necessary?
     if (((w*h) < SubRectMaxArea) && (w < SubRectMaxWidth)) {
-      writeSubRect(*rect, pb);
+      if (video)
+        writeVideoRect(*rect, pb);
+      else
+        writeSubRect(*rect, pb);
       continue;
     }
 
@@ -793,7 +1767,10 @@ void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
         if (sr.br.x > rect->br.x)
           sr.br.x = rect->br.x;
 
-        writeSubRect(sr, pb);
+        if (video)
+          writeVideoRect(sr, pb);
+        else
+          writeSubRect(sr, pb);
       }
     }
   }
@@ -873,6 +1850,8 @@ void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb)
       type = encoderIndexed;
   }
 
+  markPhotoTiles(rect, type == encoderFullColour);
+
   encoder = startRect(rect, type);
 
   if (encoder->flags & EncoderUseNativePF)
@@ -883,6 +1862,22 @@ void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb)
   endRect();
 }
 
+void EncodeManager::writeVideoRect(const Rect& rect, const PixelBuffer *pb)
+{
+  PixelBuffer *ppb;
+  Encoder *encoder;
+
+  encoder = startRect(rect, encoderFullColour);
+
+  videoPixels += rect.area();
+
+  ppb = preparePixelBuffer(rect, pb,
+                           !(encoder->flags & EncoderUseNativePF));
+  encoder->writeRect(ppb, Palette());
+
+  endRect();
+}
+
 bool EncodeManager::checkSolidTile(const Rect& r, const uint8_t* colourValue,
                                    const PixelBuffer *pb)
 {
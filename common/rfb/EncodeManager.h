@@ -20,10 +20,13 @@
 #ifndef __RFB_ENCODEMANAGER_H__
 #define __RFB_ENCODEMANAGER_H__
 
+#include <list>
 #include <vector>
 
 #include <stdint.h>
+#include <sys/time.h>
 
+#include <rfb/ContentCache.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/Region.h>
 #include <rfb/Timer.h>
@@ -56,9 +59,31 @@ namespace rfb {
     void writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
                      const RenderedCursor* renderedCursor);
 
+    // writeLosslessRefresh() sends as much of the lossy areas as
+    // should fit in maxUpdateSize bytes, starting with the ones
+    // closest to focus
     void writeLosslessRefresh(const Region& req, const PixelBuffer* pb,
                               const RenderedCursor* renderedCursor,
-                              size_t maxUpdateSize);
+                              size_t maxUpdateSize, const Point& focus);
+
+    // getRefreshEncodeRate() returns how many bytes per second of CPU
+    // time the lossless refreshes have produced so far, or 0 if that
+    // isn't known yet
+    size_t getRefreshEncodeRate();
+
+    // Latency trace events for this connection go to this track
+    void setTraceTrack(unsigned track) { traceTrack = track; }
+
+    // setLinkBandwidth() gives the current estimate, in bytes per
+    // second, of how fast data can be sent to the client. It is used
+    // to pick a compression level that keeps both the CPU and the
+    // link busy. Zero means that it is unknown.
+    void setLinkBandwidth(size_t bandwidth) { linkBandwidth = bandwidth; }
+
+    // setRegionOfInterest() marks where the user is most likely
+    // looking, which is then sent with a higher quality than the rest
+    // of the screen
+    void setRegionOfInterest(const Region& roi) { regionOfInterest = roi; }
 
   protected:
     virtual bool handleTimeout(Timer* t);
@@ -69,19 +94,56 @@ namespace rfb {
                   const RenderedCursor* renderedCursor);
     void prepareEncoders(bool allowLossy);
 
-    Region getLosslessRefresh(const Region& req, size_t maxUpdateSize);
+    // getEncoder() creates the encoder the first time it is needed
+    Encoder* getEncoder(int klass);
+    // isSupported() is like Encoder::isSupported(), but doesn't need
+    // the encoder to be created
+    bool isSupported(int klass);
+    bool isEncoderUsed(int klass);
+    bool releaseIdleEncoders();
+    void startIdleTimer();
+
+    Region getLosslessRefresh(const Region& req, size_t maxUpdateSize,
+                              const Point& focus);
+
+    void addLossy(const Region& region);
+    void removeLossy(const Region& region);
 
     int computeNumRects(const Region& changed);
 
     Encoder *startRect(const Rect& rect, int type);
     void endRect();
 
+    bool isAdaptiveClass(int klass);
+    void updateAdaptiveLevel();
+
+    void setQualityOffset(Encoder* encoder, int offset);
+    void resetQuality();
+    bool isInterestLossless(int boost);
+
+    void updateMotion(const Region& changed, const Rect& fb);
+    void markPhotoTiles(const Rect& rect, bool photo);
+    void updateVideoQuality();
+
     void writeCopyRects(const Region& copied, const Point& delta);
+
+    struct CacheTile {
+      Rect rect;
+      uint64_t hash;
+    };
+
+    bool prepareContentCache(const PixelBuffer* pb);
+    void writeCachedRects(Region *changed, const PixelBuffer* pb,
+                          std::vector<CacheTile>* stores);
+    void writeCacheStores(const std::vector<CacheTile>& stores);
+    void writeCacheRect(const Rect& rect, int op, unsigned slot);
     void writeSolidRects(Region *changed, const PixelBuffer* pb);
     void findSolidRect(const Rect& rect, Region *changed, const PixelBuffer* pb);
-    void writeRects(const Region& changed, const PixelBuffer* pb);
+    void writeRects(const Region& changed, const PixelBuffer* pb,
+                    bool video=false);
 
     void writeSubRect(const Rect& rect, const PixelBuffer *pb);
+    void writeVideoRect(const Rect& rect, const PixelBuffer *pb);
 
     bool checkSolidTile(const Rect& r, const uint8_t* colourValue,
                         const PixelBuffer *pb);
@@ -112,12 +174,33 @@ namespace rfb {
 
     std::vector<Encoder*> encoders;
     std::vector<int> activeEncoders;
+    std::vector<struct timeval> encoderLastUsed;
 
     Region lossyRegion;
     Region recentlyChangedRegion;
     Region pendingRefreshRegion;
 
+    // The parts of lossyRegion that were added by each update, so we
+    // know how long it takes until they are sent losslessly
+    struct LossyArea {
+      Region region;
+      unsigned update;
+      struct timeval since;
+    };
+    std::list<LossyArea> lossyAreas;
+
+    unsigned lossyCleared;
+    unsigned long long lossyClearedTime;
+    unsigned lossyMaxTime;
+
+    // How fast the lossless refreshes have been encoded, with older
+    // refreshes gradually counting less
+    unsigned long long refreshBytes;
+    unsigned long long refreshPixels;
+    uint64_t refreshTime;
+
     Timer recentChangeTimer;
+    Timer encoderIdleTimer;
 
     struct EncoderStats {
       unsigned rects;
@@ -127,12 +210,51 @@ namespace rfb {
     };
     typedef std::vector< std::vector<struct EncoderStats> > StatsVector;
 
+    // What the lossless refreshes have compressed to with each
+    // encoder, also with older refreshes counting less
+    std::vector<EncoderStats> refreshStats;
+
     unsigned updates;
     EncoderStats copyStats;
+    // Indexed by ContentCacheOp
+    EncoderStats cacheStats[2];
     StatsVector stats;
     int activeType;
     int beforeLength;
 
+    unsigned traceTrack;
+    uint64_t beforeTime;
+
+    size_t linkBandwidth;
+    // The zlib level used, or -1 if it isn't adjusted
+    int adaptiveLevel;
+    // Time spent in, and data produced by, the zlib based encoders
+    // since the level was last considered
+    uint64_t adaptiveTime;
+    unsigned long long adaptiveBytes;
+
+    Region regionOfInterest;
+    // Set while the quality is adjusted for each rect
+    bool adjustQuality;
+    int qualityOffset;
+
+    // For each tile, one bit per update that is set if the tile
+    // changed, with the latest update in the lowest bit
+    std::vector<uint8_t> motionHistory;
+    // If the tile needed a full colour encoder the last time it was
+    // analysed
+    std::vector<bool> photoTiles;
+    Rect motionGrid;
+    // Tiles that change on most updates
+    Region videoRegion;
+    struct timeval videoLastChanged;
+    // How the video quality is kept within the link bandwidth
+    int videoQualityOffset;
+    unsigned long long videoBytes;
+    unsigned videoUpdates;
+    struct timeval videoIntervalStart;
+    unsigned long long videoPixels;
+
     class OffsetPixelBuffer : public FullFramePixelBuffer {
     public:
       OffsetPixelBuffer() {}
@@ -145,6 +267,11 @@ namespace rfb {
       virtual uint8_t* getBufferRW(const Rect& r, int* stride);
     };
 
+    ContentCache contentCache;
+    // The cache has to be emptied if either side changes format
+    PixelFormat cacheServerPF;
+    PixelFormat cacheClientPF;
+
     OffsetPixelBuffer offsetPixelBuffer;
     ManagedPixelBuffer convertedPixelBuffer;
   };
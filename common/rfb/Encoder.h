@@ -20,6 +20,7 @@
 #ifndef __RFB_ENCODER_H__
 #define __RFB_ENCODER_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <rfb/Rect.h>
@@ -60,6 +61,10 @@ namespace rfb {
     virtual int getCompressLevel() { return -1; };
     virtual int getQualityLevel() { return -1; };
 
+    // getMemoryUsage() returns an estimate of how much memory is held by
+    // the encoder between rects, e.g. compression state.
+    virtual size_t getMemoryUsage() { return 0; };
+
     // writeRect() is the main interface that encodes the given rectangle
     // with data from the PixelBuffer onto the SConnection given at
     // encoder creation.
@@ -0,0 +1,374 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <vector>
+
+#include <rdr/Exception.h>
+#include <rdr/MemOutStream.h>
+#include <rfb/FramebufferExporter.h>
+#include <rfb/LogWriter.h>
+
+using namespace rfb;
+
+static LogWriter vlog("FramebufferExporter");
+
+// More rectangles than this are sent as their bounding rectangle
+static const int maxRects = 256;
+
+// Makes sure nobody can get write access to the memory from now on,
+// not even by opening it again via /proc. Existing writable mappings,
+// such as the one the framebuffer is drawn through, keep working.
+static void protectMemory(int fd)
+{
+#if defined(F_ADD_SEALS) && defined(F_SEAL_FUTURE_WRITE)
+  if (fcntl(fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE) == 0)
+    return;
+
+  vlog.info("Unable to seal framebuffer memory: %s", strerror(errno));
+#endif
+
+  // Without seals (before Linux 5.1) the best we can do is to stop
+  // other users from opening the memory for writing
+  if (fchmod(fd, 0400) < 0)
+    throw rdr::SystemException("unable to protect framebuffer memory",
+                               errno);
+}
+
+FramebufferExporter::FramebufferExporter(const char* path_, int mode)
+  : listenFd(-1), path(path_), fbFd(-1), sequence(0)
+{
+  struct sockaddr_un addr;
+  mode_t saved_umask;
+  int err, result;
+
+  memset(&info, 0, sizeof(info));
+
+  if (strlen(path_) >= sizeof(addr.sun_path))
+    throw rdr::SystemException("socket path is too long", ENAMETOOLONG);
+
+  listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (listenFd < 0)
+    throw rdr::SystemException("unable to create export socket", errno);
+
+  fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+  fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+  unlink(path_);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path_);
+  saved_umask = umask(0777);
+  result = bind(listenFd, (struct sockaddr*)&addr, sizeof(addr));
+  err = errno;
+  umask(saved_umask);
+  if (result < 0) {
+    close(listenFd);
+    throw rdr::SystemException("unable to bind export socket", err);
+  }
+
+  if (chmod(path_, mode) < 0) {
+    err = errno;
+    close(listenFd);
+    unlink(path_);
+    throw rdr::SystemException("unable to set export socket mode", err);
+  }
+
+  if (listen(listenFd, 5) < 0) {
+    err = errno;
+    close(listenFd);
+    unlink(path_);
+    throw rdr::SystemException("unable to listen on export socket", err);
+  }
+}
+
+FramebufferExporter::~FramebufferExporter()
+{
+  std::list<Consumer>::iterator i;
+
+  for (i = consumers.begin(); i != consumers.end(); ++i)
+    close(i->fd);
+
+  if (fbFd != -1)
+    close(fbFd);
+
+  close(listenFd);
+  unlink(path.c_str());
+}
+
+void FramebufferExporter::setFramebuffer(int fd, size_t size,
+                                         size_t offset,
+                                         int width, int height,
+                                         int stride,
+                                         const PixelFormat& pf)
+{
+  rdr::MemOutStream mos;
+  std::list<Consumer>::iterator i;
+  char procPath[64];
+  int readOnlyFd;
+
+  // The consumers must not be able to modify the pixels, so they get
+  // a new descriptor for the same memory that only allows reading,
+  // and the memory itself is locked down as well
+  protectMemory(fd);
+
+  snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+  readOnlyFd = open(procPath, O_RDONLY | O_CLOEXEC);
+  if (readOnlyFd < 0)
+    throw rdr::SystemException("unable to reopen framebuffer memory",
+                               errno);
+
+  pf.write(&mos);
+  assert(mos.length() == sizeof(info.pixelFormat));
+
+  // Anything pending refers to the old framebuffer, and consumers
+  // will have to reread everything anyway
+  changed.clear();
+
+  if (fbFd != -1)
+    close(fbFd);
+  fbFd = readOnlyFd;
+
+  info.type = framebufferExportMsgInfo;
+  info.version = framebufferExportVersion;
+  info.sequence = sequence;
+  info.size = size;
+  info.offset = offset;
+  info.width = width;
+  info.height = height;
+  info.stride = stride;
+  memcpy(info.pixelFormat, mos.data(), sizeof(info.pixelFormat));
+
+  for (i = consumers.begin(); i != consumers.end(); ++i) {
+    i->needInfo = true;
+    i->pending.clear();
+  }
+
+  flush();
+}
+
+void FramebufferExporter::add_changed(const Region& region)
+{
+  changed.assign_union(region);
+}
+
+void FramebufferExporter::flush()
+{
+  std::list<Consumer>::iterator i;
+
+  if (!changed.is_empty()) {
+    sequence++;
+    for (i = consumers.begin(); i != consumers.end(); ++i)
+      i->pending.assign_union(changed);
+    changed.clear();
+  }
+
+  for (i = consumers.begin(); i != consumers.end(); ++i) {
+    if (i->needInfo) {
+      if (!sendInfo(&*i))
+        continue;
+      i->needInfo = false;
+      i->pending.clear();
+      continue;
+    }
+
+    if (i->pending.is_empty())
+      continue;
+
+    if (sendUpdate(&*i))
+      i->pending.clear();
+  }
+}
+
+int FramebufferExporter::accept()
+{
+  Consumer consumer;
+  int fd;
+
+  fd = ::accept(listenFd, NULL, NULL);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      vlog.error("Unable to accept consumer: %s", strerror(errno));
+    return -1;
+  }
+
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  vlog.status("Consumer connected");
+
+  consumer.fd = fd;
+  consumer.needInfo = true;
+  consumers.push_back(consumer);
+
+  if (fbFd != -1) {
+    if (sendInfo(&consumers.back()))
+      consumers.back().needInfo = false;
+  }
+
+  return fd;
+}
+
+bool FramebufferExporter::isConsumer(int fd) const
+{
+  std::list<Consumer>::const_iterator i;
+
+  for (i = consumers.begin(); i != consumers.end(); ++i) {
+    if (i->fd == fd)
+      return true;
+  }
+
+  return false;
+}
+
+void FramebufferExporter::getConsumers(std::list<int>* fds) const
+{
+  std::list<Consumer>::const_iterator i;
+
+  for (i = consumers.begin(); i != consumers.end(); ++i)
+    fds->push_back(i->fd);
+}
+
+bool FramebufferExporter::processConsumer(int fd)
+{
+  char buf[256];
+  ssize_t len;
+
+  // Nothing is expected from consumers, so just drain the socket
+  // until we notice it has been closed
+  while (true) {
+    len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len == 0)
+      return false;
+    if (len < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return true;
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+  }
+}
+
+void FramebufferExporter::removeConsumer(int fd)
+{
+  std::list<Consumer>::iterator i;
+
+  for (i = consumers.begin(); i != consumers.end(); ++i) {
+    if (i->fd == fd) {
+      vlog.status("Consumer disconnected");
+      close(fd);
+      consumers.erase(i);
+      return;
+    }
+  }
+}
+
+bool FramebufferExporter::sendInfo(Consumer* consumer)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+
+  if (fbFd == -1)
+    return false;
+
+  info.sequence = sequence;
+
+  iov.iov_base = &info;
+  iov.iov_len = sizeof(info);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fbFd, sizeof(int));
+
+  if (sendmsg(consumer->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      vlog.debug("Unable to send to consumer: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+bool FramebufferExporter::sendUpdate(Consumer* consumer)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+  std::vector<uint8_t> buffer;
+  FramebufferExportUpdate update;
+  FramebufferExportRect* out;
+
+  consumer->pending.get_rects(&rects);
+  if ((int)rects.size() > maxRects) {
+    rects.clear();
+    rects.push_back(consumer->pending.get_bounding_rect());
+  }
+
+  update.type = framebufferExportMsgUpdate;
+  update.numRects = rects.size();
+  update.sequence = sequence;
+
+  buffer.resize(sizeof(update) + rects.size() * sizeof(*out));
+  memcpy(&buffer[0], &update, sizeof(update));
+
+  out = (FramebufferExportRect*)&buffer[sizeof(update)];
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    out->x = i->tl.x;
+    out->y = i->tl.y;
+    out->width = i->width();
+    out->height = i->height();
+    out++;
+  }
+
+  if (send(consumer->fd, &buffer[0], buffer.size(),
+           MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      vlog.debug("Unable to send to consumer: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,143 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// FramebufferExporter - shares the framebuffer with local processes
+//
+// Consumers connect to a Unix domain socket of type SOCK_SEQPACKET.
+// They are first sent a FramebufferExportInfo message, together with
+// a file descriptor for the memory holding the pixels, which they can
+// map read only. After that a FramebufferExportUpdate message,
+// followed by the given number of FramebufferExportRect, is sent
+// whenever areas of the framebuffer have changed. A new
+// FramebufferExportInfo is sent if the framebuffer is replaced.
+//
+// Consumers are never sent anything else, and anything they send is
+// ignored. All fields are in host byte order.
+//
+
+#ifndef __RFB_FRAMEBUFFEREXPORTER_H__
+#define __RFB_FRAMEBUFFEREXPORTER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <string>
+
+#include <rfb/PixelFormat.h>
+#include <rfb/Region.h>
+
+namespace rfb {
+
+  static const uint32_t framebufferExportVersion = 1;
+
+  enum FramebufferExportMsgType {
+    framebufferExportMsgInfo = 1,
+    framebufferExportMsgUpdate = 2,
+  };
+
+  struct FramebufferExportInfo {
+    uint32_t type;
+    uint32_t version;
+    // Sequence number of the last update that is already included
+    uint64_t sequence;
+    // Size of the memory to map, and where the first pixel is
+    uint64_t size;
+    uint64_t offset;
+    int32_t width;
+    int32_t height;
+    // In pixels
+    int32_t stride;
+    // Same layout as in the RFB protocol
+    uint8_t pixelFormat[16];
+  };
+
+  struct FramebufferExportUpdate {
+    uint32_t type;
+    uint32_t numRects;
+    uint64_t sequence;
+  };
+
+  struct FramebufferExportRect {
+    int32_t x, y, width, height;
+  };
+
+  class FramebufferExporter {
+  public:
+    // Listens for consumers on the Unix socket at the given path
+    FramebufferExporter(const char* path, int mode);
+    ~FramebufferExporter();
+
+    int getFd() const { return listenFd; }
+
+    // setFramebuffer() changes what is shared with consumers. The
+    // pixels are found at offset in the memory file fd, which should
+    // be a memfd created with MFD_ALLOW_SEALING. It is sealed against
+    // any new writable mappings, so it must already be mapped by the
+    // caller. Consumers are given their own read only descriptor for
+    // it, so fd itself does not have to stay open.
+    void setFramebuffer(int fd, size_t size, size_t offset,
+                        int width, int height, int stride,
+                        const PixelFormat& pf);
+
+    void add_changed(const Region& region);
+
+    // flush() notifies the consumers of everything changed since the
+    // last call. Consumers that are too slow get their updates merged
+    // and retried on the next call.
+    void flush();
+
+    // accept() is called when the listening socket is readable, and
+    // returns the socket of the new consumer, or -1 on failure
+    int accept();
+
+    bool isConsumer(int fd) const;
+    void getConsumers(std::list<int>* fds) const;
+
+    // processConsumer() is called when a consumer's socket is
+    // readable, and returns false if it has gone away. Such consumers
+    // must then be removed using removeConsumer().
+    bool processConsumer(int fd);
+    void removeConsumer(int fd);
+
+  private:
+    struct Consumer {
+      int fd;
+      bool needInfo;
+      Region pending;
+    };
+
+    bool sendInfo(Consumer* consumer);
+    bool sendUpdate(Consumer* consumer);
+
+  private:
+    int listenFd;
+    std::string path;
+
+    int fbFd;
+    FramebufferExportInfo info;
+    Region changed;
+    uint64_t sequence;
+
+    std::list<Consumer> consumers;
+  };
+
+}
+
+#endif
@@ -0,0 +1,279 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <new>
+
+#ifdef __linux__
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <map>
+
+#include <os/Mutex.h>
+#endif
+
+#include <rfb/Configuration.h>
+#include <rfb/FramebufferMemory.h>
+#include <rfb/LogWriter.h>
+
+using namespace rfb;
+
+static LogWriter vlog("FramebufferMemory");
+
+static StringParameter hugePages("FramebufferHugePages",
+                                 "Place large framebuffers in huge pages "
+                                 "(None, Transparent, Explicit)",
+                                 "Transparent");
+static IntParameter numaNode("FramebufferNode",
+                             "NUMA node to place large framebuffers on "
+                             "(-1 for the node of the thread that "
+                             "allocates them)", -1, -1);
+
+#ifdef __linux__
+
+// Not all systems have <numaif.h>
+static const int mpolPreferred = 1;
+
+// Used if the kernel doesn't tell us the real size
+static const size_t defaultHugePageSize = 2 * 1024 * 1024;
+
+static os::Mutex mappingLock;
+static std::map<uint8_t*, size_t> mappings;
+
+static size_t readSize(const char* path, const char* key, size_t unit)
+{
+  FILE* f;
+  char line[256];
+  size_t size;
+
+  f = fopen(path, "r");
+  if (f == NULL)
+    return 0;
+
+  size = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned long value;
+
+    if (strncmp(line, key, strlen(key)) != 0)
+      continue;
+    if (sscanf(line + strlen(key), "%lu", &value) == 1)
+      size = value * unit;
+    break;
+  }
+
+  fclose(f);
+
+  return size;
+}
+
+// Size of the pages used by transparent huge pages
+static size_t transparentPageSize()
+{
+  static size_t size = 0;
+
+  if (size == 0) {
+    size = readSize("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size",
+                    "", 1);
+    if (size == 0)
+      size = defaultHugePageSize;
+  }
+
+  return size;
+}
+
+// Size of the pages given by MAP_HUGETLB
+static size_t explicitPageSize()
+{
+  static size_t size = 0;
+
+  if (size == 0) {
+    size = readSize("/proc/meminfo", "Hugepagesize:", 1024);
+    if (size == 0)
+      size = defaultHugePageSize;
+  }
+
+  return size;
+}
+
+static size_t roundUp(size_t size, size_t align)
+{
+  return (size + align - 1) / align * align;
+}
+
+static uint8_t* mapExplicit(size_t* length)
+{
+#ifdef MAP_HUGETLB
+  void* data;
+
+  *length = roundUp(*length, explicitPageSize());
+
+  data = mmap(NULL, *length, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data == MAP_FAILED) {
+    static bool warned = false;
+    if (!warned) {
+      vlog.error("Unable to allocate explicit huge pages: %s",
+                 strerror(errno));
+      warned = true;
+    }
+    return NULL;
+  }
+
+  return (uint8_t*)data;
+#else
+  (void)length;
+  return NULL;
+#endif
+}
+
+static uint8_t* mapAligned(size_t* length, bool useHugePages)
+{
+  size_t align;
+  uint8_t *raw, *data;
+
+  align = transparentPageSize();
+  *length = roundUp(*length, align);
+
+  // Start with some slack so that the buffer can begin at a huge page
+  // boundary, which is required for the kernel to use huge pages for
+  // all of it
+  raw = (uint8_t*)mmap(NULL, *length + align, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    return NULL;
+
+  data = (uint8_t*)roundUp((uintptr_t)raw, align);
+  if (data != raw)
+    munmap(raw, data - raw);
+  if (data + *length != raw + *length + align)
+    munmap(data + *length, (raw + *length + align) - (data + *length));
+
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+  madvise(data, *length, useHugePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+  (void)useHugePages;
+#endif
+
+  return data;
+}
+
+static void bindToNode(uint8_t* data, size_t length)
+{
+  unsigned long mask[16];
+  const int bitsPerLong = sizeof(unsigned long) * 8;
+  int node;
+
+  node = numaNode;
+  if (node < 0) {
+    unsigned cpu, current;
+    if (syscall(SYS_getcpu, &cpu, &current, NULL) != 0)
+      return;
+    node = current;
+  }
+
+  if (node >= (int)sizeof(mask) * 8) {
+    vlog.error("Invalid NUMA node %d", node);
+    return;
+  }
+
+  memset(mask, 0, sizeof(mask));
+  mask[node / bitsPerLong] = 1UL << (node % bitsPerLong);
+
+  // This is just a preference, so we don't care much if it fails
+  // (e.g. if the kernel lacks NUMA support)
+  if (syscall(SYS_mbind, data, length, mpolPreferred,
+              mask, sizeof(mask) * 8, 0) != 0)
+    vlog.debug("Unable to bind framebuffer to node %d: %s",
+               node, strerror(errno));
+}
+
+uint8_t* rfb::allocFramebuffer(size_t size)
+{
+  size_t length;
+  uint8_t* data;
+
+  // Smaller buffers cannot use huge pages anyway
+  if (size < transparentPageSize())
+    return new uint8_t[size];
+
+  data = NULL;
+  length = size;
+
+  if ((strcasecmp(hugePages, "Explicit") == 0) &&
+      (size >= explicitPageSize()))
+    data = mapExplicit(&length);
+
+  if (data == NULL) {
+    length = size;
+    data = mapAligned(&length, strcasecmp(hugePages, "None") != 0);
+  }
+
+  if (data == NULL)
+    throw std::bad_alloc();
+
+  bindToNode(data, length);
+
+  os::AutoMutex a(&mappingLock);
+  mappings[data] = length;
+
+  return data;
+}
+
+void rfb::freeFramebuffer(uint8_t* data, size_t size)
+{
+  std::map<uint8_t*, size_t>::iterator iter;
+
+  if (data == NULL)
+    return;
+
+  if (size >= transparentPageSize()) {
+    os::AutoMutex a(&mappingLock);
+
+    iter = mappings.find(data);
+    if (iter != mappings.end()) {
+      munmap(data, iter->second);
+      mappings.erase(iter);
+      return;
+    }
+  }
+
+  delete [] data;
+}
+
+#else
+
+uint8_t* rfb::allocFramebuffer(size_t size)
+{
+  return new uint8_t[size];
+}
+
+void rfb::freeFramebuffer(uint8_t* data, size_t /*size*/)
+{
+  delete [] data;
+}
+
+#endif
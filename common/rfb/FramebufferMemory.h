@@ -0,0 +1,44 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// FramebufferMemory - allocation of large pixel buffers
+//
+// Framebuffers are scanned from one end to the other several times per
+// update, which causes a lot of TLB misses with normal pages. Buffers
+// large enough to benefit are therefore placed in huge pages where
+// possible, and on a chosen NUMA node, as controlled by the
+// FramebufferHugePages and FramebufferNode parameters.
+//
+
+#ifndef __RFB_FRAMEBUFFERMEMORY_H__
+#define __RFB_FRAMEBUFFERMEMORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rfb {
+
+  // The same size must be given to freeFramebuffer() as was given to
+  // allocFramebuffer(). Throws an exception if no memory is available.
+  uint8_t* allocFramebuffer(size_t size);
+  void freeFramebuffer(uint8_t* data, size_t size);
+
+}
+
+#endif
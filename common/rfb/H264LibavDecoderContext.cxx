@@ -39,6 +39,17 @@ using namespace rfb;
 
 static LogWriter vlog("H264LibavDecoderContext");
 
+// Formats that swscale can write straight in to the frame buffer
+static const struct {
+  AVPixelFormat avFormat;
+  PixelFormat pf;
+} directFormats[] = {
+  { AV_PIX_FMT_RGBA, PixelFormat(32, 24, false, true, 255, 255, 255, 0, 8, 16) },
+  { AV_PIX_FMT_BGRA, PixelFormat(32, 24, false, true, 255, 255, 255, 16, 8, 0) },
+  { AV_PIX_FMT_ARGB, PixelFormat(32, 24, false, true, 255, 255, 255, 8, 16, 24) },
+  { AV_PIX_FMT_ABGR, PixelFormat(32, 24, false, true, 255, 255, 255, 24, 16, 8) },
+};
+
 bool H264LibavDecoderContext::initCodec() {
   os::AutoMutex lock(&mutex);
 
@@ -78,6 +89,11 @@ bool H264LibavDecoderContext::initCodec() {
     return false;
   }
 
+  // Each rect has to be shown as soon as it has been decoded, so frame
+  // threading is out as it delays the output by one frame per thread
+  avctx->thread_count = 0;
+  avctx->thread_type = FF_THREAD_SLICE;
+
   if (avcodec_open2(avctx, codec, NULL) < 0)
   {
     av_parser_close(parser);
@@ -87,9 +103,6 @@ bool H264LibavDecoderContext::initCodec() {
     return false;
   }
 
-  int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB32, rect.width(), rect.height(), 1);
-  swsBuffer = new uint8_t[numBytes];
-
   initialized = true;
   return true;
 }
@@ -102,6 +115,7 @@ void H264LibavDecoderContext::freeCodec() {
   av_parser_close(parser);
   avcodec_free_context(&avctx);
   av_frame_free(&frame);
+  sws_freeContext(sws);
   delete[] swsBuffer;
   free(h264WorkBuffer);
   initialized = false;
@@ -112,22 +126,85 @@ void H264LibavDecoderContext::freeCodec() {
 // Also avcodec requires a right padded buffer
 uint8_t* H264LibavDecoderContext::makeH264WorkBuffer(const uint8_t* buffer, uint32_t len)
 {
-  uint32_t reserve_len = len + len % AV_INPUT_BUFFER_PADDING_SIZE;
+  uint32_t reserve_len = len + AV_INPUT_BUFFER_PADDING_SIZE;
 
+  // Grow in large steps, as the size varies a lot between key frames
+  // and other frames
   if (!h264WorkBuffer || reserve_len > h264WorkBufferLength)
   {
-    h264WorkBuffer = (uint8_t*)realloc(h264WorkBuffer, reserve_len);
+    uint32_t new_len = h264WorkBufferLength * 2;
+    if (new_len < reserve_len)
+      new_len = reserve_len;
+    h264WorkBuffer = (uint8_t*)realloc(h264WorkBuffer, new_len);
     if (h264WorkBuffer == NULL) {
       throw Exception("H264LibavDecoderContext: Unable to allocate memory");
     }
-    h264WorkBufferLength = reserve_len;
+    h264WorkBufferLength = new_len;
   }
 
+  // Only the padding needs to be cleared, not the whole buffer
   memcpy(h264WorkBuffer, buffer, len);
-  memset(h264WorkBuffer + len, 0, h264WorkBufferLength - len);
+  memset(h264WorkBuffer + len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
   return h264WorkBuffer;
 }
 
+void H264LibavDecoderContext::convertFrame(ModifiablePixelBuffer* pb)
+{
+  const PixelFormat& pf = pb->getPF();
+  AVPixelFormat dstFormat, swsFormat;
+  uint8_t* dst;
+  int stride;
+  // swscale looks at all four planes, even for packed formats
+  uint8_t* planes[4] = { NULL, NULL, NULL, NULL };
+  int linesizes[4] = { 0, 0, 0, 0 };
+
+  dstFormat = AV_PIX_FMT_NONE;
+  for (size_t i = 0; i < sizeof(directFormats) / sizeof(*directFormats); i++) {
+    if (pf == directFormats[i].pf) {
+      dstFormat = directFormats[i].avFormat;
+      break;
+    }
+  }
+
+  // Anything else is converted via a buffer in one of the formats
+  // above
+  if (dstFormat == AV_PIX_FMT_NONE) {
+    if (!swsBuffer)
+      swsBuffer = new uint8_t[rect.area() * 4];
+    swsFormat = AV_PIX_FMT_BGRA;
+  } else {
+    swsFormat = dstFormat;
+  }
+
+  sws = sws_getCachedContext(sws, frame->width, frame->height,
+                             (AVPixelFormat)frame->format,
+                             frame->width, frame->height, swsFormat,
+                             0, NULL, NULL, NULL);
+  if (!sws) {
+    vlog.error("Could not create colour conversion context");
+    return;
+  }
+
+  dst = pb->getBufferRW(rect, &stride);
+
+  if (dstFormat != AV_PIX_FMT_NONE) {
+    planes[0] = dst;
+    linesizes[0] = stride * 4;
+    sws_scale(sws, frame->data, frame->linesize, 0, frame->height,
+              planes, linesizes);
+  } else {
+    planes[0] = swsBuffer;
+    linesizes[0] = rect.width() * 4;
+    sws_scale(sws, frame->data, frame->linesize, 0, frame->height,
+              planes, linesizes);
+    pf.bufferFromBuffer(dst, directFormats[1].pf, swsBuffer,
+                        frame->width, frame->height,
+                        stride, rect.width());
+  }
+
+  pb->commitBufferRW(rect);
+}
+
 void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
                                      uint32_t len,
                                      ModifiablePixelBuffer* pb) {
@@ -216,15 +293,12 @@ void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
   if (!frame->height)
     return;
 
-  sws = sws_getCachedContext(sws, frame->width, frame->height, avctx->pix_fmt,
-                             frame->width, frame->height, AV_PIX_FMT_RGB32,
-                             0, NULL, NULL, NULL);
-
-  int stride;
-  pb->getBuffer(rect, &stride);
-  int dst_linesize = stride * pb->getPF().bpp/8;  // stride is in pixels, linesize is in bytes (stride x4). We need bytes
-
-  sws_scale(sws, frame->data, frame->linesize, 0, frame->height, &swsBuffer, &dst_linesize);
+  // The colour conversion writes directly to the frame buffer, so it
+  // must not overflow the rect
+  if (frame->width > rect.width() || frame->height > rect.height()) {
+    vlog.error("Decoded frame is larger than the rect");
+    return;
+  }
 
-  pb->imageRect(rect, swsBuffer, stride);
+  convertFrame(pb);
 }
@@ -43,6 +43,7 @@ namespace rfb {
 
     private:
       uint8_t* makeH264WorkBuffer(const uint8_t* buffer, uint32_t len);
+      void convertFrame(ModifiablePixelBuffer* pb);
 
       AVCodecContext *avctx;
       AVCodecParserContext *parser;
@@ -27,6 +27,7 @@
 #include <rfb/HextileEncoder.h>
 #include <rfb/Palette.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/Configuration.h>
 #include <rfb/hextileConstants.h>
 
@@ -100,6 +101,54 @@ void HextileEncoder::writeSolidRect(int width, int height,
       os->writeU8(0);
 }
 
+// Number of pixels at the start of data that are equal to value
+template<class T>
+static inline int countEqual(const T* data, T value, int count)
+{
+  int start, result;
+
+  // Most runs are short, so look at the first few pixels directly
+  // before paying for the call
+  for (start = 0; start < count && start < 8; start++) {
+    if (data[start] != value)
+      return start;
+  }
+
+  if (simdCountEqual((const uint8_t*)(data + start), sizeof(T)*8, value,
+                     count - start, &result))
+    return start + result;
+
+  for (result = start; result < count; result++) {
+    if (data[result] != value)
+      break;
+  }
+
+  return result;
+}
+
+// Number of pixels at the start of data that are either a or b, with
+// the number of a pixels in countA
+template<class T>
+static inline int countTwo(const T* data, T a, T b, int count,
+                           int* countA)
+{
+  int result;
+
+  if (simdCountTwo((const uint8_t*)data, sizeof(T)*8, a, b,
+                   count, &result, countA))
+    return result;
+
+  *countA = 0;
+  for (result = 0; result < count; result++) {
+    if (data[result] == a)
+      (*countA)++;
+    else if (data[result] != b)
+      break;
+  }
+
+  return result;
+}
+
 template<class T>
 inline void HextileEncoder::writePixel(rdr::OutStream* os, T pixel)
 {
@@ -189,28 +238,24 @@ int HextileEncoder::hextileEncodeTile(T* data, int w, int h,
   {
     int x = 0;
     while (x < w) {
-      if (*data == bg) {
-        x++;
-        data++;
-        continue;
-      }
+      int skip = countEqual(data, bg, w - x);
+      x += skip;
+      data += skip;
+      if (x == w)
+        break;
 
       // Find horizontal subrect first
-      T* ptr = data+1;
-      T* eol = data+w-x;
-      while (ptr < eol && *ptr == *data) ptr++;
-      int sw = ptr - data;
+      int sw = 1 + countEqual(data + 1, *data, w - x - 1);
 
-      ptr = data + w;
+      T* ptr = data + w;
+      T* eol;
       int sh = 1;
       while (sh < h-y) {
-        eol = ptr + sw;
-        while (ptr < eol)
-          if (*ptr++ != *data) goto endOfSubrect;
-        ptr += w - sw;
+        if (countEqual(ptr, *data, sw) != sw)
+          break;
+        ptr += w;
         sh++;
       }
-    endOfSubrect:
 
       (*nSubrectsPtr)++;
 
@@ -254,32 +299,28 @@ template<class T>
 int HextileEncoder::testTileType(T* data, int w, int h, T* bg, T* fg)
 {
   T pix1 = *data;
-  T* end = data + w * h;
+  int count = w * h;
 
-  T* ptr = data + 1;
-  while (ptr < end && *ptr == pix1)
-    ptr++;
+  int count1 = countEqual(data, pix1, count);
 
-  if (ptr == end) {
+  if (count1 == count) {
     *bg = pix1;
     return 0;                   // solid-color tile
   }
 
-  int count1 = ptr - data;
-  int count2 = 1;
-  T pix2 = *ptr++;
+  T pix2 = data[count1];
   int tileType = hextileAnySubrects;
 
-  for (; ptr < end; ptr++) {
-    if (*ptr == pix1) {
-      count1++;
-    } else if (*ptr == pix2) {
-      count2++;
-    } else {
-      tileType |= hextileSubrectsColoured;
-      break;
-    }
-  }
+  // This starts at pix2, so it is counted as well
+  int countA;
+  int twoColours = countTwo(data + count1, pix1, pix2,
+                            count - count1, &countA);
+
+  if (count1 + twoColours != count)
+    tileType |= hextileSubrectsColoured;
+
+  int count2 = twoColours - countA;
+  count1 += countA;
 
   if (count1 >= count2) {
     *bg = pix1; *fg = pix2;
@@ -359,7 +400,10 @@ class HextileTile {
 
  private:
 
-  bool m_processed[16][16];
+  // One bit per pixel
+  uint16_t m_processed[16];
+  // Length of the run of equal pixels starting at each pixel
+  uint8_t m_runs[16][16];
   Palette m_pal;
 };
 
@@ -386,14 +430,11 @@ void HextileTile<T>::analyze()
 {
   assert(m_tile && m_width && m_height);
 
-  const T *ptr = m_tile;
-  const T *end = &m_tile[m_width * m_height];
-  T color = *ptr++;
-  while (ptr != end && *ptr == color)
-    ptr++;
+  T color = m_tile[0];
+  int count = countEqual(m_tile, color, m_width * m_height);
 
   // Handle solid tile
-  if (ptr == end) {
+  if (count == m_width * m_height) {
     m_background = m_tile[0];
     m_flags = 0;
     m_size = 0;
@@ -401,7 +442,7 @@ void HextileTile<T>::analyze()
   }
 
   // Compute number of complete rows of the same color, at the top
-  int y = (ptr - m_tile) / m_width;
+  int y = count / m_width;
 
   T *colorsPtr = m_colors;
   uint8_t *coordsPtr = m_coords;
@@ -417,31 +458,36 @@ void HextileTile<T>::analyze()
     m_numSubrects++;
   }
 
-  memset(m_processed, 0, 16 * 16 * sizeof(bool));
+  memset(m_processed, 0, sizeof(m_processed));
 
-  int x, sx, sy, sw, sh, max_x;
+  int x, sx, sy, sw, sh;
+
+  // With the runs known, checking if a whole row of a subrect has the
+  // same colour only needs a look at its first pixel
+  for (sy = y; sy < m_height; sy++) {
+    const T *row = &m_tile[sy * m_width];
+    m_runs[sy][m_width - 1] = 1;
+    for (sx = m_width - 2; sx >= 0; sx--) {
+      if (row[sx] == row[sx + 1])
+        m_runs[sy][sx] = m_runs[sy][sx + 1] + 1;
+      else
+        m_runs[sy][sx] = 1;
+    }
+  }
 
   for (; y < m_height; y++) {
     for (x = 0; x < m_width; x++) {
       // Skip pixels that were processed earlier
-      if (m_processed[y][x]) {
+      if (m_processed[y] & (1 << x)) {
         continue;
       }
       // Determine dimensions of the horizontal subrect
       color = m_tile[y * m_width + x];
-      for (sx = x + 1; sx < m_width; sx++) {
-        if (m_tile[y * m_width + sx] != color)
-          break;
-      }
-      sw = sx - x;
-      max_x = sx;
+      sw = m_runs[y][x];
       for (sy = y + 1; sy < m_height; sy++) {
-        for (sx = x; sx < max_x; sx++) {
-          if (m_tile[sy * m_width + sx] != color)
-            goto done;
-        }
+        if (m_tile[sy * m_width + x] != color || m_runs[sy][x] < sw)
+          break;
       }
-    done:
       sh = sy - y;
 
       // Save properties of this subrect
@@ -460,10 +506,8 @@ void HextileTile<T>::analyze()
       m_numSubrects++;
 
       // Mark pixels of this subrect as processed, below this row
-      for (sy = y + 1; sy < y + sh; sy++) {
-        for (sx = x; sx < x + sw; sx++)
-          m_processed[sy][sx] = true;
-      }
+      for (sy = y + 1; sy < y + sh; sy++)
+        m_processed[sy] |= ((1 << sw) - 1) << x;
 
       // Skip processed pixels of this row
       x += (sw - 1);
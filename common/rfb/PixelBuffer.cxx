@@ -29,6 +29,7 @@
 #include <string.h>
 
 #include <rfb/Exception.h>
+#include <rfb/FramebufferMemory.h>
 #include <rfb/LogWriter.h>
 #include <rfb/PixelBuffer.h>
 
@@ -396,7 +397,7 @@ ManagedPixelBuffer::ManagedPixelBuffer(const PixelFormat& pf, int w, int h)
 ManagedPixelBuffer::~ManagedPixelBuffer()
 {
   if (data_)
-    delete [] data_;
+    freeFramebuffer(data_, datasize);
 }
 
 void ManagedPixelBuffer::setPF(const PixelFormat &pf)
@@ -412,12 +413,12 @@ void ManagedPixelBuffer::setSize(int w, int h)
   new_datasize = w * h * (format.bpp/8);
   if (datasize < new_datasize) {
     if (data_) {
-      delete [] data_;
+      freeFramebuffer(data_, datasize);
       data_ = NULL;
       datasize = 0;
     }
     if (new_datasize) {
-      data_ = new uint8_t[new_datasize];
+      data_ = allocFramebuffer(new_datasize);
       datasize = new_datasize;
     }
   }
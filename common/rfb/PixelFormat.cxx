@@ -30,6 +30,7 @@
 #include <rdr/OutStream.h>
 #include <rfb/Exception.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
@@ -246,6 +247,9 @@ void PixelFormat::bufferFromRGB(uint8_t *dst, const uint8_t* src, int pixels) co
 void PixelFormat::bufferFromRGB(uint8_t *dst, const uint8_t* src,
                                 int w, int stride, int h) const
 {
+  if (simdBufferFromRGB(dst, src, w, stride, h))
+    return;
+
   if (is888()) {
     // Optimised common case
     uint8_t *r, *g, *b, *x;
@@ -313,6 +317,9 @@ void PixelFormat::rgbFromBuffer(uint8_t* dst, const uint8_t* src, int pixels) co
 void PixelFormat::rgbFromBuffer(uint8_t* dst, const uint8_t* src,
                                 int w, int stride, int h) const
 {
+  if (simdRGBFromBuffer(dst, src, w, stride, h))
+    return;
+
   if (is888()) {
     // Optimised common case
     const uint8_t *r, *g, *b;
@@ -393,6 +400,9 @@ void PixelFormat::bufferFromBuffer(uint8_t* dst, const PixelFormat &srcPF,
       dst += dstStride * bpp/8;
       src += srcStride * srcPF.bpp/8;
     }
+  } else if (simdBufferFromBuffer(dst, srcPF, src, w, h,
+                                  dstStride, srcStride)) {
+    // Handled by the vectorised code
   } else if (is888() && srcPF.is888()) {
     // Optimised common case A: byte shuffling (e.g. endian conversion)
     uint8_t *d[4], *s[4];
@@ -714,6 +724,106 @@ bool PixelFormat::isSane(void)
   return true;
 }
 
+bool PixelFormat::is565(void) const
+{
+  if (!trueColour)
+    return false;
+  if (bpp != 16)
+    return false;
+  if ((redBits != 5) || (greenBits != 6) || (blueBits != 5))
+    return false;
+
+  return true;
+}
+
+void PixelFormat::byteOffsets888(uint8_t offsets[4]) const
+{
+  int xShift;
+
+  assert(is888());
+
+  xShift = 48 - redShift - greenShift - blueShift;
+
+  if (bigEndian) {
+    offsets[0] = (24 - redShift)/8;
+    offsets[1] = (24 - greenShift)/8;
+    offsets[2] = (24 - blueShift)/8;
+    offsets[3] = (24 - xShift)/8;
+  } else {
+    offsets[0] = redShift/8;
+    offsets[1] = greenShift/8;
+    offsets[2] = blueShift/8;
+    offsets[3] = xShift/8;
+  }
+}
+
+bool PixelFormat::simdBufferFromRGB(uint8_t *dst, const uint8_t* src,
+                                    int w, int stride, int h) const
+{
+  uint8_t offsets[4], perm[4];
+  int i;
+
+  if (!is888())
+    return false;
+
+  byteOffsets888(offsets);
+  for (i = 0; i < 4; i++)
+    perm[offsets[i]] = i;
+
+  return simdRGBTo32(dst, src, perm, w, h, stride, w);
+}
+
+bool PixelFormat::simdRGBFromBuffer(uint8_t* dst, const uint8_t* src,
+                                    int w, int stride, int h) const
+{
+  uint8_t offsets[4];
+
+  if (!is888())
+    return false;
+
+  byteOffsets888(offsets);
+
+  return simd32ToRGB(dst, src, offsets, w, h, w, stride);
+}
+
+bool PixelFormat::simdBufferFromBuffer(uint8_t* dst,
+                                       const PixelFormat &srcPF,
+                                       const uint8_t* src, int w, int h,
+                                       int dstStride, int srcStride) const
+{
+  uint8_t dstOffsets[4], srcOffsets[4];
+  uint8_t perm[4], shifts[3];
+  int i;
+
+  if (is888() && srcPF.is888()) {
+    byteOffsets888(dstOffsets);
+    srcPF.byteOffsets888(srcOffsets);
+    for (i = 0; i < 4; i++)
+      perm[dstOffsets[i]] = srcOffsets[i];
+    return simdShuffle32(dst, src, perm, w, h, dstStride, srcStride);
+  }
+
+  if (is565() && srcPF.is888()) {
+    srcPF.byteOffsets888(srcOffsets);
+    shifts[0] = redShift;
+    shifts[1] = greenShift;
+    shifts[2] = blueShift;
+    return simd32To565(dst, src, srcOffsets, shifts, endianMismatch,
+                       w, h, dstStride, srcStride);
+  }
+
+  if (is888() && srcPF.is565()) {
+    byteOffsets888(dstOffsets);
+    shifts[0] = srcPF.redShift;
+    shifts[1] = srcPF.greenShift;
+    shifts[2] = srcPF.blueShift;
+    return simd565To32(dst, src, dstOffsets, shifts, srcPF.endianMismatch,
+                       w, h, dstStride, srcStride);
+  }
+
+  return false;
+}
+
 static inline uint8_t swap(uint8_t n)
 {
   return n;
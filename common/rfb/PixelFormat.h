@@ -94,6 +94,18 @@ namespace rfb {
     bool isSane(void);
 
   private:
+    // Vectorised versions of the most common cases
+    bool is565(void) const;
+    void byteOffsets888(uint8_t offsets[4]) const;
+
+    bool simdBufferFromRGB(uint8_t *dst, const uint8_t* src,
+                           int w, int stride, int h) const;
+    bool simdRGBFromBuffer(uint8_t* dst, const uint8_t* src,
+                           int w, int stride, int h) const;
+    bool simdBufferFromBuffer(uint8_t* dst, const PixelFormat &srcPF,
+                              const uint8_t* src, int w, int h,
+                              int dstStride, int srcStride) const;
+
     // Templated, optimised methods
     template<class T>
     void directBufferFromBufferFrom888(T* dst, const PixelFormat &srcPF,
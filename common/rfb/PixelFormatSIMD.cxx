@@ -0,0 +1,1539 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include <rfb/PixelFormatSIMD.h>
+
+// The x86 code is compiled for specific instruction sets using
+// function attributes, so the rest of the code base doesn't need any
+// special compiler flags
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SIMD_X86
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace rfb;
+
+// Each kernel converts as many pixels of a single row as it can, and
+// returns how many that was. The rest is handled by the generic code
+// below.
+
+struct Format565 {
+  uint8_t offsets[3];
+  uint8_t shifts[3];
+  bool swap;
+};
+
+typedef int (*Shuffle32Fn)(uint8_t* dst, const uint8_t* src,
+                           const uint8_t* perm, int w);
+typedef int (*Convert565Fn)(uint8_t* dst, const uint8_t* src,
+                            const Format565* fmt, int w);
+typedef int (*FilterRowFn)(int16_t* dst, const uint8_t* src, int srcX,
+                           const SFilterWeightTab* tabs, int w);
+typedef int (*FilterColumnsFn)(uint8_t* dst, const int16_t* const* rows,
+                               const short* weights, int taps, int count);
+typedef int (*BlendOverFn)(uint8_t* dst, const uint8_t* src, int w);
+typedef int (*CountEqualFn)(const uint8_t* data, int bpp, uint32_t value,
+                            int count);
+typedef int (*CountTwoFn)(const uint8_t* data, int bpp,
+                          uint32_t a, uint32_t b, int count, int* countA);
+
+struct Kernels {
+  const char* name;
+  Shuffle32Fn shuffle32;
+  Shuffle32Fn rgbTo32;
+  Shuffle32Fn to24;
+  Convert565Fn to565;
+  Convert565Fn from565;
+  FilterRowFn filterRow;
+  FilterColumnsFn filterColumns;
+  BlendOverFn blendOver;
+  CountEqualFn countEqual;
+  CountTwoFn countTwo;
+};
+
+static const Kernels* bestKernels = NULL;
+static const Kernels* kernels = NULL;
+
+//
+// Generic code
+//
+
+static void shuffle32Generic(uint8_t* dst, const uint8_t* src,
+                             const uint8_t* perm, int w)
+{
+  while (w--) {
+    dst[0] = src[perm[0]];
+    dst[1] = src[perm[1]];
+    dst[2] = src[perm[2]];
+    dst[3] = src[perm[3]];
+    dst += 4;
+    src += 4;
+  }
+}
+
+static void rgbTo32Generic(uint8_t* dst, const uint8_t* src,
+                           const uint8_t* perm, int w)
+{
+  int i;
+
+  while (w--) {
+    for (i = 0; i < 4; i++)
+      dst[i] = perm[i] < 3 ? src[perm[i]] : 0;
+    dst += 4;
+    src += 3;
+  }
+}
+
+static void to24Generic(uint8_t* dst, const uint8_t* src,
+                        const uint8_t* perm, int w)
+{
+  while (w--) {
+    dst[0] = src[perm[0]];
+    dst[1] = src[perm[1]];
+    dst[2] = src[perm[2]];
+    dst += 3;
+    src += 4;
+  }
+}
+
+// These must give the same results as PixelFormat's conversion tables
+
+static inline unsigned downconv(unsigned value, unsigned maxVal)
+{
+  return (value * maxVal + 128) / 255;
+}
+
+static inline unsigned upconv(unsigned value, unsigned maxVal)
+{
+  return value * 255 / maxVal;
+}
+
+static void to565Generic(uint8_t* dst, const uint8_t* src,
+                         const Format565* fmt, int w)
+{
+  while (w--) {
+    uint16_t d;
+
+    d = downconv(src[fmt->offsets[0]], 31) << fmt->shifts[0];
+    d |= downconv(src[fmt->offsets[1]], 63) << fmt->shifts[1];
+    d |= downconv(src[fmt->offsets[2]], 31) << fmt->shifts[2];
+
+    if (fmt->swap)
+      d = (d << 8) | (d >> 8);
+
+    memcpy(dst, &d, 2);
+
+    dst += 2;
+    src += 4;
+  }
+}
+
+static void from565Generic(uint8_t* dst, const uint8_t* src,
+                           const Format565* fmt, int w)
+{
+  while (w--) {
+    uint16_t s;
+
+    memcpy(&s, src, 2);
+
+    if (fmt->swap)
+      s = (s << 8) | (s >> 8);
+
+    memset(dst, 0, 4);
+    dst[fmt->offsets[0]] = upconv((s >> fmt->shifts[0]) & 31, 31);
+    dst[fmt->offsets[1]] = upconv((s >> fmt->shifts[1]) & 63, 63);
+    dst[fmt->offsets[2]] = upconv((s >> fmt->shifts[2]) & 31, 31);
+
+    dst += 4;
+    src += 2;
+  }
+}
+
+// The filter works on the bytes of the pixels directly, as it treats
+// all channels the same. The weights add up to 1 << BITS_OF_WEIGHT,
+// and the result is saturated to 16 bits just like the SSE2 code does.
+
+static void filterRowGeneric(int16_t* dst, const uint8_t* src, int srcX,
+                             const SFilterWeightTab* tabs, int w)
+{
+  while (w--) {
+    const uint8_t* in;
+    int sum[4];
+
+    in = src + (tabs->i0 - srcX) * 4;
+
+    sum[0] = sum[1] = sum[2] = sum[3] = 0;
+    for (int i = 0; i < tabs->i1 - tabs->i0; i++) {
+      for (int c = 0; c < 4; c++)
+        sum[c] += tabs->weight[i] * in[c];
+      in += 4;
+    }
+
+    for (int c = 0; c < 4; c++) {
+      int value;
+
+      value = (sum[c] + (1 << (BITS_OF_WEIGHT - 8))) >> (BITS_OF_WEIGHT - 7);
+      if (value < INT16_MIN)
+        value = INT16_MIN;
+      else if (value > INT16_MAX)
+        value = INT16_MAX;
+
+      dst[c] = value;
+    }
+
+    dst += 4;
+    tabs++;
+  }
+}
+
+static void filterColumnsGeneric(uint8_t* dst, const int16_t* const* rows,
+                                 const short* weights, int taps,
+                                 int offset, int count)
+{
+  for (int i = offset; i < offset + count; i++) {
+    int sum;
+
+    sum = 0;
+    for (int k = 0; k < taps; k++)
+      sum += weights[k] * rows[k][i];
+
+    sum = (sum + (1 << (BITS_OF_WEIGHT + 6))) >> (BITS_OF_WEIGHT + 7);
+    if (sum < 0)
+      sum = 0;
+    else if (sum > 255)
+      sum = 255;
+
+    dst[i] = sum;
+  }
+}
+
+// dst = src + dst * (255 - alpha) / 255, rounded to nearest. The sum
+// cannot overflow as src is premultiplied.
+
+static void blendOverGeneric(uint8_t* dst, const uint8_t* src, int w)
+{
+  while (w--) {
+    unsigned inv;
+
+    inv = 255 - src[3];
+    for (int c = 0; c < 4; c++) {
+      unsigned t;
+      t = dst[c] * inv + 128;
+      dst[c] = src[c] + ((t + (t >> 8)) >> 8);
+    }
+
+    dst += 4;
+    src += 4;
+  }
+}
+
+template<class T>
+static int countEqualGeneric(const T* data, T value, int count)
+{
+  int i;
+  for (i = 0; i < count; i++) {
+    if (data[i] != value)
+      break;
+  }
+  return i;
+}
+
+static int countEqualGeneric(const uint8_t* data, int bpp,
+                             uint32_t value, int count)
+{
+  switch (bpp) {
+  case 8:
+    return countEqualGeneric<uint8_t>(data, value, count);
+  case 16:
+    return countEqualGeneric<uint16_t>((const uint16_t*)data,
+                                       value, count);
+  default:
+    return countEqualGeneric<uint32_t>((const uint32_t*)data,
+                                       value, count);
+  }
+}
+
+template<class T>
+static int countTwoGeneric(const T* data, T a, T b, int count,
+                           int* countA)
+{
+  int i;
+  for (i = 0; i < count; i++) {
+    if (data[i] == a)
+      (*countA)++;
+    else if (data[i] != b)
+      break;
+  }
+  return i;
+}
+
+static int countTwoGeneric(const uint8_t* data, int bpp,
+                           uint32_t a, uint32_t b, int count, int* countA)
+{
+  switch (bpp) {
+  case 8:
+    return countTwoGeneric<uint8_t>(data, a, b, count, countA);
+  case 16:
+    return countTwoGeneric<uint16_t>((const uint16_t*)data,
+                                     a, b, count, countA);
+  default:
+    return countTwoGeneric<uint32_t>((const uint32_t*)data,
+                                     a, b, count, countA);
+  }
+}
+
+//
+// x86 (SSSE3 and AVX2)
+//
+// The division by 255 when reducing the depth is done as
+// (t + 1 + (t >> 8)) >> 8, and the multiplication by 255/31 and 255/63
+// when increasing it as (v * 1053) >> 7 and (v * 259 + 3) >> 6. Both
+// are exact for the range of values we have.
+//
+
+#ifdef SIMD_X86
+
+TARGET("ssse3")
+static int shuffle32SSSE3(uint8_t* dst, const uint8_t* src,
+                          const uint8_t* perm, int w)
+{
+  uint8_t m[16];
+  __m128i mask;
+  int i, done;
+
+  for (i = 0; i < 16; i++)
+    m[i] = (i & ~3) + perm[i & 3];
+  mask = _mm_loadu_si128((const __m128i*)m);
+
+  for (done = 0; done + 4 <= w; done += 4) {
+    __m128i v;
+    v = _mm_loadu_si128((const __m128i*)src);
+    v = _mm_shuffle_epi8(v, mask);
+    _mm_storeu_si128((__m128i*)dst, v);
+    src += 16;
+    dst += 16;
+  }
+
+  return done;
+}
+
+TARGET("ssse3")
+static int rgbTo32SSSE3(uint8_t* dst, const uint8_t* src,
+                        const uint8_t* perm, int w)
+{
+  uint8_t m[16];
+  __m128i mask;
+  int i, done;
+
+  for (i = 0; i < 16; i++) {
+    if (perm[i & 3] < 3)
+      m[i] = (i / 4) * 3 + perm[i & 3];
+    else
+      m[i] = 0x80;
+  }
+  mask = _mm_loadu_si128((const __m128i*)m);
+
+  // We load 16 bytes but only use 12, so make sure we don't read
+  // past the end of the row
+  for (done = 0; done + 6 <= w; done += 4) {
+    __m128i v;
+    v = _mm_loadu_si128((const __m128i*)src);
+    v = _mm_shuffle_epi8(v, mask);
+    _mm_storeu_si128((__m128i*)dst, v);
+    src += 12;
+    dst += 16;
+  }
+
+  return done;
+}
+
+TARGET("ssse3")
+static int to24SSSE3(uint8_t* dst, const uint8_t* src,
+                     const uint8_t* perm, int w)
+{
+  uint8_t m[16];
+  __m128i mask;
+  int i, done;
+
+  for (i = 0; i < 12; i++)
+    m[i] = (i / 3) * 4 + perm[i % 3];
+  for (; i < 16; i++)
+    m[i] = 0x80;
+  mask = _mm_loadu_si128((const __m128i*)m);
+
+  // Similarly, we store 16 bytes but only 12 are valid
+  for (done = 0; done + 6 <= w; done += 4) {
+    __m128i v;
+    v = _mm_loadu_si128((const __m128i*)src);
+    v = _mm_shuffle_epi8(v, mask);
+    _mm_storeu_si128((__m128i*)dst, v);
+    src += 16;
+    dst += 12;
+  }
+
+  return done;
+}
+
+TARGET("ssse3")
+static inline __m128i downconvSSSE3(__m128i v, int maxVal)
+{
+  __m128i t;
+  t = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(maxVal)),
+                    _mm_set1_epi16(128));
+  t = _mm_add_epi16(_mm_add_epi16(t, _mm_set1_epi16(1)),
+                    _mm_srli_epi16(t, 8));
+  return _mm_srli_epi16(t, 8);
+}
+
+// Builds the masks needed to pick out one component from four 32-bit
+// pixels and place it in 16-bit lanes, either in the lower or the
+// upper half of the register
+static void componentMasks(uint8_t offset, uint8_t lower[16],
+                           uint8_t upper[16])
+{
+  int i;
+
+  memset(lower, 0x80, 16);
+  memset(upper, 0x80, 16);
+
+  for (i = 0; i < 4; i++) {
+    lower[i * 2] = i * 4 + offset;
+    upper[8 + i * 2] = i * 4 + offset;
+  }
+}
+
+TARGET("ssse3")
+static int to565SSSE3(uint8_t* dst, const uint8_t* src,
+                      const Format565* fmt, int w)
+{
+  uint8_t m[2][16];
+  __m128i lower[3], upper[3], shifts[3];
+  int i, done;
+
+  for (i = 0; i < 3; i++) {
+    componentMasks(fmt->offsets[i], m[0], m[1]);
+    lower[i] = _mm_loadu_si128((const __m128i*)m[0]);
+    upper[i] = _mm_loadu_si128((const __m128i*)m[1]);
+    shifts[i] = _mm_cvtsi32_si128(fmt->shifts[i]);
+  }
+
+  for (done = 0; done + 8 <= w; done += 8) {
+    __m128i a, b, c, d;
+
+    a = _mm_loadu_si128((const __m128i*)src);
+    b = _mm_loadu_si128((const __m128i*)(src + 16));
+
+    d = _mm_setzero_si128();
+    for (i = 0; i < 3; i++) {
+      c = _mm_or_si128(_mm_shuffle_epi8(a, lower[i]),
+                       _mm_shuffle_epi8(b, upper[i]));
+      c = downconvSSSE3(c, i == 1 ? 63 : 31);
+      d = _mm_or_si128(d, _mm_sll_epi16(c, shifts[i]));
+    }
+
+    if (fmt->swap)
+      d = _mm_or_si128(_mm_slli_epi16(d, 8), _mm_srli_epi16(d, 8));
+
+    _mm_storeu_si128((__m128i*)dst, d);
+
+    src += 32;
+    dst += 16;
+  }
+
+  return done;
+}
+
+TARGET("ssse3")
+static int from565SSSE3(uint8_t* dst, const uint8_t* src,
+                        const Format565* fmt, int w)
+{
+  __m128i offsets[3], shifts[3];
+  int i, done;
+
+  for (i = 0; i < 3; i++) {
+    offsets[i] = _mm_cvtsi32_si128(fmt->offsets[i] * 8);
+    shifts[i] = _mm_cvtsi32_si128(fmt->shifts[i]);
+  }
+
+  for (done = 0; done + 8 <= w; done += 8) {
+    __m128i s, c, lo, hi;
+
+    s = _mm_loadu_si128((const __m128i*)src);
+
+    if (fmt->swap)
+      s = _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8));
+
+    lo = hi = _mm_setzero_si128();
+    for (i = 0; i < 3; i++) {
+      c = _mm_srl_epi16(s, shifts[i]);
+      if (i == 1) {
+        c = _mm_and_si128(c, _mm_set1_epi16(63));
+        c = _mm_add_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(259)),
+                          _mm_set1_epi16(3));
+        c = _mm_srli_epi16(c, 6);
+      } else {
+        c = _mm_and_si128(c, _mm_set1_epi16(31));
+        c = _mm_mullo_epi16(c, _mm_set1_epi16(1053));
+        c = _mm_srli_epi16(c, 7);
+      }
+      lo = _mm_or_si128(lo, _mm_sll_epi32(_mm_unpacklo_epi16(c, _mm_setzero_si128()),
+                                          offsets[i]));
+      hi = _mm_or_si128(hi, _mm_sll_epi32(_mm_unpackhi_epi16(c, _mm_setzero_si128()),
+                                          offsets[i]));
+    }
+
+    _mm_storeu_si128((__m128i*)dst, lo);
+    _mm_storeu_si128((__m128i*)(dst + 16), hi);
+
+    src += 16;
+    dst += 32;
+  }
+
+  return done;
+}
+
+TARGET("avx2")
+static int shuffle32AVX2(uint8_t* dst, const uint8_t* src,
+                         const uint8_t* perm, int w)
+{
+  uint8_t m[32];
+  __m256i mask;
+  int i, done;
+
+  // The shuffle works on each 128-bit lane separately
+  for (i = 0; i < 32; i++)
+    m[i] = (i & 0x0c) + perm[i & 3];
+  mask = _mm256_loadu_si256((const __m256i*)m);
+
+  for (done = 0; done + 8 <= w; done += 8) {
+    __m256i v;
+    v = _mm256_loadu_si256((const __m256i*)src);
+    v = _mm256_shuffle_epi8(v, mask);
+    _mm256_storeu_si256((__m256i*)dst, v);
+    src += 32;
+    dst += 32;
+  }
+
+  return done + shuffle32SSSE3(dst, src, perm, w - done);
+}
+
+TARGET("avx2")
+static inline __m256i downconvAVX2(__m256i v, int maxVal)
+{
+  __m256i t;
+  t = _mm256_add_epi16(_mm256_mullo_epi16(v, _mm256_set1_epi16(maxVal)),
+                       _mm256_set1_epi16(128));
+  t = _mm256_add_epi16(_mm256_add_epi16(t, _mm256_set1_epi16(1)),
+                       _mm256_srli_epi16(t, 8));
+  return _mm256_srli_epi16(t, 8);
+}
+
+TARGET("avx2")
+static int to565AVX2(uint8_t* dst, const uint8_t* src,
+                     const Format565* fmt, int w)
+{
+  uint8_t m[2][16];
+  __m256i lower[3], upper[3];
+  __m128i shifts[3];
+  int i, done;
+
+  for (i = 0; i < 3; i++) {
+    componentMasks(fmt->offsets[i], m[0], m[1]);
+    lower[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m[0]));
+    upper[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m[1]));
+    shifts[i] = _mm_cvtsi32_si128(fmt->shifts[i]);
+  }
+
+  for (done = 0; done + 16 <= w; done += 16) {
+    __m256i a, b, c, d;
+
+    a = _mm256_loadu_si256((const __m256i*)src);
+    b = _mm256_loadu_si256((const __m256i*)(src + 32));
+
+    d = _mm256_setzero_si256();
+    for (i = 0; i < 3; i++) {
+      c = _mm256_or_si256(_mm256_shuffle_epi8(a, lower[i]),
+                          _mm256_shuffle_epi8(b, upper[i]));
+      c = downconvAVX2(c, i == 1 ? 63 : 31);
+      d = _mm256_or_si256(d, _mm256_sll_epi16(c, shifts[i]));
+    }
+
+    // The shuffles work per lane, so the pixels are now out of order
+    d = _mm256_permute4x64_epi64(d, 0xd8);
+
+    if (fmt->swap)
+      d = _mm256_or_si256(_mm256_slli_epi16(d, 8), _mm256_srli_epi16(d, 8));
+
+    _mm256_storeu_si256((__m256i*)dst, d);
+
+    src += 64;
+    dst += 32;
+  }
+
+  return done + to565SSSE3(dst, src, fmt, w - done);
+}
+
+TARGET("avx2")
+static int from565AVX2(uint8_t* dst, const uint8_t* src,
+                       const Format565* fmt, int w)
+{
+  __m128i offsets[3], shifts[3];
+  int i, done;
+
+  for (i = 0; i < 3; i++) {
+    offsets[i] = _mm_cvtsi32_si128(fmt->offsets[i] * 8);
+    shifts[i] = _mm_cvtsi32_si128(fmt->shifts[i]);
+  }
+
+  for (done = 0; done + 16 <= w; done += 16) {
+    __m256i s, c, lo, hi;
+
+    s = _mm256_loadu_si256((const __m256i*)src);
+
+    if (fmt->swap)
+      s = _mm256_or_si256(_mm256_slli_epi16(s, 8), _mm256_srli_epi16(s, 8));
+
+    lo = hi = _mm256_setzero_si256();
+    for (i = 0; i < 3; i++) {
+      c = _mm256_srl_epi16(s, shifts[i]);
+      if (i == 1) {
+        c = _mm256_and_si256(c, _mm256_set1_epi16(63));
+        c = _mm256_add_epi16(_mm256_mullo_epi16(c, _mm256_set1_epi16(259)),
+                             _mm256_set1_epi16(3));
+        c = _mm256_srli_epi16(c, 6);
+      } else {
+        c = _mm256_and_si256(c, _mm256_set1_epi16(31));
+        c = _mm256_mullo_epi16(c, _mm256_set1_epi16(1053));
+        c = _mm256_srli_epi16(c, 7);
+      }
+      lo = _mm256_or_si256(lo, _mm256_sll_epi32(_mm256_unpacklo_epi16(c, _mm256_setzero_si256()),
+                                                offsets[i]));
+      hi = _mm256_or_si256(hi, _mm256_sll_epi32(_mm256_unpackhi_epi16(c, _mm256_setzero_si256()),
+                                                offsets[i]));
+    }
+
+    // Unpacking also works per lane, so lo has pixels 0-3 and 8-11,
+    // and hi has pixels 4-7 and 12-15
+    _mm256_storeu_si256((__m256i*)dst,
+                        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 32),
+                        _mm256_permute2x128_si256(lo, hi, 0x31));
+
+    src += 32;
+    dst += 64;
+  }
+
+  return done + from565SSSE3(dst, src, fmt, w - done);
+}
+
+// The filter kernels use pmaddwd to apply two weights at a time, so
+// pixels or rows are interleaved in pairs
+
+TARGET("sse2")
+static int filterRowSSE2(int16_t* dst, const uint8_t* src, int srcX,
+                         const SFilterWeightTab* tabs, int w)
+{
+  __m128i zero, round;
+  int done;
+
+  zero = _mm_setzero_si128();
+  round = _mm_set1_epi32(1 << (BITS_OF_WEIGHT - 8));
+
+  for (done = 0; done < w; done++) {
+    const uint8_t* in;
+    const short* weight;
+    int taps;
+    __m128i sum, p, q;
+
+    in = src + (tabs->i0 - srcX) * 4;
+    weight = tabs->weight;
+    taps = tabs->i1 - tabs->i0;
+
+    sum = round;
+
+    for (; taps >= 2; taps -= 2) {
+      p = _mm_loadl_epi64((const __m128i*)in);
+      p = _mm_unpacklo_epi8(p, zero);
+      p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+      q = _mm_set1_epi32(((uint32_t)(uint16_t)weight[1] << 16) |
+                         (uint16_t)weight[0]);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(p, q));
+      in += 8;
+      weight += 2;
+    }
+
+    if (taps) {
+      int32_t pixel;
+      memcpy(&pixel, in, 4);
+      p = _mm_cvtsi32_si128(pixel);
+      p = _mm_unpacklo_epi8(p, zero);
+      p = _mm_unpacklo_epi16(p, zero);
+      q = _mm_set1_epi32((uint16_t)weight[0]);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(p, q));
+    }
+
+    sum = _mm_srai_epi32(sum, BITS_OF_WEIGHT - 7);
+    _mm_storel_epi64((__m128i*)dst, _mm_packs_epi32(sum, sum));
+
+    dst += 4;
+    tabs++;
+  }
+
+  return done;
+}
+
+TARGET("sse2")
+static int filterColumnsSSE2(uint8_t* dst, const int16_t* const* rows,
+                             const short* weights, int taps, int count)
+{
+  __m128i round;
+  int done;
+
+  round = _mm_set1_epi32(1 << (BITS_OF_WEIGHT + 6));
+
+  for (done = 0; done + 8 <= count; done += 8) {
+    __m128i lo, hi, a, b, q;
+    int k;
+
+    lo = hi = round;
+
+    for (k = 0; k + 2 <= taps; k += 2) {
+      a = _mm_loadu_si128((const __m128i*)(rows[k] + done));
+      b = _mm_loadu_si128((const __m128i*)(rows[k + 1] + done));
+      q = _mm_set1_epi32(((uint32_t)(uint16_t)weights[k + 1] << 16) |
+                         (uint16_t)weights[k]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), q));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), q));
+    }
+
+    if (k < taps) {
+      a = _mm_loadu_si128((const __m128i*)(rows[k] + done));
+      b = _mm_setzero_si128();
+      q = _mm_set1_epi32((uint16_t)weights[k]);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), q));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), q));
+    }
+
+    lo = _mm_srai_epi32(lo, BITS_OF_WEIGHT + 7);
+    hi = _mm_srai_epi32(hi, BITS_OF_WEIGHT + 7);
+
+    // Saturation takes care of clamping to 0-255
+    a = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64((__m128i*)(dst + done), _mm_packus_epi16(a, a));
+  }
+
+  return done;
+}
+
+TARGET("sse2")
+static inline __m128i blendHalfSSE2(__m128i d, __m128i inv)
+{
+  __m128i t;
+
+  t = _mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+TARGET("sse2")
+static int blendOverSSE2(uint8_t* dst, const uint8_t* src, int w)
+{
+  __m128i zero, ones;
+  int done;
+
+  zero = _mm_setzero_si128();
+  ones = _mm_set1_epi8(-1);
+
+  for (done = 0; done + 4 <= w; done += 4) {
+    __m128i s, d, inv;
+
+    s = _mm_loadu_si128((const __m128i*)(src + done * 4));
+    d = _mm_loadu_si128((const __m128i*)(dst + done * 4));
+
+    // Spread 255 - alpha to all bytes of each pixel
+    inv = _mm_srli_epi32(_mm_xor_si128(s, ones), 24);
+    inv = _mm_or_si128(inv, _mm_slli_epi32(inv, 8));
+    inv = _mm_or_si128(inv, _mm_slli_epi32(inv, 16));
+
+    d = _mm_packus_epi16(blendHalfSSE2(_mm_unpacklo_epi8(d, zero),
+                                       _mm_unpacklo_epi8(inv, zero)),
+                         blendHalfSSE2(_mm_unpackhi_epi8(d, zero),
+                                       _mm_unpackhi_epi8(inv, zero)));
+
+    _mm_storeu_si128((__m128i*)(dst + done * 4), _mm_adds_epu8(d, s));
+  }
+
+  return done;
+}
+
+// The pixel scans compare whole vectors and then use the byte mask
+// to find the first pixel that didn't match. A pixel only counts as
+// equal if all of its bytes are, so the comparison has to be done at
+// the pixel size when two values are involved.
+
+TARGET("sse2")
+static inline __m128i splatSSE2(uint32_t value, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return _mm_set1_epi8(value);
+  case 16:
+    return _mm_set1_epi16(value);
+  default:
+    return _mm_set1_epi32(value);
+  }
+}
+
+TARGET("sse2")
+static inline __m128i cmpeqSSE2(__m128i a, __m128i b, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return _mm_cmpeq_epi8(a, b);
+  case 16:
+    return _mm_cmpeq_epi16(a, b);
+  default:
+    return _mm_cmpeq_epi32(a, b);
+  }
+}
+
+TARGET("sse2")
+static int countEqualSSE2(const uint8_t* data, int bpp, uint32_t value,
+                          int count)
+{
+  __m128i v;
+  int bytes, len, done;
+
+  v = splatSSE2(value, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 16 <= len; done += 16) {
+    unsigned mask;
+
+    mask = _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + done)), v));
+    if (mask != 0xffff)
+      return (done + __builtin_ctz(~mask)) / bytes;
+  }
+
+  return done / bytes;
+}
+
+TARGET("sse2")
+static int countTwoSSE2(const uint8_t* data, int bpp,
+                        uint32_t a, uint32_t b, int count, int* countA)
+{
+  __m128i va, vb;
+  int bytes, len, done;
+
+  va = splatSSE2(a, bpp);
+  vb = splatSSE2(b, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 16 <= len; done += 16) {
+    __m128i d;
+    unsigned maskA, mask;
+
+    d = _mm_loadu_si128((const __m128i*)(data + done));
+    maskA = _mm_movemask_epi8(cmpeqSSE2(d, va, bpp));
+    mask = maskA | _mm_movemask_epi8(cmpeqSSE2(d, vb, bpp));
+    if (mask != 0xffff) {
+      int first;
+      first = __builtin_ctz(~mask) / bytes * bytes;
+      *countA += __builtin_popcount(maskA & ((1 << first) - 1)) / bytes;
+      return (done + first) / bytes;
+    }
+    *countA += __builtin_popcount(maskA) / bytes;
+  }
+
+  return done / bytes;
+}
+
+TARGET("avx2")
+static inline __m256i splatAVX2(uint32_t value, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return _mm256_set1_epi8(value);
+  case 16:
+    return _mm256_set1_epi16(value);
+  default:
+    return _mm256_set1_epi32(value);
+  }
+}
+
+TARGET("avx2")
+static inline __m256i cmpeqAVX2(__m256i a, __m256i b, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return _mm256_cmpeq_epi8(a, b);
+  case 16:
+    return _mm256_cmpeq_epi16(a, b);
+  default:
+    return _mm256_cmpeq_epi32(a, b);
+  }
+}
+
+TARGET("avx2")
+static int countEqualAVX2(const uint8_t* data, int bpp, uint32_t value,
+                          int count)
+{
+  __m256i v;
+  int bytes, len, done;
+
+  v = splatAVX2(value, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 32 <= len; done += 32) {
+    unsigned mask;
+
+    mask = _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + done)),
+                        v));
+    if (mask != 0xffffffff)
+      return (done + __builtin_ctz(~mask)) / bytes;
+  }
+
+  return done / bytes;
+}
+
+TARGET("avx2")
+static int countTwoAVX2(const uint8_t* data, int bpp,
+                        uint32_t a, uint32_t b, int count, int* countA)
+{
+  __m256i va, vb;
+  int bytes, len, done;
+
+  va = splatAVX2(a, bpp);
+  vb = splatAVX2(b, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 32 <= len; done += 32) {
+    __m256i d;
+    unsigned maskA, mask;
+
+    d = _mm256_loadu_si256((const __m256i*)(data + done));
+    maskA = _mm256_movemask_epi8(cmpeqAVX2(d, va, bpp));
+    mask = maskA | _mm256_movemask_epi8(cmpeqAVX2(d, vb, bpp));
+    if (mask != 0xffffffff) {
+      int first;
+      first = __builtin_ctz(~mask) / bytes * bytes;
+      *countA += __builtin_popcount(maskA & ((1u << first) - 1)) / bytes;
+      return (done + first) / bytes;
+    }
+    *countA += __builtin_popcount(maskA) / bytes;
+  }
+
+  return done / bytes;
+}
+
+static const Kernels kernelsSSSE3 = {
+  "SSSE3",
+  shuffle32SSSE3, rgbTo32SSSE3, to24SSSE3, to565SSSE3, from565SSSE3,
+  filterRowSSE2, filterColumnsSSE2, blendOverSSE2,
+  countEqualSSE2, countTwoSSE2
+};
+
+// The 24-bit conversions don't gain anything from the wider
+// registers, and the filters and blending only have SSE2 versions
+static const Kernels kernelsAVX2 = {
+  "AVX2",
+  shuffle32AVX2, rgbTo32SSSE3, to24SSSE3, to565AVX2, from565AVX2,
+  filterRowSSE2, filterColumnsSSE2, blendOverSSE2,
+  countEqualAVX2, countTwoAVX2
+};
+
+#endif // SIMD_X86
+
+//
+// ARM (NEON)
+//
+// The interleaved loads and stores do all the heavy lifting for us
+// here.
+//
+
+#ifdef SIMD_NEON
+
+static int shuffle32NEON(uint8_t* dst, const uint8_t* src,
+                         const uint8_t* perm, int w)
+{
+  uint8_t m[16];
+  uint8x16_t mask;
+  int i, done;
+
+  for (i = 0; i < 16; i++)
+    m[i] = (i & ~3) + perm[i & 3];
+  mask = vld1q_u8(m);
+
+  for (done = 0; done + 4 <= w; done += 4) {
+    vst1q_u8(dst, vqtbl1q_u8(vld1q_u8(src), mask));
+    src += 16;
+    dst += 16;
+  }
+
+  return done;
+}
+
+static int rgbTo32NEON(uint8_t* dst, const uint8_t* src,
+                       const uint8_t* perm, int w)
+{
+  int i, done;
+
+  for (done = 0; done + 16 <= w; done += 16) {
+    uint8x16x3_t in;
+    uint8x16x4_t out;
+
+    in = vld3q_u8(src);
+    for (i = 0; i < 4; i++)
+      out.val[i] = perm[i] < 3 ? in.val[perm[i]] : vdupq_n_u8(0);
+    vst4q_u8(dst, out);
+
+    src += 48;
+    dst += 64;
+  }
+
+  return done;
+}
+
+static int to24NEON(uint8_t* dst, const uint8_t* src,
+                    const uint8_t* perm, int w)
+{
+  int i, done;
+
+  for (done = 0; done + 16 <= w; done += 16) {
+    uint8x16x4_t in;
+    uint8x16x3_t out;
+
+    in = vld4q_u8(src);
+    for (i = 0; i < 3; i++)
+      out.val[i] = in.val[perm[i]];
+    vst3q_u8(dst, out);
+
+    src += 64;
+    dst += 48;
+  }
+
+  return done;
+}
+
+static inline uint16x8_t downconvNEON(uint8x8_t v, uint8_t maxVal)
+{
+  uint16x8_t t;
+  t = vmlal_u8(vdupq_n_u16(128), v, vdup_n_u8(maxVal));
+  t = vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8));
+  return vshrq_n_u16(t, 8);
+}
+
+static int to565NEON(uint8_t* dst, const uint8_t* src,
+                     const Format565* fmt, int w)
+{
+  int i, done;
+
+  for (done = 0; done + 16 <= w; done += 16) {
+    uint8x16x4_t in;
+    uint16x8_t lo, hi;
+
+    in = vld4q_u8(src);
+
+    lo = hi = vdupq_n_u16(0);
+    for (i = 0; i < 3; i++) {
+      uint8x16_t c;
+      uint8_t maxVal;
+      int16x8_t shift;
+
+      c = in.val[fmt->offsets[i]];
+      maxVal = i == 1 ? 63 : 31;
+      shift = vdupq_n_s16(fmt->shifts[i]);
+
+      lo = vorrq_u16(lo, vshlq_u16(downconvNEON(vget_low_u8(c), maxVal),
+                                   shift));
+      hi = vorrq_u16(hi, vshlq_u16(downconvNEON(vget_high_u8(c), maxVal),
+                                   shift));
+    }
+
+    if (fmt->swap) {
+      lo = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(lo)));
+      hi = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(hi)));
+    }
+
+    vst1q_u8(dst, vreinterpretq_u8_u16(lo));
+    vst1q_u8(dst + 16, vreinterpretq_u8_u16(hi));
+
+    src += 64;
+    dst += 32;
+  }
+
+  return done;
+}
+
+static int from565NEON(uint8_t* dst, const uint8_t* src,
+                       const Format565* fmt, int w)
+{
+  int i, done;
+
+  for (done = 0; done + 8 <= w; done += 8) {
+    uint8x16_t raw;
+    uint16x8_t s;
+    uint8x8x4_t out;
+
+    raw = vld1q_u8(src);
+    if (fmt->swap)
+      raw = vrev16q_u8(raw);
+    s = vreinterpretq_u16_u8(raw);
+
+    for (i = 0; i < 4; i++)
+      out.val[i] = vdup_n_u8(0);
+
+    for (i = 0; i < 3; i++) {
+      uint16x8_t c;
+
+      c = vshlq_u16(s, vdupq_n_s16(-fmt->shifts[i]));
+      if (i == 1) {
+        c = vandq_u16(c, vdupq_n_u16(63));
+        c = vshrq_n_u16(vmlaq_n_u16(vdupq_n_u16(3), c, 259), 6);
+      } else {
+        c = vandq_u16(c, vdupq_n_u16(31));
+        c = vshrq_n_u16(vmulq_n_u16(c, 1053), 7);
+      }
+
+      out.val[fmt->offsets[i]] = vmovn_u16(c);
+    }
+
+    vst4_u8(dst, out);
+
+    src += 16;
+    dst += 32;
+  }
+
+  return done;
+}
+
+static int filterRowNEON(int16_t* dst, const uint8_t* src, int srcX,
+                         const SFilterWeightTab* tabs, int w)
+{
+  int done;
+
+  for (done = 0; done < w; done++) {
+    const uint8_t* in;
+    int32x4_t sum;
+    uint32_t pixel;
+
+    in = src + (tabs->i0 - srcX) * 4;
+
+    sum = vdupq_n_s32(0);
+    for (int i = 0; i < tabs->i1 - tabs->i0; i++) {
+      int16x4_t p;
+      memcpy(&pixel, in, 4);
+      p = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+      sum = vmlal_n_s16(sum, p, tabs->weight[i]);
+      in += 4;
+    }
+
+    vst1_s16(dst, vqrshrn_n_s32(sum, BITS_OF_WEIGHT - 7));
+
+    dst += 4;
+    tabs++;
+  }
+
+  return done;
+}
+
+static int filterColumnsNEON(uint8_t* dst, const int16_t* const* rows,
+                             const short* weights, int taps, int count)
+{
+  int32x4_t round;
+  int done;
+
+  round = vdupq_n_s32(1 << (BITS_OF_WEIGHT + 6));
+
+  for (done = 0; done + 8 <= count; done += 8) {
+    int32x4_t lo, hi;
+    int16x8_t r;
+
+    lo = hi = round;
+    for (int k = 0; k < taps; k++) {
+      r = vld1q_s16(rows[k] + done);
+      lo = vmlal_n_s16(lo, vget_low_s16(r), weights[k]);
+      hi = vmlal_n_s16(hi, vget_high_s16(r), weights[k]);
+    }
+
+    r = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, BITS_OF_WEIGHT + 7)),
+                     vqmovn_s32(vshrq_n_s32(hi, BITS_OF_WEIGHT + 7)));
+    vst1_u8(dst + done, vqmovun_s16(r));
+  }
+
+  return done;
+}
+
+static int blendOverNEON(uint8_t* dst, const uint8_t* src, int w)
+{
+  int done;
+
+  for (done = 0; done + 8 <= w; done += 8) {
+    uint8x8x4_t s, d;
+    uint8x8_t inv;
+
+    s = vld4_u8(src + done * 4);
+    d = vld4_u8(dst + done * 4);
+
+    inv = vmvn_u8(s.val[3]);
+
+    for (int c = 0; c < 4; c++) {
+      uint16x8_t t;
+      t = vmlal_u8(vdupq_n_u16(128), d.val[c], inv);
+      d.val[c] = vqadd_u8(vaddhn_u16(t, vshrq_n_u16(t, 8)), s.val[c]);
+    }
+
+    vst4_u8(dst + done * 4, d);
+  }
+
+  return done;
+}
+
+// There is no movemask on NEON, so the comparison result is narrowed
+// to four bits per byte instead
+
+static inline uint64_t byteMaskNEON(uint8x16_t eq)
+{
+  return vget_lane_u64(vreinterpret_u64_u8(
+           vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+}
+
+static inline uint8x16_t splatNEON(uint32_t value, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return vdupq_n_u8(value);
+  case 16:
+    return vreinterpretq_u8_u16(vdupq_n_u16(value));
+  default:
+    return vreinterpretq_u8_u32(vdupq_n_u32(value));
+  }
+}
+
+static inline uint8x16_t cmpeqNEON(uint8x16_t a, uint8x16_t b, int bpp)
+{
+  switch (bpp) {
+  case 8:
+    return vceqq_u8(a, b);
+  case 16:
+    return vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(a),
+                                          vreinterpretq_u16_u8(b)));
+  default:
+    return vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(a),
+                                          vreinterpretq_u32_u8(b)));
+  }
+}
+
+static int countEqualNEON(const uint8_t* data, int bpp, uint32_t value,
+                          int count)
+{
+  uint8x16_t v;
+  int bytes, len, done;
+
+  v = splatNEON(value, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 16 <= len; done += 16) {
+    uint64_t mask;
+
+    mask = byteMaskNEON(vceqq_u8(vld1q_u8(data + done), v));
+    if (mask != ~(uint64_t)0)
+      return (done + __builtin_ctzll(~mask) / 4) / bytes;
+  }
+
+  return done / bytes;
+}
+
+static int countTwoNEON(const uint8_t* data, int bpp,
+                        uint32_t a, uint32_t b, int count, int* countA)
+{
+  uint8x16_t va, vb;
+  int bytes, len, done;
+
+  va = splatNEON(a, bpp);
+  vb = splatNEON(b, bpp);
+  bytes = bpp / 8;
+  len = count * bytes;
+
+  for (done = 0; done + 16 <= len; done += 16) {
+    uint8x16_t d;
+    uint64_t maskA, mask;
+
+    d = vld1q_u8(data + done);
+    maskA = byteMaskNEON(cmpeqNEON(d, va, bpp));
+    mask = maskA | byteMaskNEON(cmpeqNEON(d, vb, bpp));
+    if (mask != ~(uint64_t)0) {
+      int first;
+      first = __builtin_ctzll(~mask) / 4 / bytes * bytes;
+      *countA += __builtin_popcountll(maskA &
+                                      (((uint64_t)1 << (first * 4)) - 1)) /
+                 4 / bytes;
+      return (done + first) / bytes;
+    }
+    *countA += __builtin_popcountll(maskA) / 4 / bytes;
+  }
+
+  return done / bytes;
+}
+
+static const Kernels kernelsNEON = {
+  "NEON",
+  shuffle32NEON, rgbTo32NEON, to24NEON, to565NEON, from565NEON,
+  filterRowNEON, filterColumnsNEON, blendOverNEON,
+  countEqualNEON, countTwoNEON
+};
+
+#endif // SIMD_NEON
+
+//
+// Runtime selection
+//
+
+class SIMDInit {
+public:
+  SIMDInit();
+};
+
+static SIMDInit _init;
+
+SIMDInit::SIMDInit()
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    bestKernels = &kernelsAVX2;
+  else if (__builtin_cpu_supports("ssse3"))
+    bestKernels = &kernelsSSSE3;
+#endif
+#ifdef SIMD_NEON
+  bestKernels = &kernelsNEON;
+#endif
+
+  kernels = bestKernels;
+}
+
+const char* rfb::simdGetName()
+{
+  if (kernels == NULL)
+    return NULL;
+  return kernels->name;
+}
+
+void rfb::simdSetEnabled(bool enabled)
+{
+  kernels = enabled ? bestKernels : NULL;
+}
+
+bool rfb::simdShuffle32(uint8_t* dst, const uint8_t* src,
+                        const uint8_t perm[4], int w, int h,
+                        int dstStride, int srcStride)
+{
+  if (kernels == NULL)
+    return false;
+
+  while (h--) {
+    int done;
+    done = kernels->shuffle32(dst, src, perm, w);
+    shuffle32Generic(dst + done * 4, src + done * 4, perm, w - done);
+    dst += dstStride * 4;
+    src += srcStride * 4;
+  }
+
+  return true;
+}
+
+bool rfb::simdRGBTo32(uint8_t* dst, const uint8_t* src,
+                      const uint8_t perm[4], int w, int h,
+                      int dstStride, int srcStride)
+{
+  if (kernels == NULL)
+    return false;
+
+  while (h--) {
+    int done;
+    done = kernels->rgbTo32(dst, src, perm, w);
+    rgbTo32Generic(dst + done * 4, src + done * 3, perm, w - done);
+    dst += dstStride * 4;
+    src += srcStride * 3;
+  }
+
+  return true;
+}
+
+bool rfb::simd32ToRGB(uint8_t* dst, const uint8_t* src,
+                      const uint8_t perm[3], int w, int h,
+                      int dstStride, int srcStride)
+{
+  if (kernels == NULL)
+    return false;
+
+  while (h--) {
+    int done;
+    done = kernels->to24(dst, src, perm, w);
+    to24Generic(dst + done * 3, src + done * 4, perm, w - done);
+    dst += dstStride * 3;
+    src += srcStride * 4;
+  }
+
+  return true;
+}
+
+bool rfb::simd32To565(uint8_t* dst, const uint8_t* src,
+                      const uint8_t offsets[3], const uint8_t shifts[3],
+                      bool swap, int w, int h, int dstStride, int srcStride)
+{
+  Format565 fmt;
+
+  if (kernels == NULL)
+    return false;
+
+  memcpy(fmt.offsets, offsets, sizeof(fmt.offsets));
+  memcpy(fmt.shifts, shifts, sizeof(fmt.shifts));
+  fmt.swap = swap;
+
+  while (h--) {
+    int done;
+    done = kernels->to565(dst, src, &fmt, w);
+    to565Generic(dst + done * 2, src + done * 4, &fmt, w - done);
+    dst += dstStride * 2;
+    src += srcStride * 4;
+  }
+
+  return true;
+}
+
+bool rfb::simd565To32(uint8_t* dst, const uint8_t* src,
+                      const uint8_t offsets[3], const uint8_t shifts[3],
+                      bool swap, int w, int h, int dstStride, int srcStride)
+{
+  Format565 fmt;
+
+  if (kernels == NULL)
+    return false;
+
+  memcpy(fmt.offsets, offsets, sizeof(fmt.offsets));
+  memcpy(fmt.shifts, shifts, sizeof(fmt.shifts));
+  fmt.swap = swap;
+
+  while (h--) {
+    int done;
+    done = kernels->from565(dst, src, &fmt, w);
+    from565Generic(dst + done * 4, src + done * 2, &fmt, w - done);
+    dst += dstStride * 4;
+    src += srcStride * 2;
+  }
+
+  return true;
+}
+
+bool rfb::simdFilterRow32(int16_t* dst, const uint8_t* src, int srcX,
+                          const SFilterWeightTab* tabs, int w)
+{
+  int done;
+
+  if (kernels == NULL)
+    return false;
+
+  done = kernels->filterRow(dst, src, srcX, tabs, w);
+  filterRowGeneric(dst + done * 4, src, srcX, tabs + done, w - done);
+
+  return true;
+}
+
+bool rfb::simdFilterColumns(uint8_t* dst, const int16_t* const* rows,
+                            const short* weights, int taps, int count)
+{
+  int done;
+
+  if (kernels == NULL)
+    return false;
+
+  done = kernels->filterColumns(dst, rows, weights, taps, count);
+  filterColumnsGeneric(dst, rows, weights, taps, done, count - done);
+
+  return true;
+}
+
+bool rfb::simdBlendOver(uint8_t* dst, const uint8_t* src, int w, int h,
+                        int dstStride, int srcStride)
+{
+  if (kernels == NULL)
+    return false;
+
+  while (h--) {
+    int done;
+    done = kernels->blendOver(dst, src, w);
+    blendOverGeneric(dst + done * 4, src + done * 4, w - done);
+    dst += dstStride * 4;
+    src += srcStride * 4;
+  }
+
+  return true;
+}
+
+bool rfb::simdCountEqual(const uint8_t* data, int bpp, uint32_t value,
+                         int count, int* result)
+{
+  int done;
+
+  if (kernels == NULL)
+    return false;
+
+  done = kernels->countEqual(data, bpp, value, count);
+  *result = done + countEqualGeneric(data + done * (bpp / 8), bpp,
+                                     value, count - done);
+
+  return true;
+}
+
+bool rfb::simdCountTwo(const uint8_t* data, int bpp,
+                       uint32_t a, uint32_t b, int count,
+                       int* result, int* countA)
+{
+  int done;
+
+  if (kernels == NULL)
+    return false;
+
+  *countA = 0;
+  done = kernels->countTwo(data, bpp, a, b, count, countA);
+  *result = done + countTwoGeneric(data + done * (bpp / 8), bpp,
+                                   a, b, count - done, countA);
+
+  return true;
+}
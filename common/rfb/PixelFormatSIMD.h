@@ -0,0 +1,108 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// PixelFormatSIMD - vectorised versions of the most common pixel
+// format conversions, of the filter used for scaling, of the
+// blending of the server side rendered cursor, and of the pixel scans
+// done by the simple tile based encoders
+//
+// The best implementation for the current CPU is picked at runtime.
+// Every function returns false if there is no vectorised version
+// available, in which case the caller has to use the generic code.
+// The results are always identical to the generic code.
+//
+// All strides are in pixels.
+//
+
+#ifndef __RFB_PIXELFORMATSIMD_H__
+#define __RFB_PIXELFORMATSIMD_H__
+
+#include <stdint.h>
+
+#include <rfb/ScaleFilters.h>
+
+namespace rfb {
+
+  // Returns the name of the instruction set in use, or NULL if none
+  const char* simdGetName();
+
+  // Allows turning off the vectorised code, mostly for testing
+  void simdSetEnabled(bool enabled);
+
+  // Reorders the bytes of each 32-bit pixel so that byte i of each
+  // destination pixel is byte perm[i] of the source pixel
+  bool simdShuffle32(uint8_t* dst, const uint8_t* src,
+                     const uint8_t perm[4], int w, int h,
+                     int dstStride, int srcStride);
+
+  // Converts 24-bit RGB to 32-bit pixels so that byte i of each
+  // destination pixel is byte perm[i] of the source, or zero if
+  // perm[i] is 3 or more
+  bool simdRGBTo32(uint8_t* dst, const uint8_t* src,
+                   const uint8_t perm[4], int w, int h,
+                   int dstStride, int srcStride);
+
+  // Converts 32-bit pixels to 24-bit RGB so that byte i of each
+  // destination pixel is byte perm[i] of the source pixel
+  bool simd32ToRGB(uint8_t* dst, const uint8_t* src,
+                   const uint8_t perm[3], int w, int h,
+                   int dstStride, int srcStride);
+
+  // Converts between 32-bit pixels with 8-bit red, green and blue
+  // at the given byte offsets, and 16-bit pixels with 5-bit red,
+  // 6-bit green and 5-bit blue at the given shifts. If swap is set
+  // then the 16-bit pixels are in the opposite byte order compared
+  // to the CPU.
+  bool simd32To565(uint8_t* dst, const uint8_t* src,
+                   const uint8_t offsets[3], const uint8_t shifts[3],
+                   bool swap, int w, int h, int dstStride, int srcStride);
+  bool simd565To32(uint8_t* dst, const uint8_t* src,
+                   const uint8_t offsets[3], const uint8_t shifts[3],
+                   bool swap, int w, int h, int dstStride, int srcStride);
+
+  // Horizontal pass of the scaling filter for a row of 32-bit pixels,
+  // where src points at pixel srcX of the source row. Each output
+  // byte becomes a 16-bit value with seven bits of extra precision.
+  bool simdFilterRow32(int16_t* dst, const uint8_t* src, int srcX,
+                       const SFilterWeightTab* tabs, int w);
+
+  // Vertical pass of the scaling filter, combining count values from
+  // each of the rows produced by simdFilterRow32() back to bytes
+  bool simdFilterColumns(uint8_t* dst, const int16_t* const* rows,
+                         const short* weights, int taps, int count);
+
+  // Composites 32-bit pixels with premultiplied alpha in byte 3 on top
+  // of dst, which must use the same byte order. All four bytes are
+  // blended, so byte 3 of dst ends up as the combined coverage.
+  bool simdBlendOver(uint8_t* dst, const uint8_t* src, int w, int h,
+                     int dstStride, int srcStride);
+
+  // Sets result to how many of the first count pixels in data are
+  // equal to value. bpp must be 8, 16 or 32.
+  bool simdCountEqual(const uint8_t* data, int bpp, uint32_t value,
+                      int count, int* result);
+
+  // Sets result to how many of the first count pixels in data are
+  // equal to either a or b, and countA to how many of those are a
+  bool simdCountTwo(const uint8_t* data, int bpp, uint32_t a, uint32_t b,
+                    int count, int* result, int* countA);
+
+}
+
+#endif
@@ -26,6 +26,7 @@
 #include <rfb/SConnection.h>
 #include <rfb/PixelFormat.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/Palette.h>
 #include <rfb/RREEncoder.h>
 
@@ -109,6 +110,31 @@ void RREEncoder::writeSolidRect(int /*width*/, int /*height*/,
   os->writeBytes(colour, pf.bpp/8);
 }
 
+// Number of pixels at the start of data that are equal to value
+template<class T>
+static inline int countEqual(const T* data, T value, int count)
+{
+  int start, result;
+
+  // Most runs are short, so look at the first few pixels directly
+  // before paying for the call
+  for (start = 0; start < count && start < 8; start++) {
+    if (data[start] != value)
+      return start;
+  }
+
+  if (simdCountEqual((const uint8_t*)(data + start), sizeof(T)*8, value,
+                     count - start, &result))
+    return start + result;
+
+  for (result = start; result < count; result++) {
+    if (data[result] != value)
+      break;
+  }
+
+  return result;
+}
+
 template<class T>
 inline void RREEncoder::writePixel(rdr::OutStream* os, T pixel)
 {
@@ -132,28 +158,24 @@ int RREEncoder::rreEncode(T* data, int w, int h,
   {
     int x = 0;
     while (x < w) {
-      if (*data == bg) {
-        x++;
-        data++;
-        continue;
-      }
+      int skip = countEqual(data, bg, w - x);
+      x += skip;
+      data += skip;
+      if (x == w)
+        break;
 
       // Find horizontal subrect first
-      T* ptr = data+1;
-      T* eol = data+w-x;
-      while (ptr < eol && *ptr == *data) ptr++;
-      int sw = ptr - data;
+      int sw = 1 + countEqual(data + 1, *data, w - x - 1);
 
-      ptr = data + w;
+      T* ptr = data + w;
+      T* eol;
       int sh = 1;
       while (sh < h-y) {
-        eol = ptr + sw;
-        while (ptr < eol)
-          if (*ptr++ != *data) goto endOfHorizSubrect;
-        ptr += w - sw;
+        if (countEqual(ptr, *data, sw) != sw)
+          break;
+        ptr += w;
         sh++;
       }
-    endOfHorizSubrect:
 
       // Find vertical subrect
       int vh;
@@ -62,7 +62,8 @@ SConnection::SConnection()
     state_(RFBSTATE_UNINITIALISED), preferredEncoding(encodingRaw),
     accessRights(0x0000), hasRemoteClipboard(false),
     hasLocalClipboard(false),
-    unsolicitedClipboardAttempt(false)
+    unsolicitedClipboardAttempt(false),
+    clipboardTimer(this, &SConnection::handleClipboardTimeout)
 {
   defaultMajorVersion = 3;
   defaultMinorVersion = 8;
@@ -381,6 +382,8 @@ void SConnection::setEncodings(int nEncodings, const int32_t* encodings)
 
 void SConnection::clientCutText(const char* str)
 {
+  clipboardDecompressor.cancel();
+
   hasLocalClipboard = false;
 
   clientClipboard = str;
@@ -410,6 +413,8 @@ void SConnection::handleClipboardPeek()
 
 void SConnection::handleClipboardNotify(uint32_t flags)
 {
+  clipboardDecompressor.cancel();
+
   hasRemoteClipboard = false;
 
   if (flags & rfb::clipboardUTF8) {
@@ -441,6 +446,22 @@ void SConnection::handleClipboardProvide(uint32_t flags,
   handleClipboardData(clientClipboard.c_str());
 }
 
+void SConnection::handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                   size_t maxLength)
+{
+  // Anything still being unpacked has been replaced by this
+  clipboardDecompressor.cancel();
+
+  if (payload->compressed.size() < ClipboardWorker::asyncThreshold) {
+    SMsgHandler::handleClipboardProvideCompressed(payload, maxLength);
+    return;
+  }
+
+  clipboardDecompressor.startDecompress(payload, maxLength);
+  if (!clipboardTimer.isStarted())
+    clipboardTimer.start(10);
+}
+
 void SConnection::supportsQEMUKeyEvent()
 {
   writer()->writeQEMUKeyEvent();
@@ -569,6 +590,8 @@ void SConnection::requestClipboard()
 
 void SConnection::announceClipboard(bool available)
 {
+  clipboardCompressor.cancel();
+
   hasLocalClipboard = available;
   unsolicitedClipboardAttempt = false;
 
@@ -612,14 +635,58 @@ void SConnection::sendClipboardData(const char* data)
       }
     }
 
+    if (sizes[0] >= ClipboardWorker::asyncThreshold) {
+      ClipboardPayload payload;
+
+      payload.flags = rfb::clipboardUTF8;
+      payload.formats.push_back(std::vector<uint8_t>(data[0],
+                                                     data[0] + sizes[0]));
+
+      clipboardCompressor.startCompress(&payload);
+      if (!clipboardTimer.isStarted())
+        clipboardTimer.start(10);
+      return;
+    }
+
     writer()->writeClipboardProvide(rfb::clipboardUTF8, sizes, data);
   } else {
     writer()->writeServerCutText(data);
   }
 }
 
+bool SConnection::handleClipboardTimeout(Timer* /*t*/)
+{
+  ClipboardPayload payload;
+  bool failed;
+
+  if (state_ != RFBSTATE_NORMAL)
+    return false;
+
+  try {
+    if (clipboardCompressor.getResult(&payload, &failed))
+      writer()->writeClipboardProvideCompressed(payload.flags,
+                                                payload.compressed.data(),
+                                                payload.compressed.size());
+
+    if (clipboardDecompressor.getResult(&payload, &failed)) {
+      if (failed)
+        throw Exception("Extended clipboard decode error");
+      handleClipboardPayload(&payload);
+    }
+  } catch (rdr::Exception& e) {
+    close(e.str());
+    return false;
+  }
+
+  return clipboardCompressor.isBusy() || clipboardDecompressor.isBusy();
+}
+
 void SConnection::cleanup()
 {
+  clipboardTimer.stop();
+  clipboardCompressor.cancel();
+  clipboardDecompressor.cancel();
+
   delete ssecurity;
   ssecurity = NULL;
   delete reader_;
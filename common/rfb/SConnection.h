@@ -29,6 +29,7 @@
 #include <rdr/InStream.h>
 #include <rdr/OutStream.h>
 
+#include <rfb/ClipboardWorker.h>
 #include <rfb/SMsgHandler.h>
 #include <rfb/SecurityServer.h>
 #include <rfb/Timer.h>
@@ -92,6 +93,8 @@ namespace rfb {
     virtual void handleClipboardProvide(uint32_t flags,
                                         const size_t* lengths,
                                         const uint8_t* const* data);
+    virtual void handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                  size_t maxLength);
 
     virtual void supportsQEMUKeyEvent();
 
@@ -246,6 +249,7 @@ namespace rfb {
     bool processInitMsg();
 
     bool handleAuthFailureTimeout(Timer* t);
+    bool handleClipboardTimeout(Timer* t);
 
     int defaultMajorVersion, defaultMinorVersion;
 
@@ -269,6 +273,11 @@ namespace rfb {
     bool hasRemoteClipboard;
     bool hasLocalClipboard;
     bool unsolicitedClipboardAttempt;
+
+    // Large clipboards are (de)compressed in the background
+    ClipboardWorker clipboardCompressor;
+    ClipboardWorker clipboardDecompressor;
+    MethodTimer<SConnection> clipboardTimer;
   };
 }
 #endif
@@ -21,6 +21,7 @@
 #include <config.h>
 #endif
 
+#include <rfb/ClipboardWorker.h>
 #include <rfb/Exception.h>
 #include <rfb/LogWriter.h>
 #include <rfb/SMsgHandler.h>
@@ -134,6 +135,34 @@ void SMsgHandler::handleClipboardProvide(uint32_t /*flags*/,
 {
 }
 
+void SMsgHandler::handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                   size_t maxLength)
+{
+  if (!ClipboardWorker::decompress(payload, maxLength))
+    throw Exception("Extended clipboard decode error");
+
+  handleClipboardPayload(payload);
+}
+
+void SMsgHandler::handleClipboardPayload(const ClipboardPayload* payload)
+{
+  size_t num;
+  size_t lengths[16];
+  const uint8_t* data[16];
+
+  num = 0;
+  for (int i = 0;i < 16;i++) {
+    if (!(payload->flags & (1 << i)))
+      continue;
+
+    lengths[num] = payload->formats[num].size();
+    data[num] = payload->formats[num].data();
+    num++;
+  }
+
+  handleClipboardProvide(payload->flags, lengths, data);
+}
+
 void SMsgHandler::supportsLocalCursor()
 {
 }
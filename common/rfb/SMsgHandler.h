@@ -34,6 +34,8 @@ namespace rdr { class InStream; }
 
 namespace rfb {
 
+  struct ClipboardPayload;
+
   class SMsgHandler : public InputHandler {
   public:
     SMsgHandler();
@@ -64,6 +66,12 @@ namespace rfb {
                                         const size_t* lengths,
                                         const uint8_t* const* data);
 
+    // handleClipboardProvideCompressed() is called with the data of a
+    // "provide" action as it was received. The default implementation
+    // decompresses it and calls handleClipboardProvide().
+    virtual void handleClipboardProvideCompressed(ClipboardPayload* payload,
+                                                  size_t maxLength);
+
     // InputHandler interface
     // The InputHandler methods will be called for the corresponding messages.
 
@@ -96,6 +104,10 @@ namespace rfb {
     virtual void supportsQEMUKeyEvent();
 
     ClientParams client;
+
+  protected:
+    // Calls handleClipboardProvide() with the formats of a payload
+    void handleClipboardPayload(const ClipboardPayload* payload);
   };
 }
 #endif
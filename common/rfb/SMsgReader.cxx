@@ -26,11 +26,11 @@
 #include <vector>
 
 #include <rdr/InStream.h>
-#include <rdr/ZlibInStream.h>
 
 #include <rfb/msgTypes.h>
 #include <rfb/qemuTypes.h>
 #include <rfb/clipboardTypes.h>
+#include <rfb/ClipboardWorker.h>
 #include <rfb/Exception.h>
 #include <rfb/SMsgHandler.h>
 #include <rfb/SMsgReader.h>
@@ -366,68 +366,16 @@ bool SMsgReader::readExtendedClipboard(int32_t len)
 
     handler->handleClipboardCaps(flags, lengths);
   } else if (action == clipboardProvide) {
-    rdr::ZlibInStream zis;
+    ClipboardPayload payload;
 
-    int i;
-    size_t num;
-    size_t lengths[16];
-    uint8_t* buffers[16];
-
-    zis.setUnderlying(is, len - 4);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-
-      if (!zis.hasData(4))
-        throw Exception("Extended clipboard decode error");
-
-      lengths[num] = zis.readU32();
-
-      if (lengths[num] > (size_t)maxCutText) {
-        vlog.error("Extended clipboard data too long (%d bytes) - ignoring",
-                   (unsigned)lengths[num]);
-
-        // Slowly (safely) drain away the data
-        while (lengths[num] > 0) {
-          size_t chunk;
-
-          if (!zis.hasData(1))
-            throw Exception("Extended clipboard decode error");
-
-          chunk = zis.avail();
-          if (chunk > lengths[num])
-            chunk = lengths[num];
+    // The data is decompressed by the handler, as that can take a
+    // while for large clipboards
+    payload.flags = flags;
+    payload.compressed.resize(len - 4);
+    if (len > 4)
+      is->readBytes(payload.compressed.data(), len - 4);
 
-          zis.skip(chunk);
-          lengths[num] -= chunk;
-        }
-
-        flags &= ~(1 << i);
-
-        continue;
-      }
-
-      if (!zis.hasData(lengths[num]))
-        throw Exception("Extended clipboard decode error");
-
-      buffers[num] = new uint8_t[lengths[num]];
-      zis.readBytes(buffers[num], lengths[num]);
-      num++;
-    }
-
-    zis.flushUnderlying();
-    zis.setUnderlying(NULL, 0);
-
-    handler->handleClipboardProvide(flags, lengths, buffers);
-
-    num = 0;
-    for (i = 0;i < 16;i++) {
-      if (!(flags & 1 << i))
-        continue;
-      delete [] buffers[num++];
-    }
+    handler->handleClipboardProvideCompressed(&payload, maxCutText);
   } else {
     switch (action) {
     case clipboardRequest:
@@ -203,11 +203,23 @@ void SMsgWriter::writeClipboardProvide(uint32_t flags,
 
   zos.flush();
 
+  writeClipboardProvideCompressed(flags, mos.data(), mos.length());
+}
+
+void SMsgWriter::writeClipboardProvideCompressed(uint32_t flags,
+                                                 const uint8_t* data,
+                                                 size_t len)
+{
+  if (!client->supportsEncoding(pseudoEncodingExtendedClipboard))
+    throw Exception("Client does not support extended clipboard");
+  if (!(client->clipboardFlags() & clipboardProvide))
+    throw Exception("Client does not support clipboard \"provide\" action");
+
   startMsg(msgTypeServerCutText);
   os->pad(3);
-  os->writeS32(-(4 + mos.length()));
+  os->writeS32(-(4 + len));
   os->writeU32(flags | clipboardProvide);
-  os->writeBytes(mos.data(), mos.length());
+  os->writeBytes(data, len);
   endMsg();
 }
 
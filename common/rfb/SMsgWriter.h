@@ -66,6 +66,10 @@ namespace rfb {
     void writeClipboardNotify(uint32_t flags);
     void writeClipboardProvide(uint32_t flags, const size_t* lengths,
                                const uint8_t* const* data);
+    // writeClipboardProvideCompressed() sends data that has already
+    // been compressed, e.g. by a ClipboardWorker
+    void writeClipboardProvideCompressed(uint32_t flags,
+                                         const uint8_t* data, size_t len);
 
     // writeFence() sends a new fence request or response to the client.
     void writeFence(uint32_t flags, unsigned len, const uint8_t data[]);
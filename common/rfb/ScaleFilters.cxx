@@ -69,7 +69,7 @@ SFilter &ScaleFilters::operator[](unsigned int filter_id) {
   return filters[filter_id];
 }
 
-int ScaleFilters::getFilterIdByName(char *filterName) {
+int ScaleFilters::getFilterIdByName(const char *filterName) {
   for (unsigned int i = 0; i <= scaleFilterMaxNumber; i++) {
     if (strcasecmp(filters[i].name, filterName) == 0) return i;
   }
@@ -125,5 +125,17 @@ void ScaleFilters::makeWeightTabs(int filter_id, int src_x, int dst_x, SFilterWe
     for (ci = 0, i = i0; i < i1; i++) {
       weightTabs[x].weight[ci++] = (short)floor((sFilter.func((double(i)-sxc+0.5)/sourceScale) * nc) + 0.5);
     }
+
+    // Rounding each weight on its own can make them add up to more
+    // than one, which can push the results out of range. Give
+    // any difference to the largest weight.
+    int total = 0, largest = 0;
+    for (ci = 0; ci < i1 - i0; ci++) {
+      total += weightTabs[x].weight[ci];
+      if (weightTabs[x].weight[ci] > weightTabs[x].weight[largest])
+        largest = ci;
+    }
+    if (i1 > i0)
+      weightTabs[x].weight[largest] += WEIGHT_OF_ONE - total;
   }
 }
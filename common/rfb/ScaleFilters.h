@@ -22,6 +22,11 @@
 //  
 // 
 
+#ifndef __RFB_SCALEFILTERS_H__
+#define __RFB_SCALEFILTERS_H__
+
+#include <rfb/Rect.h>
+
 namespace rfb {
 
   #define SCALE_ERROR (1e-7)
@@ -66,7 +71,7 @@ namespace rfb {
 
     SFilter &operator[](unsigned int filter_id);
 
-    int getFilterIdByName(char *filterName);
+    int getFilterIdByName(const char *filterName);
 
     void makeWeightTabs(int filter, int src_x, int dst_x, SFilterWeightTab **weightTabs);
 
@@ -79,3 +84,5 @@ namespace rfb {
   };
 
 };
+
+#endif
@@ -0,0 +1,316 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <rfb/PixelFormatSIMD.h>
+#include <rfb/ScaledPixelBuffer.h>
+
+using namespace rfb;
+
+// The horizontal pass keeps this many extra bits of precision for the
+// vertical pass, which still lets the values fit in 16 bits as long as
+// the weights add up to one. The values are saturated anyway, the same
+// way the vectorised code does it.
+static const int rowBits = 7;
+static const int rowShift = BITS_OF_WEIGHT - rowBits;
+static const int finalShift = BITS_OF_WEIGHT + rowBits;
+
+static void freeWeightTabs(SFilterWeightTab* tabs, int count)
+{
+  for (int i = 0; i < count; i++)
+    delete [] tabs[i].weight;
+  delete [] tabs;
+}
+
+// Finds the first entry where the filter interval ends after pos
+static int firstEndingAfter(const SFilterWeightTab* tabs, int count,
+                            int pos)
+{
+  int low, high;
+
+  low = 0;
+  high = count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (tabs[mid].i1 > pos)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  return low;
+}
+
+// Finds the first entry where the filter interval starts at or after pos
+static int firstStartingAt(const SFilterWeightTab* tabs, int count,
+                           int pos)
+{
+  int low, high;
+
+  low = 0;
+  high = count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (tabs[mid].i0 >= pos)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  return low;
+}
+
+ScaledPixelBuffer::ScaledPixelBuffer(const PixelBuffer* src_,
+                                     int width, int height,
+                                     unsigned int filter,
+                                     uint8_t* data, int stride)
+  : FullFramePixelBuffer(src_->getPF(), 0, 0, NULL, 0),
+    src(src_), ownedData(NULL), xWeights(NULL), yWeights(NULL),
+    maxRows(0), direct(false), channels(3)
+{
+  ScaleFilters filters;
+
+  assert(filter <= scaleFilterMaxNumber);
+
+  if (data == NULL) {
+    ownedData = new uint8_t[width * height * (getPF().bpp / 8)];
+    data = ownedData;
+    stride = width;
+  }
+
+  setBuffer(width, height, data, stride);
+
+  filters.makeWeightTabs(filter, src->width(), width, &xWeights);
+  filters.makeWeightTabs(filter, src->height(), height, &yWeights);
+
+  for (int y = 0; y < height; y++) {
+    if (yWeights[y].i1 - yWeights[y].i0 > maxRows)
+      maxRows = yWeights[y].i1 - yWeights[y].i0;
+  }
+
+  if (getPF().is888()) {
+    direct = true;
+    channels = 4;
+  }
+
+  srcRow.resize(src->width() * channels);
+  rows.resize(maxRows * width * channels);
+  rowTags.resize(maxRows);
+  rowPtrs.resize(maxRows);
+  dstRow.resize(width * channels);
+
+  invalid = getRect();
+}
+
+ScaledPixelBuffer::~ScaledPixelBuffer()
+{
+  freeWeightTabs(xWeights, width());
+  freeWeightTabs(yWeights, height());
+  delete [] ownedData;
+}
+
+Region ScaledPixelBuffer::scaleRegion(const Region& region) const
+{
+  Region scaled;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+
+  region.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i)
+    scaled.assign_union(affectedRect(*i));
+
+  return scaled;
+}
+
+Point ScaledPixelBuffer::scalePoint(const Point& p) const
+{
+  // Use the pixel that covers the middle of the source pixel
+  return Point((2 * p.x + 1) * width() / (2 * src->width()),
+               (2 * p.y + 1) * height() / (2 * src->height()));
+}
+
+Point ScaledPixelBuffer::unscalePoint(const Point& p) const
+{
+  Point unscaled;
+
+  // Aim for the middle of the source area the pixel covers
+  unscaled.x = (2 * p.x + 1) * src->width() / (2 * width());
+  unscaled.y = (2 * p.y + 1) * src->height() / (2 * height());
+
+  unscaled.x = __rfbmax(0, __rfbmin(unscaled.x, src->width() - 1));
+  unscaled.y = __rfbmax(0, __rfbmin(unscaled.y, src->height() - 1));
+
+  return unscaled;
+}
+
+void ScaledPixelBuffer::invalidate(const Region& region)
+{
+  invalid.assign_union(region);
+}
+
+void ScaledPixelBuffer::refresh()
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+
+  invalid.assign_intersect(getRect());
+  invalid.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i)
+    recompute(*i);
+
+  invalid.clear();
+}
+
+Rect ScaledPixelBuffer::affectedRect(const Rect& r) const
+{
+  Rect scaled;
+
+  scaled.tl.x = firstEndingAfter(xWeights, width(), r.tl.x);
+  scaled.tl.y = firstEndingAfter(yWeights, height(), r.tl.y);
+  scaled.br.x = firstStartingAt(xWeights, width(), r.br.x);
+  scaled.br.y = firstStartingAt(yWeights, height(), r.br.y);
+
+  if (scaled.is_empty())
+    return Rect();
+
+  return scaled;
+}
+
+void ScaledPixelBuffer::recompute(const Rect& r)
+{
+  uint8_t* buffer;
+  int stride, bpp;
+
+  // The horizontal pass is done once for each source row, and then
+  // kept around as long as it is needed for the vertical pass
+
+  for (int i = 0; i < maxRows; i++)
+    rowTags[i] = -1;
+
+  buffer = getBufferRW(r, &stride);
+  bpp = getPF().bpp / 8;
+
+  for (int y = r.tl.y; y < r.br.y; y++) {
+    const SFilterWeightTab* yTab;
+    int taps;
+    uint8_t* out;
+
+    yTab = &yWeights[y];
+    taps = yTab->i1 - yTab->i0;
+
+    for (int i = 0; i < taps; i++) {
+      int sy, slot;
+
+      sy = yTab->i0 + i;
+      slot = sy % maxRows;
+
+      rowPtrs[i] = &rows[(slot * width() + r.tl.x) * channels];
+
+      if (rowTags[slot] == sy)
+        continue;
+
+      filterRow(&rows[slot * width() * channels], sy, r.tl.x, r.br.x);
+      rowTags[slot] = sy;
+    }
+
+    out = direct ? buffer : &dstRow[0];
+
+    if (!simdFilterColumns(out, &rowPtrs[0], yTab->weight, taps,
+                           r.width() * channels)) {
+      for (int i = 0; i < r.width() * channels; i++) {
+        int sum;
+
+        sum = 0;
+        for (int k = 0; k < taps; k++)
+          sum += yTab->weight[k] * rowPtrs[k][i];
+
+        sum = (sum + (1 << (finalShift - 1))) >> finalShift;
+        if (sum < 0)
+          sum = 0;
+        else if (sum > 255)
+          sum = 255;
+
+        out[i] = sum;
+      }
+    }
+
+    if (!direct)
+      getPF().bufferFromRGB(buffer, &dstRow[0], r.width());
+
+    buffer += stride * bpp;
+  }
+
+  commitBufferRW(r);
+}
+
+// filterRow() applies the horizontal pass to source row y, for the
+// columns between x0 and x1 of this buffer
+
+void ScaledPixelBuffer::filterRow(int16_t* row, int y, int x0, int x1)
+{
+  int srcX, srcWidth;
+  const uint8_t* data;
+  int stride;
+
+  srcX = xWeights[x0].i0;
+  srcWidth = xWeights[x1 - 1].i1 - srcX;
+
+  data = src->getBuffer(Rect(srcX, y, srcX + srcWidth, y + 1), &stride);
+
+  if (direct) {
+    if (simdFilterRow32(row + x0 * 4, data, srcX, &xWeights[x0], x1 - x0))
+      return;
+  } else {
+    src->getPF().rgbFromBuffer(&srcRow[0], data, srcWidth);
+    data = &srcRow[0];
+  }
+
+  for (int x = x0; x < x1; x++) {
+    const SFilterWeightTab* xTab;
+    const uint8_t* in;
+
+    xTab = &xWeights[x];
+
+    for (int c = 0; c < channels; c++) {
+      int sum;
+
+      in = data + (xTab->i0 - srcX) * channels + c;
+
+      sum = 0;
+      for (int i = 0; i < xTab->i1 - xTab->i0; i++) {
+        sum += xTab->weight[i] * *in;
+        in += channels;
+      }
+
+      sum = (sum + (1 << (rowShift - 1))) >> rowShift;
+      if (sum < INT16_MIN)
+        sum = INT16_MIN;
+      else if (sum > INT16_MAX)
+        sum = INT16_MAX;
+
+      row[x * channels + c] = sum;
+    }
+  }
+}
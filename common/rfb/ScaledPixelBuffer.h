@@ -0,0 +1,94 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ScaledPixelBuffer - a scaled down copy of another pixel buffer
+//
+// The copy is not kept up to date automatically. Changed areas of the
+// source have to be mapped using scaleRegion() and then marked using
+// invalidate(), after which refresh() will recompute them from the
+// source.
+//
+
+#ifndef __RFB_SCALEDPIXELBUFFER_H__
+#define __RFB_SCALEDPIXELBUFFER_H__
+
+#include <vector>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/Region.h>
+#include <rfb/ScaleFilters.h>
+
+namespace rfb {
+
+  class ScaledPixelBuffer : public FullFramePixelBuffer {
+  public:
+    // filter is one of the scaleFilter* constants. The source must
+    // stay valid, and keep the same size and format, for as long as
+    // this object exists. The scaled pixels are stored in data if it
+    // is given, or in memory allocated by this object otherwise.
+    ScaledPixelBuffer(const PixelBuffer* src, int width, int height,
+                      unsigned int filter,
+                      uint8_t* data=NULL, int stride=0);
+    virtual ~ScaledPixelBuffer();
+
+    const PixelBuffer* getSource() const { return src; }
+
+    // Returns the area of this buffer that depends on the given area
+    // of the source
+    Region scaleRegion(const Region& region) const;
+
+    // Convert coordinates between the source and this buffer
+    Point scalePoint(const Point& p) const;
+    Point unscalePoint(const Point& p) const;
+
+    // invalidate() marks an area of this buffer as needing to be
+    // recomputed, and refresh() does so for all such areas
+    void invalidate(const Region& region);
+    void refresh();
+
+  private:
+    Rect affectedRect(const Rect& r) const;
+    void recompute(const Rect& r);
+    void filterRow(int16_t* row, int y, int x0, int x1);
+
+  private:
+    const PixelBuffer* src;
+    uint8_t* ownedData;
+
+    SFilterWeightTab* xWeights;
+    SFilterWeightTab* yWeights;
+    int maxRows;
+
+    // 32-bit pixels with 8-bit channels can be filtered as they are,
+    // everything else goes via 24-bit RGB
+    bool direct;
+    int channels;
+
+    Region invalid;
+
+    std::vector<uint8_t> srcRow;
+    std::vector<int16_t> rows;
+    std::vector<int> rowTags;
+    std::vector<const int16_t*> rowPtrs;
+    std::vector<uint8_t> dstRow;
+  };
+
+}
+
+#endif
@@ -54,6 +54,54 @@ rfb::IntParameter rfb::Server::frameRate
 ("FrameRate",
  "The maximum number of updates per second sent to each client",
  60);
+rfb::IntParameter rfb::Server::encoderIdleTimeout
+("EncoderIdleTimeout",
+ "The number of seconds after which an unused encoder for a connection "
+ "is released to save memory (zero means never)",
+ 60, 0);
+
+rfb::IntParameter rfb::Server::contentCacheSize
+("ContentCacheSize",
+ "The largest content cache, in MiB, that viewers are asked to fill "
+ "with repeated screen content (zero disables the cache)",
+ 256, 0);
+rfb::BoolParameter rfb::Server::adaptiveCompressLevel
+("AdaptiveCompressLevel",
+ "Use a lower compression level than the client asked for when the "
+ "connection is fast enough that compressing is the bottleneck",
+ true);
+rfb::BoolParameter rfb::Server::zstdLongDistance
+("ZstdLongDistance",
+ "Let the ZstdRLE encoding find matches up to 16 MiB back at compression "
+ "level 6 and above, at the cost of much more memory per client",
+ false);
+rfb::IntParameter rfb::Server::roiQualityBoost
+("ROIQualityBoost",
+ "How many quality levels better to send the area around the pointer and "
+ "recent typing, while the rest of the screen gets half as many levels "
+ "worse. Anything above the top level is sent losslessly (zero disables "
+ "this)",
+ 2, 0, 10);
+rfb::IntParameter rfb::Server::scaleFactor
+("ScaleFactor",
+ "Percentage of the real framebuffer size that clients will see, "
+ "with the framebuffer scaled down accordingly",
+ 100, 1, 100);
+rfb::StringParameter rfb::Server::scaleFilter
+("ScaleFilter",
+ "Filter to use when scaling the framebuffer (Nearest neighbor, "
+ "Bilinear or Bicubic)",
+ "Bilinear");
+rfb::StringParameter rfb::Server::recordSession
+("RecordSession",
+ "Record all screen updates to this file, in a format suitable for the "
+ "performance tests",
+ "");
+rfb::IntParameter rfb::Server::recordSessionBuffer
+("RecordSessionBuffer",
+ "Maximum amount of memory (in MiB) used for updates waiting to be "
+ "recorded. Updates are merged when this is exceeded",
+ 64, 1);
 rfb::BoolParameter rfb::Server::protocol3_3
 ("Protocol3.3",
  "Always use protocol version 3.3 for backwards compatibility with "
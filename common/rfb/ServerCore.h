@@ -37,6 +37,15 @@ namespace rfb {
     static IntParameter maxIdleTime;
     static IntParameter compareFB;
     static IntParameter frameRate;
+    static IntParameter encoderIdleTimeout;
+    static IntParameter contentCacheSize;
+    static BoolParameter adaptiveCompressLevel;
+    static BoolParameter zstdLongDistance;
+    static IntParameter roiQualityBoost;
+    static IntParameter scaleFactor;
+    static StringParameter scaleFilter;
+    static StringParameter recordSession;
+    static IntParameter recordSessionBuffer;
     static BoolParameter protocol3_3;
     static BoolParameter alwaysShared;
     static BoolParameter neverShared;
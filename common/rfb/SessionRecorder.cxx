@@ -0,0 +1,310 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include <os/Mutex.h>
+
+#include <rdr/Exception.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/EncodeManager.h>
+#include <rfb/LogWriter.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SConnection.h>
+#include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
+#include <rfb/SessionRecorder.h>
+#include <rfb/Tracer.h>
+#include <rfb/encodings.h>
+
+using namespace rfb;
+
+static LogWriter vlog("SessionRecorder");
+
+static const int32_t encodings[] = {
+  encodingZRLE, pseudoEncodingLastRect,
+  pseudoEncodingCompressLevel0 + 6 };
+
+struct SessionRecorder::Frame {
+  Region region;
+  std::vector<uint8_t> data;
+};
+
+namespace rfb {
+
+  // The encoder needs a connection to write to, but we only care about
+  // what would have been written to the socket
+
+  class RecorderConnection : public SConnection {
+  public:
+    RecorderConnection(const PixelBuffer* pb);
+    virtual ~RecorderConnection();
+
+    void writeUpdate(const Region& changed, const PixelBuffer* pb);
+
+    rdr::MemOutStream* getBuffer() { return &buffer; }
+
+    virtual void setDesktopSize(int, int, const ScreenSet&) {}
+
+  private:
+    class Manager : public EncodeManager {
+    public:
+      Manager(SConnection* conn) : EncodeManager(conn) {}
+
+      // Calls doUpdate() directly as writeUpdate() uses timers, which
+      // aren't safe to use from another thread
+      void writeUpdate(const Region& changed, const PixelBuffer* pb) {
+        doUpdate(false, changed, Region(), Point(), pb, NULL);
+      }
+    };
+
+    rdr::MemOutStream buffer;
+    Manager* manager;
+  };
+
+}
+
+RecorderConnection::RecorderConnection(const PixelBuffer* pb)
+{
+  setStreams(NULL, &buffer);
+  setWriter(new SMsgWriter(&client, &buffer));
+
+  client.setDimensions(pb->width(), pb->height());
+  client.setPF(pb->getPF());
+  setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+
+  manager = new Manager(this);
+
+  // It runs on the recording thread, so keep it apart from the main
+  // thread in the trace
+  if (Tracer::isEnabled())
+    manager->setTraceTrack(Tracer::newTrack("Recorder thread"));
+}
+
+RecorderConnection::~RecorderConnection()
+{
+  delete manager;
+}
+
+void RecorderConnection::writeUpdate(const Region& changed,
+                                     const PixelBuffer* pb)
+{
+  manager->writeUpdate(changed, pb);
+}
+
+SessionRecorder::SessionRecorder(const char* filename_,
+                                 const PixelBuffer* pb)
+  : filename(filename_), file(NULL), shadow(NULL), conn(NULL),
+    queuedBytes(0), stopRequested(false), failed(false),
+    frames(0), mergedFrames(0), writtenBytes(0)
+{
+  char str[256];
+
+  file = fopen(filename.c_str(), "wb");
+  if (file == NULL)
+    throw rdr::SystemException(filename.c_str(), errno);
+
+  maxQueuedBytes = (size_t)Server::recordSessionBuffer * 1024 * 1024;
+
+  shadow = new ManagedPixelBuffer(pb->getPF(), pb->width(), pb->height());
+  conn = new RecorderConnection(pb);
+
+  queueMutex = new os::Mutex();
+  queueCond = new os::Condition(queueMutex);
+
+  // The first frame needs to contain everything
+  droppedRegion = pb->getRect();
+
+  pb->getPF().print(str, sizeof(str));
+  vlog.info("Recording session to %s", filename.c_str());
+  vlog.info("Recording is %dx%d, %s", pb->width(), pb->height(), str);
+
+  start();
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  {
+    os::AutoMutex a(queueMutex);
+    stopRequested = true;
+    queueCond->signal();
+  }
+
+  wait();
+
+  vlog.info("Recorded %u updates (%u merged) and %llu bytes to %s",
+            frames, mergedFrames, writtenBytes, filename.c_str());
+
+  if (fclose(file) != 0)
+    vlog.error("Failed to close %s: %s", filename.c_str(), strerror(errno));
+
+  // Only happens if we fail writing
+  while (!queue.empty()) {
+    delete queue.front();
+    queue.pop_front();
+  }
+
+  delete queueCond;
+  delete queueMutex;
+
+  delete conn;
+  delete shadow;
+}
+
+bool SessionRecorder::isCompatible(const PixelBuffer* pb)
+{
+  if (pb->getRect() != shadow->getRect())
+    return false;
+  if (pb->getPF() != shadow->getPF())
+    return false;
+  return true;
+}
+
+void SessionRecorder::addUpdate(const Region& changed,
+                                const PixelBuffer* pb)
+{
+  Frame* frame;
+  Region region;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+  size_t size, bpp;
+  uint8_t* buffer;
+
+  region = changed.union_(droppedRegion);
+  region.assign_intersect(shadow->getRect());
+  if (region.is_empty())
+    return;
+
+  bpp = pb->getPF().bpp/8;
+
+  region.get_rects(&rects);
+  size = 0;
+  for (rect = rects.begin(); rect != rects.end(); ++rect)
+    size += rect->area() * bpp;
+
+  {
+    os::AutoMutex a(queueMutex);
+
+    if (failed)
+      return;
+
+    // Rather than blocking, or growing the queue without bounds, we
+    // fold this update into the next one. The thread will always
+    // accept something if it is idle though so we don't stall
+    // completely on updates bigger than the limit.
+    if (!queue.empty() && (queuedBytes + size > maxQueuedBytes)) {
+      droppedRegion = region;
+      mergedFrames++;
+      return;
+    }
+
+    queuedBytes += size;
+  }
+
+  droppedRegion.clear();
+
+  frame = new Frame;
+  frame->region = region;
+  frame->data.resize(size);
+
+  buffer = &frame->data[0];
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    pb->getImage(buffer, *rect);
+    buffer += rect->area() * bpp;
+  }
+
+  os::AutoMutex a(queueMutex);
+  queue.push_back(frame);
+  queueCond->signal();
+}
+
+void SessionRecorder::worker()
+{
+  queueMutex->lock();
+
+  while (true) {
+    Frame* frame;
+
+    if (queue.empty()) {
+      if (stopRequested)
+        break;
+      queueCond->wait();
+      continue;
+    }
+
+    frame = queue.front();
+    queue.pop_front();
+
+    queueMutex->unlock();
+
+    try {
+      writeFrame(frame);
+    } catch (rdr::Exception& e) {
+      vlog.error("Failed to record update: %s", e.str());
+      queueMutex->lock();
+      failed = true;
+      queuedBytes -= frame->data.size();
+      delete frame;
+      break;
+    }
+
+    queueMutex->lock();
+
+    queuedBytes -= frame->data.size();
+    delete frame;
+  }
+
+  queueMutex->unlock();
+}
+
+void SessionRecorder::writeFrame(Frame* frame)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+  const uint8_t* buffer;
+  size_t bpp;
+  rdr::MemOutStream* out;
+
+  bpp = shadow->getPF().bpp/8;
+
+  frame->region.get_rects(&rects);
+  buffer = &frame->data[0];
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    shadow->imageRect(*rect, buffer);
+    buffer += rect->area() * bpp;
+  }
+
+  out = conn->getBuffer();
+  out->clear();
+
+  conn->writeUpdate(frame->region, shadow);
+
+  if (fwrite(out->data(), out->length(), 1, file) != 1)
+    throw rdr::SystemException(filename.c_str(), errno);
+
+  frames++;
+  writtenBytes += out->length();
+}
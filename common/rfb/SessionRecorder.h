@@ -0,0 +1,99 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// SessionRecorder - records screen updates to a file
+//
+// The file contains the raw server to client protocol after the
+// ServerInit message, i.e. the same format as is read by the
+// performance tests. Updates are encoded using ZRLE on a separate
+// thread. The main thread only makes a copy of the changed pixels,
+// and if the thread falls behind then updates are merged rather than
+// queued so memory usage stays bounded.
+//
+
+#ifndef __RFB_SESSIONRECORDER_H__
+#define __RFB_SESSIONRECORDER_H__
+
+#include <stdio.h>
+
+#include <list>
+#include <string>
+
+#include <os/Thread.h>
+
+#include <rfb/Region.h>
+
+namespace os {
+  class Condition;
+  class Mutex;
+}
+
+namespace rfb {
+
+  class PixelBuffer;
+  class ManagedPixelBuffer;
+
+  class SessionRecorder : public os::Thread {
+  public:
+    // The recorder will start by recording the entire contents of pb.
+    // The size of the frame buffer must not change during the
+    // recording.
+    SessionRecorder(const char* filename, const PixelBuffer* pb);
+    virtual ~SessionRecorder();
+
+    // isCompatible() checks if pb can still be used for this recording
+    bool isCompatible(const PixelBuffer* pb);
+
+    // addUpdate() queues the specified region of pb for recording.
+    // It never blocks waiting for the recording thread.
+    void addUpdate(const Region& changed, const PixelBuffer* pb);
+
+  protected:
+    virtual void worker();
+
+  private:
+    struct Frame;
+
+    void writeFrame(Frame* frame);
+
+  private:
+    std::string filename;
+    FILE* file;
+
+    ManagedPixelBuffer* shadow;
+    class RecorderConnection* conn;
+
+    os::Mutex* queueMutex;
+    os::Condition* queueCond;
+
+    std::list<Frame*> queue;
+    size_t queuedBytes;
+    size_t maxQueuedBytes;
+    bool stopRequested;
+    bool failed;
+
+    Region droppedRegion;
+
+    unsigned frames, mergedFrames;
+    unsigned long long writtenBytes;
+  };
+
+}
+
+#endif
@@ -61,7 +61,7 @@ static const TightConf conf[10] = {
 };
 
 TightEncoder::TightEncoder(SConnection* conn) :
-  Encoder(conn, encodingTight, EncoderPlain, 256)
+  Encoder(conn, encodingTight, EncoderPlain, 256), pendingResets(0)
 {
   setCompressLevel(-1);
 }
@@ -75,6 +75,23 @@ bool TightEncoder::isSupported()
   return conn->client.supportsEncoding(encodingTight);
 }
 
+size_t TightEncoder::getMemoryUsage()
+{
+  size_t usage;
+  int i;
+
+  usage = 0;
+  for (i = 0; i < 4; i++)
+    usage += zlibStreams[i].getMemoryUsage();
+
+  return usage;
+}
+
+void TightEncoder::resetStreams()
+{
+  pendingResets = 0x0f;
+}
+
 void TightEncoder::setCompressLevel(int level)
 {
   if (level < 0 || level > 9)
@@ -171,7 +188,7 @@ void TightEncoder::writeFullColourRect(const PixelBuffer* pb)
 
   os = conn->getOutStream();
 
-  os->writeU8(streamId << 4);
+  os->writeU8(streamId << 4 | getStreamReset(streamId));
 
   // Set up compression
   if ((pb->getPF().bpp != 32) || !pb->getPF().is888())
@@ -237,6 +254,19 @@ void TightEncoder::writeCompact(rdr::OutStream* os, uint32_t value)
   }
 }
 
+uint8_t TightEncoder::getStreamReset(int streamId)
+{
+  uint8_t bit;
+
+  bit = 1 << streamId;
+  if (!(pendingResets & bit))
+    return 0;
+
+  pendingResets &= ~bit;
+
+  return bit;
+}
+
 rdr::OutStream* TightEncoder::getZlibOutStream(int streamId, int level, size_t length)
 {
   // Minimum amount of data to be compressed. This value should not be
@@ -292,7 +322,8 @@ void TightEncoder::writeMonoRect(int width, int height,
 
   os = conn->getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  os->writeU8((streamId | tightExplicitFilter) << 4 |
+              getStreamReset(streamId));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -379,7 +410,8 @@ void TightEncoder::writeIndexedRect(int width, int height,
 
   os = conn->getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  os->writeU8((streamId | tightExplicitFilter) << 4 |
+              getStreamReset(streamId));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
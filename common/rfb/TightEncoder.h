@@ -35,6 +35,13 @@ namespace rfb {
 
     virtual void setCompressLevel(int level);
 
+    virtual size_t getMemoryUsage();
+
+    // resetStreams() makes the encoder tell the client to reset each
+    // zlib stream before it is next used. Needed when this encoder
+    // replaces another one on the same connection.
+    void resetStreams();
+
     virtual void writeRect(const PixelBuffer* pb, const Palette& palette);
     virtual void writeSolidRect(int width, int height,
                                 const PixelFormat& pf,
@@ -50,6 +57,7 @@ namespace rfb {
 
     void writeCompact(rdr::OutStream* os, uint32_t value);
 
+    uint8_t getStreamReset(int streamId);
     rdr::OutStream* getZlibOutStream(int streamId, int level, size_t length);
     void flushZlibOutStream(rdr::OutStream* os);
 
@@ -67,6 +75,8 @@ namespace rfb {
     rdr::ZlibOutStream zlibStreams[4];
     rdr::MemOutStream memStream;
 
+    unsigned pendingResets;
+
     int idxZlibLevel, monoZlibLevel, rawZlibLevel;
   };
 
@@ -70,7 +70,8 @@ static const struct TightJPEGConfiguration conf[10] = {
 
 TightJPEGEncoder::TightJPEGEncoder(SConnection* conn) :
   Encoder(conn, encodingTight,
-          (EncoderFlags)(EncoderUseNativePF | EncoderLossy), -1, 9),
+          (EncoderFlags)(EncoderUseNativePF | EncoderLossy), -1,
+          losslessQualityLevel),
   qualityLevel(-1), fineQuality(-1), fineSubsampling(subsampleUndefined)
 {
 }
@@ -81,15 +82,20 @@ TightJPEGEncoder::~TightJPEGEncoder()
 
 bool TightJPEGEncoder::isSupported()
 {
-  if (!conn->client.supportsEncoding(encodingTight))
+  return clientSupportsJPEG(conn->client);
+}
+
+bool TightJPEGEncoder::clientSupportsJPEG(const ClientParams& client)
+{
+  if (!client.supportsEncoding(encodingTight))
     return false;
 
   // Any one of these indicates support for JPEG
-  if (conn->client.qualityLevel != -1)
+  if (client.qualityLevel != -1)
     return true;
-  if (conn->client.fineQualityLevel != -1)
+  if (client.fineQualityLevel != -1)
     return true;
-  if (conn->client.subsampling != -1)
+  if (client.subsampling != -1)
     return true;
 
   // Tight support, but not JPEG
@@ -25,6 +25,8 @@
 
 namespace rfb {
 
+  class ClientParams;
+
   class TightJPEGEncoder : public Encoder {
   public:
     TightJPEGEncoder(SConnection* conn);
@@ -32,6 +34,13 @@ namespace rfb {
 
     virtual bool isSupported();
 
+    // clientSupportsJPEG() is the same check as isSupported(), but
+    // without needing an encoder instance
+    static bool clientSupportsJPEG(const ClientParams& client);
+
+    // Quality level that is considered lossless
+    static const int losslessQualityLevel = 9;
+
     virtual void setQualityLevel(int level);
     virtual void setFineQualityLevel(int quality, int subsampling);
 
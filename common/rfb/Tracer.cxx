@@ -0,0 +1,341 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <os/Mutex.h>
+
+#include <rfb/Configuration.h>
+#include <rfb/LogWriter.h>
+#include <rfb/Tracer.h>
+#include <rfb/util.h>
+
+using namespace rfb;
+
+static LogWriter vlog("Tracer");
+
+static StringParameter latencyTrace("LatencyTrace",
+                                    "Record the latency of each stage of "
+                                    "the update pipeline and write it to "
+                                    "this file in Chrome trace format",
+                                    "");
+static IntParameter latencyTraceEvents("LatencyTraceEvents",
+                                       "Number of events kept in the "
+                                       "latency trace ring buffer of "
+                                       "each thread",
+                                       65536, 1024, 16777216);
+
+struct Tracer::Event {
+  uint64_t start;
+  uint32_t duration;
+  uint32_t frame;
+  int32_t arg;
+  uint16_t stage;
+  uint16_t track;
+};
+
+struct Tracer::Buffer {
+  Buffer() : events(0), written(0) {}
+
+  os::Mutex mutex;
+  Event* events;
+  uint64_t written;
+};
+
+std::atomic<bool> Tracer::enabled(false);
+std::atomic<uint32_t> Tracer::frame(0);
+std::vector<Tracer::Buffer*> Tracer::buffers;
+
+static os::Mutex mutex;
+static int users = 0;
+static std::string filename;
+static size_t capacity = 0;
+static std::vector<std::string> tracks(1, "Main thread");
+
+static const char* stageName(TraceStage stage)
+{
+  switch (stage) {
+  case traceDamage:
+    return "Damage";
+  case traceGrab:
+    return "Grab";
+  case traceCompare:
+    return "Compare";
+  case traceEncodeRect:
+    return "Encode rect";
+  case traceUpdate:
+    return "Update";
+  case traceFlush:
+    return "Flush";
+  case traceDecodeRead:
+    return "Read rect";
+  case traceDecodeRect:
+    return "Decode rect";
+  case tracePresent:
+    return "Present";
+  case traceStageMax:
+    break;
+  }
+
+  return "Unknown";
+}
+
+static const char* argName(TraceStage stage)
+{
+  switch (stage) {
+  case traceDamage:
+  case traceGrab:
+    return "rects";
+  case traceCompare:
+    return "changed";
+  case traceEncodeRect:
+  case traceUpdate:
+  case traceFlush:
+  case traceDecodeRead:
+    return "bytes";
+  case traceDecodeRect:
+    return "encoding";
+  case tracePresent:
+    return "pixels";
+  case traceStageMax:
+    break;
+  }
+
+  return "arg";
+}
+
+static std::string escape(const std::string& str)
+{
+  std::string out;
+  std::string::const_iterator iter;
+
+  for (iter = str.begin(); iter != str.end(); ++iter) {
+    if ((*iter == '"') || (*iter == '\\'))
+      out += '\\';
+    if ((unsigned char)*iter < 0x20)
+      continue;
+    out += *iter;
+  }
+
+  return out;
+}
+
+void Tracer::init()
+{
+  os::AutoMutex a(&mutex);
+
+  users++;
+
+  if (isEnabled())
+    return;
+  if (strlen(latencyTrace) == 0)
+    return;
+
+  filename = (const char*)latencyTrace;
+  capacity = latencyTraceEvents;
+  // Publishes capacity to the threads that check enabled in record()
+  enabled.store(true, std::memory_order_release);
+
+  vlog.info("Recording latency trace to %s", filename.c_str());
+}
+
+void Tracer::finish()
+{
+  std::vector<Buffer*>::iterator iter;
+
+  // Everything is done with the lock held so that a new init() cannot
+  // sneak in whilst we are tearing down the buffers
+  os::AutoMutex a(&mutex);
+
+  if (users > 0)
+    users--;
+  if (users > 0)
+    return;
+
+  if (!isEnabled())
+    return;
+
+  if (!write(filename.c_str()))
+    vlog.error("Failed to write latency trace to %s", filename.c_str());
+  else
+    vlog.info("Latency trace written to %s", filename.c_str());
+
+  enabled.store(false, std::memory_order_relaxed);
+
+  for (iter = buffers.begin(); iter != buffers.end(); ++iter) {
+    os::AutoMutex b(&(*iter)->mutex);
+    delete [] (*iter)->events;
+    (*iter)->events = 0;
+    (*iter)->written = 0;
+  }
+}
+
+uint64_t Tracer::now()
+{
+  if (!isEnabled())
+    return 0;
+
+  return usMonotonic();
+}
+
+unsigned Tracer::newTrack(const char* name)
+{
+  os::AutoMutex a(&mutex);
+
+  // The track field is 16 bits, so just reuse the last one if we
+  // somehow manage to run out
+  if (tracks.size() >= 0xffff)
+    return tracks.size() - 1;
+
+  tracks.push_back(name);
+
+  return tracks.size() - 1;
+}
+
+uint32_t Tracer::nextFrame()
+{
+  return frame.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+Tracer::Buffer* Tracer::threadBuffer()
+{
+  static __thread Buffer* buffer = 0;
+
+  if (buffer != 0)
+    return buffer;
+
+  buffer = new Buffer;
+
+  os::AutoMutex a(&mutex);
+  buffers.push_back(buffer);
+
+  return buffer;
+}
+
+void Tracer::record(TraceStage stage, unsigned track, uint32_t frame,
+                    uint64_t start, uint64_t end, int32_t arg)
+{
+  Buffer* buffer;
+  Event* event;
+
+  if (!enabled.load(std::memory_order_acquire))
+    return;
+
+  buffer = threadBuffer();
+
+  // Only contended by dump() and finish()
+  os::AutoMutex a(&buffer->mutex);
+
+  // Might have been stopped whilst we were waiting
+  if (!isEnabled())
+    return;
+
+  if (buffer->events == 0)
+    buffer->events = new Event[capacity];
+
+  event = &buffer->events[buffer->written % capacity];
+  buffer->written++;
+
+  event->start = start;
+  event->duration = end > start ? end - start : 0;
+  event->frame = frame;
+  event->arg = arg;
+  event->stage = stage;
+  event->track = track;
+}
+
+bool Tracer::dump(const char* filename)
+{
+  os::AutoMutex a(&mutex);
+
+  if (!isEnabled())
+    return false;
+
+  return write(filename);
+}
+
+bool Tracer::write(const char* filename)
+{
+  FILE* f;
+  size_t t;
+  std::vector<Buffer*>::iterator iter;
+
+  // Caller must hold the global lock
+
+  f = fopen(filename, "w");
+  if (f == NULL)
+    return false;
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  for (t = 0; t < tracks.size(); t++) {
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            t == 0 ? "" : ",\n", (unsigned)t, escape(tracks[t]).c_str());
+  }
+
+  for (iter = buffers.begin(); iter != buffers.end(); ++iter) {
+    Buffer* buffer;
+    uint64_t first, i;
+
+    buffer = *iter;
+
+    os::AutoMutex b(&buffer->mutex);
+
+    if (buffer->events == 0)
+      continue;
+
+    if (buffer->written > capacity)
+      first = buffer->written - capacity;
+    else
+      first = 0;
+
+    for (i = first; i < buffer->written; i++) {
+      const Event* event;
+
+      event = &buffer->events[i % capacity];
+
+      fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"rfb\",\"pid\":1,"
+                 "\"tid\":%u,\"ts\":%llu,",
+              stageName((TraceStage)event->stage), (unsigned)event->track,
+              (unsigned long long)event->start);
+      if (event->duration == 0)
+        fprintf(f, "\"ph\":\"i\",\"s\":\"t\",");
+      else
+        fprintf(f, "\"ph\":\"X\",\"dur\":%u,", (unsigned)event->duration);
+      fprintf(f, "\"args\":{\"frame\":%u,\"%s\":%d}}",
+              (unsigned)event->frame, argName((TraceStage)event->stage),
+              (int)event->arg);
+    }
+  }
+
+  fprintf(f, "\n]}\n");
+
+  if (fclose(f) != 0)
+    return false;
+
+  return true;
+}
@@ -0,0 +1,113 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// Tracer - low overhead latency tracing of the update pipeline
+//
+// Events are stored in a fixed size binary ring buffer for each
+// thread, so only the most recent ones are kept and threads never
+// have to wait for each other. The buffers can be written out in the
+// Chrome trace event format (chrome://tracing or ui.perfetto.dev).
+//
+// Tracing is disabled unless the LatencyTrace parameter is set, in
+// which case the trace is written to that file when the last user
+// calls finish().
+//
+
+#ifndef __RFB_TRACER_H__
+#define __RFB_TRACER_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+namespace rfb {
+
+  enum TraceStage {
+    // Server side
+    traceDamage,
+    traceGrab,
+    traceCompare,
+    traceEncodeRect,
+    traceUpdate,
+    traceFlush,
+    // Viewer side
+    traceDecodeRead,
+    traceDecodeRect,
+    tracePresent,
+
+    traceStageMax
+  };
+
+  class Tracer {
+  public:
+    // init() enables tracing if configured to do so. Every call must
+    // be paired with a call to finish().
+    static void init();
+    // finish() writes out the trace and disables tracing once the
+    // last user is done with it.
+    static void finish();
+
+    static bool isEnabled() {
+      return enabled.load(std::memory_order_relaxed);
+    }
+
+    // now() returns a monotonic time stamp in microseconds, or zero
+    // if tracing is disabled
+    static uint64_t now();
+
+    // newTrack() allocates a new horizontal track in the trace (i.e.
+    // a "thread" in Chrome's terminology). Track 0 is the main thread.
+    static unsigned newTrack(const char* name);
+
+    // nextFrame() starts a new frame (i.e. a new set of changes from
+    // the desktop, or a new update from the server) and all following
+    // events should be tagged with it.
+    static uint32_t nextFrame();
+    static uint32_t currentFrame() {
+      return frame.load(std::memory_order_relaxed);
+    }
+
+    // record() adds an event covering start to end (identical for an
+    // instant event). The meaning of arg depends on the stage.
+    static void record(TraceStage stage, unsigned track, uint32_t frame,
+                       uint64_t start, uint64_t end, int32_t arg=0);
+
+    // dump() writes the current contents of the ring buffers to the
+    // specified file
+    static bool dump(const char* filename);
+
+  private:
+    struct Event;
+    struct Buffer;
+
+    static Buffer* threadBuffer();
+    static bool write(const char* filename);
+
+    // Read without any lock by every thread that traces
+    static std::atomic<bool> enabled;
+    static std::atomic<uint32_t> frame;
+    // Buffers of all threads that have recorded anything, kept after
+    // the threads exit so that their events are still written out
+    static std::vector<Buffer*> buffers;
+  };
+
+}
+
+#endif
@@ -30,9 +30,11 @@
 #include <rfb/KeyRemapper.h>
 #include <rfb/KeysymStr.h>
 #include <rfb/LogWriter.h>
+#include <rfb/ScaledPixelBuffer.h>
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/Tracer.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/VNCSConnectionST.h>
 #include <rfb/screenTypes.h>
@@ -50,6 +52,13 @@ static LogWriter vlog("VNCSConnST");
 
 static Cursor emptyCursor(0, 0, Point(0, 0), NULL);
 
+// How far from the pointer the user is likely to be looking
+static const int PointerInterestRadius = 128;
+// How long after a key press (in ms) that changes are likely to be
+// what was typed, and how large such changes can be
+static const int TypingInterestTimeout = 500;
+static const int TypingInterestMaxArea = 128 * 128;
+
 VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
                                    bool reverse)
   : sock(s), reverseConnection(reverse),
@@ -58,12 +67,23 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
     fenceDataLen(0), fenceData(NULL), congestionTimer(this),
     losslessTimer(this), server(server_),
     updateRenderedCursor(false), removeRenderedCursor(false),
-    continuousUpdates(false), encodeManager(this), idleTimer(this),
-    pointerEventTime(0), clientHasCursor(false)
+    continuousUpdates(false), encodeManager(this), scaledFb(NULL),
+    scaledCursorInvalid(true),
+    traceTrack(0),
+    traceFlushFrame(0), traceFlushStart(0), traceFlushLength(0),
+    idleTimer(this), pointerEventTime(0), clientHasCursor(false)
 {
   setStreams(&sock->inStream(), &sock->outStream());
   peerEndpoint = sock->getPeerEndpoint();
 
+  keyEventTime.tv_sec = 0;
+  keyEventTime.tv_usec = 0;
+
+  if (Tracer::isEnabled()) {
+    traceTrack = Tracer::newTrack(peerEndpoint.c_str());
+    encodeManager.setTraceTrack(traceTrack);
+  }
+
   // Kick off the idle timer
   if (rfb::Server::idleTimeout) {
     // minimum of 15 seconds while authenticating
@@ -201,6 +221,7 @@ void VNCSConnectionST::flushSocket()
   if (state() == RFBSTATE_CLOSING) return;
   try {
     sock->outStream().flush();
+    recordFlush();
     // Flushing the socket might release an update that was previously
     // delayed because of congestion.
     if (!sock->outStream().hasBufferedData())
@@ -214,9 +235,12 @@ void VNCSConnectionST::pixelBufferChange()
 {
   try {
     if (!authenticated()) return;
+
+    setupScaling();
+
     if (client.width() && client.height() &&
-        (server->getPixelBuffer()->width() != client.width() ||
-         server->getPixelBuffer()->height() != client.height()))
+        (getFramebuffer()->width() != client.width() ||
+         getFramebuffer()->height() != client.height()))
     {
       // We need to clip the next update to the new size, but also add any
       // extra bits if it's bigger.  If we wanted to do this exactly, something
@@ -233,11 +257,11 @@ void VNCSConnectionST::pixelBufferChange()
       //  updates.add_changed(Rect(0, client.height(), client.width(),
       //                           server->pb->height()));
 
-      damagedCursorRegion.assign_intersect(server->getPixelBuffer()->getRect());
+      damagedCursorRegion.assign_intersect(getFramebuffer()->getRect());
 
-      client.setDimensions(server->getPixelBuffer()->width(),
-                           server->getPixelBuffer()->height(),
-                           server->getScreenLayout());
+      client.setDimensions(getFramebuffer()->width(),
+                           getFramebuffer()->height(),
+                           getScreenLayout());
       if (state() == RFBSTATE_NORMAL) {
         if (!client.supportsDesktopSize()) {
           close("Client does not support desktop resize");
@@ -247,12 +271,12 @@ void VNCSConnectionST::pixelBufferChange()
       }
 
       // Drop any lossy tracking that is now outside the framebuffer
-      encodeManager.pruneLosslessRefresh(Region(server->getPixelBuffer()->getRect()));
+      encodeManager.pruneLosslessRefresh(Region(getFramebuffer()->getRect()));
     }
     // Just update the whole screen at the moment because we're too lazy to
     // work out what's actually changed.
     updates.clear();
-    updates.add_changed(server->getPixelBuffer()->getRect());
+    updates.add_changed(getFramebuffer()->getRect());
     writeFramebufferUpdate();
   } catch(rdr::Exception &e) {
     close(e.str());
@@ -368,6 +392,7 @@ bool VNCSConnectionST::getComparerState()
 
 void VNCSConnectionST::renderedCursorChange()
 {
+  scaledCursorInvalid = true;
   if (state() != RFBSTATE_NORMAL) return;
   // Are we switching between client-side and server-side cursor?
   if (clientHasCursor == needRenderedCursor())
@@ -415,6 +440,38 @@ bool VNCSConnectionST::needRenderedCursor()
 }
 
 
+// add_changed() and add_copied() are called with changes in the
+// server's framebuffer, which might not be what the client sees
+
+void VNCSConnectionST::add_changed(const Region& region)
+{
+  Region scaled;
+
+  if (scaledFb == NULL) {
+    updates.add_changed(region);
+    return;
+  }
+
+  // The server has already marked this in the scaled framebuffer
+  scaled = scaledFb->scaleRegion(region);
+  updates.add_changed(scaled);
+
+  if (!scaled.intersect(scaledCursor.getEffectiveRect()).is_empty())
+    scaledCursorInvalid = true;
+}
+
+void VNCSConnectionST::add_copied(const Region& dest, const Point& delta)
+{
+  // A copy doesn't stay a copy once it has been scaled
+  if (scaledFb != NULL) {
+    add_changed(dest);
+    return;
+  }
+
+  updates.add_copied(dest, delta);
+}
+
+
 void VNCSConnectionST::approveConnectionOrClose(bool accept,
                                                 const char* reason)
 {
@@ -434,10 +491,13 @@ void VNCSConnectionST::authSuccess()
   if (rfb::Server::idleTimeout)
     idleTimer.start(secsToMillis(rfb::Server::idleTimeout));
 
+  // - Set up a scaled framebuffer, if requested
+  setupScaling();
+
   // - Set the connection parameters appropriately
-  client.setDimensions(server->getPixelBuffer()->width(),
-                       server->getPixelBuffer()->height(),
-                       server->getScreenLayout());
+  client.setDimensions(getFramebuffer()->width(),
+                       getFramebuffer()->height(),
+                       getScreenLayout());
   client.setName(server->getName());
   client.setLEDState(server->getLEDState());
   
@@ -448,7 +508,7 @@ void VNCSConnectionST::authSuccess()
   vlog.info("Server default pixel format %s", buffer);
 
   // - Mark the entire display as "dirty"
-  updates.add_changed(server->getPixelBuffer()->getRect());
+  updates.add_changed(getFramebuffer()->getRect());
 }
 
 void VNCSConnectionST::queryConnection(const char* userName)
@@ -483,7 +543,15 @@ void VNCSConnectionST::pointerEvent(const Point& pos, int buttonMask)
   pointerEventTime = time(0);
   if (!accessCheck(AccessPtrEvents)) return;
   if (!rfb::Server::acceptPointerEvents) return;
-  pointerEventPos = pos;
+  // Updates are in the same coordinates as the client's pointer
+  pointerInterest.setXYWH(pos.x - PointerInterestRadius,
+                          pos.y - PointerInterestRadius,
+                          PointerInterestRadius * 2,
+                          PointerInterestRadius * 2);
+  if (scaledFb != NULL)
+    pointerEventPos = scaledFb->unscalePoint(pos);
+  else
+    pointerEventPos = pos;
   server->pointerEvent(this, pointerEventPos, buttonMask);
 }
 
@@ -517,6 +585,10 @@ void VNCSConnectionST::keyEvent(uint32_t keysym, uint32_t keycode, bool down) {
   if (!accessCheck(AccessKeyEvents)) return;
   if (!rfb::Server::acceptKeyEvents) return;
 
+  // Whatever changes next is probably what was typed
+  if (down)
+    gettimeofday(&keyEventTime, NULL);
+
   if (down)
     vlog.debug("Key pressed: 0x%04x / XK_%s (0x%04x)",
                keycode, KeySymName(keysym), keysym);
@@ -671,6 +743,10 @@ void VNCSConnectionST::setDesktopSize(int fb_width, int fb_height,
       !rfb::Server::acceptSetDesktopSize) {
     vlog.debug("Rejecting unauthorized framebuffer resize request");
     result = resultProhibited;
+  } else if (scaledFb != NULL) {
+    // We can't give the client the exact size it asks for
+    vlog.debug("Rejecting framebuffer resize request for scaled framebuffer");
+    result = resultProhibited;
   } else {
     result = server->setDesktopSize(this, fb_width, fb_height, layout);
   }
@@ -856,6 +932,7 @@ bool VNCSConnectionST::isCongested()
 
   // Stuff still waiting in the send buffer?
   sock->outStream().flush();
+  recordFlush();
   congestion.debugTrace("congestion-trace.csv", sock->getFd());
   if (sock->outStream().hasBufferedData())
     return true;
@@ -877,6 +954,8 @@ bool VNCSConnectionST::isCongested()
 
 void VNCSConnectionST::writeFramebufferUpdate()
 {
+  size_t startLength;
+
   congestion.updatePosition(sock->outStream().length());
 
   // We're in the middle of processing a command that's supposed to be
@@ -907,6 +986,8 @@ void VNCSConnectionST::writeFramebufferUpdate()
   // window.
   getOutStream()->cork(true);
 
+  startLength = sock->outStream().length();
+
   // First take care of any updates that cannot contain framebuffer data
   // changes.
   writeNoDataUpdate();
@@ -914,11 +995,39 @@ void VNCSConnectionST::writeFramebufferUpdate()
   // Then real data (if possible)
   writeDataUpdate();
 
+  // Anything actually sent will be traced until it has left our
+  // buffers
+  if (Tracer::isEnabled() && (traceFlushStart == 0) &&
+      (sock->outStream().length() != startLength)) {
+    traceFlushFrame = Tracer::currentFrame();
+    traceFlushStart = Tracer::now();
+    traceFlushLength = startLength;
+  }
+
   getOutStream()->cork(false);
 
+  recordFlush();
+
   congestion.updatePosition(sock->outStream().length());
 }
 
+// recordFlush() records how long it took for an update to be handed
+// over to the kernel, once we've managed to get rid of all of it
+
+void VNCSConnectionST::recordFlush()
+{
+  if (traceFlushStart == 0)
+    return;
+  if (sock->outStream().hasBufferedData())
+    return;
+
+  Tracer::record(traceFlush, traceTrack, traceFlushFrame,
+                 traceFlushStart, Tracer::now(),
+                 sock->outStream().length() - traceFlushLength);
+
+  traceFlushStart = 0;
+}
+
 void VNCSConnectionST::writeNoDataUpdate()
 {
   if (!writer()->needNoDataUpdate())
@@ -946,6 +1055,9 @@ void VNCSConnectionST::writeDataUpdate()
   if (req.is_empty())
     return;
 
+  if (scaledFb != NULL)
+    scaledFb->refresh();
+
   // Get the lists of updates. Prior to exporting the data to the `ui' object,
   // getUpdateInfo() will normalize the `updates' object such way that its
   // `changed' and `copied' regions would not intersect.
@@ -961,7 +1073,7 @@ void VNCSConnectionST::writeDataUpdate()
 
     bogusCopiedCursor = damagedCursorRegion;
     bogusCopiedCursor.translate(ui.copy_delta);
-    bogusCopiedCursor.assign_intersect(server->getPixelBuffer()->getRect());
+    bogusCopiedCursor.assign_intersect(getFramebuffer()->getRect());
     if (!ui.copied.intersect(bogusCopiedCursor).is_empty()) {
       updates.add_changed(bogusCopiedCursor);
       needNewUpdateInfo = true;
@@ -982,7 +1094,7 @@ void VNCSConnectionST::writeDataUpdate()
   // is marked as changed.
 
   if (updateRenderedCursor) {
-    updates.add_changed(server->getRenderedCursor()->getEffectiveRect());
+    updates.add_changed(getRenderedCursor()->getEffectiveRect());
     needNewUpdateInfo = true;
     updateRenderedCursor = false;
   }
@@ -1006,7 +1118,7 @@ void VNCSConnectionST::writeDataUpdate()
   if (needRenderedCursor()) {
     Rect renderedCursorRect;
 
-    cursor = server->getRenderedCursor();
+    cursor = getRenderedCursor();
     renderedCursorRect = cursor->getEffectiveRect();
 
     // Check that we don't try to copy over the cursor area, and
@@ -1031,7 +1143,9 @@ void VNCSConnectionST::writeDataUpdate()
 
   writeRTTPing();
 
-  encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor);
+  encodeManager.setLinkBandwidth(congestion.getBandwidth());
+  updateRegionOfInterest(ui.changed);
+  encodeManager.writeUpdate(ui, getFramebuffer(), cursor);
 
   writeRTTPing();
 
@@ -1046,9 +1160,10 @@ void VNCSConnectionST::writeLosslessRefresh()
 {
   Region req, pending;
   const RenderedCursor *cursor;
+  Point focus;
 
   int nextRefresh, nextUpdate;
-  size_t bandwidth, maxUpdateSize;
+  size_t bandwidth, encodeRate, maxUpdateSize, inFlight;
 
   if (continuousUpdates)
     req = cuRegion.union_(requested);
@@ -1059,6 +1174,8 @@ void VNCSConnectionST::writeLosslessRefresh()
   // update without risking a partially updated screen, however we
   // might still be able to send a lossless refresh
   pending = server->getPendingRegion();
+  if (scaledFb != NULL)
+    pending = scaledFb->scaleRegion(pending);
   if (!pending.is_empty()) {
     UpdateInfo ui;
 
@@ -1084,9 +1201,12 @@ void VNCSConnectionST::writeLosslessRefresh()
 
   // Prepare the cursor in case it overlaps with a region getting
   // refreshed
+  if (scaledFb != NULL)
+    scaledFb->refresh();
+
   cursor = NULL;
   if (needRenderedCursor())
-    cursor = server->getRenderedCursor();
+    cursor = getRenderedCursor();
 
   // FIXME: If continuous updates aren't used then the client might
   //        be slower than frameRate in its requests and we could
@@ -1098,18 +1218,38 @@ void VNCSConnectionST::writeLosslessRefresh()
     return;
 
   // FIXME: Bandwidth estimation without congestion control
-  bandwidth = congestion.getBandwidth();
-
-  // FIXME: Hard coded value for maximum CPU throughput
-  if (bandwidth > 5000000)
-    bandwidth = 5000000;
+  bandwidth = __rfbmax(1, congestion.getBandwidth());
 
   maxUpdateSize = bandwidth * nextUpdate / 1000;
 
+  // Earlier updates that are still on their way get the link first,
+  // so the refresh only gets what is left
+  inFlight = congestion.getInFlight();
+  if (inFlight >= maxUpdateSize) {
+    losslessTimer.start(__rfbmax(1, (int)(inFlight * 1000 / bandwidth)));
+    return;
+  }
+  maxUpdateSize -= inFlight;
+
+  // We also can't produce data faster than we can encode it. Guess
+  // at 5 MB/s until we have seen some refreshes.
+  encodeRate = encodeManager.getRefreshEncodeRate();
+  if (encodeRate == 0)
+    encodeRate = 5000000;
+  if (maxUpdateSize > encodeRate * nextUpdate / 1000)
+    maxUpdateSize = encodeRate * nextUpdate / 1000;
+
+  // The server doesn't know about keyboard focus, so the cursor is
+  // our best guess at where the user is looking
+  focus = server->getCursorPos();
+  if (scaledFb != NULL)
+    focus = scaledFb->scalePoint(focus);
+
   writeRTTPing();
 
-  encodeManager.writeLosslessRefresh(req, server->getPixelBuffer(),
-                                     cursor, maxUpdateSize);
+  encodeManager.setLinkBandwidth(congestion.getBandwidth());
+  encodeManager.writeLosslessRefresh(req, getFramebuffer(),
+                                     cursor, maxUpdateSize, focus);
 
   writeRTTPing();
 
@@ -1117,13 +1257,36 @@ void VNCSConnectionST::writeLosslessRefresh()
 }
 
 
+void VNCSConnectionST::updateRegionOfInterest(const Region& changed)
+{
+  Region roi;
+
+  roi = Region(pointerInterest);
+
+  // Small changes right after a key press are most likely the text
+  // being typed
+  if ((keyEventTime.tv_sec != 0) &&
+      (msSince(&keyEventTime) < TypingInterestTimeout)) {
+    std::vector<Rect> rects;
+    std::vector<Rect>::const_iterator rect;
+
+    changed.get_rects(&rects);
+    for (rect = rects.begin(); rect != rects.end(); ++rect) {
+      if (rect->area() <= TypingInterestMaxArea)
+        roi.assign_union(Region(*rect));
+    }
+  }
+
+  encodeManager.setRegionOfInterest(roi);
+}
+
 void VNCSConnectionST::screenLayoutChange(uint16_t reason)
 {
   if (!authenticated())
     return;
 
   client.setDimensions(client.width(), client.height(),
-                       server->getScreenLayout());
+                       getScreenLayout());
 
   if (state() != RFBSTATE_NORMAL)
     return;
@@ -1164,7 +1327,10 @@ void VNCSConnectionST::setCursorPos()
     return;
 
   if (client.supportsCursorPosition()) {
-    client.setCursorPos(server->getCursorPos());
+    if (scaledFb != NULL)
+      client.setCursorPos(scaledFb->scalePoint(server->getCursorPos()));
+    else
+      client.setCursorPos(server->getCursorPos());
     writer()->writeCursorPos();
   }
 }
@@ -1190,3 +1356,54 @@ void VNCSConnectionST::setLEDState(unsigned int ledstate)
   if (client.supportsLEDState())
     writer()->writeLEDState();
 }
+
+// setupScaling() picks up the server's scaled framebuffer, if there is
+// one, whenever the server's framebuffer has been replaced
+
+void VNCSConnectionST::setupScaling()
+{
+  scaledFb = server->getScaledPixelBuffer();
+  scaledCursorInvalid = true;
+}
+
+// getFramebuffer() returns the framebuffer as seen by the client
+
+const PixelBuffer* VNCSConnectionST::getFramebuffer()
+{
+  if (scaledFb != NULL)
+    return scaledFb;
+  return server->getPixelBuffer();
+}
+
+const RenderedCursor* VNCSConnectionST::getRenderedCursor()
+{
+  if (scaledFb == NULL)
+    return server->getRenderedCursor();
+
+  // The cursor is kept at its normal size so that it stays usable.
+  // It only needs redrawing if it or what is below it has changed.
+  if (scaledCursorInvalid) {
+    scaledCursor.update(scaledFb, server->getCursor(),
+                        scaledFb->scalePoint(server->getCursorPos()));
+    scaledCursorInvalid = false;
+  }
+
+  return &scaledCursor;
+}
+
+ScreenSet VNCSConnectionST::getScreenLayout()
+{
+  ScreenSet layout;
+  ScreenSet::iterator iter;
+
+  layout = server->getScreenLayout();
+  if (scaledFb == NULL)
+    return layout;
+
+  for (iter = layout.begin(); iter != layout.end(); ++iter) {
+    iter->dimensions.tl = scaledFb->scalePoint(iter->dimensions.tl);
+    iter->dimensions.br = scaledFb->scalePoint(iter->dimensions.br);
+  }
+
+  return layout;
+}
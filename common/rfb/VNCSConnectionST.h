@@ -30,11 +30,13 @@
 #include <map>
 
 #include <rfb/Congestion.h>
+#include <rfb/Cursor.h>
 #include <rfb/EncodeManager.h>
 #include <rfb/SConnection.h>
 #include <rfb/Timer.h>
 
 namespace rfb {
+  class ScaledPixelBuffer;
   class VNCServerST;
 
   class VNCSConnectionST : private SConnection,
@@ -107,10 +109,8 @@ namespace rfb {
 
     // Change tracking
 
-    void add_changed(const Region& region) { updates.add_changed(region); }
-    void add_copied(const Region& dest, const Point& delta) {
-      updates.add_copied(dest, delta);
-    }
+    void add_changed(const Region& region);
+    void add_copied(const Region& dest, const Point& delta);
 
     const char* getPeerEndpoint() const {return peerEndpoint.c_str();}
 
@@ -158,6 +158,17 @@ namespace rfb {
     void writeDataUpdate();
     void writeLosslessRefresh();
 
+    void updateRegionOfInterest(const Region& changed);
+
+    void recordFlush();
+
+    // Scaling
+
+    void setupScaling();
+    const PixelBuffer* getFramebuffer();
+    const RenderedCursor* getRenderedCursor();
+    ScreenSet getScreenLayout();
+
     void screenLayoutChange(uint16_t reason);
     void setCursor();
     void setCursorPos();
@@ -189,6 +200,16 @@ namespace rfb {
     Region cuRegion;
     EncodeManager encodeManager;
 
+    // Shared by all clients, and owned by the server
+    ScaledPixelBuffer* scaledFb;
+    RenderedCursor scaledCursor;
+    bool scaledCursorInvalid;
+
+    unsigned traceTrack;
+    uint32_t traceFlushFrame;
+    uint64_t traceFlushStart;
+    size_t traceFlushLength;
+
     std::map<uint32_t, uint32_t> pressedKeys;
 
     Timer idleTimer;
@@ -197,6 +218,10 @@ namespace rfb {
     Point pointerEventPos;
     bool clientHasCursor;
 
+    // What updateRegionOfInterest() bases its guess on
+    Rect pointerInterest;
+    struct timeval keyEventTime;
+
     std::string closeReason;
   };
 }
@@ -54,6 +54,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <rfb/ComparingUpdateTracker.h>
 #include <rfb/Exception.h>
@@ -62,6 +63,9 @@
 #include <rfb/LogWriter.h>
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
+#include <rfb/ScaledPixelBuffer.h>
+#include <rfb/SessionRecorder.h>
+#include <rfb/Tracer.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/VNCSConnectionST.h>
 #include <rfb/util.h>
@@ -81,10 +85,11 @@ static LogWriter connectionsLog("Connections");
 
 VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
   : blHosts(&blacklist), desktop(desktop_), desktopStarted(false),
-    blockCounter(0), pb(0), ledState(ledUnknown),
+    blockCounter(0), pb(0), scaledPb(0), ledState(ledUnknown),
     name(name_), pointerClient(0), clipboardClient(0),
     pointerClientTime(0),
-    comparer(0), cursor(new Cursor(0, 0, Point(), NULL)),
+    comparer(0), recorder(0), recordingStopped(false),
+    cursor(new Cursor(0, 0, Point(), NULL)),
     renderedCursorInvalid(false),
     keyRemapper(&KeyRemapper::defInstance),
     idleTimer(this), disconnectTimer(this), connectTimer(this),
@@ -92,6 +97,8 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
 {
   slog.debug("creating single-threaded server %s", name.c_str());
 
+  Tracer::init();
+
   // FIXME: Do we really want to kick off these right away?
   if (rfb::Server::maxIdleTime)
     idleTimer.start(secsToMillis(rfb::Server::maxIdleTime));
@@ -124,6 +131,12 @@ VNCServerST::~VNCServerST()
     comparer->logStats();
   delete comparer;
 
+  delete recorder;
+
+  delete scaledPb;
+
+  Tracer::finish();
+
   delete cursor;
 }
 
@@ -264,6 +277,8 @@ void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
   delete comparer;
   comparer = 0;
 
+  setupScaling();
+
   if (!pb) {
     screenLayout = ScreenSet();
 
@@ -284,6 +299,24 @@ void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
   renderedCursorInvalid = true;
   add_changed(pb->getRect());
 
+  // A recording can't change size or format midway
+  if (recorder && !recorder->isCompatible(pb)) {
+    slog.info("Framebuffer changed, stopping session recording");
+    delete recorder;
+    recorder = NULL;
+    recordingStopped = true;
+  }
+
+  if (!recorder && !recordingStopped &&
+      (strlen(rfb::Server::recordSession) > 0)) {
+    try {
+      recorder = new SessionRecorder(rfb::Server::recordSession, pb);
+    } catch (rdr::Exception& e) {
+      slog.error("Unable to record session: %s", e.str());
+      recordingStopped = true;
+    }
+  }
+
   std::list<VNCSConnectionST*>::iterator ci, ci_next;
   for (ci=clients.begin();ci!=clients.end();ci=ci_next) {
     ci_next = ci; ci_next++;
@@ -404,6 +437,13 @@ void VNCServerST::add_changed(const Region& region)
 
   comparer->add_changed(region);
   startFrameClock();
+
+  // The damage will be part of the next frame we send out
+  if (Tracer::isEnabled()) {
+    uint64_t now = Tracer::now();
+    Tracer::record(traceDamage, 0, Tracer::currentFrame() + 1,
+                   now, now, region.numRects());
+  }
 }
 
 void VNCServerST::add_copied(const Region& dest, const Point& delta)
@@ -795,12 +835,16 @@ void VNCServerST::writeUpdate()
 {
   UpdateInfo ui;
   Region toCheck;
+  uint32_t frame;
+  uint64_t start;
 
   std::list<VNCSConnectionST*>::iterator ci, ci_next;
 
   assert(blockCounter == 0);
   assert(desktopStarted);
 
+  frame = Tracer::nextFrame();
+
   comparer->getUpdateInfo(&ui, pb->getRect());
   toCheck = ui.changed.union_(ui.copied);
 
@@ -813,18 +857,32 @@ void VNCServerST::writeUpdate()
       renderedCursorInvalid = true;
   }
 
+  start = Tracer::now();
   pb->grabRegion(toCheck);
+  Tracer::record(traceGrab, 0, frame, start, Tracer::now(),
+                 toCheck.numRects());
 
   if (getComparerState())
     comparer->enable();
   else
     comparer->disable();
 
+  start = Tracer::now();
   if (comparer->compare())
     comparer->getUpdateInfo(&ui, pb->getRect());
+  Tracer::record(traceCompare, 0, frame, start, Tracer::now(),
+                 ui.changed.numRects());
 
   comparer->clear();
 
+  if (recorder)
+    recorder->addUpdate(ui.changed.union_(ui.copied), pb);
+
+  // The scaled framebuffer is shared, so mark it here once rather
+  // than in every client
+  if (scaledPb != NULL)
+    scaledPb->invalidate(scaledPb->scaleRegion(ui.changed.union_(ui.copied)));
+
   for (ci = clients.begin(); ci != clients.end(); ci = ci_next) {
     ci_next = ci; ci_next++;
     (*ci)->add_copied(ui.copied, ui.copy_delta);
@@ -853,6 +911,39 @@ Region VNCServerST::getPendingRegion()
   return ui.changed.union_(ui.copied);
 }
 
+// setupScaling() (re)creates the scaled framebuffer, if one is wanted,
+// whenever the framebuffer has been replaced
+
+void VNCServerST::setupScaling()
+{
+  int width, height, filter;
+
+  delete scaledPb;
+  scaledPb = NULL;
+
+  if (!pb || (rfb::Server::scaleFactor >= 100))
+    return;
+
+  width = pb->width() * rfb::Server::scaleFactor / 100;
+  height = pb->height() * rfb::Server::scaleFactor / 100;
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+
+  filter = ScaleFilters().getFilterIdByName(rfb::Server::scaleFilter);
+  if (filter < 0) {
+    slog.error("Unknown scale filter \"%s\"",
+               (const char*)rfb::Server::scaleFilter);
+    filter = defaultScaleFilter;
+  }
+
+  slog.info("Scaling framebuffer from %dx%d to %dx%d for clients",
+            pb->width(), pb->height(), width, height);
+
+  scaledPb = new ScaledPixelBuffer(pb, width, height, filter);
+}
+
 const RenderedCursor* VNCServerST::getRenderedCursor()
 {
   if (renderedCursorInvalid) {
@@ -40,6 +40,8 @@ namespace rfb {
   class ListConnInfo;
   class PixelBuffer;
   class KeyRemapper;
+  class SessionRecorder;
+  class ScaledPixelBuffer;
 
   class VNCServerST : public VNCServer,
                       public Timer::Callback {
@@ -152,6 +154,11 @@ namespace rfb {
     // side rendered cursor buffer
     const RenderedCursor* getRenderedCursor();
 
+    // getScaledPixelBuffer() returns the scaled down framebuffer that
+    // all clients see, or NULL if there is no scaling. Clients have to
+    // call refresh() on it before reading from it.
+    ScaledPixelBuffer* getScaledPixelBuffer() { return scaledPb; }
+
   protected:
 
     // Timer callbacks
@@ -170,6 +177,8 @@ namespace rfb {
     void stopFrameClock();
     void writeUpdate();
 
+    void setupScaling();
+
     bool getComparerState();
 
   protected:
@@ -180,6 +189,7 @@ namespace rfb {
     bool desktopStarted;
     int blockCounter;
     PixelBuffer* pb;
+    ScaledPixelBuffer* scaledPb;
     ScreenSet screenLayout;
     unsigned int ledState;
 
@@ -195,6 +205,9 @@ namespace rfb {
 
     ComparingUpdateTracker* comparer;
 
+    SessionRecorder* recorder;
+    bool recordingStopped;
+
     Point cursorPos;
     Cursor* cursor;
     RenderedCursor renderedCursor;
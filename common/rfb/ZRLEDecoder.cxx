@@ -51,23 +51,26 @@ static inline uint32_t readOpaque24B(rdr::InStream* is)
 }
 
 template<class T>
-static inline T readPixel(rdr::ZlibInStream* zis)
+static inline T readPixel(rdr::InStream* is)
 {
   if (sizeof(T) == 1)
-    return zis->readOpaque8();
+    return is->readOpaque8();
   if (sizeof(T) == 2)
-    return zis->readOpaque16();
+    return is->readOpaque16();
   if (sizeof(T) == 4)
-    return zis->readOpaque32();
+    return is->readOpaque32();
 }
 
-static inline void zlibHasData(rdr::ZlibInStream* zis, size_t length)
+static inline void checkData(rdr::InStream* is, size_t length)
 {
-  if (!zis->hasData(length))
+  if (!is->hasData(length))
     throw Exception("ZRLE decode error");
 }
 
-ZRLEDecoder::ZRLEDecoder() : Decoder(DecoderOrdered)
+// The zlib stream is shared by all rects, so it is inflated when the
+// data is read, which is done in order. The result has no dependency
+// on other rects, so the tiles can be decoded in parallel.
+ZRLEDecoder::ZRLEDecoder() : Decoder(DecoderPlain)
 {
 }
 
@@ -75,11 +78,25 @@ ZRLEDecoder::~ZRLEDecoder()
 {
 }
 
-bool ZRLEDecoder::readRect(const Rect& /*r*/, rdr::InStream* is,
-                           const ServerParams& /*server*/,
+// Each tile is at most a mode byte, a full palette, and a CPIXEL plus
+// a run length byte for every pixel. CPIXELs are never larger than
+// the pixels themselves.
+size_t ZRLEDecoder::maxRectLength(const Rect& r, const PixelFormat& pf)
+{
+  size_t tiles, pixelSize;
+
+  tiles = ((r.width() + 63) / 64) * ((r.height() + 63) / 64);
+  pixelSize = pf.bpp / 8;
+
+  return tiles * (1 + 127 * pixelSize) + r.area() * (pixelSize + 1);
+}
+
+bool ZRLEDecoder::readRect(const Rect& r, rdr::InStream* is,
+                           const ServerParams& server,
                            rdr::OutStream* os)
 {
   uint32_t len;
+  size_t maxLength, length;
 
   if (!is->hasData(4))
     return false;
@@ -87,14 +104,30 @@ bool ZRLEDecoder::readRect(const Rect& /*r*/, rdr::InStream* is,
   is->setRestorePoint();
 
   len = is->readU32();
-  os->writeU32(len);
 
   if (!is->hasDataOrRestore(len))
     return false;
 
   is->clearRestorePoint();
 
-  os->copyBytes(is, len);
+  // The compressed data must be limited so that we know when we have
+  // all of the output
+  rdr::MemInStream mis(is->getptr(len), len);
+
+  // Don't let a bogus stream make us buffer unlimited amounts of data
+  maxLength = maxRectLength(r, server.pf());
+  length = 0;
+
+  zis.setUnderlying(&mis, len);
+  while (zis.hasData(1)) {
+    if (zis.avail() > maxLength - length)
+      throw Exception("ZRLE decode error: too much data in rect");
+    length += zis.avail();
+    os->copyBytes(&zis, zis.avail());
+  }
+  zis.flushUnderlying();
+
+  is->setptr(len);
 
   return true;
 }
@@ -106,20 +139,17 @@ void ZRLEDecoder::decodeRect(const Rect& r, const uint8_t* buffer,
   rdr::MemInStream is(buffer, buflen);
   const rfb::PixelFormat& pf = server.pf();
   switch (pf.bpp) {
-  case 8:  zrleDecode<uint8_t>(r, &is, &zis, pf, pb); break;
-  case 16: zrleDecode<uint16_t>(r, &is, &zis, pf, pb); break;
-  case 32: zrleDecode<uint32_t>(r, &is, &zis, pf, pb); break;
+  case 8:  zrleDecode<uint8_t>(r, &is, pf, pb); break;
+  case 16: zrleDecode<uint16_t>(r, &is, pf, pb); break;
+  case 32: zrleDecode<uint32_t>(r, &is, pf, pb); break;
   }
 }
 
 template<class T>
 void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
-                             rdr::ZlibInStream* zis,
                              const PixelFormat& pf,
                              ModifiablePixelBuffer* pb)
 {
-  int length = is->readU32();
-  zis->setUnderlying(is, length);
   Rect t;
   T buf[64 * 64];
 
@@ -141,24 +171,24 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
 
       t.br.x = __rfbmin(r.br.x, t.tl.x + 64);
 
-      zlibHasData(zis, 1);
-      int mode = zis->readU8();
+      checkData(is, 1);
+      int mode = is->readU8();
       bool rle = mode & 128;
       int palSize = mode & 127;
       T palette[128];
 
       if (isLowCPixel || isHighCPixel)
-        zlibHasData(zis, 3 * palSize);
+        checkData(is, 3 * palSize);
       else
-        zlibHasData(zis, sizeof(T) * palSize);
+        checkData(is, sizeof(T) * palSize);
 
       for (int i = 0; i < palSize; i++) {
         if (isLowCPixel)
-          palette[i] = readOpaque24A(zis);
+          palette[i] = readOpaque24A(is);
         else if (isHighCPixel)
-          palette[i] = readOpaque24B(zis);
+          palette[i] = readOpaque24B(is);
         else
-          palette[i] = readPixel<T>(zis);
+          palette[i] = readPixel<T>(is);
       }
 
       if (palSize == 1) {
@@ -173,19 +203,19 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
           // raw
 
           if (isLowCPixel || isHighCPixel)
-            zlibHasData(zis, 3 * t.area());
+            checkData(is, 3 * t.area());
           else
-            zlibHasData(zis, sizeof(T) * t.area());
+            checkData(is, sizeof(T) * t.area());
 
           if (isLowCPixel || isHighCPixel) {
             for (T* ptr = buf; ptr < buf+t.area(); ptr++) {
               if (isLowCPixel)
-                *ptr = readOpaque24A(zis);
+                *ptr = readOpaque24A(is);
               else
-                *ptr = readOpaque24B(zis);
+                *ptr = readOpaque24B(is);
             }
           } else {
-            zis->readBytes((uint8_t*)buf, t.area() * sizeof(T));
+            is->readBytes((uint8_t*)buf, t.area() * sizeof(T));
           }
 
         } else {
@@ -203,8 +233,8 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
 
             while (ptr < eol) {
               if (nbits == 0) {
-                zlibHasData(zis, 1);
-                byte = zis->readU8();
+                checkData(is, 1);
+                byte = is->readU8();
                 nbits = 8;
               }
               nbits -= bppp;
@@ -225,20 +255,20 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
           while (ptr < end) {
             T pix;
             if (isLowCPixel || isHighCPixel)
-              zlibHasData(zis, 3);
+              checkData(is, 3);
             else
-              zlibHasData(zis, sizeof(T));
+              checkData(is, sizeof(T));
             if (isLowCPixel)
-              pix = readOpaque24A(zis);
+              pix = readOpaque24A(is);
             else if (isHighCPixel)
-              pix = readOpaque24B(zis);
+              pix = readOpaque24B(is);
             else
-              pix = readPixel<T>(zis);
+              pix = readPixel<T>(is);
             int len = 1;
             int b;
             do {
-              zlibHasData(zis, 1);
-              b = zis->readU8();
+              checkData(is, 1);
+              b = is->readU8();
               len += b;
             } while (b == 255);
 
@@ -256,14 +286,14 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
           T* ptr = buf;
           T* end = ptr + t.area();
           while (ptr < end) {
-            zlibHasData(zis, 1);
-            int index = zis->readU8();
+            checkData(is, 1);
+            int index = is->readU8();
             int len = 1;
             if (index & 128) {
               int b;
               do {
-                zlibHasData(zis, 1);
-                b = zis->readU8();
+                checkData(is, 1);
+                b = is->readU8();
                 len += b;
               } while (b == 255);
 
@@ -284,7 +314,4 @@ void ZRLEDecoder::zrleDecode(const Rect& r, rdr::InStream* is,
       pb->imageRect(pf, t, buf);
     }
   }
-
-  zis->flushUnderlying();
-  zis->setUnderlying(NULL, 0);
 }
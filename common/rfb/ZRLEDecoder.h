@@ -36,10 +36,14 @@ namespace rfb {
                             size_t buflen, const ServerParams& server,
                             ModifiablePixelBuffer* pb);
 
+  protected:
+    // maxRectLength() returns the largest amount of uncompressed data
+    // that a valid rect can have
+    static size_t maxRectLength(const Rect& r, const PixelFormat& pf);
+
   private:
     template<class T>
     void zrleDecode(const Rect& r, rdr::InStream* is,
-                    rdr::ZlibInStream* zis,
                     const PixelFormat& pf, ModifiablePixelBuffer* pb);
 
   private:
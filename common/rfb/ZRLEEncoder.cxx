@@ -46,6 +46,13 @@ ZRLEEncoder::ZRLEEncoder(SConnection* conn)
               "by the client instead.");
   }
   zos.setUnderlying(&mos);
+  cos = &zos;
+}
+
+ZRLEEncoder::ZRLEEncoder(SConnection* conn, int encoding)
+  : Encoder(conn, encoding, EncoderPlain, 127),
+  zos(0, 2), mos(129*1024), cos(NULL)
+{
 }
 
 ZRLEEncoder::~ZRLEEncoder()
@@ -63,6 +70,11 @@ void ZRLEEncoder::setCompressLevel(int level)
   zos.setCompressionLevel(level);
 }
 
+size_t ZRLEEncoder::getMemoryUsage()
+{
+  return zos.getMemoryUsage();
+}
+
 void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 {
   int x, y;
@@ -97,7 +109,7 @@ void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
     }
   }
 
-  zos.flush();
+  cos->flush();
 
   os = conn->getOutStream();
 
@@ -118,11 +130,11 @@ void ZRLEEncoder::writeSolidRect(int width, int height,
   tiles = ((width + 63)/64) * ((height + 63)/64);
 
   while (tiles--) {
-    zos.writeU8(1);
+    cos->writeU8(1);
     writePixels(colour, pf, 1);
   }
 
-  zos.flush();
+  cos->flush();
 
   os = conn->getOutStream();
 
@@ -193,7 +205,7 @@ void ZRLEEncoder::writeRawTile(const Rect& tile, const PixelBuffer* pb)
 
   buffer = pb->getBuffer(tile, &stride);
 
-  zos.writeU8(0); // Empty palette (i.e. raw pixels)
+  cos->writeU8(0); // Empty palette (i.e. raw pixels)
 
   w = tile.width();
   h = tile.height();
@@ -239,7 +251,7 @@ void ZRLEEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf,
   pf.bufferFromPixel(pixBuf, maxPixel);
 
   if ((pf.bpp != 32) || ((pixBuf[0] != 0) && (pixBuf[3] != 0))) {
-    zos.writeBytes(buffer, count * (pf.bpp/8));
+    cos->writeBytes(buffer, count * (pf.bpp/8));
     return;
   }
 
@@ -247,7 +259,7 @@ void ZRLEEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf,
     buffer++;
 
   while (count--) {
-    zos.writeBytes(buffer, 3);
+    cos->writeBytes(buffer, 3);
     buffer += 4;
   }
 }
@@ -268,7 +280,7 @@ void ZRLEEncoder::writePaletteTile(int width, int height,
   assert(palette.size() > 1);
   assert(palette.size() <= 16);
 
-  zos.writeU8(palette.size());
+  cos->writeU8(palette.size());
   writePalette(pf, palette);
 
   bppp = bitsPerPackedPixel[palette.size()-1];
@@ -287,13 +299,13 @@ void ZRLEEncoder::writePaletteTile(int width, int height,
       byte = (byte << bppp) | index;
       nbits += bppp;
       if (nbits >= 8) {
-        zos.writeU8(byte);
+        cos->writeU8(byte);
         nbits = 0;
       }
     }
     if (nbits > 0) {
       byte <<= 8 - nbits;
-      zos.writeU8(byte);
+      cos->writeU8(byte);
     }
 
     buffer += pad;
@@ -314,7 +326,7 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
   assert(palette.size() > 1);
   assert(palette.size() <= 127);
 
-  zos.writeU8(palette.size() | 0x80);
+  cos->writeU8(palette.size() | 0x80);
   writePalette(pf, palette);
 
   pad = stride - width;
@@ -327,15 +339,15 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
     while (w--) {
       if (prevColour != *buffer) {
         if (runLength == 1)
-          zos.writeU8(palette.lookup(prevColour));
+          cos->writeU8(palette.lookup(prevColour));
         else {
-          zos.writeU8(palette.lookup(prevColour) | 0x80);
+          cos->writeU8(palette.lookup(prevColour) | 0x80);
 
           while (runLength > 255) {
-            zos.writeU8(255);
+            cos->writeU8(255);
             runLength -= 255;
           }
-          zos.writeU8(runLength - 1);
+          cos->writeU8(runLength - 1);
         }
 
         prevColour = *buffer;
@@ -348,14 +360,14 @@ void ZRLEEncoder::writePaletteRLETile(int width, int height,
     buffer += pad;
   }
   if (runLength == 1)
-    zos.writeU8(palette.lookup(prevColour));
+    cos->writeU8(palette.lookup(prevColour));
   else {
-    zos.writeU8(palette.lookup(prevColour) | 0x80);
+    cos->writeU8(palette.lookup(prevColour) | 0x80);
 
     while (runLength > 255) {
-      zos.writeU8(255);
+      cos->writeU8(255);
       runLength -= 255;
     }
-    zos.writeU8(runLength - 1);
+    cos->writeU8(runLength - 1);
   }
 }
@@ -34,12 +34,18 @@ namespace rfb {
 
     virtual void setCompressLevel(int level);
 
+    virtual size_t getMemoryUsage();
+
     virtual void writeRect(const PixelBuffer* pb, const Palette& palette);
     virtual void writeSolidRect(int width, int height,
                                 const PixelFormat& pf,
                                 const uint8_t* colour);
 
   protected:
+    // For variants that only differ in how the tile data is compressed,
+    // which must set cos
+    ZRLEEncoder(SConnection* conn, int encoding);
+
     void writePaletteTile(const Rect& tile, const PixelBuffer* pb,
                           const Palette& palette);
     void writePaletteRLETile(const Rect& tile, const PixelBuffer* pb,
@@ -65,6 +71,8 @@ namespace rfb {
   protected:
     rdr::ZlibOutStream zos;
     rdr::MemOutStream mos;
+    // The stream that compresses the tile data in to mos
+    rdr::OutStream* cos;
   };
 }
 #endif
@@ -0,0 +1,82 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rdr/InStream.h>
+#include <rdr/MemInStream.h>
+#include <rdr/OutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/ServerParams.h>
+#include <rfb/ZstdRLEDecoder.h>
+
+using namespace rfb;
+
+// Only the compression differs from ZRLE, so the stream is decompressed
+// here and the tiles are then decoded by ZRLEDecoder
+ZstdRLEDecoder::ZstdRLEDecoder()
+{
+}
+
+ZstdRLEDecoder::~ZstdRLEDecoder()
+{
+}
+
+bool ZstdRLEDecoder::readRect(const Rect& r, rdr::InStream* is,
+                              const ServerParams& server,
+                              rdr::OutStream* os)
+{
+  uint32_t len;
+  size_t maxLength, length;
+
+  if (!is->hasData(4))
+    return false;
+
+  is->setRestorePoint();
+
+  len = is->readU32();
+
+  if (!is->hasDataOrRestore(len))
+    return false;
+
+  is->clearRestorePoint();
+
+  // The compressed data must be limited so that we know when we have
+  // all of the output
+  rdr::MemInStream mis(is->getptr(len), len);
+
+  // Don't let a bogus stream make us buffer unlimited amounts of data
+  maxLength = maxRectLength(r, server.pf());
+  length = 0;
+
+  zis.setUnderlying(&mis, len);
+  while (zis.hasData(1)) {
+    if (zis.avail() > maxLength - length)
+      throw Exception("ZstdRLE decode error: too much data in rect");
+    length += zis.avail();
+    os->copyBytes(&zis, zis.avail());
+  }
+  zis.flushUnderlying();
+
+  is->setptr(len);
+
+  return true;
+}
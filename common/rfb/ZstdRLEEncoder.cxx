@@ -0,0 +1,56 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rfb/encodings.h>
+#include <rfb/SConnection.h>
+#include <rfb/ServerCore.h>
+#include <rfb/ZstdRLEEncoder.h>
+
+using namespace rfb;
+
+ZstdRLEEncoder::ZstdRLEEncoder(SConnection* conn)
+  : ZRLEEncoder(conn, encodingZstdRLE), zstdos(0, 2)
+{
+  zstdos.setUnderlying(&mos);
+  cos = &zstdos;
+}
+
+ZstdRLEEncoder::~ZstdRLEEncoder()
+{
+  zstdos.setUnderlying(NULL);
+}
+
+bool ZstdRLEEncoder::isSupported()
+{
+  return conn->client.supportsEncoding(encodingZstdRLE);
+}
+
+void ZstdRLEEncoder::setCompressLevel(int level)
+{
+  zstdos.setCompressionLevel(level);
+  zstdos.setLongDistance(Server::zstdLongDistance);
+}
+
+size_t ZstdRLEEncoder::getMemoryUsage()
+{
+  return zstdos.getMemoryUsage();
+}
@@ -34,6 +34,9 @@ int rfb::encodingNum(const char* name)
   if (strcasecmp(name, "Tight") == 0)    return encodingTight;
 #ifdef HAVE_H264
   if (strcasecmp(name, "H.264") == 0)    return encodingH264;
+#endif
+#ifdef HAVE_ZSTD
+  if (strcasecmp(name, "ZstdRLE") == 0)  return encodingZstdRLE;
 #endif
   return -1;
 }
@@ -51,6 +54,10 @@ const char* rfb::encodingName(int num)
 #ifdef HAVE_H264
   case encodingH264:     return "H.264";
 #endif
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:  return "ZstdRLE";
+#endif
+  case encodingContentCache: return "ContentCache";
   default:               return "[unknown encoding]";
   }
 }
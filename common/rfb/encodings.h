@@ -34,6 +34,18 @@ namespace rfb {
 
   const int encodingMax = 255;
 
+  // TigerVNC-specific. Like pseudoEncodingContentCache0 these are in
+  // the 0x545643xx ("TVC") block, the way VMware uses 0x574d56xx, so
+  // they stay clear of the small numbers other implementations pick.
+  // They are above encodingMax.
+
+  // Only sent to clients that announce a cache size
+  const int encodingContentCache = 0x54564310;
+#ifdef HAVE_ZSTD
+  // ZRLE with a Zstandard stream instead of zlib
+  const int encodingZstdRLE = 0x54564311;
+#endif
+
   const int pseudoEncodingXCursor = -240;
   const int pseudoEncodingCursor = -239;
   const int pseudoEncodingDesktopSize = -223;
@@ -70,6 +82,11 @@ namespace rfb {
   // UltraVNC-specific
   const int pseudoEncodingExtendedClipboard = 0xC0A1E5CE;
 
+  // TigerVNC-specific, the size of the client's content cache is
+  // 1 MiB << (encoding - pseudoEncodingContentCache0)
+  const int pseudoEncodingContentCache0 = 0x54564300;
+  const int pseudoEncodingContentCache15 = 0x5456430F;
+
   int encodingNum(const char* name);
   const char* encodingName(int num);
 }
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include <rfb/util.h>
 
@@ -626,6 +627,18 @@ namespace rfb {
     return msBetween(then, &now);
   }
 
+  uint64_t usMonotonic()
+  {
+#if defined(CLOCK_MONOTONIC) && !defined(WIN32)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+      return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  }
+
   bool isBefore(const struct timeval *first,
                 const struct timeval *second)
   {
@@ -93,6 +93,9 @@ namespace rfb {
   // Returns time elapsed since given moment in milliseconds.
   unsigned msSince(const struct timeval *then);
 
+  // Returns a monotonic time stamp in microseconds
+  uint64_t usMonotonic();
+
   // Returns true if first happened before seconds
   bool isBefore(const struct timeval *first,
                 const struct timeval *second);
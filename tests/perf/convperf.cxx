@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #include "util.h"
 
@@ -39,6 +40,7 @@ typedef void (*testfn) (rfb::PixelFormat&, rfb::PixelFormat&, uint8_t*, uint8_t*
 struct TestEntry {
   const char *label;
   testfn fn;
+  bool simd;
 };
 
 static void testMemcpy(rfb::PixelFormat &dstpf,
@@ -100,10 +102,13 @@ static void doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 }
 
 struct TestEntry tests[] = {
-  {"memcpy", testMemcpy},
-  {"bufferFromBuffer", testBuffer},
-  {"rgbFromBuffer", testToRGB},
-  {"bufferFromRGB", testFromRGB},
+  {"memcpy", testMemcpy, false},
+  {"bufferFromBuffer", testBuffer, true},
+  {"rgbFromBuffer", testToRGB, true},
+  {"bufferFromRGB", testFromRGB, true},
+  {"bufferFromBuffer (generic)", testBuffer, false},
+  {"rgbFromBuffer (generic)", testToRGB, false},
+  {"bufferFromRGB (generic)", testFromRGB, false},
 };
 
 static void doTests(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
@@ -118,9 +123,12 @@ static void doTests(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 
   for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++) {
     printf(",");
+    rfb::simdSetEnabled(tests[i].simd);
     doTest(tests[i].fn, dstpf, srcpf);
   }
 
+  rfb::simdSetEnabled(true);
+
   printf("\n");
 }
 
@@ -150,6 +158,8 @@ int main(int /*argc*/, char** /*argv*/)
   printf("#\n");
   printf("# Frame buffer: %dx%d pixels\n", fbsize, fbsize);
   printf("# Tile size: %dx%d pixels\n", tile, tile);
+  printf("# Vector instructions: %s\n",
+         rfb::simdGetName() ? rfb::simdGetName() : "none");
   printf("#\n");
   printf("# Note: Results are Mpixels/sec\n");
   printf("#\n");
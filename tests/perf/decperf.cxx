@@ -22,6 +22,11 @@
  * from the server side from the ServerInit message and forward.
  * It is assumed that the client is using a bgr888 (LE) pixel
  * format.
+ *
+ * The amount of data for each encoding is listed as well, so that
+ * the results for e.g. an H.264 capture can be told apart from the
+ * other rects in it. The time per rect shows the fixed overhead for
+ * each rect, which dominates captures with many small rects.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -33,6 +38,8 @@
 #include <math.h>
 #include <sys/time.h>
 
+#include <map>
+
 #include <rdr/Exception.h>
 #include <rdr/FileInStream.h>
 #include <rdr/OutStream.h>
@@ -42,6 +49,7 @@
 #include <rfb/CMsgWriter.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/encodings.h>
 
 #include "util.h"
 
@@ -67,18 +75,24 @@ public:
   CConn(const char *filename);
   ~CConn();
 
+  size_t getBytesRead() { return in->pos(); }
+
   virtual void initDone();
   virtual void setPixelFormat(const rfb::PixelFormat& pf);
   virtual void setCursor(int, int, const rfb::Point&, const uint8_t*);
   virtual void setCursorPos(const rfb::Point&);
   virtual void framebufferUpdateStart();
   virtual void framebufferUpdateEnd();
+  virtual bool dataRect(const rfb::Rect&, int);
   virtual void setColourMapEntries(int, int, uint16_t*);
   virtual void bell();
   virtual void serverCutText(const char*);
 
 public:
   double cpuTime;
+  // Rects and pixels decoded for each encoding
+  std::map<int, unsigned> rects;
+  std::map<int, unsigned long long> pixels;
 
 protected:
   rdr::FileInStream *in;
@@ -169,6 +183,17 @@ void CConn::framebufferUpdateEnd()
   cpuTime += getCpuCounter();
 }
 
+bool CConn::dataRect(const rfb::Rect& r, int encoding)
+{
+  if (!CConnection::dataRect(r, encoding))
+    return false;
+
+  rects[encoding]++;
+  pixels[encoding] += r.area();
+
+  return true;
+}
+
 void CConn::setColourMapEntries(int, int, uint16_t*)
 {
 }
@@ -185,6 +210,9 @@ struct stats
 {
   double decodeTime;
   double realTime;
+  unsigned long long bytes;
+  std::map<int, unsigned> rects;
+  std::map<int, unsigned long long> pixels;
 };
 
 static struct stats runTest(const char *fn)
@@ -214,6 +242,9 @@ static struct stats runTest(const char *fn)
   gettimeofday(&stop, NULL);
 
   s.decodeTime = cc->cpuTime;
+  s.bytes = cc->getBytesRead();
+  s.rects = cc->rects;
+  s.pixels = cc->pixels;
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec)/1000000.0;
 
@@ -248,6 +279,9 @@ int main(int argc, char **argv)
   struct stats runs[runCount];
   double values[runCount], dev[runCount];
   double median, meddev;
+  double cpuTime;
+  unsigned totalRects;
+  unsigned long long totalPixels;
 
   if (argc != 2) {
     printf("Syntax: %s <rfb file>\n", argv[0]);
@@ -276,6 +310,8 @@ int main(int argc, char **argv)
 
   printf("CPU time: %g s (+/- %g %%)\n", median, meddev);
 
+  cpuTime = median;
+
   // And for CPU core usage
   for (i = 0;i < runCount;i++)
     values[i] = runs[i].decodeTime / runs[i].realTime;
@@ -291,5 +327,28 @@ int main(int argc, char **argv)
 
   printf("Core usage: %g (+/- %g %%)\n", median, meddev);
 
+  totalRects = 0;
+  totalPixels = 0;
+  std::map<int, unsigned>::const_iterator iter;
+  for (iter = runs[0].rects.begin(); iter != runs[0].rects.end(); ++iter) {
+    const char* name;
+
+    name = rfb::encodingName(iter->first);
+    printf("Rects (%s): %u (%g Mpixels)\n", name, iter->second,
+           runs[0].pixels[iter->first] / (1000.0 * 1000.0));
+
+    totalRects += iter->second;
+    totalPixels += runs[0].pixels[iter->first];
+  }
+
+  if (totalRects > 0)
+    printf("CPU time per rect: %g us\n", cpuTime * 1000000.0 / totalRects);
+
+  // Comparable between captures of the same content with different
+  // encodings, e.g. made with encperf's output option
+  printf("Input: %llu bytes (%g MB/s)\n", runs[0].bytes,
+         runs[0].bytes / cpuTime / (1000.0 * 1000.0));
+  printf("Output: %g Mpixels/s\n", totalPixels / cpuTime / (1000.0 * 1000.0));
+
   return 0;
 }
@@ -34,9 +34,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <rdr/Exception.h>
 #include <rdr/OutStream.h>
 #include <rdr/FileInStream.h>
@@ -47,6 +50,7 @@
 #include <rfb/CMsgReader.h>
 #include <rfb/CMsgWriter.h>
 #include <rfb/UpdateTracker.h>
+#include <rfb/encodings.h>
 
 #include <rfb/EncodeManager.h>
 #include <rfb/SConnection.h>
@@ -59,24 +63,52 @@ static rfb::IntParameter height("height", "Frame buffer height", 0);
 static rfb::IntParameter count("count", "Number of benchmark iterations", 9);
 
 static rfb::StringParameter format("format", "Pixel format (e.g. bgr888)", "");
+static rfb::StringParameter encoding("encoding",
+                                     "Preferred encoding (e.g. Hextile)",
+                                     "Tight");
+
+static rfb::IntParameter compressLevel("compressLevel",
+                                       "Compression level to request (0-9)",
+                                       2, 0, 9);
+
+static rfb::IntParameter bandwidth("bandwidth",
+                                   "Link bandwidth in kB/s to adapt the "
+                                   "compression level to (0 means unknown)",
+                                   0, 0);
+
+static rfb::StringParameter output("output",
+                                   "Also write the encoded result to this "
+                                   "file, in a form decperf can read", "");
+
+static rfb::IntParameter contentCache("contentCache",
+                                      "Size in MiB of the content cache "
+                                      "to announce (0 disables)", 0, 0);
+
+static rfb::StringParameter pointerTrace("pointerTrace",
+                                         "File with a pointer position, "
+                                         "as \"x y\", for each update. "
+                                         "The area around it is sent with "
+                                         "a better quality.", "");
 
 static rfb::BoolParameter translate("translate",
                                     "Translate 8-bit and 16-bit datasets into 24-bit",
                                     true);
 
+// Same as the server uses around the pointer
+static const int pointerInterestRadius = 128;
+
 // The frame buffer (and output) is always this format
 static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
-// Encodings to use
+// Encodings to use, after the preferred one
 static const int32_t encodings[] = {
   rfb::encodingTight, rfb::encodingCopyRect, rfb::encodingRRE,
   rfb::encodingHextile, rfb::encodingZRLE, rfb::pseudoEncodingLastRect,
-  rfb::pseudoEncodingQualityLevel0 + 8,
-  rfb::pseudoEncodingCompressLevel0 + 2};
+  rfb::pseudoEncodingQualityLevel0 + 8};
 
 class DummyOutStream : public rdr::OutStream {
 public:
-  DummyOutStream();
+  DummyOutStream(FILE* file=NULL);
 
   virtual size_t length();
   virtual void flush();
@@ -86,6 +118,7 @@ private:
 
   int offset;
   uint8_t buf[131072];
+  FILE* file;
 };
 
 class CConn : public rfb::CConnection {
@@ -95,6 +128,8 @@ public:
 
   void getStats(double& ratio, unsigned long long& bytes,
                 unsigned long long& rawEquivalent);
+  void getCacheStats(unsigned long long& restoredPixels,
+                     unsigned long long& cacheBytes);
 
   virtual void initDone() {};
   virtual void resizeFramebuffer();
@@ -123,6 +158,7 @@ public:
   Manager(class rfb::SConnection *conn);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getCacheStats(unsigned long long&, unsigned long long&);
 };
 
 class SConn : public rfb::SConnection {
@@ -130,9 +166,11 @@ public:
   SConn();
   ~SConn();
 
+  void writeServerInit();
   void writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getCacheStats(unsigned long long&, unsigned long long&);
 
   virtual void setAccessRights(AccessRights ar);
 
@@ -140,15 +178,20 @@ public:
                               const rfb::ScreenSet& layout);
 
 protected:
+  FILE *file;
   DummyOutStream *out;
   Manager *manager;
+
+  std::vector<rfb::Point> trace;
+  size_t tracePos;
 };
 
-DummyOutStream::DummyOutStream()
+DummyOutStream::DummyOutStream(FILE* file_)
 {
   offset = 0;
   ptr = buf;
   end = buf + sizeof(buf);
+  file = file_;
 }
 
 size_t DummyOutStream::length()
@@ -159,6 +202,10 @@ size_t DummyOutStream::length()
 
 void DummyOutStream::flush()
 {
+  if ((file != NULL) && (ptr != buf)) {
+    if (fwrite(buf, ptr - buf, 1, file) != 1)
+      throw rdr::Exception("Failed to write output file");
+  }
   offset += ptr - buf;
   ptr = buf;
 }
@@ -192,7 +239,24 @@ CConn::CConn(const char *filename)
 
   sc = new SConn();
   sc->client.setPF((bool)translate ? fbPF : pf);
-  sc->setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+  sc->client.setDimensions(width, height);
+
+  std::vector<int32_t> encs;
+  encs.push_back(rfb::encodingNum(encoding));
+  for (size_t i = 0; i < sizeof(encodings) / sizeof(*encodings); i++) {
+    if (encodings[i] != encs[0])
+      encs.push_back(encodings[i]);
+  }
+  encs.push_back(rfb::pseudoEncodingCompressLevel0 + ::compressLevel);
+  if (contentCache > 0) {
+    int level = 0;
+    while (((contentCache >> (level + 1)) > 0) && (level < 15))
+      level++;
+    encs.push_back(rfb::pseudoEncodingContentCache0 + level);
+  }
+  sc->setEncodings(encs.size(), encs.data());
+
+  sc->writeServerInit();
 }
 
 CConn::~CConn()
@@ -208,6 +272,12 @@ void CConn::getStats(double& ratio, unsigned long long& bytes,
   sc->getStats(ratio, bytes, rawEquivalent);
 }
 
+void CConn::getCacheStats(unsigned long long& restoredPixels,
+                          unsigned long long& cacheBytes)
+{
+  sc->getCacheStats(restoredPixels, cacheBytes);
+}
+
 void CConn::resizeFramebuffer()
 {
   rfb::ModifiablePixelBuffer *pb;
@@ -297,29 +367,86 @@ void Manager::getStats(double& ratio, unsigned long long& encodedBytes,
     }
   }
 
+  for (size_t i = 0; i < sizeof(cacheStats) / sizeof(*cacheStats); i++) {
+    bytes += cacheStats[i].bytes;
+    equivalent += cacheStats[i].equivalent;
+  }
+
   ratio = (double)equivalent / bytes;
   encodedBytes = bytes;
   rawEquivalent = equivalent;
 }
 
+void Manager::getCacheStats(unsigned long long& restoredPixels,
+                            unsigned long long& cacheBytes)
+{
+  restoredPixels = cacheStats[rfb::contentCacheRestore].pixels;
+  cacheBytes = cacheStats[rfb::contentCacheRestore].bytes +
+               cacheStats[rfb::contentCacheStore].bytes;
+}
+
 SConn::SConn()
 {
-  out = new DummyOutStream;
+  file = NULL;
+  if (strcmp(output, "") != 0) {
+    file = fopen(output, "wb");
+    if (file == NULL)
+      throw rdr::Exception("Failed to open output file");
+  }
+
+  out = new DummyOutStream(file);
   setStreams(NULL, out);
 
   setWriter(new rfb::SMsgWriter(&client, out));
 
   manager = new Manager(this);
+
+  tracePos = 0;
+  if (strcmp(pointerTrace, "") != 0) {
+    FILE *f;
+    int x, y;
+
+    f = fopen(pointerTrace, "r");
+    if (f == NULL)
+      throw rdr::Exception("Failed to open pointer trace");
+    while (fscanf(f, "%d %d", &x, &y) == 2)
+      trace.push_back(rfb::Point(x, y));
+    fclose(f);
+
+    if (trace.empty())
+      throw rdr::Exception("No positions in pointer trace");
+  }
 }
 
 SConn::~SConn()
 {
   delete manager;
   delete out;
+  if (file != NULL)
+    fclose(file);
+}
+
+void SConn::writeServerInit()
+{
+  // decperf expects the capture to start with this
+  writer()->writeServerInit(client.width(), client.height(), client.pf(),
+                            "encperf");
 }
 
 void SConn::writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb)
 {
+  manager->setLinkBandwidth((size_t)bandwidth * 1000);
+
+  // The trace starts over if there are more updates than positions
+  if (!trace.empty()) {
+    rfb::Point pos;
+
+    pos = trace[tracePos++ % trace.size()];
+    manager->setRegionOfInterest(rfb::Region(rfb::Rect(
+      pos.x - pointerInterestRadius, pos.y - pointerInterestRadius,
+      pos.x + pointerInterestRadius, pos.y + pointerInterestRadius)));
+  }
+
   manager->writeUpdate(ui, pb, NULL);
 }
 
@@ -329,6 +456,12 @@ void SConn::getStats(double& ratio, unsigned long long& bytes,
   manager->getStats(ratio, bytes, rawEquivalent);
 }
 
+void SConn::getCacheStats(unsigned long long& restoredPixels,
+                          unsigned long long& cacheBytes)
+{
+  manager->getCacheStats(restoredPixels, cacheBytes);
+}
+
 void SConn::setAccessRights(AccessRights)
 {
 }
@@ -346,6 +479,9 @@ struct stats
   double ratio;
   unsigned long long bytes;
   unsigned long long rawEquivalent;
+
+  unsigned long long restoredPixels;
+  unsigned long long cacheBytes;
 };
 
 static struct stats runTest(const char *fn)
@@ -379,6 +515,7 @@ static struct stats runTest(const char *fn)
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec)/1000000.0;
   cc->getStats(s.ratio, s.bytes, s.rawEquivalent);
+  cc->getCacheStats(s.restoredPixels, s.cacheBytes);
 
   delete cc;
 
@@ -459,6 +596,11 @@ int main(int argc, char **argv)
     usage(argv[0]);
   }
 
+  if (rfb::encodingNum(encoding) == -1) {
+    fprintf(stderr, "Unknown encoding!\n\n");
+    usage(argv[0]);
+  }
+
   // Warmup
   runTest(fn);
 
@@ -479,6 +621,8 @@ int main(int argc, char **argv)
   sort(dev, runCount);
   meddev = dev[runCount/2];
 
+  printf("Encoding: %s\n", rfb::encodingName(rfb::encodingNum(encoding)));
+
   printf("CPU time (decoding): %g s (+/- %g %%)\n", median, meddev);
 
   // And for CPU usage encoding
@@ -495,6 +639,8 @@ int main(int argc, char **argv)
   meddev = dev[runCount/2];
 
   printf("CPU time (encoding): %g s (+/- %g %%)\n", median, meddev);
+  printf("Encoding speed: %g MB/s\n",
+         runs[0].rawEquivalent / median / (1000.0 * 1000.0));
 
   // And for CPU core usage encoding
   for (i = 0;i < runCount;i++)
@@ -515,5 +661,10 @@ int main(int argc, char **argv)
   printf("Raw equivalent bytes: %llu\n", runs[0].rawEquivalent);
   printf("Ratio: %g\n", runs[0].ratio);
 
+  if (contentCache > 0) {
+    printf("Content cache restored pixels: %llu\n", runs[0].restoredPixels);
+    printf("Content cache bytes: %llu\n", runs[0].cacheBytes);
+  }
+
   return 0;
 }
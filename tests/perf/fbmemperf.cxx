@@ -0,0 +1,194 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures how the placement of framebuffer memory
+ * affects the full screen passes a server does for every update: the
+ * comparison against the previous frame, and the conversion to the
+ * client's pixel format that precedes encoding. Each pass is run with
+ * the buffers allocated using every setting of FramebufferHugePages.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/Configuration.h>
+#include <rfb/PixelBuffer.h>
+
+#include "util.h"
+
+static rfb::IntParameter width("width", "Frame buffer width", 3840);
+static rfb::IntParameter height("height", "Frame buffer height", 2160);
+static rfb::IntParameter runs("runs", "Number of passes per test", 50);
+
+static const char* modes[] = { "None", "Transparent", "Explicit" };
+
+static const int tile = 64;
+
+static void fillRandom(rfb::ManagedPixelBuffer* pb)
+{
+  uint8_t* data;
+  int stride;
+
+  data = pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width() * 4; x++)
+      data[(y * stride) * 4 + x] = rand();
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+// Touch a few pixels spread out over the screen, so that almost all of
+// it has to be compared, like with a blinking cursor and a clock
+static void scatterChanges(rfb::ManagedPixelBuffer* pb)
+{
+  uint8_t* data;
+  int stride;
+
+  data = pb->getBufferRW(pb->getRect(), &stride);
+  for (int i = 0; i < 16; i++) {
+    int x, y;
+    x = rand() % pb->width();
+    y = rand() % pb->height();
+    data[(y * stride + x) * 4] ^= 0xff;
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static double testCompare()
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::ManagedPixelBuffer fb(pf, width, height);
+  rfb::ComparingUpdateTracker tracker(&fb);
+
+  fillRandom(&fb);
+
+  // The first call allocates and fills the copy of the framebuffer
+  tracker.compare();
+
+  startCpuCounter();
+
+  for (int i = 0; i < runs; i++) {
+    scatterChanges(&fb);
+    tracker.add_changed(fb.getRect());
+    tracker.compare();
+    tracker.clear();
+  }
+
+  endCpuCounter();
+
+  return getCpuCounter();
+}
+
+static double testConvert()
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::PixelFormat dstpf(16, 16, false, true, 31, 63, 31, 11, 5, 0);
+  rfb::ManagedPixelBuffer fb(pf, width, height);
+  rfb::ManagedPixelBuffer converted(dstpf, width, height);
+
+  fillRandom(&fb);
+
+  startCpuCounter();
+
+  for (int i = 0; i < runs; i++) {
+    // Same tile order as the encoder uses
+    for (int y = 0; y < fb.height(); y += tile) {
+      for (int x = 0; x < fb.width(); x += tile) {
+        rfb::Rect r(x, y, __rfbmin(x + tile, fb.width()),
+                    __rfbmin(y + tile, fb.height()));
+        const uint8_t* src;
+        uint8_t* dst;
+        int srcStride, dstStride;
+
+        src = fb.getBuffer(r, &srcStride);
+        dst = converted.getBufferRW(r, &dstStride);
+        dstpf.bufferFromBuffer(dst, pf, src, r.width(), r.height(),
+                               dstStride, srcStride);
+        converted.commitBufferRW(r);
+      }
+    }
+  }
+
+  endCpuCounter();
+
+  return getCpuCounter();
+}
+
+static void usage(const char* argv0)
+{
+  fprintf(stderr, "Syntax: %s [options]\n", argv0);
+  fprintf(stderr, "Options:\n");
+  rfb::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  time_t t;
+  char datebuffer[256];
+
+  for (int i = 1; i < argc; i++) {
+    if (rfb::Configuration::setParam(argv[i]))
+      continue;
+
+    if (argv[i][0] == '-') {
+      if (i + 1 < argc) {
+        if (rfb::Configuration::setParam(&argv[i][1], argv[i + 1])) {
+          i++;
+          continue;
+        }
+      }
+      usage(argv[0]);
+    }
+
+    usage(argv[0]);
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Framebuffer Memory Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Frame buffer: %dx%d pixels\n", (int)width, (int)height);
+  printf("# Passes: %d\n", (int)runs);
+  printf("#\n");
+  printf("# Note: Results are Mpixels/sec\n");
+  printf("#\n");
+
+  printf("Huge pages,Compare,Convert\n");
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+    double pixels;
+
+    rfb::Configuration::setParam("FramebufferHugePages", modes[i]);
+
+    pixels = (double)width * height * runs / (1000.0 * 1000.0);
+
+    printf("%s,%g,%g\n", modes[i],
+           pixels / testCompare(), pixels / testConvert());
+  }
+
+  return 0;
+}
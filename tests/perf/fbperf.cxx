@@ -35,6 +35,8 @@
 
 #include "util.h"
 
+static const int scales[] = { 75, 50, 33 };
+
 class TestWindow: public Fl_Window {
 public:
   TestWindow();
@@ -59,6 +61,7 @@ public:
 
 protected:
   PlatformPixelBuffer* fb;
+  int scale;
 };
 
 class PartialTestWindow: public TestWindow {
@@ -66,6 +69,11 @@ protected:
   virtual void changefb();
 };
 
+class ScaledTestWindow: public TestWindow {
+public:
+  ScaledTestWindow(int scale);
+};
+
 class OverlayTestWindow: public PartialTestWindow {
 public:
   OverlayTestWindow();
@@ -82,7 +90,7 @@ protected:
 
 TestWindow::TestWindow() :
   Fl_Window(0, 0, "Framebuffer Performance Test"),
-  fb(NULL)
+  fb(NULL), scale(100)
 {
 }
 
@@ -103,7 +111,8 @@ void TestWindow::start(int width, int height)
   frames = 0;
   time = 0;
 
-  fb = new PlatformPixelBuffer(w(), h());
+  fb = new PlatformPixelBuffer(w() * 100 / scale, h() * 100 / scale,
+                               w(), h());
 
   pixel = 0;
   fb->fillRect(fb->getRect(), &pixel);
@@ -207,6 +216,11 @@ void PartialTestWindow::changefb()
   fb->fillRect(r, &pixel);
 }
 
+ScaledTestWindow::ScaledTestWindow(int scale_)
+{
+  scale = scale_;
+}
+
 OverlayTestWindow::OverlayTestWindow() :
   overlay(NULL), offscreen(NULL)
 {
@@ -397,5 +411,13 @@ int main(int /*argc*/, char** /*argv*/)
   delete win;
   fprintf(stderr, "\n");
 
+  for (size_t i = 0; i < sizeof(scales) / sizeof(*scales); i++) {
+    fprintf(stderr, "Full window update scaled to %d%%:\n\n", scales[i]);
+    win = new ScaledTestWindow(scales[i]);
+    dotest(win);
+    delete win;
+    fprintf(stderr, "\n");
+  }
+
   return 0;
 }
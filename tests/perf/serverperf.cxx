@@ -0,0 +1,789 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures how well a complete server scales with the
+ * number of connected clients. The screen changes are replayed from an
+ * rfb file (see encperf) at a fixed rate, and a number of clients with
+ * different settings are connected over local socket pairs.
+ *
+ * The server runs on the main thread, and all the clients run on a
+ * second thread so that the CPU time of the server can be measured
+ * separately.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <list>
+#include <vector>
+
+#include <os/Mutex.h>
+#include <os/Thread.h>
+
+#include <rdr/Exception.h>
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rdr/FileInStream.h>
+#include <rdr/OutStream.h>
+
+#include <network/Socket.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/CSecurity.h>
+#include <rfb/Configuration.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/SDesktop.h>
+#include <rfb/SecurityClient.h>
+#include <rfb/SecurityServer.h>
+#include <rfb/Timer.h>
+#include <rfb/UpdateTracker.h>
+#include <rfb/UserMsgBox.h>
+#include <rfb/UserPasswdGetter.h>
+#include <rfb/VNCServerST.h>
+#include <rfb/encodings.h>
+
+static rfb::IntParameter width("width", "Frame buffer width", 0);
+static rfb::IntParameter height("height", "Frame buffer height", 0);
+static rfb::StringParameter format("format", "Pixel format (e.g. bgr888)", "");
+
+static rfb::StringParameter clientCounts("clients",
+                                         "Comma separated list of "
+                                         "number of clients to test with",
+                                         "1,2,5,10,20,50");
+static rfb::IntParameter rate("rate",
+                              "Rate (in frames per second) to replay "
+                              "the file at", 60);
+static rfb::IntParameter maxFrames("frames",
+                                   "Maximum number of frames to replay "
+                                   "(0 for the entire file)", 0);
+
+// Different kinds of clients that are connected in turn
+
+static const struct {
+  const char* name;
+  int encoding;
+  int quality;
+  int compress;
+} clientTypes[] = {
+  { "Tight q8", rfb::encodingTight, 8, 2 },
+  { "Tight lossless", rfb::encodingTight, -1, 2 },
+  { "ZRLE", rfb::encodingZRLE, -1, 6 },
+  { "Tight q2", rfb::encodingTight, 2, 6 },
+  { "Hextile", rfb::encodingHextile, -1, -1 },
+};
+
+static double getTime()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static double getThreadCpuTime()
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0.0;
+
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// A point in a client's stream where the server finished writing data
+// for a specific frame
+
+struct Marker {
+  size_t pos;
+  unsigned frame;
+};
+
+// Each client needs a unique address or the blacklist will kick in
+
+class PairSocket : public network::Socket {
+public:
+  PairSocket(int fd, int id) : Socket(fd) {
+    snprintf(address, sizeof(address), "client%d", id);
+  }
+
+  virtual const char* getPeerAddress() { return address; }
+  virtual const char* getPeerEndpoint() { return address; }
+
+protected:
+  char address[32];
+};
+
+// Security type None is used, so these should never be called
+
+class DummyPrompt : public rfb::UserPasswdGetter,
+                    public rfb::UserMsgBox {
+public:
+  virtual void getUserPasswd(bool, std::string*, std::string*) {
+    throw rdr::Exception("Unexpected password prompt");
+  }
+  virtual bool showMsgBox(int, const char*, const char*) {
+    return false;
+  }
+};
+
+class Desktop : public rfb::SDesktop {
+public:
+  Desktop(rfb::PixelBuffer* pb_) : pb(pb_) {}
+
+  virtual void start(rfb::VNCServer* vs) { vs->setPixelBuffer(pb); }
+  virtual void stop() {}
+  virtual void terminate() {}
+  virtual void queryConnection(network::Socket*, const char*) {}
+
+protected:
+  rfb::PixelBuffer* pb;
+};
+
+// Reads the recorded session directly in to the frame buffer
+
+class Replay : public rfb::CConnection {
+public:
+  Replay(const char *filename);
+  ~Replay();
+
+  // readFrame() reads the next frame from the file, returning false
+  // once the end of it has been reached
+  bool readFrame(rfb::Region* changed);
+
+  rfb::PixelBuffer* getPixelBuffer() { return getFramebuffer(); }
+
+  virtual void initDone() {}
+  virtual void resizeFramebuffer();
+  virtual void setCursor(int, int, const rfb::Point&, const uint8_t*) {}
+  virtual void setCursorPos(const rfb::Point&) {}
+  virtual void framebufferUpdateStart();
+  virtual void framebufferUpdateEnd();
+  virtual bool dataRect(const rfb::Rect&, int);
+  virtual void setColourMapEntries(int, int, uint16_t*) {}
+  virtual void bell() {}
+  virtual void serverCutText(const char*) {}
+
+protected:
+  class DummyOutStream : public rdr::OutStream {
+  public:
+    DummyOutStream() { ptr = buf; end = buf + sizeof(buf); }
+
+    virtual size_t length() { return 0; }
+    virtual void flush() { ptr = buf; }
+
+  private:
+    virtual void overrun(size_t) { flush(); }
+
+    uint8_t buf[1024];
+  };
+
+  rdr::FileInStream *in;
+  DummyOutStream out;
+
+  bool frameDone;
+  rfb::SimpleUpdateTracker updates;
+};
+
+class Client : public rfb::CConnection {
+public:
+  Client(int fd, int type);
+  ~Client();
+
+  int getFd() { return fd; }
+
+  // process() handles all available incoming data
+  void process();
+
+  // addMarker() is called by the server thread whenever it has
+  // finished writing something for a frame
+  void addMarker(size_t pos, unsigned frame);
+
+  virtual void initDone();
+  virtual void resizeFramebuffer();
+  virtual void setCursor(int, int, const rfb::Point&, const uint8_t*) {}
+  virtual void setCursorPos(const rfb::Point&) {}
+  virtual void framebufferUpdateEnd();
+  virtual void setColourMapEntries(int, int, uint16_t*) {}
+  virtual void bell() {}
+  virtual void serverCutText(const char*) {}
+
+public:
+  const char* typeName;
+
+  unsigned updates;
+  unsigned frames;
+  double totalLatency;
+  double maxLatency;
+
+protected:
+  int fd;
+  rdr::FdInStream in;
+  rdr::FdOutStream out;
+
+  os::Mutex mutex;
+  std::list<Marker> markers;
+  unsigned lastFrame;
+};
+
+// The shared state between the server and the client thread
+
+static os::Mutex frameMutex;
+static std::vector<double> frameTimes;
+
+class ClientThread : public os::Thread {
+public:
+  ClientThread(std::vector<Client*>* clients_)
+    : clients(clients_), stopRequested(false) {}
+
+  void stop() { os::AutoMutex a(&mutex); stopRequested = true; }
+
+protected:
+  virtual void worker();
+
+protected:
+  std::vector<Client*>* clients;
+
+  os::Mutex mutex;
+  bool stopRequested;
+};
+
+Replay::Replay(const char *filename)
+  : frameDone(false)
+{
+  in = new rdr::FileInStream(filename);
+  setStreams(in, &out);
+
+  // Need to skip the initial handshake and ServerInit
+  setState(RFBSTATE_NORMAL);
+  // That also means that the reader and writer weren't setup
+  setReader(new rfb::CMsgReader(this, in));
+  setWriter(new rfb::CMsgWriter(&server, &out));
+  // Nor the frame buffer size and format
+  rfb::PixelFormat pf;
+  pf.parse(format);
+  setPixelFormat(pf);
+  setDesktopSize(width, height);
+}
+
+Replay::~Replay()
+{
+  delete in;
+}
+
+bool Replay::readFrame(rfb::Region* changed)
+{
+  rfb::UpdateInfo ui;
+
+  frameDone = false;
+  updates.clear();
+
+  try {
+    while (!frameDone)
+      processMsg();
+  } catch (rdr::EndOfStream& e) {
+    return false;
+  }
+
+  updates.getUpdateInfo(&ui, getFramebuffer()->getRect());
+  *changed = ui.changed.union_(ui.copied);
+
+  return true;
+}
+
+void Replay::resizeFramebuffer()
+{
+  setFramebuffer(new rfb::ManagedPixelBuffer(server.pf(),
+                                             server.width(),
+                                             server.height()));
+}
+
+void Replay::framebufferUpdateStart()
+{
+  CConnection::framebufferUpdateStart();
+}
+
+void Replay::framebufferUpdateEnd()
+{
+  CConnection::framebufferUpdateEnd();
+  frameDone = true;
+}
+
+bool Replay::dataRect(const rfb::Rect &r, int encoding)
+{
+  if (!CConnection::dataRect(r, encoding))
+    return false;
+
+  updates.add_changed(rfb::Region(r));
+
+  return true;
+}
+
+Client::Client(int fd_, int type)
+  : updates(0), frames(0), totalLatency(0), maxLatency(0),
+    fd(fd_), in(fd_), out(fd_), lastFrame(0)
+{
+  typeName = clientTypes[type].name;
+
+  setStreams(&in, &out);
+  setShared(true);
+
+  setPreferredEncoding(clientTypes[type].encoding);
+  setQualityLevel(clientTypes[type].quality);
+  setCompressLevel(clientTypes[type].compress);
+
+  initialiseProtocol();
+}
+
+Client::~Client()
+{
+}
+
+void Client::process()
+{
+  out.flush();
+
+  out.cork(true);
+  while (processMsg())
+    ;
+  out.cork(false);
+}
+
+void Client::addMarker(size_t pos, unsigned frame)
+{
+  Marker marker;
+
+  marker.pos = pos;
+  marker.frame = frame;
+
+  os::AutoMutex a(&mutex);
+  markers.push_back(marker);
+}
+
+void Client::initDone()
+{
+  resizeFramebuffer();
+}
+
+void Client::resizeFramebuffer()
+{
+  setFramebuffer(new rfb::ManagedPixelBuffer(server.pf(),
+                                             server.width(),
+                                             server.height()));
+}
+
+void Client::framebufferUpdateEnd()
+{
+  size_t pos;
+  unsigned frame;
+  double now;
+
+  CConnection::framebufferUpdateEnd();
+
+  updates++;
+
+  // Figure out which frame we've now caught up with
+  pos = in.pos();
+  frame = lastFrame;
+  {
+    os::AutoMutex a(&mutex);
+    while (!markers.empty() && (markers.front().pos <= pos)) {
+      frame = markers.front().frame;
+      markers.pop_front();
+    }
+  }
+
+  if (frame == lastFrame)
+    return;
+
+  now = getTime();
+
+  os::AutoMutex a(&frameMutex);
+  for (lastFrame++; lastFrame <= frame; lastFrame++) {
+    double latency;
+
+    latency = now - frameTimes[lastFrame];
+
+    frames++;
+    totalLatency += latency;
+    if (latency > maxLatency)
+      maxLatency = latency;
+  }
+  lastFrame = frame;
+}
+
+void ClientThread::worker()
+{
+  std::vector<struct pollfd> fds(clients->size());
+
+  while (true) {
+    size_t i;
+
+    {
+      os::AutoMutex a(&mutex);
+      if (stopRequested)
+        break;
+    }
+
+    for (i = 0; i < clients->size(); i++) {
+      fds[i].fd = (*clients)[i]->getFd();
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+
+    if (poll(&fds[0], fds.size(), 10) < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "Failed to wait for clients: %s\n", strerror(errno));
+      exit(1);
+    }
+
+    for (i = 0; i < clients->size(); i++) {
+      if (fds[i].revents == 0)
+        continue;
+
+      try {
+        (*clients)[i]->process();
+      } catch (rdr::Exception& e) {
+        fprintf(stderr, "Client failed: %s\n", e.str());
+        exit(1);
+      }
+    }
+  }
+}
+
+struct stats
+{
+  unsigned frames;
+  double serverTime;
+  double latency;
+  double maxLatency;
+  double fairness;
+};
+
+static struct stats runTest(const char *fn, int clientCount)
+{
+  Replay *replay;
+  Desktop *desktop;
+  rfb::VNCServerST *server;
+
+  std::vector<network::Socket*> sockets;
+  std::vector<size_t> positions;
+  std::vector<Client*> clients;
+  ClientThread *thread;
+
+  unsigned frame;
+  double start, nextFrame, serverTime;
+  bool done;
+
+  struct stats s;
+  double sum, sumSq;
+  int i;
+
+  try {
+    replay = new Replay(fn);
+  } catch (rdr::Exception& e) {
+    fprintf(stderr, "Failed to open rfb file: %s\n", e.str());
+    exit(1);
+  }
+
+  desktop = new Desktop(replay->getPixelBuffer());
+  server = new rfb::VNCServerST("serverperf", desktop);
+  server->setPixelBuffer(replay->getPixelBuffer());
+
+  for (i = 0; i < clientCount; i++) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      fprintf(stderr, "Failed to create socket pair: %s\n",
+              strerror(errno));
+      exit(1);
+    }
+
+    sockets.push_back(new PairSocket(fds[0], i));
+    positions.push_back(0);
+    clients.push_back(new Client(fds[1], i % (sizeof(clientTypes) /
+                                              sizeof(*clientTypes))));
+
+    server->addSocket(sockets.back());
+  }
+
+  frameTimes.clear();
+  frameTimes.push_back(getTime());
+
+  thread = new ClientThread(&clients);
+  thread->start();
+
+  frame = 0;
+  serverTime = 0;
+  done = false;
+
+  start = getTime();
+  nextFrame = start;
+
+  // Keep going a bit after the last frame to let things settle
+  while (!done || (getTime() < nextFrame + 1.0)) {
+    std::vector<struct pollfd> fds(sockets.size());
+    double cpuStart, now;
+    int timeout;
+    size_t j;
+
+    now = getTime();
+
+    if (!done && (now >= nextFrame)) {
+      rfb::Region changed;
+
+      // Note that the replay is done on this thread, but doesn't count
+      // towards the server time
+      if (!replay->readFrame(&changed) ||
+          ((maxFrames > 0) && (frame >= (unsigned)maxFrames))) {
+        done = true;
+      } else {
+        frame++;
+
+        {
+          os::AutoMutex a(&frameMutex);
+          frameTimes.push_back(getTime());
+        }
+
+        cpuStart = getThreadCpuTime();
+        server->add_changed(changed);
+        serverTime += getThreadCpuTime() - cpuStart;
+
+        nextFrame += 1.0 / rate;
+      }
+    }
+
+    cpuStart = getThreadCpuTime();
+    timeout = rfb::Timer::checkTimeouts();
+    serverTime += getThreadCpuTime() - cpuStart;
+    if (timeout == 0)
+      timeout = -1;
+    if (!done) {
+      int frameTimeout;
+      frameTimeout = (nextFrame - getTime()) * 1000;
+      if (frameTimeout < 0)
+        frameTimeout = 0;
+      if ((timeout < 0) || (frameTimeout < timeout))
+        timeout = frameTimeout;
+    }
+    if ((timeout < 0) || (timeout > 100))
+      timeout = 100;
+
+    for (j = 0; j < sockets.size(); j++) {
+      fds[j].fd = sockets[j]->getFd();
+      fds[j].events = POLLIN;
+      if (sockets[j]->outStream().hasBufferedData())
+        fds[j].events |= POLLOUT;
+      fds[j].revents = 0;
+    }
+
+    if (poll(&fds[0], fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "Failed to wait for server: %s\n", strerror(errno));
+      exit(1);
+    }
+
+    cpuStart = getThreadCpuTime();
+
+    for (j = 0; j < sockets.size(); j++) {
+      if (fds[j].revents & POLLIN)
+        server->processSocketReadEvent(sockets[j]);
+      if (fds[j].revents & POLLOUT)
+        server->processSocketWriteEvent(sockets[j]);
+    }
+
+    serverTime += getThreadCpuTime() - cpuStart;
+
+    // Tell the clients about any frames the server has written
+    for (j = 0; j < sockets.size(); j++) {
+      size_t pos;
+
+      if (sockets[j]->isShutdown()) {
+        fprintf(stderr, "Server closed client connection\n");
+        exit(1);
+      }
+
+      pos = sockets[j]->outStream().length();
+      if (pos == positions[j])
+        continue;
+
+      clients[j]->addMarker(pos, frame);
+      positions[j] = pos;
+    }
+  }
+
+  thread->stop();
+  thread->wait();
+  delete thread;
+
+  s.frames = frame;
+  s.serverTime = serverTime;
+
+  // Latency for each client, and the fairness of the frames they got
+  // (Jain's fairness index)
+  s.latency = 0;
+  s.maxLatency = 0;
+  sum = sumSq = 0;
+  for (i = 0; i < clientCount; i++) {
+    Client* client;
+
+    client = clients[i];
+
+    if (client->frames > 0)
+      s.latency += client->totalLatency / client->frames;
+    if (client->maxLatency > s.maxLatency)
+      s.maxLatency = client->maxLatency;
+
+    sum += client->updates;
+    sumSq += (double)client->updates * client->updates;
+  }
+  s.latency /= clientCount;
+  if (sumSq > 0)
+    s.fairness = sum * sum / (clientCount * sumSq);
+  else
+    s.fairness = 0;
+
+  delete server;
+
+  for (i = 0; i < clientCount; i++) {
+    delete clients[i];
+    delete sockets[i];
+  }
+
+  delete desktop;
+  delete replay;
+
+  return s;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "Syntax: %s [options] <rfb file>\n", argv0);
+  fprintf(stderr, "Options:\n");
+  rfb::Configuration::listParams(79, 14);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+
+  const char *fn;
+  std::vector<int> counts;
+  DummyPrompt prompt;
+  char* str;
+  char* token;
+
+  fn = NULL;
+  for (i = 1; i < argc; i++) {
+    if (rfb::Configuration::setParam(argv[i]))
+      continue;
+
+    if (argv[i][0] == '-') {
+      if (i + 1 < argc) {
+        if (rfb::Configuration::setParam(&argv[i][1], argv[i + 1])) {
+          i++;
+          continue;
+        }
+      }
+      usage(argv[0]);
+    }
+
+    if (fn != NULL)
+      usage(argv[0]);
+
+    fn = argv[i];
+  }
+
+  if (fn == NULL) {
+    fprintf(stderr, "No file specified!\n\n");
+    usage(argv[0]);
+  }
+
+  if (strcmp(format, "") == 0) {
+    fprintf(stderr, "Pixel format not specified!\n\n");
+    usage(argv[0]);
+  }
+
+  if (width == 0 || height == 0) {
+    fprintf(stderr, "Frame buffer size not specified!\n\n");
+    usage(argv[0]);
+  }
+
+  if (rate <= 0) {
+    fprintf(stderr, "Invalid frame rate!\n\n");
+    usage(argv[0]);
+  }
+
+  str = strdup(clientCounts);
+  for (token = strtok(str, ","); token != NULL; token = strtok(NULL, ",")) {
+    int count = atoi(token);
+    if (count <= 0) {
+      fprintf(stderr, "Invalid client count: %s\n\n", token);
+      usage(argv[0]);
+    }
+    counts.push_back(count);
+  }
+  free(str);
+
+  // No authentication, as we only want to measure the updates
+  rfb::SecurityServer::secTypes.setParam("None");
+  rfb::SecurityClient::secTypes.setParam("None");
+  rfb::CSecurity::upg = &prompt;
+  rfb::CSecurity::msg = &prompt;
+
+  printf("Client types:");
+  for (i = 0; i < (int)(sizeof(clientTypes) / sizeof(*clientTypes)); i++)
+    printf(" %s%s", clientTypes[i].name,
+           i < (int)(sizeof(clientTypes) / sizeof(*clientTypes)) - 1 ?
+           "," : "\n");
+  printf("\n");
+
+  printf("%8s %8s %14s %14s %14s %10s\n", "Clients", "Frames",
+         "CPU/frame (ms)", "Latency (ms)", "Max lat. (ms)", "Fairness");
+
+  for (i = 0; i < (int)counts.size(); i++) {
+    struct stats s;
+
+    s = runTest(fn, counts[i]);
+
+    printf("%8d %8u %14.3f %14.3f %14.3f %10.3f\n", counts[i], s.frames,
+           s.frames ? s.serverTime * 1000 / s.frames : 0.0,
+           s.latency * 1000, s.maxLatency * 1000, s.fairness);
+    fflush(stdout);
+  }
+
+  return 0;
+}
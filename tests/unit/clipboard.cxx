@@ -0,0 +1,189 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <rfb/ClipboardWorker.h>
+
+static void fillPayload(rfb::ClipboardPayload* payload, size_t size)
+{
+    payload->flags = 0x5;
+    payload->formats.clear();
+    payload->formats.push_back(std::vector<uint8_t>(size));
+    payload->formats.push_back(std::vector<uint8_t>(size / 2));
+
+    for (size_t i = 0; i < size; i++)
+        payload->formats[0][i] = i % 251;
+    for (size_t i = 0; i < size / 2; i++)
+        payload->formats[1][i] = i % 13;
+}
+
+static bool waitResult(rfb::ClipboardWorker* worker,
+                       rfb::ClipboardPayload* payload, bool* failed)
+{
+    // Give the worker up to ten seconds
+    for (int i = 0; i < 1000; i++) {
+        if (worker->getResult(payload, failed))
+            return true;
+        usleep(10000);
+    }
+
+    return false;
+}
+
+static void testRoundTrip(size_t size)
+{
+    rfb::ClipboardPayload payload, expected;
+
+    printf("Round trip of %d bytes: ", (int)size);
+
+    fillPayload(&payload, size);
+    fillPayload(&expected, size);
+
+    rfb::ClipboardWorker::compress(&payload);
+    payload.formats.clear();
+
+    if (!rfb::ClipboardWorker::decompress(&payload, size))
+        printf("FAILED: decompression failed");
+    else if ((payload.flags != expected.flags) ||
+             (payload.formats != expected.formats))
+        printf("FAILED: data mismatch");
+    else
+        printf("OK");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void testTooLong()
+{
+    rfb::ClipboardPayload payload;
+
+    printf("Dropping too long format: ");
+
+    fillPayload(&payload, 1000);
+    rfb::ClipboardWorker::compress(&payload);
+
+    if (!rfb::ClipboardWorker::decompress(&payload, 500))
+        printf("FAILED: decompression failed");
+    else if ((payload.flags != 0x4) || (payload.formats.size() != 1) ||
+             (payload.formats[0].size() != 500))
+        printf("FAILED: format was not dropped");
+    else
+        printf("OK");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void testCorrupt()
+{
+    rfb::ClipboardPayload payload;
+
+    printf("Corrupt data: ");
+
+    fillPayload(&payload, 1000);
+    rfb::ClipboardWorker::compress(&payload);
+    payload.compressed.resize(payload.compressed.size() / 2);
+
+    if (rfb::ClipboardWorker::decompress(&payload, 1000))
+        printf("FAILED: corruption not detected");
+    else
+        printf("OK");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void testWorker()
+{
+    rfb::ClipboardWorker worker;
+    rfb::ClipboardPayload payload, expected;
+    bool failed;
+
+    printf("Background compression: ");
+
+    fillPayload(&payload, 4 * 1024 * 1024);
+    fillPayload(&expected, 4 * 1024 * 1024);
+
+    worker.startCompress(&payload);
+    if (!payload.formats.empty()) {
+        printf("FAILED: payload was not taken over\n");
+        return;
+    }
+
+    if (!waitResult(&worker, &payload, &failed)) {
+        printf("FAILED: no result\n");
+        return;
+    }
+
+    worker.startDecompress(&payload, 4 * 1024 * 1024);
+    if (!waitResult(&worker, &payload, &failed))
+        printf("FAILED: no result");
+    else if (failed)
+        printf("FAILED: decompression failed");
+    else if (payload.formats != expected.formats)
+        printf("FAILED: data mismatch");
+    else if (worker.isBusy())
+        printf("FAILED: still busy");
+    else
+        printf("OK");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void testCancel()
+{
+    rfb::ClipboardWorker worker;
+    rfb::ClipboardPayload payload;
+    bool failed;
+
+    printf("Cancelled job: ");
+
+    fillPayload(&payload, 4 * 1024 * 1024);
+    worker.startCompress(&payload);
+    worker.cancel();
+
+    // Make sure the job has had time to finish if it was started
+    while (worker.isBusy())
+        usleep(10000);
+
+    if (worker.getResult(&payload, &failed))
+        printf("FAILED: got a result");
+    else
+        printf("OK");
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    testRoundTrip(0);
+    testRoundTrip(1);
+    testRoundTrip(100 * 1024);
+
+    testTooLong();
+    testCorrupt();
+
+    testWorker();
+    testCancel();
+
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 static const uint8_t pixelRed = 0xf1;
 static const uint8_t pixelGreen = 0xc3;
@@ -260,11 +261,65 @@ static bool testPixelRGB(const rfb::PixelFormat &dstpf,
   return true;
 }
 
+static bool testSIMD(const rfb::PixelFormat &dstpf,
+                     const rfb::PixelFormat &srcpf)
+{
+  int i, unaligned;
+  uint8_t bufIn[fbMalloc];
+  uint8_t bufOut[fbMalloc], bufRef[fbMalloc];
+
+  if (rfb::simdGetName() == NULL)
+    return true;
+
+  // Random data, and an odd width to also get the remaining pixels
+  // that the vectorised code leaves to the generic code
+  for (i = 0;i < fbMalloc;i++)
+    bufIn[i] = rand();
+
+  for (unaligned = 0;unaligned < 2;unaligned++) {
+    memset(bufRef, 0, sizeof(bufRef));
+    rfb::simdSetEnabled(false);
+    dstpf.bufferFromBuffer(bufRef + unaligned, srcpf, bufIn + unaligned,
+                           fbWidth - 3, fbHeight, fbWidth, fbWidth);
+    rfb::simdSetEnabled(true);
+    memset(bufOut, 0, sizeof(bufOut));
+    dstpf.bufferFromBuffer(bufOut + unaligned, srcpf, bufIn + unaligned,
+                           fbWidth - 3, fbHeight, fbWidth, fbWidth);
+    if (memcmp(bufOut, bufRef, sizeof(bufOut)) != 0)
+      return false;
+
+    memset(bufRef, 0, sizeof(bufRef));
+    rfb::simdSetEnabled(false);
+    srcpf.rgbFromBuffer(bufRef + unaligned, bufIn + unaligned,
+                        fbWidth - 3, fbWidth, fbHeight);
+    rfb::simdSetEnabled(true);
+    memset(bufOut, 0, sizeof(bufOut));
+    srcpf.rgbFromBuffer(bufOut + unaligned, bufIn + unaligned,
+                        fbWidth - 3, fbWidth, fbHeight);
+    if (memcmp(bufOut, bufRef, sizeof(bufOut)) != 0)
+      return false;
+
+    memset(bufRef, 0, sizeof(bufRef));
+    rfb::simdSetEnabled(false);
+    dstpf.bufferFromRGB(bufRef + unaligned, bufIn + unaligned,
+                        fbWidth - 3, fbWidth, fbHeight);
+    rfb::simdSetEnabled(true);
+    memset(bufOut, 0, sizeof(bufOut));
+    dstpf.bufferFromRGB(bufOut + unaligned, bufIn + unaligned,
+                        fbWidth - 3, fbWidth, fbHeight);
+    if (memcmp(bufOut, bufRef, sizeof(bufOut)) != 0)
+      return false;
+  }
+
+  return true;
+}
+
 struct TestEntry tests[] = {
   {"Pixel from pixel", testPixel},
   {"Buffer from buffer", testBuffer},
   {"Buffer to/from RGB", testRGB},
   {"Pixel to/from RGB", testPixelRGB},
+  {"Vectorised code", testSIMD},
 };
 
 static void doTests(const rfb::PixelFormat &dstpf,
@@ -296,6 +351,8 @@ int main(int /*argc*/, char** /*argv*/)
   rfb::PixelFormat dstpf, srcpf;
 
   printf("Pixel Conversion Correctness Test\n");
+  printf("Vector instructions: %s\n",
+         rfb::simdGetName() ? rfb::simdGetName() : "none");
 
   /* rgb888 targets */
 
@@ -0,0 +1,169 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rfb/Cursor.h>
+#include <rfb/PixelFormatSIMD.h>
+
+static const int fbWidth = 40;
+static const int fbHeight = 30;
+
+static const int cursorWidth = 21;
+static const int cursorHeight = 17;
+
+static void fillRandom(rfb::ManagedPixelBuffer* pb)
+{
+  uint8_t* data;
+  int stride;
+
+  data = pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width() * (pb->getPF().bpp / 8); x++)
+      data[y * stride * (pb->getPF().bpp / 8) + x] = rand();
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static rfb::Cursor* makeCursor()
+{
+  uint8_t data[cursorWidth * cursorHeight * 4];
+
+  for (int i = 0; i < cursorWidth * cursorHeight; i++) {
+    data[i * 4 + 0] = rand();
+    data[i * 4 + 1] = rand();
+    data[i * 4 + 2] = rand();
+    // Make sure we get plenty of the special cases
+    switch (rand() % 3) {
+    case 0:
+      data[i * 4 + 3] = 0x00;
+      break;
+    case 1:
+      data[i * 4 + 3] = 0xff;
+      break;
+    default:
+      data[i * 4 + 3] = rand();
+    }
+  }
+
+  return new rfb::Cursor(cursorWidth, cursorHeight,
+                         rfb::Point(5, 3), data);
+}
+
+// Straightforward version of what RenderedCursor does
+static bool verifyPixel(const rfb::PixelBuffer* fb,
+                        const rfb::Cursor* cursor,
+                        const rfb::RenderedCursor* rendered,
+                        const rfb::Point& cursorTL, int x, int y)
+{
+  const rfb::PixelFormat& pf = fb->getPF();
+  uint8_t bg[4], out[4];
+  uint8_t bgRGB[3], outRGB[3], expected[3];
+  const uint8_t* fg;
+  unsigned alpha;
+
+  fb->getImage(bg, rfb::Rect(x, y, x + 1, y + 1));
+  rendered->getImage(out, rfb::Rect(x, y, x + 1, y + 1));
+
+  pf.rgbFromBuffer(bgRGB, bg, 1);
+  pf.rgbFromBuffer(outRGB, out, 1);
+
+  fg = cursor->getBuffer() +
+       ((y - cursorTL.y) * cursor->width() + (x - cursorTL.x)) * 4;
+  alpha = fg[3];
+
+  for (int c = 0; c < 3; c++) {
+    expected[c] = (fg[c] * alpha + 127) / 255 +
+                  (bgRGB[c] * (255 - alpha) + 127) / 255;
+  }
+
+  // The framebuffer format might not be able to represent the exact
+  // value, so convert the expected value the same way
+  pf.bufferFromRGB(bg, expected, 1);
+  pf.rgbFromBuffer(expected, bg, 1);
+
+  return memcmp(expected, outRGB, 3) == 0;
+}
+
+static void testRender(const char* name, const rfb::PixelFormat& pf,
+                       const rfb::Point& pos, bool simd)
+{
+  rfb::ManagedPixelBuffer fb(pf, fbWidth, fbHeight);
+  rfb::RenderedCursor rendered;
+  rfb::Cursor* cursor;
+  rfb::Rect r;
+  rfb::Point cursorTL;
+
+  printf("%s at %d,%d%s: ", name, pos.x, pos.y,
+         simd ? " (vectorised)" : "");
+
+  rfb::simdSetEnabled(simd);
+
+  fillRandom(&fb);
+  cursor = makeCursor();
+
+  rendered.update(&fb, cursor, pos);
+
+  cursorTL = pos.subtract(cursor->hotspot());
+  r = rfb::Rect(0, 0, cursor->width(), cursor->height())
+      .translate(cursorTL).intersect(fb.getRect());
+
+  if (rendered.getEffectiveRect() != r) {
+    printf("FAILED: wrong area\n");
+    delete cursor;
+    return;
+  }
+
+  for (int y = r.tl.y; y < r.br.y; y++) {
+    for (int x = r.tl.x; x < r.br.x; x++) {
+      if (!verifyPixel(&fb, cursor, &rendered, cursorTL, x, y)) {
+        printf("FAILED: mismatch at %d,%d\n", x, y);
+        delete cursor;
+        return;
+      }
+    }
+  }
+
+  printf("OK\n");
+  fflush(stdout);
+
+  delete cursor;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  rfb::PixelFormat rgb888(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::PixelFormat rgb565(16, 16, false, true, 31, 63, 31, 11, 5, 0);
+  rfb::Point positions[] = { rfb::Point(10, 10), rfb::Point(2, 1),
+                             rfb::Point(35, 27) };
+
+  for (size_t i = 0; i < sizeof(positions) / sizeof(*positions); i++) {
+    for (int simd = 0; simd < 2; simd++) {
+      testRender("RGB888", rgb888, positions[i], simd);
+      testRender("RGB565", rgb565, positions[i], simd);
+    }
+  }
+
+  return 0;
+}
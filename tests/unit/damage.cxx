@@ -0,0 +1,260 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../../unix/xserver/hw/vnc/vncDamage.h"
+#include "../../unix/xserver/hw/vnc/vncExtInit.h"
+
+static const int tileSize = 16;
+
+static int screenWidth, screenHeight;
+static std::vector<UpdateRect> flushed;
+
+void vncAddChanged(int /*scrIdx*/, int nRects, const UpdateRect* rects)
+{
+  flushed.insert(flushed.end(), rects, rects + nRects);
+}
+
+static UpdateRect makeRect(int x1, int y1, int x2, int y2)
+{
+  UpdateRect rect;
+
+  rect.x1 = x1;
+  rect.y1 = y1;
+  rect.x2 = x2;
+  rect.y2 = y2;
+
+  return rect;
+}
+
+static void paint(std::vector<bool>* pixels, const UpdateRect& rect)
+{
+  for (int y = rect.y1; y < rect.y2; y++) {
+    for (int x = rect.x1; x < rect.x2; x++)
+      (*pixels)[y * screenWidth + x] = true;
+  }
+}
+
+// Checks that everything that was added was also flushed, and that
+// nothing was flushed outside the screen or the damaged tiles
+static bool checkFlushed(const std::vector<bool>& added)
+{
+  std::vector<bool> result(added.size());
+
+  for (size_t i = 0; i < flushed.size(); i++) {
+    const UpdateRect& r = flushed[i];
+
+    if ((r.x1 < 0) || (r.y1 < 0) ||
+        (r.x2 > screenWidth) || (r.y2 > screenHeight) ||
+        (r.x1 >= r.x2) || (r.y1 >= r.y2)) {
+      printf("FAILED (bad rect %d,%d-%d,%d)\n", r.x1, r.y1, r.x2, r.y2);
+      return false;
+    }
+
+    paint(&result, r);
+  }
+
+  for (int y = 0; y < screenHeight; y++) {
+    for (int x = 0; x < screenWidth; x++) {
+      bool inTile;
+
+      if (added[y * screenWidth + x] && !result[y * screenWidth + x]) {
+        printf("FAILED (%d,%d was lost)\n", x, y);
+        return false;
+      }
+
+      if (!result[y * screenWidth + x] || added[y * screenWidth + x])
+        continue;
+
+      inTile = false;
+      for (int ty = y / tileSize * tileSize;
+           (ty < y / tileSize * tileSize + tileSize) && (ty < screenHeight);
+           ty++) {
+        for (int tx = x / tileSize * tileSize;
+             (tx < x / tileSize * tileSize + tileSize) &&
+             (tx < screenWidth);
+             tx++)
+          inTile = inTile || added[ty * screenWidth + tx];
+      }
+
+      if (!inTile) {
+        printf("FAILED (%d,%d is not near any change)\n", x, y);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void testExact()
+{
+  struct VncDamage damage;
+  UpdateRect rects[3];
+
+  printf("Exact rectangles: ");
+
+  screenWidth = 200;
+  screenHeight = 100;
+  flushed.clear();
+
+  vncDamageInit(&damage);
+
+  rects[0] = makeRect(1, 2, 3, 4);
+  rects[1] = makeRect(10, 20, 30, 40);
+  rects[2] = makeRect(50, 60, 70, 80);
+
+  vncDamageAdd(&damage, 0, screenWidth, screenHeight, 4, 2, rects);
+  vncDamageAdd(&damage, 0, screenWidth, screenHeight, 4, 1, rects + 2);
+
+  if (!flushed.empty()) {
+    printf("FAILED (flushed too early)\n");
+    vncDamageFree(&damage);
+    return;
+  }
+
+  vncDamageFlush(&damage, 0, screenWidth, screenHeight);
+
+  if ((flushed.size() != 3) ||
+      (memcmp(flushed.data(), rects, sizeof(rects)) != 0)) {
+    printf("FAILED (rectangles changed)\n");
+    vncDamageFree(&damage);
+    return;
+  }
+
+  flushed.clear();
+  vncDamageFlush(&damage, 0, screenWidth, screenHeight);
+  if (!flushed.empty()) {
+    printf("FAILED (flushed twice)\n");
+    vncDamageFree(&damage);
+    return;
+  }
+
+  vncDamageFree(&damage);
+
+  printf("OK\n");
+}
+
+static void testMerge()
+{
+  struct VncDamage damage;
+
+  printf("Merged tile rows: ");
+
+  screenWidth = 200;
+  screenHeight = 100;
+  flushed.clear();
+
+  vncDamageInit(&damage);
+
+  // One column of small changes, which should become one tall
+  // rectangle once it is tracked as tiles
+  for (int y = 10; y < 90; y += 2) {
+    UpdateRect rect;
+
+    rect = makeRect(40, y, 41, y + 1);
+    vncDamageAdd(&damage, 0, screenWidth, screenHeight, 4, 1, &rect);
+  }
+
+  vncDamageFlush(&damage, 0, screenWidth, screenHeight);
+
+  if ((flushed.size() != 1) ||
+      (flushed[0].x1 != 32) || (flushed[0].x2 != 48) ||
+      (flushed[0].y1 != 0) || (flushed[0].y2 != 96)) {
+    printf("FAILED (got %d rectangles)\n", (int)flushed.size());
+    vncDamageFree(&damage);
+    return;
+  }
+
+  vncDamageFree(&damage);
+
+  printf("OK\n");
+}
+
+static void testRandom()
+{
+  struct VncDamage damage;
+
+  printf("Random changes: ");
+
+  vncDamageInit(&damage);
+
+  for (int iter = 0; iter < 500; iter++) {
+    std::vector<bool> added;
+    int maxRects, count;
+
+    // The screen size changes, as if it had been resized
+    screenWidth = 1 + rand() % 400;
+    screenHeight = 1 + rand() % 300;
+    maxRects = 1 + rand() % 20;
+
+    added.assign(screenWidth * screenHeight, false);
+    flushed.clear();
+
+    count = rand() % 60;
+    for (int i = 0; i < count; i++) {
+      UpdateRect rects[4];
+      int nRects;
+
+      nRects = 1 + rand() % 4;
+      for (int j = 0; j < nRects; j++) {
+        int x, y;
+
+        x = rand() % screenWidth;
+        y = rand() % screenHeight;
+        rects[j] = makeRect(x, y,
+                            x + 1 + rand() % std::min(40, screenWidth - x),
+                            y + 1 + rand() % std::min(40, screenHeight - y));
+        paint(&added, rects[j]);
+      }
+
+      vncDamageAdd(&damage, 0, screenWidth, screenHeight, maxRects,
+                   nRects, rects);
+    }
+
+    vncDamageFlush(&damage, 0, screenWidth, screenHeight);
+
+    if (!checkFlushed(added)) {
+      vncDamageFree(&damage);
+      return;
+    }
+  }
+
+  vncDamageFree(&damage);
+
+  printf("OK\n");
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  testExact();
+  testMerge();
+  testRandom();
+
+  return 0;
+}
@@ -0,0 +1,801 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/CConnection.h>
+#include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/ContentCache.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/ServerCore.h>
+#include <rfb/UpdateTracker.h>
+#include <rfb/encodings.h>
+
+#include "testutil.h"
+
+//
+// Adaptive compression level
+//
+
+// Enough updates for several rounds of measurements, even on a fast
+// machine
+static const int minUpdates = 100;
+static const int maxUpdates = 1000;
+
+static void testLevel(const char* name, int32_t encoding,
+                      size_t bandwidth, int expected)
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  int32_t encodings[3];
+
+  printf("    %s: ", name);
+
+  encodings[0] = encoding;
+  encodings[1] = rfb::pseudoEncodingLastRect;
+  encodings[2] = rfb::pseudoEncodingCompressLevel0 + 6;
+
+  sconn.setup(3, encodings);
+
+  manager.setLinkBandwidth(bandwidth);
+
+  for (int i = 0; i < maxUpdates; i++) {
+    rfb::UpdateInfo ui;
+
+    fillText(&pb, pb.getRect());
+
+    ui.changed = rfb::Region(pb.getRect());
+    manager.writeUpdate(ui, &pb, NULL);
+    out.clear();
+
+    if ((manager.compressLevel() == expected) && (i >= minUpdates))
+      break;
+  }
+
+  if (manager.compressLevel() != expected) {
+    printf("FAILED: level %d, expected %d\n",
+           manager.compressLevel(), expected);
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testCompressLevel()
+{
+  printf("Compression level:\n");
+
+  // Nothing to compare with, so the client's level is used
+  testLevel("Tight (unknown link)", rfb::encodingTight, 0, 6);
+  // No encoder can keep up with this, so the lowest level is best
+  testLevel("Tight (fast link)", rfb::encodingTight, (size_t)1 << 40, 0);
+  testLevel("ZRLE (fast link)", rfb::encodingZRLE, (size_t)1 << 40, 0);
+
+  // And nothing is too slow for this one
+  testLevel("Tight (slow link)", rfb::encodingTight, 1, 6);
+}
+
+//
+// Content cache
+//
+
+class DummyCConnection : public rfb::CConnection {
+public:
+  DummyCConnection(rdr::InStream* is, rdr::OutStream* os)
+  {
+    setStreams(is, os);
+    setState(RFBSTATE_NORMAL);
+    setReader(new rfb::CMsgReader(this, is));
+    setWriter(new rfb::CMsgWriter(&server, os));
+    setContentCacheSize(1);
+    setPixelFormat(fbPF);
+    setDesktopSize(fbWidth, fbHeight);
+
+    badUpdate = -1;
+    updates = 0;
+  }
+
+  virtual void initDone() {}
+  virtual void resizeFramebuffer()
+  {
+    setFramebuffer(new rfb::ManagedPixelBuffer(server.pf(), server.width(),
+                                               server.height()));
+  }
+  virtual void setCursor(int, int, const rfb::Point&, const uint8_t*) {}
+  virtual void setCursorPos(const rfb::Point&) {}
+  virtual void setColourMapEntries(int, int, uint16_t*) {}
+  virtual void bell() {}
+  virtual void serverCutText(const char*) {}
+
+  virtual void framebufferUpdateEnd();
+
+  using rfb::CConnection::getFramebuffer;
+
+  // What the framebuffer should look like after each update
+  std::vector<const rfb::PixelBuffer*> expected;
+  int badUpdate;
+
+private:
+  size_t updates;
+};
+
+void DummyCConnection::framebufferUpdateEnd()
+{
+  CConnection::framebufferUpdateEnd();
+
+  if ((badUpdate == -1) && !expected.empty() &&
+      !sameContents(expected[updates], getFramebuffer()))
+    badUpdate = updates;
+
+  updates++;
+}
+
+static void testCacheIndex()
+{
+  rfb::ContentCache cache;
+  unsigned slot;
+
+  printf("    Index: ");
+
+  cache.setSlots(3);
+
+  if ((cache.insert(1) != 0) || (cache.insert(2) != 1) ||
+      (cache.insert(3) != 2)) {
+    printf("FAILED: slots not filled in order\n");
+    return;
+  }
+
+  // Makes 2 the least recently used
+  if (!cache.lookup(1, &slot) || (slot != 0)) {
+    printf("FAILED: missing entry\n");
+    return;
+  }
+
+  if (cache.insert(4) != 1) {
+    printf("FAILED: wrong slot replaced\n");
+    return;
+  }
+
+  if (cache.lookup(2, &slot)) {
+    printf("FAILED: replaced entry still present\n");
+    return;
+  }
+
+  if (!cache.lookup(3, &slot) || (slot != 2)) {
+    printf("FAILED: missing entry\n");
+    return;
+  }
+
+  cache.setSlots(3);
+  if (cache.lookup(1, &slot)) {
+    printf("FAILED: entry survived resize\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testCacheHash()
+{
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  rfb::Rect a(0, 0, 37, 20), b(100, 50, 137, 70);
+  uint64_t hash;
+  uint8_t* data;
+  int stride;
+
+  printf("    Hash: ");
+
+  fillText(&pb, pb.getRect());
+
+  // Make b a copy of a
+  data = pb.getBufferRW(b, &stride);
+  pb.getImage(data, a, stride);
+  pb.commitBufferRW(b);
+
+  hash = rfb::ContentCache::hashRect(&pb, a);
+
+  if (rfb::ContentCache::hashRect(&pb, b) != hash) {
+    printf("FAILED: same pixels give different hashes\n");
+    return;
+  }
+
+  if (rfb::ContentCache::hashRect(&pb, rfb::Rect(0, 0, 20, 37)) == hash) {
+    printf("FAILED: different shapes give the same hash\n");
+    return;
+  }
+
+  data = pb.getBufferRW(rfb::Rect(136, 69, 137, 70), &stride);
+  data[0] ^= 1;
+  pb.commitBufferRW(rfb::Rect(136, 69, 137, 70));
+
+  if (rfb::ContentCache::hashRect(&pb, b) == hash) {
+    printf("FAILED: changed pixel gives the same hash\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testCacheSwitching(const char* name, int32_t encoding,
+                               int quality, bool photo, bool rapid)
+{
+  rdr::MemOutStream serverOut, clientOut;
+  DummySConnection sconn(&serverOut);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer screenA(fbPF, fbWidth, fbHeight);
+  rfb::ManagedPixelBuffer screenB(fbPF, fbWidth, fbHeight);
+  std::vector<const rfb::PixelBuffer*> sequence;
+  int32_t encodings[4];
+
+  printf("    %s: ", name);
+
+  encodings[0] = encoding;
+  encodings[1] = rfb::pseudoEncodingLastRect;
+  encodings[2] = rfb::pseudoEncodingContentCache0;
+  encodings[3] = rfb::pseudoEncodingQualityLevel0 + quality;
+
+  sconn.setup(quality >= 0 ? 4 : 3, encodings);
+
+  if (photo) {
+    fillPhoto(&screenA, screenA.getRect());
+    fillPhoto(&screenB, screenB.getRect());
+  } else {
+    fillText(&screenA, screenA.getRect());
+    fillText(&screenB, screenB.getRect());
+  }
+
+  // Like switching back and forth between two windows
+  sequence.push_back(&screenA);
+  sequence.push_back(&screenB);
+  sequence.push_back(&screenA);
+  sequence.push_back(&screenB);
+  sequence.push_back(&screenA);
+  sequence.push_back(&screenB);
+
+  for (size_t i = 0; i < sequence.size(); i++) {
+    rfb::UpdateInfo ui;
+
+    ui.changed = rfb::Region(sequence[i]->getRect());
+    manager.writeUpdate(ui, sequence[i], NULL);
+    // Otherwise everything looks like video
+    if (!rapid)
+      manager.expireRecentChanges();
+  }
+
+  rdr::MemInStream is(serverOut.data(), serverOut.length());
+  DummyCConnection cconn(&is, &clientOut);
+
+  // JPEG can't be compared exactly, but the cache still has to be
+  // consistent enough for the client to decode everything
+  if (!photo)
+    cconn.expected = sequence;
+  while (is.avail() > 0)
+    cconn.processMsg();
+
+  if (cconn.badUpdate != -1) {
+    printf("FAILED: wrong contents after update %d\n", cconn.badUpdate);
+    return;
+  }
+
+  if (!photo && (manager.cacheRestores() == 0)) {
+    printf("FAILED: nothing restored from the cache\n");
+    return;
+  }
+
+  if (photo && (manager.cacheStores() != 0)) {
+    printf("FAILED: lossy content stored in the cache\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testContentCache()
+{
+  printf("Content cache:\n");
+
+  testCacheIndex();
+  testCacheHash();
+
+  testCacheSwitching("ZRLE", rfb::encodingZRLE, -1, false, false);
+  testCacheSwitching("ZRLE (rapid switching)", rfb::encodingZRLE, -1,
+                     false, true);
+  testCacheSwitching("Tight", rfb::encodingTight, -1, false, false);
+  testCacheSwitching("Tight (JPEG)", rfb::encodingTight, 5, true, false);
+}
+
+//
+// Lossless refresh
+//
+
+// Two areas with a gap between them
+static const rfb::Rect leftArea(0, 0, 80, 150);
+static const rfb::Rect rightArea(120, 0, 200, 150);
+
+static void testRefreshFocus(const char* name, const rfb::Point& focus,
+                             const rfb::Rect& first,
+                             const rfb::Rect& second)
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  rfb::Region all(pb.getRect());
+  rfb::UpdateInfo ui;
+  int32_t encodings[2];
+  size_t budget;
+
+  printf("    %s: ", name);
+
+  encodings[0] = rfb::encodingTight;
+  encodings[1] = rfb::pseudoEncodingQualityLevel0 + 5;
+
+  sconn.setup(2, encodings);
+
+  fillPhoto(&pb, pb.getRect());
+
+  ui.changed.assign_union(rfb::Region(leftArea));
+  ui.changed.assign_union(rfb::Region(rightArea));
+  manager.writeUpdate(ui, &pb, NULL);
+  manager.expireRecentChanges();
+  manager.expireRecentChanges();
+
+  if (!manager.needsLosslessRefresh(rfb::Region(leftArea)) ||
+      !manager.needsLosslessRefresh(rfb::Region(rightArea))) {
+    printf("FAILED: update was not lossy\n");
+    return;
+  }
+
+  // Enough for one of the areas at the guessed ratio of 2:1
+  budget = first.area() * (fbPF.bpp / 8) / 2;
+  manager.writeLosslessRefresh(all, &pb, NULL, budget, focus);
+
+  if (manager.needsLosslessRefresh(rfb::Region(first))) {
+    printf("FAILED: area closest to the focus not refreshed\n");
+    return;
+  }
+
+  if (!manager.needsLosslessRefresh(rfb::Region(second))) {
+    printf("FAILED: refresh went over budget\n");
+    return;
+  }
+
+  if (manager.refreshedUpdates() != 0) {
+    printf("FAILED: partially refreshed update counted as refreshed\n");
+    return;
+  }
+
+  manager.writeLosslessRefresh(all, &pb, NULL, budget * 100, focus);
+
+  if (manager.needsLosslessRefresh(all)) {
+    printf("FAILED: lossy areas left after refresh\n");
+    return;
+  }
+
+  if (manager.refreshedUpdates() != 1) {
+    printf("FAILED: refreshed update not counted\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void makeLossy(TestEncodeManager* manager,
+                      rfb::ManagedPixelBuffer* pb)
+{
+  rfb::UpdateInfo ui;
+
+  fillPhoto(pb, pb->getRect());
+
+  ui.changed = rfb::Region(pb->getRect());
+  manager->writeUpdate(ui, pb, NULL);
+  manager->expireRecentChanges();
+  manager->expireRecentChanges();
+}
+
+static void testRefreshRatio()
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  rfb::Region all(pb.getRect());
+  rfb::Point focus(10, 75);
+  int32_t encodings[3];
+  size_t budget;
+
+  printf("    Encoder ratios: ");
+
+  encodings[0] = rfb::encodingTight;
+  encodings[1] = rfb::encodingZRLE;
+  encodings[2] = rfb::pseudoEncodingQualityLevel0 + 5;
+
+  sconn.setup(3, encodings);
+
+  // Noise, so much worse than the guessed ratio of 2:1
+  for (int i = 0; i < 3; i++) {
+    makeLossy(&manager, &pb);
+    manager.writeLosslessRefresh(all, &pb, NULL, (size_t)1 << 30, focus);
+  }
+
+  makeLossy(&manager, &pb);
+
+  // Enough for the left area at the guessed ratio
+  budget = leftArea.area() * (fbPF.bpp / 8) / 2;
+  manager.writeLosslessRefresh(all, &pb, NULL, budget, focus);
+
+  if (!manager.needsLosslessRefresh(rfb::Region(leftArea))) {
+    printf("FAILED: measured ratio not used\n");
+    return;
+  }
+
+  makeLossy(&manager, &pb);
+
+  // Nothing is known about this encoder yet
+  encodings[0] = rfb::encodingZRLE;
+  encodings[1] = rfb::encodingTight;
+  sconn.setup(3, encodings);
+
+  if (!manager.needsLosslessRefresh(rfb::Region(leftArea))) {
+    printf("FAILED: update was not lossy\n");
+    return;
+  }
+
+  manager.writeLosslessRefresh(all, &pb, NULL, budget, focus);
+
+  if (manager.needsLosslessRefresh(rfb::Region(leftArea))) {
+    printf("FAILED: ratio of another encoder used\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testLosslessRefresh()
+{
+  printf("Lossless refresh:\n");
+
+  testRefreshFocus("Focus left", rfb::Point(10, 75), leftArea, rightArea);
+  testRefreshFocus("Focus right", rfb::Point(190, 75), rightArea, leftArea);
+  testRefreshRatio();
+}
+
+//
+// Region of interest
+//
+
+static const rfb::Rect interestArea(60, 40, 140, 110);
+
+// Returns the size of the update
+static size_t writeInterestUpdate(int quality, int boost,
+                                  bool* interestLossy,
+                                  bool* backgroundLossy)
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  rfb::Region background;
+  rfb::UpdateInfo ui;
+  int32_t encodings[2];
+  int oldBoost;
+
+  encodings[0] = rfb::encodingTight;
+  encodings[1] = rfb::pseudoEncodingQualityLevel0 + quality;
+
+  sconn.setup(2, encodings);
+
+  oldBoost = rfb::Server::roiQualityBoost;
+  rfb::Server::roiQualityBoost.setParam(boost);
+
+  srand(0);
+  fillPhoto(&pb, pb.getRect());
+
+  ui.changed = rfb::Region(pb.getRect());
+  manager.setRegionOfInterest(rfb::Region(interestArea));
+  manager.writeUpdate(ui, &pb, NULL);
+
+  rfb::Server::roiQualityBoost.setParam(oldBoost);
+
+  background = rfb::Region(pb.getRect()).subtract(rfb::Region(interestArea));
+  *interestLossy = manager.needsLosslessRefresh(rfb::Region(interestArea));
+  *backgroundLossy = manager.needsLosslessRefresh(background);
+
+  return out.length();
+}
+
+static void testInterestLossless()
+{
+  bool interestLossy, backgroundLossy;
+
+  printf("    Lossless interest: ");
+
+  writeInterestUpdate(8, 2, &interestLossy, &backgroundLossy);
+
+  if (interestLossy) {
+    printf("FAILED: interest sent lossy\n");
+    return;
+  }
+
+  if (!backgroundLossy) {
+    printf("FAILED: background sent lossless\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testInterestBudget()
+{
+  bool interestLossy, backgroundLossy;
+  size_t plain, boosted;
+
+  printf("    Budget: ");
+
+  plain = writeInterestUpdate(6, 0, &interestLossy, &backgroundLossy);
+  if (!interestLossy || !backgroundLossy) {
+    printf("FAILED: update was not lossy\n");
+    return;
+  }
+
+  boosted = writeInterestUpdate(6, 1, &interestLossy, &backgroundLossy);
+  if (!interestLossy || !backgroundLossy) {
+    printf("FAILED: boosted update was not lossy\n");
+    return;
+  }
+
+  // The interest is about a fifth of the screen, so lowering the
+  // quality of the rest should more than make up for it
+  if (boosted > plain) {
+    printf("FAILED: %d bytes instead of %d\n", (int)boosted, (int)plain);
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testRegionOfInterest()
+{
+  printf("Region of interest:\n");
+
+  testInterestLossless();
+  testInterestBudget();
+}
+
+//
+// Video detection
+//
+
+// Exactly four tiles
+static const rfb::Rect videoArea(0, 0, 128, 128);
+// Like text being typed
+static const rfb::Rect typingArea(150, 130, 160, 140);
+// Next to the video
+static const rfb::Rect photoArea(136, 0, 200, 64);
+
+static void setupVideo(DummySConnection* sconn)
+{
+  int32_t encodings[3];
+
+  encodings[0] = rfb::encodingTight;
+  encodings[1] = rfb::pseudoEncodingLastRect;
+  encodings[2] = rfb::pseudoEncodingQualityLevel0 + 8;
+
+  sconn->setup(3, encodings);
+}
+
+static void testVideoPlaying()
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+
+  printf("    Playing: ");
+
+  setupVideo(&sconn);
+
+  fillText(&pb, pb.getRect());
+
+  for (int i = 0; i < 10; i++) {
+    rfb::UpdateInfo ui;
+
+    fillPhoto(&pb, videoArea);
+    fillText(&pb, typingArea);
+
+    ui.changed.assign_union(rfb::Region(videoArea));
+    ui.changed.assign_union(rfb::Region(typingArea));
+    manager.writeUpdate(ui, &pb, NULL);
+  }
+
+  if (manager.video() != rfb::Region(videoArea)) {
+    printf("FAILED: video not found\n");
+    return;
+  }
+
+  manager.expireRecentChanges();
+  manager.expireRecentChanges();
+
+  if (!manager.pendingRefresh().intersect(rfb::Region(videoArea)).is_empty()) {
+    printf("FAILED: video refreshed while playing\n");
+    return;
+  }
+
+  usleep(600000);
+  manager.expireRecentChanges();
+
+  if (!manager.video().is_empty()) {
+    printf("FAILED: video still found after it stopped\n");
+    return;
+  }
+
+  if (manager.pendingRefresh().intersect(rfb::Region(videoArea)).is_empty()) {
+    printf("FAILED: video not refreshed after it stopped\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testVideoSwitching()
+{
+  rdr::MemOutStream out;
+  DummySConnection sconn(&out);
+  TestEncodeManager manager(&sconn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+
+  printf("    Window switching: ");
+
+  setupVideo(&sconn);
+
+  for (int i = 0; i < 10; i++) {
+    rfb::UpdateInfo ui;
+
+    fillText(&pb, pb.getRect());
+
+    ui.changed = rfb::Region(pb.getRect());
+    manager.writeUpdate(ui, &pb, NULL);
+  }
+
+  if (!manager.video().is_empty()) {
+    printf("FAILED: text mistaken for video\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+// Decodes everything the server has sent, and returns what the client
+// ends up with in the given area
+static void decodeArea(rdr::MemOutStream* serverOut, const rfb::Rect& r,
+                       rfb::ManagedPixelBuffer* result)
+{
+  rdr::MemInStream is(serverOut->data(), serverOut->length());
+  rdr::MemOutStream clientOut;
+  DummyCConnection cconn(&is, &clientOut);
+  uint8_t* data;
+  int stride;
+
+  while (is.avail() > 0)
+    cconn.processMsg();
+
+  data = result->getBufferRW(result->getRect(), &stride);
+  cconn.getFramebuffer()->getImage(data, r, stride);
+  result->commitBufferRW(result->getRect());
+}
+
+static void testVideoQuality()
+{
+  rdr::MemOutStream out, refOut;
+  DummySConnection sconn(&out), refSConn(&refOut);
+  TestEncodeManager manager(&sconn), refManager(&refSConn);
+  rfb::ManagedPixelBuffer pb(fbPF, fbWidth, fbHeight);
+  rfb::ManagedPixelBuffer area(fbPF, photoArea.width(), photoArea.height());
+  rfb::ManagedPixelBuffer refArea(fbPF, photoArea.width(), photoArea.height());
+  rfb::UpdateInfo ui, refUi;
+
+  printf("    Quality of other rects: ");
+
+  setupVideo(&sconn);
+  setupVideo(&refSConn);
+
+  // Makes the video quality go down
+  manager.setLinkBandwidth(1);
+  refManager.setLinkBandwidth(1);
+
+  fillText(&pb, pb.getRect());
+
+  ui.changed = rfb::Region(pb.getRect());
+  manager.writeUpdate(ui, &pb, NULL);
+  refManager.writeUpdate(ui, &pb, NULL);
+
+  for (int i = 0; i < 30; i++) {
+    rfb::UpdateInfo videoUi;
+
+    fillPhoto(&pb, videoArea);
+
+    videoUi.changed = rfb::Region(videoArea);
+    manager.writeUpdate(videoUi, &pb, NULL);
+  }
+
+  if (manager.videoQuality() >= 0) {
+    printf("FAILED: video quality not lowered\n");
+    return;
+  }
+
+  // A picture that isn't video, in the same update as a video frame
+  fillPhoto(&pb, videoArea);
+  fillPhoto(&pb, photoArea);
+
+  ui.changed = rfb::Region(videoArea);
+  ui.changed.assign_union(rfb::Region(photoArea));
+  manager.writeUpdate(ui, &pb, NULL);
+
+  if (manager.video() != rfb::Region(videoArea)) {
+    printf("FAILED: video not found\n");
+    return;
+  }
+
+  // The same picture on its own
+  refUi.changed = rfb::Region(photoArea);
+  refManager.writeUpdate(refUi, &pb, NULL);
+
+  decodeArea(&out, photoArea, &area);
+  decodeArea(&refOut, photoArea, &refArea);
+
+  if (!sameContents(&area, &refArea)) {
+    printf("FAILED: picture sent at the video quality\n");
+    return;
+  }
+
+  printf("OK\n");
+}
+
+static void testVideo()
+{
+  printf("Video:\n");
+
+  testVideoPlaying();
+  testVideoSwitching();
+  testVideoQuality();
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  testCompressLevel();
+  testContentCache();
+  testLosslessRefresh();
+  testRegionOfInterest();
+  testVideo();
+
+  return 0;
+}
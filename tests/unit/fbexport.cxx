@@ -0,0 +1,402 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <rdr/MemInStream.h>
+#include <rfb/FramebufferExporter.h>
+
+static const int fbWidth = 64;
+static const int fbHeight = 32;
+static const int fbStride = 80;
+
+static rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static char sockPath[108];
+
+static int createFramebuffer(uint32_t** pixels)
+{
+  int fd;
+
+  // Same as Xvnc
+  fd = memfd_create("fbexport", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    return -1;
+
+  if (ftruncate(fd, fbStride * fbHeight * 4) < 0)
+    return -1;
+
+  *pixels = (uint32_t*)mmap(NULL, fbStride * fbHeight * 4,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (*pixels == MAP_FAILED)
+    return -1;
+
+  for (int i = 0; i < fbStride * fbHeight; i++)
+    (*pixels)[i] = i;
+
+  return fd;
+}
+
+static int connectConsumer()
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd < 0)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, sockPath);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static bool receiveInfo(int fd, rfb::FramebufferExportInfo* info,
+                        int* fbFd)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+
+  iov.iov_base = info;
+  iov.iov_len = sizeof(*info);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  if (recvmsg(fd, &msg, MSG_DONTWAIT) != sizeof(*info))
+    return false;
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if ((cmsg == NULL) || (cmsg->cmsg_type != SCM_RIGHTS))
+    return false;
+
+  memcpy(fbFd, CMSG_DATA(cmsg), sizeof(int));
+
+  return info->type == rfb::framebufferExportMsgInfo;
+}
+
+// Consumers can open the memory again via /proc, so that must not
+// give them write access either
+static bool checkReadOnly(int fbFd, const rfb::FramebufferExportInfo* info)
+{
+  char path[64];
+  void* mapped;
+  uint32_t pixel;
+  int fd;
+
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fbFd);
+  fd = open(path, O_RDWR);
+  // Refusing to open it is fine, but root can always do that
+  if (fd < 0)
+    return true;
+
+  mapped = mmap(NULL, info->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, info->offset);
+  if (mapped != MAP_FAILED) {
+    munmap(mapped, info->size);
+    close(fd);
+    return false;
+  }
+
+  pixel = 0;
+  if (pwrite(fd, &pixel, sizeof(pixel), info->offset) >= 0) {
+    close(fd);
+    return false;
+  }
+
+  if (ftruncate(fd, 0) == 0) {
+    close(fd);
+    return false;
+  }
+
+  close(fd);
+
+  return true;
+}
+
+static void testInfo()
+{
+  rfb::FramebufferExporter* exporter;
+  rfb::FramebufferExportInfo info;
+  rfb::PixelFormat pf;
+  uint32_t *pixels, *mapped;
+  int fd, consumer, fbFd;
+
+  printf("Framebuffer info: ");
+
+  fd = createFramebuffer(&pixels);
+  if (fd < 0) {
+    printf("FAILED (cannot create framebuffer)\n");
+    return;
+  }
+
+  exporter = new rfb::FramebufferExporter(sockPath, 0600);
+  exporter->setFramebuffer(fd, fbStride * fbHeight * 4, 0,
+                           fbWidth, fbHeight, fbStride, fbPF);
+
+  consumer = connectConsumer();
+  exporter->accept();
+
+  if (!receiveInfo(consumer, &info, &fbFd)) {
+    printf("FAILED (no info received)\n");
+    goto out;
+  }
+
+  if ((info.version != rfb::framebufferExportVersion) ||
+      (info.width != fbWidth) || (info.height != fbHeight) ||
+      (info.stride != fbStride)) {
+    printf("FAILED (wrong geometry)\n");
+    goto out;
+  }
+
+  {
+    rdr::MemInStream mis(info.pixelFormat, sizeof(info.pixelFormat));
+    pf.read(&mis);
+    if (pf != fbPF) {
+      printf("FAILED (wrong pixel format)\n");
+      goto out;
+    }
+  }
+
+  mapped = (uint32_t*)mmap(NULL, info.size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fbFd, info.offset);
+  if (mapped != MAP_FAILED) {
+    printf("FAILED (framebuffer is writable)\n");
+    munmap(mapped, info.size);
+    goto out;
+  }
+
+  if (!checkReadOnly(fbFd, &info)) {
+    printf("FAILED (framebuffer is writable when opened again)\n");
+    goto out;
+  }
+
+  mapped = (uint32_t*)mmap(NULL, info.size, PROT_READ, MAP_SHARED,
+                           fbFd, info.offset);
+  if (mapped == MAP_FAILED) {
+    printf("FAILED (cannot map framebuffer)\n");
+    goto out;
+  }
+
+  pixels[fbStride * 5 + 7] = 0xdeadbeef;
+  if (mapped[fbStride * 5 + 7] != 0xdeadbeef) {
+    printf("FAILED (pixels not shared)\n");
+    munmap(mapped, info.size);
+    goto out;
+  }
+
+  munmap(mapped, info.size);
+  close(fbFd);
+
+  printf("OK\n");
+
+out:
+  close(consumer);
+  delete exporter;
+  munmap(pixels, fbStride * fbHeight * 4);
+  close(fd);
+}
+
+static void testUpdates()
+{
+  rfb::FramebufferExporter* exporter;
+  rfb::FramebufferExportInfo info;
+  uint8_t buffer[65536];
+  rfb::FramebufferExportUpdate* update;
+  rfb::FramebufferExportRect* rects;
+  uint32_t* pixels;
+  int fd, consumer, fbFd;
+  ssize_t len;
+
+  printf("Damage updates: ");
+
+  fd = createFramebuffer(&pixels);
+  if (fd < 0) {
+    printf("FAILED (cannot create framebuffer)\n");
+    return;
+  }
+
+  exporter = new rfb::FramebufferExporter(sockPath, 0600);
+  exporter->setFramebuffer(fd, fbStride * fbHeight * 4, 0,
+                           fbWidth, fbHeight, fbStride, fbPF);
+
+  consumer = connectConsumer();
+  exporter->accept();
+
+  if (!receiveInfo(consumer, &info, &fbFd)) {
+    printf("FAILED (no info received)\n");
+    goto out;
+  }
+  close(fbFd);
+
+  exporter->add_changed(rfb::Region(rfb::Rect(1, 2, 3, 4)));
+  exporter->add_changed(rfb::Region(rfb::Rect(10, 20, 30, 25)));
+  exporter->flush();
+
+  // Nothing new, so nothing should be sent
+  exporter->flush();
+
+  len = recv(consumer, buffer, sizeof(buffer), MSG_DONTWAIT);
+  if (len < (ssize_t)sizeof(*update)) {
+    printf("FAILED (no update received)\n");
+    goto out;
+  }
+
+  update = (rfb::FramebufferExportUpdate*)buffer;
+  rects = (rfb::FramebufferExportRect*)(buffer + sizeof(*update));
+
+  if ((update->type != rfb::framebufferExportMsgUpdate) ||
+      (update->sequence != info.sequence + 1) ||
+      (update->numRects != 2) ||
+      (len != (ssize_t)(sizeof(*update) + 2 * sizeof(*rects)))) {
+    printf("FAILED (bad update header)\n");
+    goto out;
+  }
+
+  if ((rects[0].x != 1) || (rects[0].y != 2) ||
+      (rects[0].width != 2) || (rects[0].height != 2) ||
+      (rects[1].x != 10) || (rects[1].y != 20) ||
+      (rects[1].width != 20) || (rects[1].height != 5)) {
+    printf("FAILED (wrong rectangles)\n");
+    goto out;
+  }
+
+  if (recv(consumer, buffer, sizeof(buffer), MSG_DONTWAIT) >= 0) {
+    printf("FAILED (unexpected extra message)\n");
+    goto out;
+  }
+
+  // Many small changes should be merged in to their bounding box
+  for (int i = 0; i < fbHeight; i++)
+    exporter->add_changed(rfb::Region(rfb::Rect(i, i, i + 1, i + 1)));
+  for (int i = 0; i < fbHeight; i++) {
+    int x = fbWidth - 1 - i;
+    exporter->add_changed(rfb::Region(rfb::Rect(x, i, x + 1, i + 1)));
+  }
+  for (int i = 0; i < 300; i++) {
+    int x = (i * 7) % fbWidth, y = (i * 13) % fbHeight;
+    exporter->add_changed(rfb::Region(rfb::Rect(x, y, x + 1, y + 1)));
+  }
+  exporter->flush();
+
+  len = recv(consumer, buffer, sizeof(buffer), MSG_DONTWAIT);
+  if ((len < (ssize_t)sizeof(*update)) ||
+      (update->sequence != info.sequence + 2) ||
+      (update->numRects > 256)) {
+    printf("FAILED (bad large update)\n");
+    goto out;
+  }
+
+  printf("OK\n");
+
+out:
+  close(consumer);
+  delete exporter;
+  munmap(pixels, fbStride * fbHeight * 4);
+  close(fd);
+}
+
+static void testDisconnect()
+{
+  rfb::FramebufferExporter* exporter;
+  uint32_t* pixels;
+  int fd, consumer, serverFd;
+
+  printf("Consumer disconnect: ");
+
+  fd = createFramebuffer(&pixels);
+  if (fd < 0) {
+    printf("FAILED (cannot create framebuffer)\n");
+    return;
+  }
+
+  exporter = new rfb::FramebufferExporter(sockPath, 0600);
+  exporter->setFramebuffer(fd, fbStride * fbHeight * 4, 0,
+                           fbWidth, fbHeight, fbStride, fbPF);
+
+  consumer = connectConsumer();
+  serverFd = exporter->accept();
+
+  if (!exporter->isConsumer(serverFd) ||
+      !exporter->processConsumer(serverFd)) {
+    printf("FAILED (consumer not registered)\n");
+    close(consumer);
+    goto out;
+  }
+
+  close(consumer);
+
+  if (exporter->processConsumer(serverFd)) {
+    printf("FAILED (disconnect not noticed)\n");
+    goto out;
+  }
+
+  exporter->removeConsumer(serverFd);
+  if (exporter->isConsumer(serverFd)) {
+    printf("FAILED (consumer not removed)\n");
+    goto out;
+  }
+
+  // Make sure nothing breaks without any consumers
+  exporter->add_changed(rfb::Region(rfb::Rect(0, 0, 1, 1)));
+  exporter->flush();
+
+  printf("OK\n");
+
+out:
+  delete exporter;
+  munmap(pixels, fbStride * fbHeight * 4);
+  close(fd);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  snprintf(sockPath, sizeof(sockPath), "/tmp/fbexport-%d.sock",
+           (int)getpid());
+
+  testInfo();
+  testUpdates();
+  testDisconnect();
+
+  return 0;
+}
@@ -0,0 +1,286 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
+#include <rfb/ScaleFilters.h>
+#include <rfb/ScaledPixelBuffer.h>
+
+#include "testutil.h"
+
+static const int srcWidth = 101;
+static const int srcHeight = 67;
+
+static const int scales[] = { 100, 75, 50, 33, 10 };
+
+static rfb::PixelFormat srcPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static void fillRandom(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r)
+{
+  uint8_t* data;
+  int stride;
+
+  data = pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width() * 4; x++)
+      data[y * stride * 4 + x] = rand();
+  }
+  pb->commitBufferRW(r);
+}
+
+static void testSolid(unsigned int filter, int width, int height)
+{
+  rfb::ManagedPixelBuffer src(srcPF, srcWidth, srcHeight);
+  rfb::ScaledPixelBuffer* scaled;
+  uint8_t pixel[4];
+  const uint8_t* data;
+  int stride;
+
+  printf("    Solid colour: ");
+
+  srcPF.bufferFromRGB(pixel, (const uint8_t*)"\x12\x80\xff", 1);
+  src.fillRect(src.getRect(), pixel);
+
+  scaled = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  scaled->refresh();
+
+  data = scaled->getBuffer(scaled->getRect(), &stride);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (memcmp(data + (y * stride + x) * 4, pixel, 4) != 0) {
+        printf("FAILED (mismatch at %d,%d)\n", x, y);
+        delete scaled;
+        return;
+      }
+    }
+  }
+
+  delete scaled;
+
+  printf("OK\n");
+}
+
+static void testIncremental(unsigned int filter, int width, int height)
+{
+  rfb::ManagedPixelBuffer src(srcPF, srcWidth, srcHeight);
+  rfb::ScaledPixelBuffer *scaled, *reference;
+
+  printf("    Incremental updates: ");
+
+  fillRandom(&src, src.getRect());
+
+  scaled = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  scaled->refresh();
+
+  for (int i = 0; i < 20; i++) {
+    rfb::Rect r;
+
+    r.tl.x = rand() % srcWidth;
+    r.tl.y = rand() % srcHeight;
+    r.br.x = r.tl.x + 1 + rand() % (srcWidth - r.tl.x);
+    r.br.y = r.tl.y + 1 + rand() % (srcHeight - r.tl.y);
+
+    fillRandom(&src, r);
+
+    scaled->invalidate(scaled->scaleRegion(r));
+    scaled->refresh();
+  }
+
+  reference = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  reference->refresh();
+
+  if (sameContents(scaled, reference))
+    printf("OK\n");
+  else
+    printf("FAILED\n");
+
+  delete reference;
+  delete scaled;
+}
+
+static void testSIMD(unsigned int filter, int width, int height)
+{
+  rfb::ManagedPixelBuffer src(srcPF, srcWidth, srcHeight);
+  rfb::ScaledPixelBuffer *vectorised, *generic;
+
+  printf("    Vectorised code: ");
+
+  if (rfb::simdGetName() == NULL) {
+    printf("SKIPPED (not available)\n");
+    return;
+  }
+
+  fillRandom(&src, src.getRect());
+
+  vectorised = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  vectorised->refresh();
+
+  rfb::simdSetEnabled(false);
+  generic = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  generic->refresh();
+  rfb::simdSetEnabled(true);
+
+  if (sameContents(vectorised, generic))
+    printf("OK\n");
+  else
+    printf("FAILED\n");
+
+  delete generic;
+  delete vectorised;
+}
+
+static void testPoints(unsigned int filter, int width, int height)
+{
+  rfb::ManagedPixelBuffer src(srcPF, srcWidth, srcHeight);
+  rfb::ScaledPixelBuffer scaled(&src, width, height, filter);
+
+  printf("    Coordinate mapping: ");
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      rfb::Point p;
+
+      p = scaled.unscalePoint(rfb::Point(x, y));
+      if (!src.getRect().contains(p)) {
+        printf("FAILED (%d,%d outside source)\n", p.x, p.y);
+        return;
+      }
+      if (scaled.scalePoint(p) != rfb::Point(x, y)) {
+        printf("FAILED (%d,%d does not map back)\n", x, y);
+        return;
+      }
+    }
+  }
+
+  printf("OK\n");
+}
+
+static void testExternal(unsigned int filter, int width, int height)
+{
+  rfb::ManagedPixelBuffer src(srcPF, srcWidth, srcHeight);
+  rfb::ScaledPixelBuffer *scaled, *reference;
+  std::vector<uint8_t> memory;
+  int stride;
+
+  printf("    Caller's memory: ");
+
+  fillRandom(&src, src.getRect());
+
+  // Like an XImage, with padding at the end of each row that must be
+  // left alone
+  stride = width + 7;
+  memory.resize(stride * height * 4, 0xa5);
+
+  scaled = new rfb::ScaledPixelBuffer(&src, width, height, filter,
+                                      memory.data(), stride);
+  scaled->refresh();
+
+  reference = new rfb::ScaledPixelBuffer(&src, width, height, filter);
+  reference->refresh();
+
+  if (!sameContents(scaled, reference)) {
+    printf("FAILED (wrong contents)\n");
+    goto out;
+  }
+
+  for (int y = 0; y < height; y++) {
+    for (int x = width * 4; x < stride * 4; x++) {
+      if (memory[y * stride * 4 + x] != 0xa5) {
+        printf("FAILED (padding overwritten at row %d)\n", y);
+        goto out;
+      }
+    }
+  }
+
+  printf("OK\n");
+
+out:
+  delete reference;
+  delete scaled;
+}
+
+static void testWeights(unsigned int filter, int width)
+{
+  rfb::ScaleFilters filters;
+  rfb::SFilterWeightTab* tabs;
+  bool ok;
+
+  printf("    Weight sums: ");
+
+  filters.makeWeightTabs(filter, srcWidth, width, &tabs);
+
+  ok = true;
+  for (int x = 0; x < width; x++) {
+    int sum;
+
+    sum = 0;
+    for (int i = 0; i < tabs[x].i1 - tabs[x].i0; i++)
+      sum += tabs[x].weight[i];
+    if (sum != WEIGHT_OF_ONE) {
+      printf("FAILED (weights for %d add up to %d)\n", x, sum);
+      ok = false;
+      break;
+    }
+  }
+
+  for (int x = 0; x < width; x++)
+    delete [] tabs[x].weight;
+  delete [] tabs;
+
+  if (ok)
+    printf("OK\n");
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  rfb::ScaleFilters filters;
+
+  for (unsigned int filter = 0; filter <= rfb::scaleFilterMaxNumber;
+       filter++) {
+    for (size_t i = 0; i < sizeof(scales) / sizeof(*scales); i++) {
+      int width, height;
+
+      width = srcWidth * scales[i] / 100;
+      height = srcHeight * scales[i] / 100;
+
+      printf("%s, %dx%d to %dx%d:\n", filters[filter].name,
+             srcWidth, srcHeight, width, height);
+
+      testSolid(filter, width, height);
+      testIncremental(filter, width, height);
+      testSIMD(filter, width, height);
+      testPoints(filter, width, height);
+      testExternal(filter, width, height);
+      testWeights(filter, width);
+
+      printf("\n");
+    }
+  }
+
+  return 0;
+}
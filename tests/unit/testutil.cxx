@@ -0,0 +1,116 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <rfb/Palette.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SMsgWriter.h>
+
+#include "testutil.h"
+
+const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+
+DummySConnection::DummySConnection(rdr::OutStream* os)
+{
+  setStreams(NULL, os);
+  setWriter(new rfb::SMsgWriter(&client, os));
+}
+
+void DummySConnection::setup(int nEncodings, const int32_t* encodings)
+{
+  client.setPF(fbPF);
+  client.setDimensions(fbWidth, fbHeight);
+  setEncodings(nEncodings, encodings);
+}
+
+void fillText(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r)
+{
+  uint32_t* data;
+  int stride;
+  uint32_t colours[2];
+
+  colours[0] = rand() & 0xffffff;
+  colours[1] = rand() & 0xffffff;
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++)
+      data[y * stride + x] = colours[(x % 7 < 3) && (rand() % 3)];
+  }
+  pb->commitBufferRW(r);
+}
+
+void fillPhoto(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r)
+{
+  uint32_t* data;
+  int stride;
+
+  data = (uint32_t*)pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++)
+      data[y * stride + x] = (x * 0x010203 + y * 0x030201 + rand()) & 0xffffff;
+  }
+  pb->commitBufferRW(r);
+}
+
+void makePalette(const rfb::PixelBuffer* pb, rfb::Palette* palette)
+{
+  const uint8_t* data;
+  int stride, bpp;
+
+  palette->clear();
+
+  bpp = pb->getPF().bpp / 8;
+  data = pb->getBuffer(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width(); x++) {
+      uint32_t value;
+
+      value = 0;
+      memcpy(&value, data + (y * stride + x) * bpp, bpp);
+      if (!palette->insert(value, 1)) {
+        palette->clear();
+        return;
+      }
+    }
+  }
+}
+
+bool sameContents(const rfb::PixelBuffer* a, const rfb::PixelBuffer* b)
+{
+  const uint8_t *dataA, *dataB;
+  int strideA, strideB, bpp;
+
+  bpp = a->getPF().bpp / 8;
+  dataA = a->getBuffer(a->getRect(), &strideA);
+  dataB = b->getBuffer(b->getRect(), &strideB);
+
+  for (int y = 0; y < a->height(); y++) {
+    if (memcmp(dataA + y * strideA * bpp, dataB + y * strideB * bpp,
+               a->width() * bpp) != 0)
+      return false;
+  }
+
+  return true;
+}
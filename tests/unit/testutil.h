@@ -0,0 +1,90 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// testutil.h - fixture shared by the encoding and scaling tests
+//
+
+#ifndef __TESTUTIL_H__
+#define __TESTUTIL_H__
+
+#include <rfb/ContentCache.h>
+#include <rfb/EncodeManager.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/SConnection.h>
+
+namespace rfb {
+  class ManagedPixelBuffer;
+  class Palette;
+  class PixelBuffer;
+}
+
+// Framebuffer used unless a test needs something specific
+static const int fbWidth = 200;
+static const int fbHeight = 150;
+
+extern const rfb::PixelFormat fbPF;
+
+// Server connection that writes everything to the given stream
+class DummySConnection : public rfb::SConnection {
+public:
+  DummySConnection(rdr::OutStream* os);
+
+  // setup() gives the client fbPF, the framebuffer size, and the
+  // specified encodings
+  void setup(int nEncodings, const int32_t* encodings);
+
+  virtual void setAccessRights(AccessRights) {}
+  virtual void setDesktopSize(int, int, const rfb::ScreenSet&) {}
+};
+
+// Exposes the internal state of EncodeManager to the tests
+class TestEncodeManager : public rfb::EncodeManager {
+public:
+  TestEncodeManager(rfb::SConnection* conn) : EncodeManager(conn) {}
+
+  int compressLevel() { return adaptiveLevel; }
+
+  unsigned cacheRestores() { return cacheStats[rfb::contentCacheRestore].rects; }
+  unsigned cacheStores() { return cacheStats[rfb::contentCacheStore].rects; }
+
+  unsigned refreshedUpdates() { return lossyCleared; }
+  const rfb::Region& pendingRefresh() { return pendingRefreshRegion; }
+
+  const rfb::Region& video() { return videoRegion; }
+  int videoQuality() { return videoQualityOffset; }
+
+  // Makes the next update unrelated to the previous ones as far as
+  // the tracking of recent changes goes. Doing it twice also lets
+  // lossy areas get scheduled for a refresh.
+  void expireRecentChanges() { handleTimeout(&recentChangeTimer); }
+};
+
+// fillText() draws something that looks a bit like text, which the
+// encoders handle losslessly, and fillPhoto() something photo like
+// that gets JPEG. Both expect fbPF.
+void fillText(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r);
+void fillPhoto(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r);
+
+// makePalette() collects the colours of the buffer, or leaves the
+// palette empty if there are too many
+void makePalette(const rfb::PixelBuffer* pb, rfb::Palette* palette);
+
+bool sameContents(const rfb::PixelBuffer* a, const rfb::PixelBuffer* b);
+
+#endif
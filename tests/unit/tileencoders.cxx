@@ -0,0 +1,205 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/Configuration.h>
+#include <rfb/HextileDecoder.h>
+#include <rfb/HextileEncoder.h>
+#include <rfb/Palette.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
+#include <rfb/RREDecoder.h>
+#include <rfb/RREEncoder.h>
+#include <rfb/SConnection.h>
+#include <rfb/ServerParams.h>
+#include <rfb/encodings.h>
+
+#include "testutil.h"
+
+enum Pattern { Solid, Text, Stripes, FewColours, Noise };
+
+static const char* patternNames[] = {
+  "solid", "text", "stripes", "few colours", "noise" };
+
+static void fillPattern(rfb::ManagedPixelBuffer* pb, Pattern pattern)
+{
+  uint8_t* data;
+  int stride, bpp;
+  uint32_t colours[4];
+
+  for (int i = 0; i < 4; i++)
+    colours[i] = rand() * 2654435761U;
+
+  bpp = pb->getPF().bpp / 8;
+  data = pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = 0; y < pb->height(); y++) {
+    for (int x = 0; x < pb->width(); x++) {
+      uint32_t value;
+
+      switch (pattern) {
+      case Solid:
+        value = colours[0];
+        break;
+      case Text:
+        value = colours[(x % 7 < 2) && (y % 9 < 6) && (rand() % 3)];
+        break;
+      case Stripes:
+        value = colours[(x / 5 + y / 3) % 2];
+        break;
+      case FewColours:
+        value = colours[rand() % 4];
+        break;
+      default:
+        value = rand() * 2654435761U;
+      }
+
+      memcpy(data + (y * stride + x) * bpp, &value, bpp);
+    }
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static void encode(rfb::Encoder* encoder, rdr::MemOutStream* out,
+                   const rfb::PixelBuffer* pb, const rfb::Palette& palette,
+                   bool simd, std::vector<uint8_t>* result)
+{
+  rfb::simdSetEnabled(simd);
+
+  out->clear();
+  encoder->writeRect(pb, palette);
+  result->assign(out->data(), out->data() + out->length());
+}
+
+static bool decode(rfb::Decoder* decoder, const rfb::PixelFormat& pf,
+                   const std::vector<uint8_t>& data,
+                   rfb::ManagedPixelBuffer* pb)
+{
+  rfb::ServerParams server;
+  rdr::MemInStream is(data.data(), data.size());
+  rdr::MemOutStream os;
+
+  server.setPF(pf);
+
+  if (!decoder->readRect(pb->getRect(), &is, server, &os))
+    return false;
+  if (is.avail() != 0)
+    return false;
+
+  decoder->decodeRect(pb->getRect(), os.data(), os.length(), server, pb);
+
+  return true;
+}
+
+static void testEncoder(const char* name, rfb::Encoder* encoder,
+                        rfb::Decoder* decoder, rdr::MemOutStream* out,
+                        const rfb::PixelFormat& pf, int width, int height,
+                        Pattern pattern)
+{
+  rfb::ManagedPixelBuffer pb(pf, width, height);
+  rfb::ManagedPixelBuffer decoded(pf, width, height);
+  rfb::Palette palette;
+  std::vector<uint8_t> simdData, genericData;
+
+  printf("    %s, %dx%d %s: ", name, width, height,
+         patternNames[pattern]);
+
+  fillPattern(&pb, pattern);
+  makePalette(&pb, &palette);
+
+  encode(encoder, out, &pb, palette, true, &simdData);
+  encode(encoder, out, &pb, palette, false, &genericData);
+
+  if (simdData != genericData) {
+    printf("FAILED: vectorised output differs\n");
+    return;
+  }
+
+  if (!decode(decoder, pf, simdData, &decoded)) {
+    printf("FAILED: invalid data\n");
+    return;
+  }
+
+  if (!sameContents(&pb, &decoded)) {
+    printf("FAILED: wrong decoded contents\n");
+    return;
+  }
+
+  printf("OK\n");
+  fflush(stdout);
+}
+
+static void testFormat(const char* name, const rfb::PixelFormat& pf)
+{
+  static const int sizes[][2] = { { 16, 16 }, { 1, 1 }, { 37, 23 },
+                                  { 64, 48 }, { 3, 70 } };
+
+  rdr::MemOutStream out;
+  DummySConnection conn(&out);
+  int32_t encodings[] = { rfb::encodingHextile, rfb::encodingRRE };
+  rfb::HextileEncoder hextile(&conn);
+  rfb::RREEncoder rre(&conn);
+  rfb::HextileDecoder hextileDecoder;
+  rfb::RREDecoder rreDecoder;
+
+  printf("%s:\n", name);
+
+  conn.client.setPF(pf);
+  conn.setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+    for (int p = Solid; p <= Noise; p++) {
+      rfb::Configuration::setParam("ImprovedHextile", "1");
+      testEncoder("Hextile", &hextile, &hextileDecoder, &out, pf,
+                  sizes[i][0], sizes[i][1], (Pattern)p);
+      rfb::Configuration::setParam("ImprovedHextile", "0");
+      testEncoder("Hextile (basic)", &hextile, &hextileDecoder, &out, pf,
+                  sizes[i][0], sizes[i][1], (Pattern)p);
+      testEncoder("RRE", &rre, &rreDecoder, &out, pf,
+                  sizes[i][0], sizes[i][1], (Pattern)p);
+    }
+  }
+
+  rfb::Configuration::setParam("ImprovedHextile", "1");
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  if (rfb::simdGetName() == NULL)
+    printf("No vectorised code for this CPU\n\n");
+
+  testFormat("8 bpp", rfb::PixelFormat(8, 8, false, true,
+                                       7, 7, 3, 5, 2, 0));
+  testFormat("16 bpp", rfb::PixelFormat(16, 16, false, true,
+                                        31, 63, 31, 11, 5, 0));
+  testFormat("32 bpp", rfb::PixelFormat(32, 24, false, true,
+                                        255, 255, 255, 16, 8, 0));
+
+  return 0;
+}
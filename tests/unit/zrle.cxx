@@ -0,0 +1,317 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include <rdr/Exception.h>
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibInStream.h>
+
+#include <rfb/Palette.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/SConnection.h>
+#include <rfb/ServerParams.h>
+#include <rfb/ZRLEDecoder.h>
+#include <rfb/ZRLEEncoder.h>
+#ifdef HAVE_ZSTD
+#include <rfb/ZstdRLEDecoder.h>
+#include <rfb/ZstdRLEEncoder.h>
+#endif
+#include <rfb/encodings.h>
+
+#include "testutil.h"
+
+// Rects are decoded in the opposite order to how they were read, which
+// only works if nothing but the reading depends on earlier rects
+static const int rectCount = 6;
+
+static rfb::Pixel randomPixel(const rfb::PixelFormat& pf)
+{
+  return pf.pixelFromRGB((uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand());
+}
+
+static void fillRect(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r,
+                     int colours)
+{
+  const rfb::PixelFormat& pf = pb->getPF();
+  uint8_t* data;
+  int stride, bpp;
+  rfb::Pixel palette[256];
+
+  for (int i = 0; i < colours; i++)
+    palette[i] = randomPixel(pf);
+
+  bpp = pf.bpp / 8;
+  data = pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width(); x++) {
+      rfb::Pixel value;
+
+      // Runs of pixels to get the RLE modes as well
+      if (colours == 0)
+        value = randomPixel(pf);
+      else
+        value = palette[((x / 3) * 7 + y / 2 + rand() % 2) % colours];
+
+      pf.bufferFromPixel(data + (y * stride + x) * bpp, value);
+    }
+  }
+  pb->commitBufferRW(r);
+}
+
+template<class Encoder, class Decoder>
+static void testOutOfOrder(const char* name, const rfb::PixelFormat& pf)
+{
+  static const int colours[rectCount] = { 1, 2, 0, 5, 100, 17 };
+  // Changing the level mid stream is a special case for some of the
+  // compressors
+  static const int levels[rectCount] = { 2, 2, 9, 0, 6, 2 };
+
+  rdr::MemOutStream encoded;
+  DummySConnection conn(&encoded);
+  Encoder encoder(&conn);
+  Decoder decoder;
+  rfb::ServerParams server;
+
+  rfb::ManagedPixelBuffer fb(pf, fbWidth, fbHeight);
+  rfb::ManagedPixelBuffer decoded(pf, fbWidth, fbHeight);
+  rfb::Rect rects[rectCount];
+  rdr::MemOutStream buffers[rectCount];
+
+  printf("%s: ", name);
+
+  conn.client.setPF(pf);
+  server.setPF(pf);
+
+  for (int i = 0; i < rectCount; i++) {
+    rfb::Rect r;
+    rfb::Palette palette;
+    uint8_t* data;
+    int stride;
+
+    // Covers the whole framebuffer, with rects of more than one tile
+    r.tl.x = (i % 3) * fbWidth / 3;
+    r.tl.y = (i / 3) * fbHeight / 2;
+    r.br.x = (i % 3 + 1) * fbWidth / 3;
+    r.br.y = (i / 3 + 1) * fbHeight / 2;
+    rects[i] = r;
+
+    fillRect(&fb, r, colours[i]);
+
+    rfb::ManagedPixelBuffer rectBuffer(pf, r.width(), r.height());
+    data = rectBuffer.getBufferRW(rectBuffer.getRect(), &stride);
+    fb.getImage(data, r, stride);
+    rectBuffer.commitBufferRW(rectBuffer.getRect());
+
+    // ZRLE can't use larger palettes, and EncodeManager never gives it
+    // one
+    makePalette(&rectBuffer, &palette);
+    if (palette.size() > 127)
+      palette.clear();
+
+    encoded.clear();
+    encoder.setCompressLevel(levels[i]);
+    encoder.writeRect(&rectBuffer, palette);
+
+    rdr::MemInStream is(encoded.data(), encoded.length());
+    if (!decoder.readRect(r, &is, server, &buffers[i])) {
+      printf("FAILED: incomplete data\n");
+      return;
+    }
+    if (is.avail() != 0) {
+      printf("FAILED: unused data\n");
+      return;
+    }
+  }
+
+  for (int i = rectCount - 1; i >= 0; i--) {
+    decoder.decodeRect(rects[i], buffers[i].data(), buffers[i].length(),
+                       server, &decoded);
+  }
+
+  if (!sameContents(&fb, &decoded)) {
+    printf("FAILED: wrong decoded contents\n");
+    return;
+  }
+
+  printf("OK\n");
+  fflush(stdout);
+}
+
+// Reads everything the stream will give for the given compressed data,
+// like ZRLEDecoder::readRect() does
+static size_t inflateAll(rdr::ZlibInStream* zis, const uint8_t* data,
+                         size_t length)
+{
+  rdr::MemInStream mis(data, length);
+  size_t total;
+
+  total = 0;
+  zis->setUnderlying(&mis, length);
+  while (zis->hasData(1)) {
+    total += zis->avail();
+    zis->skip(zis->avail());
+  }
+  zis->flushUnderlying();
+
+  return total;
+}
+
+static void testStraddlingMatch()
+{
+  printf("Match straddling the inflate buffer: ");
+
+  // Long runs are a few long matches, and one of them will end up
+  // crossing the end of the output buffer for some of these sizes
+  for (size_t size = 8000; size < 8600; size += 7) {
+    uint8_t* input;
+    uint8_t compressed[1024];
+    size_t length, first;
+    z_stream zs;
+
+    input = new uint8_t[size];
+    memset(input, 0, size);
+
+    memset(&zs, 0, sizeof(zs));
+    deflateInit(&zs, 9);
+    zs.next_in = input;
+    zs.avail_in = size;
+    zs.next_out = compressed;
+    zs.avail_out = sizeof(compressed);
+    deflate(&zs, Z_SYNC_FLUSH);
+    length = sizeof(compressed) - zs.avail_out;
+    deflateEnd(&zs);
+
+    delete [] input;
+
+    // Split the stream so that the first part ends on the last match,
+    // and the empty block from the flush ends up in the next part
+    first = length - 4;
+
+    rdr::ZlibInStream zis;
+    if (inflateAll(&zis, compressed, first) != size) {
+      printf("FAILED: lost data for %d bytes\n", (int)size);
+      return;
+    }
+    if (inflateAll(&zis, compressed + first, length - first) != 0) {
+      printf("FAILED: extra data for %d bytes\n", (int)size);
+      return;
+    }
+  }
+
+  printf("OK\n");
+  fflush(stdout);
+}
+
+static void testOverlongRect()
+{
+  static const int size = 64 * 64 * 4 * 3;
+
+  rfb::ZRLEDecoder decoder;
+  rfb::ServerParams server;
+  rfb::Rect r(0, 0, 64, 64);
+  rdr::MemOutStream encoded, buffer;
+  uint8_t* input;
+  uint8_t* compressed;
+  size_t length;
+  z_stream zs;
+
+  printf("Overlong ZRLE rect: ");
+
+  server.setPF(rfb::PixelFormat(32, 24, false, true,
+                                255, 255, 255, 16, 8, 0));
+
+  // Far more data than any 64x64 tile can need
+  input = new uint8_t[size];
+  memset(input, 0, size);
+  compressed = new uint8_t[size];
+
+  memset(&zs, 0, sizeof(zs));
+  deflateInit(&zs, 9);
+  zs.next_in = input;
+  zs.avail_in = size;
+  zs.next_out = compressed;
+  zs.avail_out = size;
+  deflate(&zs, Z_SYNC_FLUSH);
+  length = size - zs.avail_out;
+  deflateEnd(&zs);
+
+  encoded.writeU32(length);
+  encoded.writeBytes(compressed, length);
+
+  delete [] input;
+  delete [] compressed;
+
+  rdr::MemInStream is(encoded.data(), encoded.length());
+  try {
+    decoder.readRect(r, &is, server, &buffer);
+  } catch (rdr::Exception&) {
+    printf("OK\n");
+    fflush(stdout);
+    return;
+  }
+
+  printf("FAILED: accepted %d bytes\n", (int)buffer.length());
+}
+
+template<class Encoder, class Decoder>
+static void testFormats(const char* encoding)
+{
+  char name[256];
+
+  snprintf(name, sizeof(name), "%s 8 bpp", encoding);
+  testOutOfOrder<Encoder, Decoder>(name,
+                                   rfb::PixelFormat(8, 8, false, true,
+                                                    7, 7, 3, 5, 2, 0));
+  snprintf(name, sizeof(name), "%s 16 bpp", encoding);
+  testOutOfOrder<Encoder, Decoder>(name,
+                                   rfb::PixelFormat(16, 16, false, true,
+                                                    31, 63, 31, 11, 5, 0));
+  snprintf(name, sizeof(name), "%s 24 bpp", encoding);
+  testOutOfOrder<Encoder, Decoder>(name,
+                                   rfb::PixelFormat(32, 24, false, true,
+                                                    255, 255, 255,
+                                                    16, 8, 0));
+  snprintf(name, sizeof(name), "%s 24 bpp (big endian)", encoding);
+  testOutOfOrder<Encoder, Decoder>(name,
+                                   rfb::PixelFormat(32, 24, true, true,
+                                                    255, 255, 255,
+                                                    16, 8, 0));
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  testStraddlingMatch();
+  testOverlongRect();
+
+  testFormats<rfb::ZRLEEncoder, rfb::ZRLEDecoder>("ZRLE");
+#ifdef HAVE_ZSTD
+  testFormats<rfb::ZstdRLEEncoder, rfb::ZstdRLEDecoder>("ZstdRLE");
+#endif
+
+  return 0;
+}
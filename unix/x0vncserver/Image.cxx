@@ -217,12 +217,12 @@ static int ShmCreationXErrorHandler(Display* /*dpy*/,
 }
 
 ShmImage::ShmImage(Display *d)
-  : Image(d), shminfo(NULL)
+  : Image(d), shminfo(NULL), scratch(NULL)
 {
 }
 
 ShmImage::ShmImage(Display *d, int width, int height)
-  : Image(d), shminfo(NULL)
+  : Image(d), shminfo(NULL), scratch(NULL)
 {
   Init(width, height);
 }
@@ -312,6 +312,8 @@ void ShmImage::Init(int width, int height, const XVisualInfo *vinfo)
 
 ShmImage::~ShmImage()
 {
+  delete scratch;
+
   if (shminfo != NULL) {
     XShmDetach(dpy, shminfo);
     shmdt(shminfo->shmaddr);
@@ -337,6 +339,46 @@ void ShmImage::get(Window wnd, int x, int y, int w, int h,
   }
 }
 
+void ShmImage::prepareGetArea()
+{
+  if (scratch == NULL)
+    scratch = new ShmImage(dpy, (xim->width + 3) / 4, xim->height);
+}
+
+void ShmImage::getArea(Window wnd, int x, int y, int w, int h,
+                       int dst_x, int dst_y)
+{
+  XImage area;
+
+  // XShmGetImage() always fills complete rows of the image. That is
+  // still the cheapest way for all but narrow areas, as the extra
+  // pixels don't have to go over the X connection.
+  if (getAreaFillsRows(w)) {
+    area = *xim;
+    area.height = h;
+    area.data = locatePixel(0, dst_y);
+    XShmGetImage(dpy, wnd, &area, x - dst_x, y, AllPlanes);
+    return;
+  }
+
+  // Narrow areas are fetched to a separate segment, packed using
+  // their own width, and then copied in to place
+  prepareGetArea();
+  if (scratch->xim == NULL) {
+    get(wnd, x, y, w, h, dst_x, dst_y);
+    return;
+  }
+
+  area = *scratch->xim;
+  area.width = w;
+  area.height = h;
+  area.bytes_per_line = (w * area.bits_per_pixel + area.bitmap_pad - 1) /
+                        area.bitmap_pad * (area.bitmap_pad / 8);
+  XShmGetImage(dpy, wnd, &area, x, y, AllPlanes);
+
+  copyPixels(&area, dst_x, dst_y, 0, 0, w, h);
+}
+
 //
 // ImageFactory class implementation
 //
@@ -109,12 +109,27 @@ public:
   virtual void get(Window wnd, int x, int y, int w, int h,
                    int dst_x = 0, int dst_y = 0);
 
+  // Like get(), but always uses a single XShmGetImage() call no matter
+  // the size of the area. Some surrounding pixels might also be
+  // updated.
+  void getArea(Window wnd, int x, int y, int w, int h,
+               int dst_x, int dst_y);
+  // Does getArea() update complete rows for an area this wide?
+  bool getAreaFillsRows(int w) const { return w * 4 >= xim->width; }
+  // Set up what getArea() needs straight away. Creating a ShmImage
+  // temporarily replaces the X error handler of the whole process, so
+  // this is needed before getArea() is used from another thread.
+  void prepareGetArea();
+
 protected:
 
   void Init(int width, int height, const XVisualInfo *vinfo = NULL);
 
   XShmSegmentInfo *shminfo;
 
+  // Intermediate storage for getArea()
+  ShmImage *scratch;
+
 };
 
 //
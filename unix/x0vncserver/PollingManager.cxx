@@ -28,6 +28,7 @@
 #include <string.h>
 #include <time.h>
 #include <X11/Xlib.h>
+#include <os/Mutex.h>
 #include <rfb/LogWriter.h>
 #include <rfb/VNCServer.h>
 #include <rfb/Configuration.h>
@@ -39,6 +40,13 @@ using namespace rfb;
 
 static LogWriter vlog("PollingMgr");
 
+IntParameter pollingThreads("PollingThreads",
+                            "Number of threads to use when polling the "
+                            "screen for changes (0 = automatic)", 0, 0, 64);
+
+// How many passes a tile stays hot after it has changed
+static const uint8_t hotPasses = 32;
+
 const int PollingManager::m_pollingOrder[32] = {
    0, 16,  8, 24,  4, 20, 12, 28,
   10, 26, 18,  2, 22,  6, 30, 14,
@@ -67,16 +75,23 @@ PollingManager::PollingManager(Display *dpy, const Image *image,
     m_heightTiles((image->xim->height + 31) / 32),
     m_numTiles(((image->xim->width + 31) / 32) *
                ((image->xim->height + 31) / 32)),
-    m_pollingStep(0)
+    m_pollingStep(0),
+    m_passCount(0),
+    m_scanOffset(0),
+    m_checkCold(true),
+    m_useShm(factory.isShmAllowed()),
+    m_threadsStarted(false),
+    m_passNumber(0),
+    m_threadsBusy(0),
+    m_threadTiles(0)
 {
   // Create additional images used in polling algorithm, warn if
   // underlying class names are different from the class name of the
   // primary image.
-  m_rowImage = factory.newImage(m_dpy, m_width, 1);
-  m_columnImage = factory.newImage(m_dpy, 1, m_height);
+  newReader(&m_reader, m_dpy);
   const char *primaryImgClass = m_image->className();
-  const char *rowImgClass = m_rowImage->className();
-  const char *columnImgClass = m_columnImage->className();
+  const char *rowImgClass = m_reader.rowImage->className();
+  const char *columnImgClass = m_reader.columnImage->className();
   if (strcmp(rowImgClass, primaryImgClass) != 0 ||
       strcmp(columnImgClass, primaryImgClass) != 0) {
     vlog.error("Image types do not match (%s, %s, %s)",
@@ -85,14 +100,175 @@ PollingManager::PollingManager(Display *dpy, const Image *image,
 
   m_changeFlags = new bool[m_numTiles];
   memset(m_changeFlags, 0, m_numTiles * sizeof(bool));
+
+  m_heat = new uint8_t[m_numTiles];
+  memset(m_heat, 0, m_numTiles * sizeof(uint8_t));
+
+  m_mutex = new os::Mutex();
+  m_passCond = new os::Condition(m_mutex);
+  m_doneCond = new os::Condition(m_mutex);
 }
 
 PollingManager::~PollingManager()
 {
+  stopThreads();
+
+  delete m_doneCond;
+  delete m_passCond;
+  delete m_mutex;
+
+  delete[] m_heat;
   delete[] m_changeFlags;
 
-  delete m_rowImage;
-  delete m_columnImage;
+  deleteReader(&m_reader);
+}
+
+void PollingManager::newReader(Reader *reader, Display *dpy)
+{
+  ImageFactory factory(m_useShm);
+
+  reader->dpy = dpy;
+  reader->rowImage = factory.newImage(dpy, m_width, 1);
+  reader->columnImage = factory.newImage(dpy, 1, m_height);
+  reader->stripeImage = factory.newImage(dpy, m_width,
+                                         m_height < 32 ? m_height : 32);
+}
+
+void PollingManager::deleteReader(Reader *reader)
+{
+  delete reader->rowImage;
+  delete reader->columnImage;
+  delete reader->stripeImage;
+
+  if (reader->dpy != m_dpy)
+    XCloseDisplay(reader->dpy);
+}
+
+//
+// The first pass is split in to bands of stripes that are checked in
+// parallel. The X server itself is single threaded, but the threads
+// can still overlap their waiting and their comparisons.
+//
+
+void PollingManager::startThreads()
+{
+  int count;
+
+  m_threadsStarted = true;
+
+  count = pollingThreads;
+  if (count == 0) {
+    count = os::Thread::getSystemCPUCount();
+    if (count > 4)
+      count = 4;
+  }
+
+  // Each thread should get a decent amount of work
+  if (count > m_heightTiles / 4)
+    count = m_heightTiles / 4;
+  if (count < 2)
+    return;
+
+  // Xlib needs a separate connection for each thread
+  m_threadReaders.resize(count);
+  for (int i = 0; i < count; i++) {
+    Display *dpy;
+
+    dpy = XOpenDisplay(DisplayString(m_dpy));
+    if (dpy == NULL) {
+      vlog.error("Unable to open extra X connection for polling");
+      for (int j = 0; j < i; j++)
+        deleteReader(&m_threadReaders[j]);
+      m_threadReaders.clear();
+      return;
+    }
+
+    newReader(&m_threadReaders[i], dpy);
+  }
+
+  for (int i = 0; i < count; i++) {
+    m_threads.push_back(new PollingThread(this, &m_threadReaders[i],
+                                          m_heightTiles * i / count,
+                                          m_heightTiles * (i + 1) / count - 1));
+  }
+
+  vlog.info("Using %d threads for polling", count);
+}
+
+void PollingManager::stopThreads()
+{
+  std::vector<PollingThread*>::iterator iter;
+  std::vector<Reader>::iterator reader;
+
+  for (iter = m_threads.begin(); iter != m_threads.end(); ++iter)
+    (*iter)->stop();
+  for (iter = m_threads.begin(); iter != m_threads.end(); ++iter)
+    delete *iter;
+  m_threads.clear();
+
+  for (reader = m_threadReaders.begin();
+       reader != m_threadReaders.end(); ++reader)
+    deleteReader(&*reader);
+  m_threadReaders.clear();
+}
+
+PollingManager::PollingThread::PollingThread(PollingManager *manager_,
+                                             Reader *reader_,
+                                             int firstStripe_,
+                                             int lastStripe_)
+  : manager(manager_), reader(reader_),
+    firstStripe(firstStripe_), lastStripe(lastStripe_),
+    passesDone(manager_->m_passNumber), stopRequested(false)
+{
+  start();
+}
+
+PollingManager::PollingThread::~PollingThread()
+{
+  stop();
+  wait();
+}
+
+void PollingManager::PollingThread::stop()
+{
+  os::AutoMutex a(manager->m_mutex);
+
+  if (!isRunning())
+    return;
+
+  stopRequested = true;
+
+  // We can't wake just this thread, so wake everyone
+  manager->m_passCond->broadcast();
+}
+
+void PollingManager::PollingThread::worker()
+{
+  manager->m_mutex->lock();
+
+  while (!stopRequested) {
+    int nTilesChanged;
+
+    if (passesDone == manager->m_passNumber) {
+      manager->m_passCond->wait();
+      continue;
+    }
+
+    passesDone = manager->m_passNumber;
+
+    manager->m_mutex->unlock();
+
+    nTilesChanged = manager->checkStripes(reader, firstStripe, lastStripe);
+
+    manager->m_mutex->lock();
+
+    manager->m_threadTiles += nTilesChanged;
+    manager->m_threadsBusy--;
+    if (manager->m_threadsBusy == 0)
+      manager->m_doneCond->signal();
+  }
+
+  manager->m_mutex->unlock();
 }
 
 //
@@ -123,13 +299,16 @@ void PollingManager::debugAfterPoll()
 // Search for changed rectangles on the screen.
 //
 
-void PollingManager::poll(VNCServer *server)
+void PollingManager::poll(VNCServer *server, int coldInterval)
 {
 #ifdef DEBUG
   debugBeforePoll();
 #endif
 
-  pollScreen(server);
+  if (!m_threadsStarted)
+    startThreads();
+
+  pollScreen(server, coldInterval);
 
 #ifdef DEBUG
   debugAfterPoll();
@@ -142,7 +321,7 @@ void PollingManager::poll(VNCServer *server)
 #define DBG_REPORT_CHANGES(title)
 #endif
 
-bool PollingManager::pollScreen(VNCServer *server)
+bool PollingManager::pollScreen(VNCServer *server, int coldInterval)
 {
   if (!server)
     return false;
@@ -155,10 +334,27 @@ bool PollingManager::pollScreen(VNCServer *server)
   // framebuffer -- that is, one line in each (32 * m_width) stripe.
   // We compare the pixels of that line with previous framebuffer
   // contents and raise corresponding elements of m_changeFlags[].
-  int scanOffset = m_pollingOrder[m_pollingStep++ % 32];
+  // Hot tiles are checked completely, and cold ones might be skipped
+  // for this pass.
+  m_checkCold = (m_passCount++ % coldInterval) == 0;
+  if (m_checkCold)
+    m_scanOffset = m_pollingOrder[m_pollingStep++ % 32];
+
   int nTilesChanged = 0;
-  for (int y = scanOffset; y < m_height; y += 32) {
-    nTilesChanged += checkRow(0, y, m_width);
+  if (m_threads.empty()) {
+    nTilesChanged = checkStripes(&m_reader, 0, m_heightTiles - 1);
+  } else {
+    os::AutoMutex a(m_mutex);
+
+    m_passNumber++;
+    m_threadsBusy = m_threads.size();
+    m_threadTiles = 0;
+    m_passCond->broadcast();
+
+    while (m_threadsBusy > 0)
+      m_doneCond->wait();
+
+    nTilesChanged = m_threadTiles;
   }
 
   DBG_REPORT_CHANGES("After 1st pass");
@@ -172,6 +368,8 @@ bool PollingManager::pollScreen(VNCServer *server)
     nTilesChanged = sendChanges(server);
   }
 
+  updateHeat();
+
 #ifdef DEBUG_PRINT_NUM_CHANGED_TILES
   printf("%3d ", nTilesChanged);
   if (m_pollingStep % 32 == 0) {
@@ -188,7 +386,80 @@ bool PollingManager::pollScreen(VNCServer *server)
   return (nTilesChanged != 0);
 }
 
-int PollingManager::checkRow(int x, int y, int w)
+int PollingManager::checkStripes(Reader *reader, int first, int last)
+{
+  int nTilesChanged = 0;
+
+  for (int stripe = first; stripe <= last; stripe++) {
+    const uint8_t *pHeat = &m_heat[stripe * m_widthTiles];
+    bool hot = false;
+
+    for (int x = 0; x < m_widthTiles; x++) {
+      if (pHeat[x]) {
+        hot = true;
+        break;
+      }
+    }
+
+    if (hot) {
+      nTilesChanged += checkHotStripe(reader, stripe);
+    } else if (m_checkCold && stripe * 32 + m_scanOffset < m_height) {
+      nTilesChanged += checkRow(reader, 0, stripe * 32 + m_scanOffset,
+                                m_width);
+    }
+  }
+
+  return nTilesChanged;
+}
+
+int PollingManager::checkHotStripe(Reader *reader, int stripe)
+{
+  int y = stripe * 32;
+  int h = (m_height - y >= 32) ? 32 : m_height - y;
+
+  // Read the entire row of tiles into stripeImage.
+  if (h == 32) {
+    reader->stripeImage->get(DefaultRootWindow(reader->dpy),
+                             m_offsetLeft, m_offsetTop + y);
+  } else {
+    reader->stripeImage->get(DefaultRootWindow(reader->dpy),
+                             m_offsetLeft, m_offsetTop + y, m_width, h);
+  }
+
+  bool *pChangeFlags = &m_changeFlags[stripe * m_widthTiles];
+  const uint8_t *pHeat = &m_heat[stripe * m_widthTiles];
+
+  int nTilesChanged = 0;
+  for (int x = 0; x < m_widthTiles; x++) {
+    int tile_w = (m_width - x * 32 >= 32) ? 32 : m_width - x * 32;
+    int first, last;
+
+    // Hot tiles get every row compared, cold ones just the one for
+    // this pass.
+    if (pHeat[x]) {
+      first = 0;
+      last = h - 1;
+    } else if (m_checkCold && m_scanOffset < h) {
+      first = last = m_scanOffset;
+    } else {
+      continue;
+    }
+
+    for (int i = first; i <= last; i++) {
+      char *ptr_old = m_image->locatePixel(x * 32, y + i);
+      char *ptr_new = reader->stripeImage->locatePixel(x * 32, i);
+      if (memcmp(ptr_old, ptr_new, tile_w * m_bytesPerPixel)) {
+        pChangeFlags[x] = true;
+        nTilesChanged++;
+        break;
+      }
+    }
+  }
+
+  return nTilesChanged;
+}
+
+int PollingManager::checkRow(Reader *reader, int x, int y, int w)
 {
   // If necessary, expand the row to the left, to the tile border.
   // In other words, x must be a multiple of 32.
@@ -198,15 +469,20 @@ int PollingManager::checkRow(int x, int y, int w)
     w += correction;
   }
 
-  // Read a row from the screen into m_rowImage.
-  getRow(x, y, w);
+  // Read a row from the screen into rowImage.
+  getRow(reader, x, y, w);
 
   // Compute a pointer to the initial element of m_changeFlags.
   bool *pChangeFlags = &m_changeFlags[getTileIndex(x, y)];
 
   // Compute pointers to image data to be compared.
   char *ptr_old = m_image->locatePixel(x, y);
-  char *ptr_new = m_rowImage->xim->data;
+  char *ptr_new = reader->rowImage->xim->data;
+
+  // Unchanged rows are by far the most common case, and a single
+  // memcmp() over the whole row is a lot faster than one per tile.
+  if (memcmp(ptr_old, ptr_new, w * m_bytesPerPixel) == 0)
+    return 0;
 
   // Compare pixels, raise corresponding elements of m_changeFlags[].
   // First, handle full-size (32 pixels wide) tiles.
@@ -234,9 +510,10 @@ int PollingManager::checkRow(int x, int y, int w)
   return nTilesChanged;
 }
 
-int PollingManager::checkColumn(int x, int y, int h, bool *pChangeFlags)
+int PollingManager::checkColumn(Reader *reader, int x, int y, int h,
+                                bool *pChangeFlags)
 {
-  getColumn(x, y, h);
+  getColumn(reader, x, y, h);
 
   int nTilesChanged = 0;
   for (int nTile = 0; nTile < (h + 31) / 32; nTile++) {
@@ -245,7 +522,7 @@ int PollingManager::checkColumn(int x, int y, int h, bool *pChangeFlags)
       for (int i = 0; i < tile_h; i++) {
         // FIXME: Do not compute these pointers in the inner cycle.
         char *ptr_old = m_image->locatePixel(x, y + nTile * 32 + i);
-        char *ptr_new = m_columnImage->locatePixel(0, nTile * 32 + i);
+        char *ptr_new = reader->columnImage->locatePixel(0, nTile * 32 + i);
         if (memcmp(ptr_old, ptr_new, m_bytesPerPixel)) {
           *pChangeFlags = true;
           nTilesChanged++;
@@ -306,14 +583,14 @@ PollingManager::checkNeighbors()
           m_changeFlags[y * m_widthTiles + x] &&
           !m_changeFlags[(y - 1) * m_widthTiles + x]) {
         // FIXME: Check m_changeFlags[] to decrease height of the row.
-        checkRow(x * 32, y * 32 - 1, m_width - x * 32);
+        checkRow(&m_reader, x * 32, y * 32 - 1, m_width - x * 32);
         doneAbove = true;
       }
       if (!doneBelow && y < m_heightTiles - 1 &&
           m_changeFlags[y * m_widthTiles + x] &&
           !m_changeFlags[(y + 1) * m_widthTiles + x]) {
         // FIXME: Check m_changeFlags[] to decrease height of the row.
-        checkRow(x * 32, (y + 1) * 32, m_width - x * 32);
+        checkRow(&m_reader, x * 32, (y + 1) * 32, m_width - x * 32);
         doneBelow = true;
       }
       if (doneBelow && doneAbove)
@@ -327,7 +604,7 @@ PollingManager::checkNeighbors()
       if (m_changeFlags[y * m_widthTiles + x] &&
           !m_changeFlags[y * m_widthTiles + x + 1]) {
         // FIXME: Check m_changeFlags[] to decrease height of the column.
-        checkColumn((x + 1) * 32, y * 32, m_height - y * 32,
+        checkColumn(&m_reader, (x + 1) * 32, y * 32, m_height - y * 32,
                     &m_changeFlags[y * m_widthTiles + x + 1]);
         break;
       }
@@ -340,7 +617,7 @@ PollingManager::checkNeighbors()
       if (m_changeFlags[y * m_widthTiles + x] &&
           !m_changeFlags[y * m_widthTiles + x - 1]) {
         // FIXME: Check m_changeFlags[] to decrease height of the column.
-        checkColumn(x * 32 - 1, y * 32, m_height - y * 32,
+        checkColumn(&m_reader, x * 32 - 1, y * 32, m_height - y * 32,
                     &m_changeFlags[y * m_widthTiles + x - 1]);
         break;
       }
@@ -348,6 +625,17 @@ PollingManager::checkNeighbors()
   }
 }
 
+void
+PollingManager::updateHeat()
+{
+  for (int i = 0; i < m_numTiles; i++) {
+    if (m_changeFlags[i])
+      m_heat[i] = hotPasses;
+    else if (m_heat[i] > 0)
+      m_heat[i]--;
+  }
+}
+
 void
 PollingManager::printChanges(const char *header) const
 {
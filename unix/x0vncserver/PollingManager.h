@@ -23,7 +23,12 @@
 #ifndef __POLLINGMANAGER_H__
 #define __POLLINGMANAGER_H__
 
+#include <stdint.h>
+
+#include <vector>
+
 #include <X11/Xlib.h>
+#include <os/Thread.h>
 #include <rfb/VNCServer.h>
 
 #include <x0vncserver/Image.h>
@@ -32,6 +37,11 @@
 #include <x0vncserver/TimeMillis.h>
 #endif
 
+namespace os {
+  class Condition;
+  class Mutex;
+}
+
 class PollingManager {
 
 public:
@@ -40,12 +50,14 @@ public:
                  int offsetLeft = 0, int offsetTop = 0);
   virtual ~PollingManager();
 
-  void poll(rfb::VNCServer *server);
+  // Tiles that haven't changed recently are only checked every
+  // coldInterval passes.
+  void poll(rfb::VNCServer *server, int coldInterval = 1);
 
 protected:
 
   // Screen polling. Returns true if some changes were detected.
-  bool pollScreen(rfb::VNCServer *server);
+  bool pollScreen(rfb::VNCServer *server, int coldInterval);
 
   Display *m_dpy;
 
@@ -59,20 +71,56 @@ protected:
 
 private:
 
-  inline void getRow(int x, int y, int w) {
+  // Everything needed to read from the screen. Each thread needs
+  // its own X connection.
+  struct Reader {
+    Display *dpy;
+    Image *rowImage;            // one row of the framebuffer
+    Image *columnImage;         // one column of the framebuffer
+    Image *stripeImage;         // one row of tiles
+  };
+
+  // Stripes of tiles checked by one thread during the first pass
+  class PollingThread : public os::Thread {
+  public:
+    PollingThread(PollingManager *manager, Reader *reader,
+                  int firstStripe, int lastStripe);
+    ~PollingThread();
+
+    void stop();
+
+  protected:
+    void worker();
+
+  private:
+    PollingManager *manager;
+    Reader *reader;
+    int firstStripe, lastStripe;
+
+    unsigned int passesDone;
+    bool stopRequested;
+  };
+
+  void newReader(Reader *reader, Display *dpy);
+  void deleteReader(Reader *reader);
+
+  void startThreads();
+  void stopThreads();
+
+  inline void getRow(Reader *reader, int x, int y, int w) {
     if (w == m_width) {
       // Getting full row may be more efficient.
-      m_rowImage->get(DefaultRootWindow(m_dpy),
-                      m_offsetLeft, m_offsetTop + y);
+      reader->rowImage->get(DefaultRootWindow(reader->dpy),
+                            m_offsetLeft, m_offsetTop + y);
     } else {
-      m_rowImage->get(DefaultRootWindow(m_dpy),
-                      m_offsetLeft + x, m_offsetTop + y, w, 1);
+      reader->rowImage->get(DefaultRootWindow(reader->dpy),
+                            m_offsetLeft + x, m_offsetTop + y, w, 1);
     }
   }
 
-  inline void getColumn(int x, int y, int h) {
-    m_columnImage->get(DefaultRootWindow(m_dpy),
-                       m_offsetLeft + x, m_offsetTop + y, 1, h);
+  inline void getColumn(Reader *reader, int x, int y, int h) {
+    reader->columnImage->get(DefaultRootWindow(reader->dpy),
+                             m_offsetLeft + x, m_offsetTop + y, 1, h);
   }
 
   inline int getTileIndex(int x, int y) {
@@ -81,19 +129,23 @@ private:
     return tile_y * m_widthTiles + tile_x;
   }
 
-  int checkRow(int x, int y, int w);
-  int checkColumn(int x, int y, int h, bool *pChangeFlags);
+  int checkRow(Reader *reader, int x, int y, int w);
+  int checkColumn(Reader *reader, int x, int y, int h, bool *pChangeFlags);
+  int checkStripes(Reader *reader, int first, int last);
+  int checkHotStripe(Reader *reader, int stripe);
   int sendChanges(rfb::VNCServer *server) const;
 
   // Check neighboring tiles and update m_changeFlags[].
   void checkNeighbors();
 
+  // Let recently changed tiles cool down, and heat up new ones.
+  void updateHeat();
+
   // DEBUG: Print the list of changed tiles.
   void printChanges(const char *header) const;
 
-  // Additional images used in polling algorithms.
-  Image *m_rowImage;            // one row of the framebuffer
-  Image *m_columnImage;         // one column of the framebuffer
+  // Used for everything but the first pass.
+  Reader m_reader;
 
   const int m_widthTiles;       // shortcut for ((m_width + 31) / 32)
   const int m_heightTiles;      // shortcut for ((m_height + 31) / 32)
@@ -104,9 +156,32 @@ private:
   // in that tile.
   bool *m_changeFlags;
 
+  // m_heat[] counts down the number of passes since each tile last
+  // changed. Tiles that are still warm are checked completely on
+  // every pass, rather than one row at a time.
+  uint8_t *m_heat;
+
   unsigned int m_pollingStep;
   static const int m_pollingOrder[];
 
+  unsigned int m_passCount;
+
+  // Parameters for the current first pass, for the threads
+  int m_scanOffset;
+  bool m_checkCold;
+
+  bool m_useShm;
+  bool m_threadsStarted;
+  std::vector<PollingThread*> m_threads;
+  std::vector<Reader> m_threadReaders;
+
+  os::Mutex *m_mutex;
+  os::Condition *m_passCond;
+  os::Condition *m_doneCond;
+  unsigned int m_passNumber;
+  int m_threadsBusy;
+  int m_threadTiles;
+
 #ifdef DEBUG
 private:
 
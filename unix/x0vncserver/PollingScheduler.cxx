@@ -57,6 +57,7 @@ void PollingScheduler::setParameters(int interval, int maxload)
 void PollingScheduler::reset()
 {
   m_initialState = true;
+  m_coldInterval = 1;
 }
 
 bool PollingScheduler::isRunning()
@@ -144,6 +145,20 @@ void PollingScheduler::newPass()
             m_ratedDuration, optimalLoadDuration1, optimalLoadDuration8);
 #endif
 
+    // Rather than slowing down for the entire screen when over the
+    // CPU budget, spend less time on the areas that aren't changing.
+    // Only adjust once the history has been refreshed to avoid
+    // oscillating.
+    if (m_count > 16 && (m_count & 7) == 0) {
+      if (optimalLoadDuration > m_interval) {
+        if (m_coldInterval < 8)
+          m_coldInterval *= 2;
+      } else if (optimalLoadDuration * 2 < m_interval) {
+        if (m_coldInterval > 1)
+          m_coldInterval /= 2;
+      }
+    }
+
     // Choose final estimation.
     if (m_ratedDuration < optimalLoadDuration) {
       m_ratedDuration = optimalLoadDuration;
@@ -57,6 +57,11 @@ public:
   // This function tells if it's ok to start polling pass right now.
   bool goodTimeToPoll() const;
 
+  // How often tiles that haven't changed recently should be polled,
+  // in passes. Increased when there isn't enough CPU time to poll
+  // everything at the desired interval.
+  int coldInterval() const { return m_coldInterval; }
+
 protected:
 
   // Parameters.
@@ -95,6 +100,9 @@ protected:
 
   // Pass counter.
   int m_count;
+
+  // Current value for coldInterval().
+  int m_coldInterval;
 };
 
 #endif // __POLLINGSCHEDULER_H__
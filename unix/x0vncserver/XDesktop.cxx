@@ -213,9 +213,9 @@ XDesktop::~XDesktop() {
 }
 
 
-void XDesktop::poll() {
+void XDesktop::poll(int coldInterval) {
   if (pb and not haveDamage)
-    pb->poll(server);
+    pb->poll(server, coldInterval);
   if (running) {
     Window root, child;
     int x, y, wx, wy;
@@ -254,6 +254,8 @@ void XDesktop::start(VNCServer* vs) {
   if (haveDamage) {
     damage = XDamageCreate(dpy, DefaultRootWindow(dpy),
                            XDamageReportRawRectangles);
+    if (pb->startPrefetch())
+      vlog.info("Fetching changed areas in the background");
   }
 #endif
 
@@ -826,6 +828,7 @@ bool XDesktop::handleGlobalEvent(XEvent* ev) {
     rect.setXYWH(dev->area.x, dev->area.y, dev->area.width, dev->area.height);
     rect = rect.translate(Point(-geometry->offsetLeft(),
                                 -geometry->offsetTop()));
+    pb->prefetch(rect);
     server->add_changed(rect);
 
     return true;
@@ -879,6 +882,8 @@ bool XDesktop::handleGlobalEvent(XEvent* ev) {
       ImageFactory factory((bool)useShm);
       delete pb;
       pb = new XPixelBuffer(dpy, factory, geometry->getRect());
+      if (haveDamage)
+        pb->startPrefetch();
       server->setPixelBuffer(pb, computeScreenLayout());
 
       // Mark entire screen as changed
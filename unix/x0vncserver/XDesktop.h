@@ -45,7 +45,9 @@ class XDesktop : public rfb::SDesktop,
 public:
   XDesktop(Display* dpy_, Geometry *geometry);
   virtual ~XDesktop();
-  void poll();
+  // Tiles that haven't changed recently are only polled every
+  // coldInterval calls.
+  void poll(int coldInterval);
   // -=- SDesktop interface
   virtual void start(rfb::VNCServer* vs);
   virtual void stop();
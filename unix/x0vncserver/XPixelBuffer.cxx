@@ -26,12 +26,17 @@
 #endif
 
 #include <vector>
+#include <os/Mutex.h>
 #include <rfb/Region.h>
+#include <rfb/Tracer.h>
 #include <X11/Xlib.h>
 #include <x0vncserver/XPixelBuffer.h>
 
 using namespace rfb;
 
+// More requests than this cost more than fetching a few extra pixels
+static const size_t maxBoxes = 8;
+
 XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
                            const Rect &rect)
   : FullFramePixelBuffer(),
@@ -39,7 +44,13 @@ XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
     m_dpy(dpy),
     m_image(factory.newImage(dpy, rect.width(), rect.height())),
     m_offsetLeft(rect.tl.x),
-    m_offsetTop(rect.tl.y)
+    m_offsetTop(rect.tl.y),
+    m_prefetcher(NULL),
+    m_prefetchDpy(NULL),
+    m_prefetchImage(NULL),
+    m_prefetchMutex(NULL),
+    m_prefetchCond(NULL),
+    m_copying(false)
 {
   // Fill in the PixelFormat structure of the parent class.
   format = PixelFormat(m_image->xim->bits_per_pixel,
@@ -67,18 +78,278 @@ XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
 
 XPixelBuffer::~XPixelBuffer()
 {
+  delete m_prefetcher;
+  delete m_prefetchImage;
+  if (m_prefetchDpy)
+    XCloseDisplay(m_prefetchDpy);
+  delete m_prefetchCond;
+  delete m_prefetchMutex;
+
   delete m_poller;
   delete m_image;
 }
 
+bool
+XPixelBuffer::startPrefetch()
+{
+  if (m_prefetcher != NULL)
+    return true;
+
+  // Areas are copied between the images, so both have to be in
+  // shared memory
+  if (dynamic_cast<ShmImage*>(m_image) == NULL)
+    return false;
+
+  m_prefetchDpy = XOpenDisplay(DisplayString(m_dpy));
+  if (m_prefetchDpy == NULL)
+    return false;
+
+  m_prefetchImage = new ShmImage(m_prefetchDpy, width(), height());
+  if (m_prefetchImage->xim == NULL) {
+    delete m_prefetchImage;
+    m_prefetchImage = NULL;
+    XCloseDisplay(m_prefetchDpy);
+    m_prefetchDpy = NULL;
+    return false;
+  }
+
+  // Both images must be completely set up before the thread starts
+  m_prefetchImage->prepareGetArea();
+  ((ShmImage*)m_image)->prepareGetArea();
+
+  m_prefetchMutex = new os::Mutex();
+  m_prefetchCond = new os::Condition(m_prefetchMutex);
+
+  m_prefetcher = new PrefetchThread(this);
+
+  return true;
+}
+
+void
+XPixelBuffer::prefetch(const rfb::Rect& r)
+{
+  Rect clipped;
+
+  if (m_prefetcher == NULL)
+    return;
+
+  clipped = r.intersect(getRect());
+  if (clipped.is_empty())
+    return;
+
+  os::AutoMutex a(m_prefetchMutex);
+
+  m_ready.assign_subtract(clipped);
+  m_dirty.assign_union(clipped);
+  m_pending.assign_union(clipped);
+
+  m_prefetchCond->signal();
+}
+
 void
 XPixelBuffer::grabRegion(const rfb::Region& region)
+{
+  rfb::Region ready, remaining, touched;
+  std::vector<Rect> rects, boxes;
+  std::vector<Rect>::const_iterator i;
+
+  if (m_prefetcher == NULL) {
+    region.get_rects(&rects);
+    for (i = rects.begin(); i != rects.end(); i++) {
+      grabRect(*i);
+    }
+    return;
+  }
+
+  m_prefetchMutex->lock();
+
+  // Areas that are being fetched right now will be done sooner than
+  // if we started over. This also makes sure that the prefetcher
+  // isn't writing to anything we are about to copy.
+  while (!m_fetching.intersect(region).is_empty())
+    m_prefetchCond->wait();
+
+  ready = m_ready.intersect(region);
+  m_ready.assign_subtract(ready);
+
+  // Anything else we fetch ourselves, so the prefetcher can skip it
+  remaining = region.subtract(ready);
+  m_pending.assign_subtract(remaining);
+
+  m_copying = !ready.is_empty();
+
+  m_prefetchMutex->unlock();
+
+  if (m_copying) {
+    ready.get_rects(&rects);
+    for (i = rects.begin(); i != rects.end(); i++) {
+      m_image->updateRect(m_prefetchImage, i->tl.x, i->tl.y,
+                          i->tl.x, i->tl.y, i->width(), i->height());
+    }
+
+    m_prefetchMutex->lock();
+    m_copying = false;
+    m_prefetchCond->broadcast();
+    m_prefetchMutex->unlock();
+  }
+
+  // startPrefetch() made sure this is a ShmImage
+  coalesce((ShmImage*)m_image, remaining, &boxes, &touched);
+  grabBoxes((ShmImage*)m_image, DefaultRootWindow(m_dpy),
+            m_offsetLeft, m_offsetTop, boxes);
+}
+
+void
+XPixelBuffer::coalesce(const ShmImage* image, const rfb::Region& region,
+                       std::vector<rfb::Rect>* boxes, rfb::Region* touched)
 {
   std::vector<Rect> rects;
   std::vector<Rect>::const_iterator i;
+  Rect box;
+  int used;
+
+  boxes->clear();
+  touched->clear();
+
   region.get_rects(&rects);
-  for (i = rects.begin(); i != rects.end(); i++) {
-    grabRect(*i);
+  if (rects.empty())
+    return;
+
+  // The rectangles are sorted top to bottom, so neighbours in the
+  // list are usually close on screen as well. Merge them as long as
+  // at least half of the resulting box is actually needed.
+  box = rects[0];
+  used = box.area();
+  for (i = rects.begin() + 1; i != rects.end(); i++) {
+    Rect merged;
+
+    merged = box.union_boundary(*i);
+    if (merged.area() <= (used + i->area()) * 2) {
+      box = merged;
+      used += i->area();
+      continue;
+    }
+
+    boxes->push_back(box);
+    box = *i;
+    used = box.area();
   }
+  boxes->push_back(box);
+
+  // Still too many? Then merge the pairs that waste the least.
+  while (boxes->size() > maxBoxes) {
+    size_t best;
+    int bestWaste;
+
+    best = 0;
+    bestWaste = 0;
+    for (size_t j = 0; j < boxes->size() - 1; j++) {
+      int waste;
+
+      // Negative if the boxes overlap
+      waste = (*boxes)[j].union_boundary((*boxes)[j + 1]).area() -
+              (*boxes)[j].area() - (*boxes)[j + 1].area();
+      if ((j == 0) || (waste < bestWaste)) {
+        best = j;
+        bestWaste = waste;
+      }
+    }
+
+    (*boxes)[best] = (*boxes)[best].union_boundary((*boxes)[best + 1]);
+    boxes->erase(boxes->begin() + best + 1);
+  }
+
+  for (i = boxes->begin(); i != boxes->end(); i++) {
+    if (image->getAreaFillsRows(i->width())) {
+      touched->assign_union(Rect(0, i->tl.y,
+                                 image->xim->width, i->br.y));
+    } else {
+      touched->assign_union(*i);
+    }
+  }
+}
+
+void
+XPixelBuffer::grabBoxes(ShmImage* image, Window root,
+                        int offsetLeft, int offsetTop,
+                        const std::vector<rfb::Rect>& boxes)
+{
+  std::vector<Rect>::const_iterator i;
+
+  for (i = boxes.begin(); i != boxes.end(); i++) {
+    image->getArea(root, offsetLeft + i->tl.x, offsetTop + i->tl.y,
+                   i->width(), i->height(), i->tl.x, i->tl.y);
+  }
+}
+
+XPixelBuffer::PrefetchThread::PrefetchThread(XPixelBuffer* pb_)
+  : pb(pb_), stopRequested(false), traceTrack(0)
+{
+  if (Tracer::isEnabled())
+    traceTrack = Tracer::newTrack("Grab thread");
+
+  start();
+}
+
+XPixelBuffer::PrefetchThread::~PrefetchThread()
+{
+  stop();
+  wait();
+}
+
+void
+XPixelBuffer::PrefetchThread::stop()
+{
+  os::AutoMutex a(pb->m_prefetchMutex);
+
+  if (!isRunning())
+    return;
+
+  stopRequested = true;
+
+  pb->m_prefetchCond->broadcast();
+}
+
+void
+XPixelBuffer::PrefetchThread::worker()
+{
+  pb->m_prefetchMutex->lock();
+
+  while (!stopRequested) {
+    rfb::Region fetch;
+    std::vector<Rect> boxes;
+    uint64_t start;
+
+    if (pb->m_pending.is_empty() || pb->m_copying) {
+      pb->m_prefetchCond->wait();
+      continue;
+    }
+
+    fetch = pb->m_pending;
+    pb->m_pending.clear();
+    pb->m_dirty.clear();
+
+    coalesce(pb->m_prefetchImage, fetch, &boxes, &pb->m_fetching);
+
+    pb->m_prefetchMutex->unlock();
+
+    start = Tracer::now();
+
+    grabBoxes(pb->m_prefetchImage, DefaultRootWindow(pb->m_prefetchDpy),
+              pb->m_offsetLeft, pb->m_offsetTop, boxes);
+
+    Tracer::record(traceGrab, traceTrack, Tracer::currentFrame() + 1,
+                   start, Tracer::now(), fetch.numRects());
+
+    pb->m_prefetchMutex->lock();
+
+    // Anything that changed again might not have been included
+    pb->m_ready.assign_union(fetch.subtract(pb->m_dirty));
+    pb->m_fetching.clear();
+
+    pb->m_prefetchCond->broadcast();
+  }
+
+  pb->m_prefetchMutex->unlock();
 }
 
@@ -23,11 +23,20 @@
 #ifndef __XPIXELBUFFER_H__
 #define __XPIXELBUFFER_H__
 
+#include <vector>
+
+#include <os/Thread.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/Region.h>
 #include <rfb/VNCServer.h>
 #include <x0vncserver/Image.h>
 #include <x0vncserver/PollingManager.h>
 
+namespace os {
+  class Condition;
+  class Mutex;
+}
+
 //
 // XPixelBuffer is an Image-based implementation of FullFramePixelBuffer.
 //
@@ -42,12 +51,51 @@ public:
   const Image *getImage() const { return m_image; }
 
   // Detect changed pixels, notify the server.
-  inline void poll(rfb::VNCServer *server) { m_poller->poll(server); }
+  inline void poll(rfb::VNCServer *server, int coldInterval) {
+    m_poller->poll(server, coldInterval);
+  }
+
+  // Start fetching changed areas in the background, as soon as they
+  // are reported to prefetch(). This is only possible if every change
+  // gets reported, i.e. when XDamage is available. Returns false if
+  // prefetching isn't possible.
+  bool startPrefetch();
+
+  // Report an area that has changed on screen
+  void prefetch(const rfb::Rect& r);
 
   // Override PixelBuffer::grabRegion().
   virtual void grabRegion(const rfb::Region& region);
 
 protected:
+  // Merge a region in to a few boxes that can be fetched with as few
+  // requests as possible, and work out which part of the image those
+  // requests will update
+  static void coalesce(const ShmImage* image, const rfb::Region& region,
+                       std::vector<rfb::Rect>* boxes,
+                       rfb::Region* touched);
+  static void grabBoxes(ShmImage* image, Window root,
+                        int offsetLeft, int offsetTop,
+                        const std::vector<rfb::Rect>& boxes);
+
+  class PrefetchThread : public os::Thread {
+  public:
+    PrefetchThread(XPixelBuffer* pb);
+    ~PrefetchThread();
+
+    void stop();
+
+  protected:
+    void worker();
+
+  private:
+    XPixelBuffer* pb;
+
+    bool stopRequested;
+
+    unsigned traceTrack;
+  };
+
   PollingManager *m_poller;
 
   Display *m_dpy;
@@ -55,6 +103,29 @@ protected:
   int m_offsetLeft;
   int m_offsetTop;
 
+  // The prefetcher needs its own connection, and its own copy of the
+  // screen that areas are copied from once they are asked for
+  PrefetchThread* m_prefetcher;
+  Display* m_prefetchDpy;
+  ShmImage* m_prefetchImage;
+
+  // Protects the regions below, which describe the prefetcher's copy
+  // of the screen
+  os::Mutex* m_prefetchMutex;
+  os::Condition* m_prefetchCond;
+  // Changed, but not yet fetched
+  rfb::Region m_pending;
+  // Currently being updated by the prefetcher, which might be more
+  // than was asked for
+  rfb::Region m_fetching;
+  // Changed again while being fetched
+  rfb::Region m_dirty;
+  // Fetched, and up to date as far as we know
+  rfb::Region m_ready;
+  // grabRegion() is copying from m_prefetchImage, so the prefetcher
+  // must not start updating it
+  bool m_copying;
+
   // Copy pixels from the screen to the pixel buffer,
   // for the specified rectangular area of the buffer.
   inline void grabRect(const rfb::Rect &r) {
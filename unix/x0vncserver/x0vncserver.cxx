@@ -313,6 +313,9 @@ int main(int argc, char** argv)
     usage();
   }
 
+  // Changed areas of the screen are fetched by a separate thread
+  XInitThreads();
+
   if (!(dpy = XOpenDisplay(displayname))) {
     // FIXME: Why not vlog.error(...)?
     fprintf(stderr,"%s: unable to open display \"%s\"\r\n",
@@ -479,7 +482,7 @@ int main(int argc, char** argv)
 
       if (desktop.isRunning() && sched.goodTimeToPoll()) {
         sched.newPass();
-        desktop.poll();
+        desktop.poll(sched.coldInterval());
       }
     }
 
@@ -25,6 +25,7 @@
 
 #include <network/TcpSocket.h>
 #include <rfb/Configuration.h>
+#include <rfb/FramebufferMemory.h>
 #include <rfb/LogWriter.h>
 #include <rfb/Logger_stdio.h>
 #include <rfb/Logger_syslog.h>
@@ -257,3 +258,17 @@ int vncIsValidUTF8(const char* str, size_t bytes)
     return 0;
   }
 }
+
+void* vncAllocFramebuffer(size_t size)
+{
+  try {
+    return allocFramebuffer(size);
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void vncFreeFramebuffer(void* data, size_t size)
+{
+  freeFramebuffer((uint8_t*)data, size);
+}
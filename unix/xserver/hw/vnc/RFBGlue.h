@@ -55,6 +55,9 @@ char* vncUTF8ToLatin1(const char* src, size_t bytes);
 
 int vncIsValidUTF8(const char* str, size_t bytes);
 
+void* vncAllocFramebuffer(size_t size);
+void vncFreeFramebuffer(void* data, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
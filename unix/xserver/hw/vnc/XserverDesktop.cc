@@ -39,6 +39,7 @@
 
 #include <network/Socket.h>
 #include <rfb/Exception.h>
+#include <rfb/FramebufferMemory.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/LogWriter.h>
 #include <rfb/Configuration.h>
@@ -76,16 +77,17 @@ XserverDesktop::XserverDesktop(int screenIndex_,
                                std::list<network::SocketListener*> listeners_,
                                const char* name, const rfb::PixelFormat &pf,
                                int width, int height,
-                               void* fbptr, int stride_)
+                               void* fbptr, int stride_, int fbfd)
   : screenIndex(screenIndex_),
     server(0), listeners(listeners_),
-    shadowFramebuffer(NULL),
+    shadowFramebuffer(NULL), shadowFramebufferSize(0),
+    framebufferFd(-1), exporter(NULL),
     queryConnectId(0), queryConnectTimer(this)
 {
   format = pf;
 
   server = new VNCServerST(name, this);
-  setFramebuffer(width, height, fbptr, stride_);
+  setFramebuffer(width, height, fbptr, stride_, fbfd);
 
   for (std::list<SocketListener*>::iterator i = listeners.begin();
        i != listeners.end();
@@ -96,13 +98,25 @@ XserverDesktop::XserverDesktop(int screenIndex_,
 
 XserverDesktop::~XserverDesktop()
 {
+  if (exporter) {
+    std::list<int> consumers;
+    std::list<int>::iterator i;
+
+    exporter->getConsumers(&consumers);
+    for (i = consumers.begin(); i != consumers.end(); ++i)
+      vncRemoveNotifyFd(*i);
+
+    vncRemoveNotifyFd(exporter->getFd());
+    delete exporter;
+  }
+
   while (!listeners.empty()) {
     vncRemoveNotifyFd(listeners.back()->getFd());
     delete listeners.back();
     listeners.pop_back();
   }
   if (shadowFramebuffer)
-    delete [] shadowFramebuffer;
+    freeFramebuffer(shadowFramebuffer, shadowFramebufferSize);
   delete server;
 }
 
@@ -116,29 +130,68 @@ void XserverDesktop::unblockUpdates()
   server->unblockUpdates();
 }
 
-void XserverDesktop::setFramebuffer(int w, int h, void* fbptr, int stride_)
+void XserverDesktop::setFramebuffer(int w, int h, void* fbptr, int stride_,
+                                    int fbfd)
 {
   ScreenSet layout;
 
   if (shadowFramebuffer) {
-    delete [] shadowFramebuffer;
+    freeFramebuffer(shadowFramebuffer, shadowFramebufferSize);
     shadowFramebuffer = NULL;
   }
 
   if (!fbptr) {
-    shadowFramebuffer = new uint8_t[w * h * (format.bpp/8)];
+    shadowFramebufferSize = w * h * (format.bpp/8);
+    shadowFramebuffer = allocFramebuffer(shadowFramebufferSize);
     fbptr = shadowFramebuffer;
     stride_ = w;
+    fbfd = -1;
   }
 
   setBuffer(w, h, (uint8_t*)fbptr, stride_);
 
+  framebufferFd = fbfd;
+  updateExporter();
+
   vncSetGlueContext(screenIndex);
   layout = ::computeScreenLayout(&outputIdMap);
 
   server->setPixelBuffer(this, layout);
 }
 
+void XserverDesktop::exportFramebuffer(const char* path, int mode)
+{
+  assert(exporter == NULL);
+
+  exporter = new FramebufferExporter(path, mode);
+  vncSetNotifyFd(exporter->getFd(), screenIndex, true, false);
+
+  updateExporter();
+}
+
+void XserverDesktop::updateExporter()
+{
+  int stride;
+
+  if (!exporter)
+    return;
+
+  if (framebufferFd == -1) {
+    vlog.error("Framebuffer memory cannot be shared, so it will not be "
+               "exported");
+    return;
+  }
+
+  getBuffer(getRect(), &stride);
+  try {
+    exporter->setFramebuffer(framebufferFd,
+                             (size_t)stride * height() * (format.bpp/8), 0,
+                             width(), height(), stride, format);
+  } catch (rdr::Exception& e) {
+    vlog.error("Unable to export framebuffer: %s", e.str());
+  }
+}
+
 void XserverDesktop::refreshScreenLayout()
 {
   vncSetGlueContext(screenIndex);
@@ -278,6 +331,8 @@ void XserverDesktop::add_changed(const rfb::Region &region)
 {
   try {
     server->add_changed(region);
+    if (exporter)
+      exporter->add_changed(region);
   } catch (rdr::Exception& e) {
     vlog.error("XserverDesktop::add_changed: %s",e.str());
   }
@@ -287,6 +342,8 @@ void XserverDesktop::add_copied(const rfb::Region &dest, const rfb::Point &delta
 {
   try {
     server->add_copied(dest, delta);
+    if (exporter)
+      exporter->add_changed(dest);
   } catch (rdr::Exception& e) {
     vlog.error("XserverDesktop::add_copied: %s",e.str());
   }
@@ -303,6 +360,9 @@ void XserverDesktop::handleSocketEvent(int fd, bool read, bool write)
     if (handleSocketEvent(fd, server, read, write))
       return;
 
+    if (read && handleExporterEvent(fd))
+      return;
+
     vlog.error("Cannot find file descriptor for socket event");
   } catch (rdr::Exception& e) {
     vlog.error("XserverDesktop::handleSocketEvent: %s",e.str());
@@ -356,6 +416,35 @@ bool XserverDesktop::handleSocketEvent(int fd,
   return true;
 }
 
+bool XserverDesktop::handleExporterEvent(int fd)
+{
+  if (!exporter)
+    return false;
+
+  if (fd == exporter->getFd()) {
+    int consumer;
+
+    consumer = exporter->accept();
+    if (consumer != -1) {
+      vlog.debug("new framebuffer consumer, sock %d", consumer);
+      vncSetNotifyFd(consumer, screenIndex, true, false);
+    }
+
+    return true;
+  }
+
+  if (!exporter->isConsumer(fd))
+    return false;
+
+  if (!exporter->processConsumer(fd)) {
+    vlog.debug("framebuffer consumer gone, sock %d", fd);
+    vncRemoveNotifyFd(fd);
+    exporter->removeConsumer(fd);
+  }
+
+  return true;
+}
+
 void XserverDesktop::blockHandler(int* timeout)
 {
   // We don't have a good callback for when we can init input devices[1],
@@ -393,6 +482,10 @@ void XserverDesktop::blockHandler(int* timeout)
       server->setCursorPos(oldCursorPos, false);
     }
 
+    // Tell local consumers what has been drawn since last time
+    if (exporter)
+      exporter->flush();
+
     // Trigger timers and check when the next will expire
     int nextTimeout = Timer::checkTimeouts();
     if (nextTimeout > 0 && (*timeout == -1 || nextTimeout < *timeout))
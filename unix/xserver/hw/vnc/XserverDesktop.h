@@ -35,6 +35,7 @@
 #include <rfb/PixelBuffer.h>
 #include <rfb/Configuration.h>
 #include <rfb/Timer.h>
+#include <rfb/FramebufferExporter.h>
 #include <unixcommon.h>
 #include "vncInput.h"
 
@@ -51,13 +52,15 @@ public:
   XserverDesktop(int screenIndex,
                  std::list<network::SocketListener*> listeners_,
                  const char* name, const rfb::PixelFormat &pf,
-                 int width, int height, void* fbptr, int stride);
+                 int width, int height, void* fbptr, int stride,
+                 int fbfd);
   virtual ~XserverDesktop();
 
   // methods called from X server code
   void blockUpdates();
   void unblockUpdates();
-  void setFramebuffer(int w, int h, void* fbptr, int stride);
+  void setFramebuffer(int w, int h, void* fbptr, int stride, int fbfd);
+  void exportFramebuffer(const char* path, int mode);
   void refreshScreenLayout();
   void requestClipboard();
   void announceClipboard(bool available);
@@ -111,6 +114,8 @@ protected:
   bool handleSocketEvent(int fd,
                          network::SocketServer* sockserv,
                          bool read, bool write);
+  bool handleExporterEvent(int fd);
+  void updateExporter();
 
   virtual bool handleTimeout(rfb::Timer* t);
 
@@ -120,6 +125,10 @@ private:
   rfb::VNCServer* server;
   std::list<network::SocketListener*> listeners;
   uint8_t* shadowFramebuffer;
+  size_t shadowFramebufferSize;
+  int framebufferFd;
+
+  rfb::FramebufferExporter* exporter;
 
   uint32_t queryConnectId;
   network::Socket* queryConnectSocket;
@@ -0,0 +1,268 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vncDamage.h"
+#include "vncExtInit.h"
+
+// Some applications draw a large number of tiny things (e.g. glyphs or
+// spans) for every frame. Passing each of those on directly results in
+// a huge and very fragmented region that is expensive to handle further
+// down. So we collect the changes here and pass them on once per
+// iteration of the main loop. If there are too many rectangles then we
+// switch to marking fixed size tiles instead, which puts an upper bound
+// on the complexity of the resulting region.
+
+#define DAMAGE_TILE_SIZE 16
+
+void vncDamageInit(struct VncDamage *damage)
+{
+  damage->count = 0;
+  damage->size = 0;
+  damage->rects = NULL;
+  damage->tiled = 0;
+  damage->tilesWidth = 0;
+  damage->tilesHeight = 0;
+  damage->tiles = NULL;
+}
+
+void vncDamageFree(struct VncDamage *damage)
+{
+  free(damage->rects);
+  free(damage->tiles);
+  vncDamageInit(damage);
+}
+
+static void mark_tiles(struct VncDamage *damage,
+                       const struct UpdateRect *rect)
+{
+  int x1, y1, x2, y2;
+  int y;
+
+  x1 = rect->x1 / DAMAGE_TILE_SIZE;
+  y1 = rect->y1 / DAMAGE_TILE_SIZE;
+  x2 = (rect->x2 + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+  y2 = (rect->y2 + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+
+  if (x1 < 0)
+    x1 = 0;
+  if (y1 < 0)
+    y1 = 0;
+  if (x2 > damage->tilesWidth)
+    x2 = damage->tilesWidth;
+  if (y2 > damage->tilesHeight)
+    y2 = damage->tilesHeight;
+
+  if ((x1 >= x2) || (y1 >= y2))
+    return;
+
+  for (y = y1; y < y2; y++)
+    memset(damage->tiles + y * damage->tilesWidth + x1, 1, x2 - x1);
+}
+
+static int start_tiles(struct VncDamage *damage, int width, int height)
+{
+  int tilesWidth, tilesHeight;
+  int i;
+
+  tilesWidth = (width + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+  tilesHeight = (height + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+
+  // Screen might have been resized since last time
+  if ((damage->tiles == NULL) ||
+      (tilesWidth != damage->tilesWidth) ||
+      (tilesHeight != damage->tilesHeight)) {
+    free(damage->tiles);
+    damage->tiles = calloc((size_t)tilesWidth * tilesHeight, 1);
+    if (damage->tiles == NULL)
+      return 0;
+    damage->tilesWidth = tilesWidth;
+    damage->tilesHeight = tilesHeight;
+  }
+
+  for (i = 0; i < damage->count; i++)
+    mark_tiles(damage, &damage->rects[i]);
+
+  damage->count = 0;
+  damage->tiled = 1;
+
+  return 1;
+}
+
+static void flush_tiles(struct VncDamage *damage, int scrIdx,
+                        int width, int height)
+{
+  unsigned char *row;
+  int x, y;
+  int rowStart, rowCount;
+  int prevStart, prevCount;
+
+  // Each row of tiles is converted to a set of rectangles, and
+  // identical rows are merged in to a single, taller set
+  damage->count = 0;
+  prevStart = prevCount = 0;
+
+  for (y = 0; y < damage->tilesHeight; y++) {
+    row = damage->tiles + y * damage->tilesWidth;
+
+    rowStart = damage->count;
+    rowCount = 0;
+
+    x = 0;
+    while (x < damage->tilesWidth) {
+      struct UpdateRect rect;
+
+      if (!row[x]) {
+        x++;
+        continue;
+      }
+
+      rect.x1 = x * DAMAGE_TILE_SIZE;
+      rect.y1 = y * DAMAGE_TILE_SIZE;
+
+      while ((x < damage->tilesWidth) && row[x])
+        x++;
+
+      rect.x2 = x * DAMAGE_TILE_SIZE;
+      rect.y2 = (y + 1) * DAMAGE_TILE_SIZE;
+
+      if (rect.x2 > width)
+        rect.x2 = width;
+      if (rect.y2 > height)
+        rect.y2 = height;
+
+      if (damage->count == damage->size) {
+        struct UpdateRect *rects;
+        int size;
+
+        size = damage->size * 2;
+        if (size < 16)
+          size = 16;
+
+        rects = realloc(damage->rects, sizeof(struct UpdateRect) * size);
+        if (rects == NULL) {
+          // Give up and send the whole thing
+          damage->count = 0;
+          rect.x1 = rect.y1 = 0;
+          rect.x2 = width;
+          rect.y2 = height;
+          vncAddChanged(scrIdx, 1, &rect);
+          memset(damage->tiles, 0,
+                 (size_t)damage->tilesWidth * damage->tilesHeight);
+          return;
+        }
+
+        damage->rects = rects;
+        damage->size = size;
+      }
+
+      damage->rects[damage->count++] = rect;
+      rowCount++;
+    }
+
+    // Same as the row above?
+    if ((rowCount != 0) && (rowCount == prevCount) &&
+        (rowStart == prevStart + prevCount) &&
+        (damage->rects[prevStart].y2 == y * DAMAGE_TILE_SIZE)) {
+      struct UpdateRect *prev, *cur;
+
+      prev = &damage->rects[prevStart];
+      cur = &damage->rects[rowStart];
+
+      for (x = 0; x < rowCount; x++) {
+        if ((prev[x].x1 != cur[x].x1) || (prev[x].x2 != cur[x].x2))
+          break;
+      }
+
+      if (x == rowCount) {
+        for (x = 0; x < rowCount; x++)
+          prev[x].y2 = cur[x].y2;
+        damage->count = rowStart;
+        continue;
+      }
+    }
+
+    prevStart = rowStart;
+    prevCount = rowCount;
+  }
+
+  memset(damage->tiles, 0, (size_t)damage->tilesWidth * damage->tilesHeight);
+
+  if (damage->count > 0)
+    vncAddChanged(scrIdx, damage->count, damage->rects);
+}
+
+void vncDamageAdd(struct VncDamage *damage, int scrIdx,
+                  int width, int height, int maxRects,
+                  int nRects, const struct UpdateRect *rects)
+{
+  int i;
+
+  if (!damage->tiled) {
+    if (damage->count + nRects <= maxRects) {
+      if (damage->size < maxRects) {
+        struct UpdateRect *newRects;
+
+        newRects = realloc(damage->rects,
+                           sizeof(struct UpdateRect) * maxRects);
+        if (newRects == NULL) {
+          vncAddChanged(scrIdx, nRects, rects);
+          return;
+        }
+
+        damage->rects = newRects;
+        damage->size = maxRects;
+      }
+
+      memcpy(damage->rects + damage->count, rects,
+             sizeof(struct UpdateRect) * nRects);
+      damage->count += nRects;
+
+      return;
+    }
+
+    // Too fragmented, so switch to tiles
+    if (!start_tiles(damage, width, height)) {
+      vncDamageFlush(damage, scrIdx, width, height);
+      vncAddChanged(scrIdx, nRects, rects);
+      return;
+    }
+  }
+
+  for (i = 0; i < nRects; i++)
+    mark_tiles(damage, &rects[i]);
+}
+
+void vncDamageFlush(struct VncDamage *damage, int scrIdx,
+                    int width, int height)
+{
+  if (damage->tiled) {
+    flush_tiles(damage, scrIdx, width, height);
+    damage->tiled = 0;
+  } else if (damage->count > 0) {
+    vncAddChanged(scrIdx, damage->count, damage->rects);
+  }
+
+  damage->count = 0;
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+#ifndef __VNCDAMAGE_H__
+#define __VNCDAMAGE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct UpdateRect;
+
+// Changes to a screen collected since they were last passed on to the
+// VNC server. Up to a given number of rectangles are kept exactly,
+// after which fixed size tiles are marked instead.
+
+struct VncDamage {
+  int count;
+  int size;
+  struct UpdateRect *rects;
+  int tiled;
+  int tilesWidth;
+  int tilesHeight;
+  unsigned char *tiles;
+};
+
+void vncDamageInit(struct VncDamage *damage);
+void vncDamageFree(struct VncDamage *damage);
+
+void vncDamageAdd(struct VncDamage *damage, int scrIdx,
+                  int width, int height, int maxRects,
+                  int nRects, const struct UpdateRect *rects);
+
+// vncDamageFlush() gives everything collected to vncAddChanged()
+void vncDamageFlush(struct VncDamage *damage, int scrIdx,
+                    int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
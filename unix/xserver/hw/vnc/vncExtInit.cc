@@ -67,6 +67,7 @@ static bool initialised = false;
 static XserverDesktop* desktop[MAXSCREENS] = { 0, };
 void* vncFbptr[MAXSCREENS] = { 0, };
 int vncFbstride[MAXSCREENS];
+int vncFbfd[MAXSCREENS];
 
 int vncInetdSock = -1;
 
@@ -102,6 +103,19 @@ rfb::BoolParameter setPrimary("SetPrimary", "Set the PRIMARY as well "
 rfb::BoolParameter sendPrimary("SendPrimary",
                                "Send the PRIMARY as well as the CLIPBOARD selection",
                                true);
+rfb::IntParameter damageMaxRects("DamageMaxRects",
+                                 "Maximum number of damaged rectangles to "
+                                 "track exactly between updates before "
+                                 "falling back to coarser tiles (0 to "
+                                 "report each change directly)",
+                                 256, 0);
+rfb::StringParameter framebufferExport("FramebufferExport",
+                                       "Unix socket where local processes "
+                                       "can get access to the framebuffer "
+                                       "and be notified of changes", "");
+rfb::IntParameter framebufferExportMode("FramebufferExportMode",
+                                        "Access mode of the framebuffer "
+                                        "export socket", 0600);
 
 static const char* defaultDesktopName()
 {
@@ -262,9 +276,27 @@ void vncExtensionInit(void)
                                           vncGetScreenWidth(),
                                           vncGetScreenHeight(),
                                           vncFbptr[scr],
-                                          vncFbstride[scr]);
+                                          vncFbstride[scr],
+                                          vncFbfd[scr]);
         vlog.info("created VNC server for screen %d", scr);
 
+        if (((const char*)framebufferExport)[0] != '\0') {
+          char path[PATH_MAX];
+          int mode = (int)framebufferExportMode;
+
+          if (scr == 0)
+            strncpy(path, framebufferExport, sizeof(path));
+          else
+            snprintf(path, sizeof(path), "%s.%d",
+                     (const char*)framebufferExport, scr);
+          path[sizeof(path)-1] = '\0';
+
+          desktop[scr]->exportFramebuffer(path, mode);
+
+          vlog.info("Exporting framebuffer on %s (mode %04o)",
+                    path, mode);
+        }
+
         if (scr == 0 && vncInetdSock != -1 && listeners.empty()) {
           network::Socket* sock = new network::TcpSocket(vncInetdSock);
           desktop[scr]->addClient(sock, false);
@@ -300,8 +332,11 @@ void vncHandleSocketEvent(int fd, int scrIdx, int read, int write)
 
 void vncCallBlockHandlers(int* timeout)
 {
-  for (int scr = 0; scr < vncGetScreenCount(); scr++)
+  for (int scr = 0; scr < vncGetScreenCount(); scr++) {
+    // Any collected damage must be known before deciding on the timeout
+    vncHooksFlushDamage(scr);
     desktop[scr]->blockHandler(timeout);
+  }
 }
 
 int vncGetAvoidShiftNumLock(void)
@@ -319,6 +354,16 @@ int vncGetSendPrimary(void)
   return (bool)sendPrimary;
 }
 
+int vncGetDamageMaxRects(void)
+{
+  return damageMaxRects;
+}
+
+int vncGetFramebufferExport(void)
+{
+  return ((const char*)framebufferExport)[0] != '\0';
+}
+
 void vncUpdateDesktopName(void)
 {
   for (int scr = 0; scr < vncGetScreenCount(); scr++)
@@ -414,10 +459,14 @@ void vncSetLEDState(unsigned long leds)
 void vncAddChanged(int scrIdx, int nRects,
                    const struct UpdateRect *rects)
 {
+  Region changed;
+
   for (int i = 0;i < nRects;i++) {
-    desktop[scrIdx]->add_changed(Region(Rect(rects[i].x1, rects[i].y1,
-                                             rects[i].x2, rects[i].y2)));
+    changed.assign_union(Region(Rect(rects[i].x1, rects[i].y1,
+                                     rects[i].x2, rects[i].y2)));
   }
+
+  desktop[scrIdx]->add_changed(changed);
 }
 
 void vncAddCopied(int scrIdx, int nRects,
@@ -459,7 +508,8 @@ void vncPostScreenResize(int scrIdx, int success, int width, int height)
     try {
       desktop[scrIdx]->setFramebuffer(width, height,
                                       vncFbptr[scrIdx],
-                                      vncFbstride[scrIdx]);
+                                      vncFbstride[scrIdx],
+                                      vncFbfd[scrIdx]);
     } catch (rdr::Exception& e) {
       vncFatalError("vncPostScreenResize: %s\n", e.str());
     }
@@ -37,6 +37,9 @@ int vncNotifyQueryConnect(void);
 // vncExtInit.cc
 extern void* vncFbptr[];
 extern int vncFbstride[];
+// File descriptor of the framebuffer memory, or -1 if it cannot be
+// shared. Only valid when vncFbptr is set.
+extern int vncFbfd[];
 
 extern int vncInetdSock;
 
@@ -51,6 +54,10 @@ int vncGetAvoidShiftNumLock(void);
 int vncGetSetPrimary(void);
 int vncGetSendPrimary(void);
 
+int vncGetDamageMaxRects(void);
+
+int vncGetFramebufferExport(void);
+
 void vncUpdateDesktopName(void);
 
 void vncRequestClipboard(void);
@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include "vncHooks.h"
+#include "vncDamage.h"
 #include "vncExtInit.h"
 
 #include "xorg-version.h"
@@ -55,6 +56,9 @@
 typedef struct _vncHooksScreenRec {
   int                          ignoreHooks;
 
+  // Changes collected since the last time they were passed on
+  struct VncDamage             damage;
+
   CloseScreenProcPtr           CloseScreen;
   CreateGCProcPtr              CreateGC;
   CopyWindowProcPtr            CopyWindow;
@@ -267,6 +271,8 @@ int vncHooksInit(int scrIdx)
 
   vncHooksScreen->ignoreHooks = 0;
 
+  vncDamageInit(&vncHooksScreen->damage);
+
   wrap(vncHooksScreen, pScreen, CloseScreen, vncHooksCloseScreen);
   wrap(vncHooksScreen, pScreen, CreateGC, vncHooksCreateGC);
   wrap(vncHooksScreen, pScreen, CopyWindow, vncHooksCopyWindow);
@@ -329,6 +335,19 @@ void vncGetScreenImage(int scrIdx, int x, int y, int width, int height,
   vncHooksScreen->ignoreHooks--;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// vncHooksFlushDamage() passes on all changes collected since the last
+// call. It needs to be called before the server decides what to send.
+
+void vncHooksFlushDamage(int scrIdx)
+{
+  ScreenPtr pScreen = screenInfo.screens[scrIdx];
+  vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+
+  vncDamageFlush(&vncHooksScreen->damage, scrIdx,
+                 pScreen->width, pScreen->height);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // Helper functions
@@ -341,9 +360,16 @@ static inline void add_changed(ScreenPtr pScreen, RegionPtr reg)
     return;
   if (RegionNil(reg))
     return;
-  vncAddChanged(pScreen->myNum,
-                RegionNumRects(reg),
-                (const struct UpdateRect*)RegionRects(reg));
+  if (vncGetDamageMaxRects() <= 0) {
+    vncAddChanged(pScreen->myNum,
+                  RegionNumRects(reg),
+                  (const struct UpdateRect*)RegionRects(reg));
+    return;
+  }
+  vncDamageAdd(&vncHooksScreen->damage, pScreen->myNum,
+               pScreen->width, pScreen->height, vncGetDamageMaxRects(),
+               RegionNumRects(reg),
+               (const struct UpdateRect*)RegionRects(reg));
 }
 
 static inline void add_copied(ScreenPtr pScreen, RegionPtr dst,
@@ -354,6 +380,8 @@ static inline void add_copied(ScreenPtr pScreen, RegionPtr dst,
     return;
   if (RegionNil(dst))
     return;
+  // Earlier changes might be affected by the copy
+  vncHooksFlushDamage(pScreen->myNum);
   vncAddCopied(pScreen->myNum,
                RegionNumRects(dst),
                (const struct UpdateRect*)RegionRects(dst), dx, dy);
@@ -414,6 +442,8 @@ static Bool vncHooksCloseScreen(ScreenPtr pScreen_)
 
   SCREEN_PROLOGUE(pScreen_, CloseScreen);
 
+  vncDamageFree(&vncHooksScreen->damage);
+
   unwrap(vncHooksScreen, pScreen, CreateGC);
   unwrap(vncHooksScreen, pScreen, CopyWindow);
   unwrap(vncHooksScreen, pScreen, ClearToBackground);
@@ -648,8 +678,9 @@ static void vncHooksCursorWarpedTo(DeviceIntPtr pDev,
 }
 #endif
 
-// BlockHandler - ignore any changes during the block handler - it's likely
-// these are just drawing the cursor.
+// BlockHandler - pass on the changes collected so far, and ignore any
+// changes during the block handler - it's likely these are just drawing
+// the cursor.
 
 #if XORG_AT_LEAST(1, 19, 0)
 static void vncHooksBlockHandler(ScreenPtr pScreen_, void * pTimeout)
@@ -660,6 +691,8 @@ static void vncHooksBlockHandler(ScreenPtr pScreen_, void * pTimeout,
 {
   SCREEN_PROLOGUE(pScreen_, BlockHandler);
 
+  vncHooksFlushDamage(pScreen->myNum);
+
   vncHooksScreen->ignoreHooks++;
 
 #if XORG_AT_LEAST(1, 19, 0)
@@ -1121,6 +1154,7 @@ static Bool vncHooksRandRSetConfig(ScreenPtr pScreen, Rotation rotation,
 
   RANDR_PROLOGUE(SetConfig);
 
+  vncHooksFlushDamage(pScreen->myNum);
   vncPreScreenResize(pScreen->myNum);
   ret = (*rp->rrSetConfig)(pScreen, rotation, rate, pSize);
   vncPostScreenResize(pScreen->myNum, ret, pScreen->width, pScreen->height);
@@ -1141,6 +1175,7 @@ static Bool vncHooksRandRScreenSetSize(ScreenPtr pScreen,
 
   RANDR_PROLOGUE(ScreenSetSize);
 
+  vncHooksFlushDamage(pScreen->myNum);
   vncPreScreenResize(pScreen->myNum);
   ret = (*rp->rrScreenSetSize)(pScreen, width, height, mmWidth, mmHeight);
   vncPostScreenResize(pScreen->myNum, ret, pScreen->width, pScreen->height);
@@ -25,6 +25,8 @@ extern "C" {
 
 int vncHooksInit(int scrIdx);
 
+void vncHooksFlushDamage(int scrIdx);
+
 void vncGetScreenImage(int scrIdx, int x, int y, int width, int height,
                        char *buffer, int strideBytes);
 
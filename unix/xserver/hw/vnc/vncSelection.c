@@ -43,6 +43,12 @@
 
 static Atom xaPRIMARY, xaCLIPBOARD;
 static Atom xaTARGETS, xaTIMESTAMP, xaSTRING, xaTEXT, xaUTF8_STRING;
+static Atom xaINCR;
+
+/* Selections larger than this are sent in chunks using the INCR
+ * mechanism, rather than in a single property */
+#define INCR_THRESHOLD (256 * 1024)
+#define INCR_CHUNK_SIZE (64 * 1024)
 
 static WindowPtr pWindow;
 static Window wid;
@@ -64,13 +70,33 @@ struct VncDataTarget {
 
 static struct VncDataTarget* vncDataTargetHead;
 
+struct VncIncrTransfer {
+  ClientPtr client;
+  Window requestor;
+  Atom property;
+  Atom type;
+  char* data;
+  size_t size;
+  size_t offset;
+  struct VncIncrTransfer* next;
+};
+
+static struct VncIncrTransfer* vncIncrTransferHead;
+
 static int vncCreateSelectionWindow(void);
 static int vncOwnSelection(Atom selection);
 static int vncConvertSelection(ClientPtr client, Atom selection,
                                Atom target, Atom property,
                                Window requestor, CARD32 time,
                                const char* data);
+static int vncSetSelectionData(ClientPtr client, WindowPtr pWin,
+                               Atom property, Atom type,
+                               const char* data, size_t size);
+static void vncRemoveIncrTransfer(struct VncIncrTransfer* transfer);
+static void vncHandlePropertyDeletion(Window window, Atom property);
 static int vncProcConvertSelection(ClientPtr client);
+static int vncProcDeleteProperty(ClientPtr client);
+static int vncProcGetProperty(ClientPtr client);
 static void vncSelectionRequest(Atom selection, Atom target);
 static int vncProcSendEvent(ClientPtr client);
 static void vncSelectionCallback(CallbackListPtr *callbacks,
@@ -79,6 +105,8 @@ static void vncClientStateCallback(CallbackListPtr * l,
                                    void * d, void * p);
 
 static int (*origProcConvertSelection)(ClientPtr);
+static int (*origProcDeleteProperty)(ClientPtr);
+static int (*origProcGetProperty)(ClientPtr);
 static int (*origProcSendEvent)(ClientPtr);
 
 void vncSelectionInit(void)
@@ -91,6 +119,7 @@ void vncSelectionInit(void)
   xaSTRING = MakeAtom("STRING", 6, TRUE);
   xaTEXT = MakeAtom("TEXT", 4, TRUE);
   xaUTF8_STRING = MakeAtom("UTF8_STRING", 11, TRUE);
+  xaINCR = MakeAtom("INCR", 4, TRUE);
 
   /* There are no hooks for when these are internal windows, so
    * override the relevant handlers. */
@@ -99,6 +128,12 @@ void vncSelectionInit(void)
   origProcSendEvent = ProcVector[X_SendEvent];
   ProcVector[X_SendEvent] = vncProcSendEvent;
 
+  /* INCR transfers progress as the requestor deletes the property */
+  origProcDeleteProperty = ProcVector[X_DeleteProperty];
+  ProcVector[X_DeleteProperty] = vncProcDeleteProperty;
+  origProcGetProperty = ProcVector[X_GetProperty];
+  ProcVector[X_GetProperty] = vncProcGetProperty;
+
   if (!AddCallback(&SelectionCallback, vncSelectionCallback, 0))
     FatalError("Add VNC SelectionCallback failed\n");
   if (!AddCallback(&ClientStateCallback, vncClientStateCallback, 0))
@@ -421,18 +456,16 @@ static int vncConvertSelection(ClientPtr client, Atom selection,
         if (latin1 == NULL)
           return BadAlloc;
 
-        rc = dixChangeWindowProperty(serverClient, pWin, realProperty,
-                                     XA_STRING, 8, PropModeReplace,
-                                     strlen(latin1), latin1, TRUE);
+        rc = vncSetSelectionData(client, pWin, realProperty, XA_STRING,
+                                 latin1, strlen(latin1));
 
         free(latin1);
 
         if (rc != Success)
           return rc;
       } else if (target == xaUTF8_STRING) {
-        rc = dixChangeWindowProperty(serverClient, pWin, realProperty,
-                                     xaUTF8_STRING, 8, PropModeReplace,
-                                     strlen(data), data, TRUE);
+        rc = vncSetSelectionData(client, pWin, realProperty,
+                                 xaUTF8_STRING, data, strlen(data));
         if (rc != Success)
           return rc;
       } else {
@@ -451,6 +484,132 @@ static int vncConvertSelection(ClientPtr client, Atom selection,
   return Success;
 }
 
+static int vncSetSelectionData(ClientPtr client, WindowPtr pWin,
+                               Atom property, Atom type,
+                               const char* data, size_t size)
+{
+  struct VncIncrTransfer* transfer;
+  CARD32 length;
+  int rc;
+
+  if (size <= INCR_THRESHOLD) {
+    return dixChangeWindowProperty(serverClient, pWin, property,
+                                   type, 8, PropModeReplace,
+                                   size, data, TRUE);
+  }
+
+  /* Any earlier transfer to the same place has been abandoned */
+  for (transfer = vncIncrTransferHead; transfer; transfer = transfer->next) {
+    if ((transfer->requestor == pWin->drawable.id) &&
+        (transfer->property == property)) {
+      vncRemoveIncrTransfer(transfer);
+      break;
+    }
+  }
+
+  transfer = calloc(1, sizeof(struct VncIncrTransfer));
+  if (transfer == NULL)
+    return BadAlloc;
+
+  transfer->data = malloc(size);
+  if (transfer->data == NULL) {
+    free(transfer);
+    return BadAlloc;
+  }
+
+  memcpy(transfer->data, data, size);
+
+  transfer->client = client;
+  transfer->requestor = pWin->drawable.id;
+  transfer->property = property;
+  transfer->type = type;
+  transfer->size = size;
+  transfer->offset = 0;
+
+  /* The actual data follows once the requestor deletes this */
+  length = size;
+  rc = dixChangeWindowProperty(serverClient, pWin, property,
+                               xaINCR, 32, PropModeReplace,
+                               1, &length, TRUE);
+  if (rc != Success) {
+    free(transfer->data);
+    free(transfer);
+    return rc;
+  }
+
+  LOG_DEBUG("Sending %d bytes of %s incrementally",
+            (int)size, NameForAtom(type));
+
+  transfer->next = vncIncrTransferHead;
+  vncIncrTransferHead = transfer;
+
+  return Success;
+}
+
+static void vncRemoveIncrTransfer(struct VncIncrTransfer* transfer)
+{
+  struct VncIncrTransfer** nextPtr;
+
+  for (nextPtr = &vncIncrTransferHead; *nextPtr; nextPtr = &(*nextPtr)->next) {
+    if (*nextPtr == transfer) {
+      *nextPtr = transfer->next;
+      free(transfer->data);
+      free(transfer);
+      return;
+    }
+  }
+}
+
+static void vncHandlePropertyDeletion(Window window, Atom property)
+{
+  struct VncIncrTransfer* transfer;
+  WindowPtr pWin;
+  PropertyPtr prop;
+  size_t chunk;
+  int rc;
+
+  for (transfer = vncIncrTransferHead; transfer; transfer = transfer->next) {
+    if ((transfer->requestor == window) && (transfer->property == property))
+      break;
+  }
+
+  if (transfer == NULL)
+    return;
+
+  rc = dixLookupWindow(&pWin, window, serverClient, DixSetAttrAccess);
+  if (rc != Success) {
+    vncRemoveIncrTransfer(transfer);
+    return;
+  }
+
+  /* A GetProperty with delete set doesn't always delete anything */
+  rc = dixLookupProperty(&prop, pWin, property,
+                         serverClient, DixReadAccess);
+  if (rc == Success)
+    return;
+
+  /* A final empty chunk marks the end of the transfer */
+  chunk = transfer->size - transfer->offset;
+  if (chunk > INCR_CHUNK_SIZE)
+    chunk = INCR_CHUNK_SIZE;
+
+  rc = dixChangeWindowProperty(serverClient, pWin, property,
+                               transfer->type, 8, PropModeReplace,
+                               chunk, transfer->data + transfer->offset,
+                               TRUE);
+  if ((rc != Success) || (chunk == 0)) {
+    if (rc != Success)
+      LOG_ERROR("Failed to send selection data");
+    else
+      LOG_DEBUG("Incremental transfer of %s complete",
+                NameForAtom(transfer->type));
+    vncRemoveIncrTransfer(transfer);
+    return;
+  }
+
+  transfer->offset += chunk;
+}
+
 static int vncProcConvertSelection(ClientPtr client)
 {
   Bool paramsOkay;
@@ -501,6 +660,46 @@ static int vncProcConvertSelection(ClientPtr client)
   return origProcConvertSelection(client);
 }
 
+static int vncProcDeleteProperty(ClientPtr client)
+{
+  Window window;
+  Atom property;
+  int rc;
+
+  REQUEST(xDeletePropertyReq);
+  REQUEST_SIZE_MATCH(xDeletePropertyReq);
+
+  window = stuff->window;
+  property = stuff->property;
+
+  rc = origProcDeleteProperty(client);
+  if (rc == Success)
+    vncHandlePropertyDeletion(window, property);
+
+  return rc;
+}
+
+static int vncProcGetProperty(ClientPtr client)
+{
+  Window window;
+  Atom property;
+  Bool deleteProp;
+  int rc;
+
+  REQUEST(xGetPropertyReq);
+  REQUEST_SIZE_MATCH(xGetPropertyReq);
+
+  window = stuff->window;
+  property = stuff->property;
+  deleteProp = stuff->delete;
+
+  rc = origProcGetProperty(client);
+  if ((rc == Success) && deleteProp)
+    vncHandlePropertyDeletion(window, property);
+
+  return rc;
+}
+
 static void vncSelectionRequest(Atom selection, Atom target)
 {
   Selection *pSel;
@@ -700,5 +899,13 @@ static void vncClientStateCallback(CallbackListPtr * l,
       }
       nextPtr = &cur->next;
     }
+
+    struct VncIncrTransfer* transfer = vncIncrTransferHead;
+    while (transfer != NULL) {
+      struct VncIncrTransfer* next = transfer->next;
+      if (transfer->client == client)
+        vncRemoveIncrTransfer(transfer);
+      transfer = next;
+    }
   }
 }
@@ -54,6 +54,9 @@ from the X Consortium.
 #include <sys/stat.h>
 #include <errno.h>
 #include <sys/param.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "dix.h"
 #include "os.h"
 #include "miline.h"
@@ -86,6 +89,7 @@ typedef struct {
     int depth;
     int bitsPerPixel;
     void *pfbMemory;
+    int fd;
 } VncFramebufferInfo, *VncFramebufferInfoPtr;
 
 typedef struct {
@@ -101,6 +105,7 @@ static VncScreenInfo vncScreenInfo = {
     .fb.height = VNC_DEFAULT_HEIGHT,
     .fb.depth = VNC_DEFAULT_DEPTH,
     .fb.pfbMemory = NULL,
+    .fb.fd = -1,
     .pixelFormatDefined = FALSE,
 };
 
@@ -478,7 +483,48 @@ vncAllocateFramebufferMemory(VncFramebufferInfoPtr pfb)
 
     /* And allocate buffer */
     sizeInBytes = pfb->paddedBytesWidth * pfb->height;
-    pfb->pfbMemory = malloc(sizeInBytes);
+
+    pfb->fd = -1;
+
+#ifdef __linux__
+    /* Exported framebuffers need memory that others can map. It is
+     * sealed against writing once it is exported, so it is mapped
+     * here first. */
+    if (vncGetFramebufferExport()) {
+        void *mem;
+
+        pfb->fd = memfd_create("Xvnc framebuffer",
+                               MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (pfb->fd == -1) {
+            ErrorF("Unable to create shared framebuffer: %s\n",
+                   strerror(errno));
+            return NULL;
+        }
+
+        if (ftruncate(pfb->fd, sizeInBytes) == -1) {
+            ErrorF("Unable to size shared framebuffer: %s\n",
+                   strerror(errno));
+            close(pfb->fd);
+            pfb->fd = -1;
+            return NULL;
+        }
+
+        mem = mmap(NULL, sizeInBytes, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, pfb->fd, 0);
+        if (mem == MAP_FAILED) {
+            ErrorF("Unable to map shared framebuffer: %s\n",
+                   strerror(errno));
+            close(pfb->fd);
+            pfb->fd = -1;
+            return NULL;
+        }
+
+        pfb->pfbMemory = mem;
+        return pfb->pfbMemory;
+    }
+#endif
+
+    pfb->pfbMemory = vncAllocFramebuffer(sizeInBytes);
 
     /* This will be NULL if the above failed */
     return pfb->pfbMemory;
@@ -490,7 +536,18 @@ vncFreeFramebufferMemory(VncFramebufferInfoPtr pfb)
     if ((pfb == NULL) || (pfb->pfbMemory == NULL))
         return;
 
-    free(pfb->pfbMemory);
+#ifdef __linux__
+    if (pfb->fd != -1) {
+        munmap(pfb->pfbMemory, pfb->paddedBytesWidth * pfb->height);
+        close(pfb->fd);
+        pfb->fd = -1;
+        pfb->pfbMemory = NULL;
+        return;
+    }
+#endif
+
+    vncFreeFramebuffer(pfb->pfbMemory,
+                       pfb->paddedBytesWidth * pfb->height);
     pfb->pfbMemory = NULL;
 }
 
@@ -638,6 +695,7 @@ vncRandRScreenSetSize(ScreenPtr pScreen,
     /* Let VNC get the new framebuffer (actual update is in vncHooks.cc) */
     vncFbptr[pScreen->myNum] = pbits;
     vncFbstride[pScreen->myNum] = fb.paddedWidth;
+    vncFbfd[pScreen->myNum] = fb.fd;
 
     /* Restore ability to update screen, now with new dimensions */
     SetRootClip(pScreen, ROOT_CLIP_FULL);
@@ -991,6 +1049,7 @@ vncScreenInit(ScreenPtr pScreen, int argc, char **argv)
         return FALSE;
     vncFbptr[0] = pbits;
     vncFbstride[0] = vncScreenInfo.fb.paddedWidth;
+    vncFbfd[0] = vncScreenInfo.fb.fd;
 
     switch (vncScreenInfo.fb.depth) {
     case 16:
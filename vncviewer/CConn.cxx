@@ -90,6 +90,8 @@ CConn::CConn(const char* vncServerName, network::Socket* socket=NULL)
   if (!noJpeg)
     setQualityLevel(::qualityLevel);
 
+  setContentCacheSize(::contentCacheSize);
+
   if(sock == NULL) {
     try {
 #ifndef WIN32
@@ -410,7 +412,8 @@ bool CConn::dataRect(const Rect& r, int encoding)
 {
   bool ret;
 
-  if (encoding != encodingCopyRect)
+  if ((encoding != encodingCopyRect) &&
+      (encoding != encodingContentCache))
     lastServerEncoding = encoding;
 
   ret = CConnection::dataRect(r, encoding);
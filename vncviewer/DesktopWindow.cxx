@@ -81,7 +81,8 @@ static std::set<DesktopWindow *> instances;
 DesktopWindow::DesktopWindow(int w, int h, const char *name,
                              const rfb::PixelFormat& serverPF,
                              CConn* cc_)
-  : Fl_Window(w, h), cc(cc_), offscreen(NULL), overlay(NULL),
+  : Fl_Window(Viewport::scaledSize(w), Viewport::scaledSize(h)),
+    cc(cc_), offscreen(NULL), overlay(NULL),
     firstUpdate(true),
     delayedFullscreen(false), delayedDesktopSize(false),
     keyboardGrabbed(false), mouseGrabbed(false),
@@ -97,6 +98,10 @@ DesktopWindow::DesktopWindow(int w, int h, const char *name,
 
   viewport = new Viewport(w, h, serverPF, cc);
 
+  // Everything from here on is about the size on screen
+  w = viewport->w();
+  h = viewport->h();
+
   // Position will be adjusted later
   hscroll = new Fl_Scrollbar(0, 0, 0, 0);
   vscroll = new Fl_Scrollbar(0, 0, 0, 0);
@@ -315,8 +320,14 @@ void DesktopWindow::resizeFramebuffer(int new_w, int new_h)
 {
   bool maximized;
 
-  if ((new_w == viewport->w()) && (new_h == viewport->h()))
+  new_w = Viewport::scaledSize(new_w);
+  new_h = Viewport::scaledSize(new_h);
+
+  if ((new_w == viewport->w()) && (new_h == viewport->h())) {
+    // The framebuffer itself might still have changed size
+    viewport->size(new_w, new_h);
     return;
+  }
 
   maximized = false;
 
@@ -382,12 +393,17 @@ void DesktopWindow::setCursor(int width, int height,
 }
 
 
-void DesktopWindow::setCursorPos(const rfb::Point& pos)
+void DesktopWindow::setCursorPos(const rfb::Point& fbPos)
 {
+  rfb::Point pos;
+
   if (!mouseGrabbed) {
     // Do nothing if we do not have the mouse captured.
     return;
   }
+
+  pos = viewport->scalePoint(fbPos);
+
 #if defined(WIN32)
   SetCursorPos(pos.x + x_root() + viewport->x(),
                pos.y + y_root() + viewport->y());
@@ -668,9 +684,11 @@ void DesktopWindow::resize(int x, int y, int w, int h)
     // b) The server supports it
     // c) We're not still waiting for a chance to handle DesktopSize
     // d) We're not still waiting for startup fullscreen to kick in
+    // e) We're not scaling the remote desktop
     //
     if (not firstUpdate and not delayedFullscreen and
-        ::remoteResize and cc->server.supportsSetDesktopSize) {
+        ::remoteResize and cc->server.supportsSetDesktopSize and
+        (::scale == 100)) {
       // We delay updating the remote desktop as we tend to get a flood
       // of resize events as the user is dragging the window.
       Fl::remove_timeout(handleResizeTimeout, this);
@@ -1262,7 +1280,7 @@ void DesktopWindow::handleDesktopSize()
       return;
 
     remoteResize(width, height);
-  } else if (::remoteResize) {
+  } else if (::remoteResize && (::scale == 100)) {
     // No explicit size, but remote resizing is on so make sure it
     // matches whatever size the window ended up being
     remoteResize(w(), h());
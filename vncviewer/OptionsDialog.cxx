@@ -178,6 +178,11 @@ void OptionsDialog::loadOptions(void)
   case encodingH264:
     h264Button->setonly();
     break;
+#endif
+#ifdef HAVE_ZSTD
+  case encodingZstdRLE:
+    zstdrleButton->setonly();
+    break;
 #endif
   case encodingRaw:
     rawButton->setonly();
@@ -372,6 +377,10 @@ void OptionsDialog::storeOptions(void)
 #ifdef HAVE_H264
   else if (h264Button->value())
     preferredEncoding.setParam(encodingName(encodingH264));
+#endif
+#ifdef HAVE_ZSTD
+  else if (zstdrleButton->value())
+    preferredEncoding.setParam(encodingName(encodingZstdRLE));
 #endif
   else if (rawButton->value())
     preferredEncoding.setParam(encodingName(encodingRaw));
@@ -565,6 +574,15 @@ void OptionsDialog::createCompressionPage(int tx, int ty, int tw, int th)
     ty += RADIO_HEIGHT + TIGHT_MARGIN;
 #endif
 
+#ifdef HAVE_ZSTD
+    zstdrleButton = new Fl_Round_Button(LBLRIGHT(tx, ty,
+                                                 RADIO_MIN_WIDTH,
+                                                 RADIO_HEIGHT,
+                                                 "ZstdRLE"));
+    zstdrleButton->type(FL_RADIO_BUTTON);
+    ty += RADIO_HEIGHT + TIGHT_MARGIN;
+#endif
+
     rawButton = new Fl_Round_Button(LBLRIGHT(tx, ty,
                                              RADIO_MIN_WIDTH,
                                              RADIO_HEIGHT,
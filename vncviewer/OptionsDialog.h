@@ -83,6 +83,9 @@ protected:
   Fl_Round_Button *hextileButton;
 #ifdef HAVE_H264
   Fl_Round_Button *h264Button;
+#endif
+#ifdef HAVE_ZSTD
+  Fl_Round_Button *zstdrleButton;
 #endif
   Fl_Round_Button *rawButton;
 
@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if !defined(WIN32) && !defined(__APPLE__)
 #include <sys/ipc.h>
@@ -32,25 +33,31 @@
 #include <FL/x.H>
 
 #include <rfb/LogWriter.h>
+#include <rfb/ScaledPixelBuffer.h>
 #include <rdr/Exception.h>
 
 #include "PlatformPixelBuffer.h"
 
 static rfb::LogWriter vlog("PlatformPixelBuffer");
 
-PlatformPixelBuffer::PlatformPixelBuffer(int width, int height) :
+PlatformPixelBuffer::PlatformPixelBuffer(int width, int height,
+                                         int displayWidth,
+                                         int displayHeight) :
   FullFramePixelBuffer(rfb::PixelFormat(32, 24, false, true,
                                         255, 255, 255, 16, 8, 0),
                        0, 0, NULL, 0),
-  Surface(width, height)
+  Surface(displayWidth, displayHeight), scaled(NULL), unscaledData(NULL)
 #if !defined(WIN32) && !defined(__APPLE__)
   , shminfo(NULL), xim(NULL)
 #endif
 {
+  uint8_t* data;
+  int stride;
+
 #if !defined(WIN32) && !defined(__APPLE__)
-  if (!setupShm(width, height)) {
+  if (!setupShm(displayWidth, displayHeight)) {
     xim = XCreateImage(fl_display, CopyFromParent, 32,
-                       ZPixmap, 0, 0, width, height, 32, 0);
+                       ZPixmap, 0, 0, displayWidth, displayHeight, 32, 0);
     if (!xim)
       throw rdr::Exception("XCreateImage");
 
@@ -61,18 +68,40 @@ PlatformPixelBuffer::PlatformPixelBuffer(int width, int height) :
     vlog.debug("Using standard XImage");
   }
 
-  setBuffer(width, height, (uint8_t*)xim->data,
-            xim->bytes_per_line / (getPF().bpp/8));
+  data = (uint8_t*)xim->data;
+  stride = xim->bytes_per_line / (getPF().bpp/8);
 
   // On X11, the Pixmap backing this Surface is uninitialized.
   clear(0, 0, 0);
 #else
-  setBuffer(width, height, (uint8_t*)Surface::data, width);
+  data = (uint8_t*)Surface::data;
+  stride = displayWidth;
 #endif
+
+  if ((width == displayWidth) && (height == displayHeight)) {
+    setBuffer(width, height, data, stride);
+    return;
+  }
+
+  // The decoders need the full framebuffer, and then only the areas
+  // that change get scaled down to what is shown
+  vlog.debug("Scaling framebuffer from %dx%d to %dx%d",
+             width, height, displayWidth, displayHeight);
+
+  unscaledData = new uint8_t[width * height * (getPF().bpp/8)];
+  memset(unscaledData, 0, width * height * (getPF().bpp/8));
+  setBuffer(width, height, unscaledData, width);
+
+  scaled = new rfb::ScaledPixelBuffer(this, displayWidth, displayHeight,
+                                      rfb::defaultScaleFilter,
+                                      data, stride);
 }
 
 PlatformPixelBuffer::~PlatformPixelBuffer()
 {
+  delete scaled;
+  delete [] unscaledData;
+
 #if !defined(WIN32) && !defined(__APPLE__)
   if (shminfo) {
     vlog.debug("Freeing shared memory XImage");
@@ -100,13 +129,22 @@ void PlatformPixelBuffer::commitBufferRW(const rfb::Rect& r)
 
 rfb::Rect PlatformPixelBuffer::getDamage(void)
 {
+  rfb::Region changed;
   rfb::Rect r;
 
   mutex.lock();
-  r = damage.get_bounding_rect();
+  changed = damage;
   damage.clear();
   mutex.unlock();
 
+  if (scaled) {
+    changed = scaled->scaleRegion(changed);
+    scaled->invalidate(changed);
+    scaled->refresh();
+  }
+
+  r = changed.get_bounding_rect();
+
 #if !defined(WIN32) && !defined(__APPLE__)
   if (r.width() == 0 || r.height() == 0)
     return r;
@@ -131,6 +169,20 @@ rfb::Rect PlatformPixelBuffer::getDamage(void)
   return r;
 }
 
+rfb::Point PlatformPixelBuffer::scalePoint(const rfb::Point& p)
+{
+  if (!scaled)
+    return p;
+  return scaled->scalePoint(p);
+}
+
+rfb::Point PlatformPixelBuffer::unscalePoint(const rfb::Point& p)
+{
+  if (!scaled)
+    return p;
+  return scaled->unscalePoint(p);
+}
+
 #if !defined(WIN32) && !defined(__APPLE__)
 
 static bool caughtError;
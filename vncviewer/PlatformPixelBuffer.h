@@ -35,15 +35,25 @@
 
 #include "Surface.h"
 
+namespace rfb { class ScaledPixelBuffer; }
+
 class PlatformPixelBuffer: public rfb::FullFramePixelBuffer, public Surface {
 public:
-  PlatformPixelBuffer(int width, int height);
+  // The framebuffer is width x height, but it is shown scaled to
+  // displayWidth x displayHeight if those differ
+  PlatformPixelBuffer(int width, int height,
+                      int displayWidth, int displayHeight);
   ~PlatformPixelBuffer();
 
   virtual void commitBufferRW(const rfb::Rect& r);
 
+  // Returns the changed area in display coordinates
   rfb::Rect getDamage(void);
 
+  // Conversion between framebuffer and display coordinates
+  rfb::Point scalePoint(const rfb::Point& p);
+  rfb::Point unscalePoint(const rfb::Point& p);
+
   using rfb::FullFramePixelBuffer::width;
   using rfb::FullFramePixelBuffer::height;
 
@@ -51,6 +61,9 @@ protected:
   os::Mutex mutex;
   rfb::Region damage;
 
+  rfb::ScaledPixelBuffer* scaled;
+  uint8_t* unscaledData;
+
 #if !defined(WIN32) && !defined(__APPLE__)
 protected:
   bool setupShm(int width, int height);
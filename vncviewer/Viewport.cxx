@@ -29,6 +29,7 @@
 #include <rfb/LogWriter.h>
 #include <rfb/Exception.h>
 #include <rfb/KeysymStr.h>
+#include <rfb/Tracer.h>
 #include <rfb/ledStates.h>
 #include <rfb/util.h>
 
@@ -116,7 +117,7 @@ static const WORD SCAN_FAKE = 0xaa;
 #endif
 
 Viewport::Viewport(int w, int h, const rfb::PixelFormat& /*serverPF*/, CConn* cc_)
-  : Fl_Widget(0, 0, w, h), cc(cc_), frameBuffer(NULL),
+  : Fl_Widget(0, 0, scaledSize(w), scaledSize(h)), cc(cc_), frameBuffer(NULL),
     lastPointerPos(0, 0), lastButtonMask(0),
 #ifdef WIN32
     altGrArmed(false),
@@ -168,7 +169,7 @@ Viewport::Viewport(int w, int h, const rfb::PixelFormat& /*serverPF*/, CConn* cc
   // We need to intercept keyboard events early
   Fl::add_system_handler(handleSystemEvent, this);
 
-  frameBuffer = new PlatformPixelBuffer(w, h);
+  frameBuffer = new PlatformPixelBuffer(w, h, this->w(), this->h());
   assert(frameBuffer);
   cc->setFramebuffer(frameBuffer);
 
@@ -531,23 +532,51 @@ void Viewport::draw(Surface* dst)
 void Viewport::draw()
 {
   int X, Y, W, H;
+  uint64_t start;
 
   // Check what actually needs updating
   fl_clip_box(x(), y(), w(), h(), X, Y, W, H);
   if ((W == 0) || (H == 0))
     return;
 
+  start = Tracer::now();
   frameBuffer->draw(X - x(), Y - y(), X, Y, W, H);
+  Tracer::record(tracePresent, 0, Tracer::currentFrame(),
+                 start, Tracer::now(), W * H);
+}
+
+
+int Viewport::scaledSize(int size)
+{
+  if (::scale >= 100)
+    return size;
+
+  return __rfbmax(1, size * ::scale / 100);
+}
+
+
+rfb::Point Viewport::scalePoint(const rfb::Point& pos)
+{
+  return frameBuffer->scalePoint(pos);
 }
 
 
 void Viewport::resize(int x, int y, int w, int h)
 {
-  if ((w != frameBuffer->width()) || (h != frameBuffer->height())) {
+  int fbWidth, fbHeight;
+
+  // The widget size is what is shown on screen, which isn't the size
+  // of the framebuffer when scaling
+  fbWidth = cc->server.width();
+  fbHeight = cc->server.height();
+
+  if ((fbWidth != frameBuffer->width()) ||
+      (fbHeight != frameBuffer->height())) {
     vlog.debug("Resizing framebuffer from %dx%d to %dx%d",
-               frameBuffer->width(), frameBuffer->height(), w, h);
+               frameBuffer->width(), frameBuffer->height(),
+               fbWidth, fbHeight);
 
-    frameBuffer = new PlatformPixelBuffer(w, h);
+    frameBuffer = new PlatformPixelBuffer(fbWidth, fbHeight, w, h);
     assert(frameBuffer);
     cc->setFramebuffer(frameBuffer);
   }
@@ -792,7 +821,7 @@ void Viewport::flushPendingClipboard()
 
 void Viewport::handlePointerEvent(const rfb::Point& pos, int buttonMask)
 {
-  filterPointerEvent(pos, buttonMask);
+  filterPointerEvent(frameBuffer->unscalePoint(pos), buttonMask);
 }
 
 
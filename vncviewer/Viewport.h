@@ -41,6 +41,12 @@ public:
   Viewport(int w, int h, const rfb::PixelFormat& serverPF, CConn* cc_);
   ~Viewport();
 
+  // Size on screen of something of the given size in the framebuffer
+  static int scaledSize(int size);
+
+  // Position on screen of a point in the framebuffer
+  rfb::Point scalePoint(const rfb::Point& pos);
+
   // Most efficient format (from Viewport's point of view)
   const rfb::PixelFormat &getPreferredPF();
 
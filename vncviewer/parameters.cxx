@@ -102,6 +102,10 @@ BoolParameter noJpeg("NoJPEG",
 IntParameter qualityLevel("QualityLevel",
                           "JPEG quality level. 0 = Low, 9 = High",
                           8);
+IntParameter contentCacheSize("ContentCacheSize",
+                              "Memory in MiB to use for keeping copies of "
+                              "repeated screen content (0 disables)",
+                              64, 0);
 
 BoolParameter maximize("Maximize", "Maximize viewer window", false);
 BoolParameter fullScreen("FullScreen", "Enable full screen", false);
@@ -120,6 +124,9 @@ StringParameter desktopSize("DesktopSize",
                             "connect (if possible)", "");
 StringParameter geometry("geometry",
                          "Specify size and position of viewer window", "");
+IntParameter scale("Scale",
+                   "Percentage of its real size to show the remote "
+                   "desktop at", 100, 1, 100);
 
 BoolParameter listenMode("listen", "Listen for connections from VNC servers", false);
 
@@ -191,10 +198,12 @@ static VoidParameter* parameterArray[] = {
   &compressLevel,
   &noJpeg,
   &qualityLevel,
+  &contentCacheSize,
   /* Display */
   &fullScreen,
   &fullScreenMode,
   &fullScreenSelectedMonitors,
+  &scale,
   /* Input */
   &viewOnly,
   &emulateMiddleButton,
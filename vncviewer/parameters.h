@@ -47,6 +47,7 @@ extern rfb::BoolParameter customCompressLevel;
 extern rfb::IntParameter compressLevel;
 extern rfb::BoolParameter noJpeg;
 extern rfb::IntParameter qualityLevel;
+extern rfb::IntParameter contentCacheSize;
 
 extern rfb::BoolParameter maximize;
 extern rfb::BoolParameter fullScreen;
@@ -55,6 +56,7 @@ extern rfb::BoolParameter fullScreenAllMonitors; // deprecated
 extern MonitorIndicesParameter fullScreenSelectedMonitors;
 extern rfb::StringParameter desktopSize;
 extern rfb::StringParameter geometry;
+extern rfb::IntParameter scale;
 extern rfb::BoolParameter remoteResize;
 
 extern rfb::BoolParameter listenMode;